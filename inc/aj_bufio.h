@@ -55,11 +55,15 @@ typedef AJ_Status (*AJ_RxFunc)(struct _AJ_IOBuffer* buf, uint32_t len, uint32_t
 #define AJ_IO_BUF_RX     1 /**< I/O direction is receive */
 #define AJ_IO_BUF_TX     2 /**< I/O direction is send */
 
+#define AJ_IO_BUF_MORE     1 /**< More data follows so the transport may hold back a partial packet */
+#define AJ_IO_BUF_NONBLOCK 2 /**< Only send what can be sent without blocking */
+
 /**
  * A type for managing a receive or transmit buffer
  */
 typedef struct _AJ_IOBuffer {
     uint8_t direction;  /**< I/O buffer is either a Tx buffer or an Rx buffer */
+    uint8_t flags;      /**< Hints to the send function */
     uint16_t bufSize;   /**< Size of the data buffer */
     uint8_t* bufStart;  /**< Start for the data buffer */
     uint8_t* readPtr;   /**< Current position in buf for reading data */
@@ -313,7 +313,8 @@ AJ_Status AJ_BusSetLinkTimeout(AJ_BusAttachment* bus, uint32_t sessionId, uint32
 /**
  * Invoke a built-in handler for standard bus messages. Signals passed to this function that are
  * not bus messages are silently ignored. Method calls passed to this function that are not
- * recognized bus messages are rejected with an error response.
+ * recognized bus messages are rejected with an error response. Method replies and timeout errors for
+ * calls made with AJ_MarshalMethodCallAsync() are passed to the callback for the call.
  *
  * Method calls that currently have built-in handlers are:
  *
@@ -0,0 +1,215 @@
+#ifndef _AJ_COMPRESS_H
+#define _AJ_COMPRESS_H
+/**
+ * @file aj_compress.h
+ * @defgroup aj_compress Message Header and Body Compression
+ * @{
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_status.h"
+#include "aj_msg.h"
+
+/*
+ * A signal marshaled with the AJ_FLAG_COMPRESSED flag replaces the object path, interface, member,
+ * destination, signature, time-to-live and session id header fields with a compression token. A
+ * receiver that does not know the token asks the sender for the expanded header fields by calling
+ * org.alljoyn.Bus.Peer.HeaderCompression.GetExpansion.
+ */
+
+/**
+ * Maximum number of compression rules cached for sending and, separately, for receiving.
+ */
+#define AJ_MAX_COMPRESSION_RULES  4
+
+/**
+ * Space for the string header fields of a single compression rule.
+ */
+#define AJ_COMPRESSION_RULE_SIZE  128
+
+/**
+ * Get the compression token for the header of a signal that is being marshaled. A new token is
+ * allocated if the header fields do not match any of the cached rules.
+ *
+ * @param msg  The message being marshaled
+ *
+ * @return  The compression token or 0 if the header cannot be compressed
+ */
+uint32_t AJ_CompressionToken(const AJ_Message* msg);
+
+/**
+ * Fill in the header fields of a compressed message that is being unmarshaled. If the token is not
+ * known a GetExpansion method call is sent to the sender of the message.
+ *
+ * @param msg    The message being unmarshaled
+ * @param token  The compression token from the message header
+ *
+ * @return
+ *          - AJ_OK if the header fields were expanded
+ *          - AJ_ERR_NO_MATCH if the expansion for the token is not yet known
+ *          - AJ_ERR_UNMARSHAL if the message has no sender
+ */
+AJ_Status AJ_ExpandHeader(AJ_Message* msg, uint32_t token);
+
+/**
+ * Handle a GetExpansion method call from a peer
+ *
+ * @param msg    The GetExpansion method call
+ * @param reply  The reply to marshal
+ *
+ * @return  Return AJ_Status
+ */
+AJ_Status AJ_HandleGetExpansion(AJ_Message* msg, AJ_Message* reply);
+
+/**
+ * Handle the reply (or error) to a GetExpansion method call
+ *
+ * @param msg    The method reply
+ *
+ * @return  Return AJ_Status
+ */
+AJ_Status AJ_HandleGetExpansionReply(AJ_Message* msg);
+
+/**
+ * Discard all compression rules and negotiated body compression peers, called when connecting to a
+ * bus.
+ */
+void AJ_ClearCompressionRules(void);
+
+/*
+ * A message marshaled with the AJ_FLAG_BODY_COMPRESSED flag has its body compressed with an LZ4
+ * block compressor when it is delivered. The flag is an opt-in, it is cleared and the body is sent
+ * uncompressed unless the destination is a unique name that has negotiated body compression by
+ * calling org.alljoyn.Bus.Peer.BodyCompression.Negotiate, the body is at least as large as the
+ * compression threshold, and compressing actually makes the body smaller. A compressed body is the
+ * uncompressed body length as a uint32 followed by the LZ4 block.
+ *
+ * There is no compression dictionary: compression and decompression both work in place in the free
+ * space at the end of the I/O buffers so matches are limited to a small window.
+ */
+
+/**
+ * Matches are searched for in this many preceding bytes. The free space in the transmit buffer
+ * must be a little larger than the window for a body to be compressed.
+ */
+#ifndef AJ_BODY_COMPRESSION_WINDOW
+#define AJ_BODY_COMPRESSION_WINDOW  256
+#endif
+
+/**
+ * Default minimum body size worth compressing
+ */
+#ifndef AJ_BODY_COMPRESSION_THRESHOLD
+#define AJ_BODY_COMPRESSION_THRESHOLD  128
+#endif
+
+/**
+ * Maximum number of peers that body compression can be negotiated with
+ */
+#define AJ_MAX_BODY_COMPRESSION_PEERS  4
+
+/**
+ * Body compression statistics
+ */
+typedef struct _AJ_BodyCompressionStats {
+    uint32_t compressed;    /**< Messages sent with a compressed body */
+    uint32_t skipped;       /**< Messages flagged for compression that were sent uncompressed */
+    uint32_t bytesIn;       /**< Body bytes before compression of the messages that were compressed */
+    uint32_t bytesOut;      /**< Body bytes after compression of the messages that were compressed */
+    uint32_t expanded;      /**< Compressed messages received */
+} AJ_BodyCompressionStats;
+
+/**
+ * Ask a peer to negotiate body compression. The reply is handled by AJ_BusHandleBusMessage(), after
+ * that messages to the peer marshaled with AJ_FLAG_BODY_COMPRESSED are compressed.
+ *
+ * @param bus   The bus attachment
+ * @param peer  The unique name of the peer
+ *
+ * @return  Return AJ_Status
+ */
+AJ_Status AJ_NegotiateBodyCompression(AJ_BusAttachment* bus, const char* peer);
+
+/**
+ * Check if body compression has been negotiated with a peer
+ *
+ * @param peer  The unique name of the peer
+ *
+ * @return  TRUE if messages to the peer can be compressed
+ */
+uint8_t AJ_BodyCompressionNegotiated(const char* peer);
+
+/**
+ * Set the minimum body size that is worth compressing
+ *
+ * @param threshold  The threshold in bytes
+ */
+void AJ_SetBodyCompressionThreshold(uint32_t threshold);
+
+/**
+ * Get the body compression statistics
+ *
+ * @return  The statistics since the last call to AJ_ClearCompressionRules()
+ */
+const AJ_BodyCompressionStats* AJ_GetBodyCompressionStats(void);
+
+/**
+ * Compress the body of a message that is about to be delivered. The entire message must be in the
+ * transmit buffer. Clears AJ_FLAG_BODY_COMPRESSED if the body is not compressed.
+ *
+ * @param msg  The message being delivered
+ */
+void AJ_CompressBody(AJ_Message* msg);
+
+/**
+ * Decompress the body of a message that is being unmarshaled. The entire body must be in the
+ * receive buffer and the read pointer must be at the start of the body.
+ *
+ * @param msg  The message being unmarshaled
+ * @param len  The length of the compressed body not including any message authentication code
+ *
+ * @return
+ *          - AJ_OK if the body was decompressed
+ *          - AJ_ERR_RESOURCES if the decompressed body will not fit in the receive buffer
+ *          - AJ_ERR_UNMARSHAL if the compressed body is corrupt
+ */
+AJ_Status AJ_ExpandBody(AJ_Message* msg, uint32_t len);
+
+/**
+ * Handle a Negotiate method call from a peer
+ *
+ * @param msg    The Negotiate method call
+ * @param reply  The reply to marshal
+ *
+ * @return  Return AJ_Status
+ */
+AJ_Status AJ_HandleNegotiateBodyCompression(AJ_Message* msg, AJ_Message* reply);
+
+/**
+ * Handle the reply (or error) to a Negotiate method call
+ *
+ * @param msg    The method reply
+ *
+ * @return  Return AJ_Status
+ */
+AJ_Status AJ_HandleNegotiateBodyCompressionReply(AJ_Message* msg);
+
+/**
+ * @}
+ */
+#endif
@@ -24,6 +24,34 @@
 #include "aj_target.h"
 #include "aj_status.h"
 #include "aj_bus.h"
+#include "aj_disco.h"
+
+/*
+ * AJ_Connect() remembers the address of the daemon it connected to in RAM and NVRAM. The next
+ * connect to the same service name tries that address first, with a short timeout, and only
+ * falls back to discovery if it cannot connect.
+ */
+
+/**
+ * How long in milliseconds AJ_Connect() waits to connect to the cached daemon address
+ */
+#ifndef AJ_CACHED_CONNECT_TIMEOUT
+#define AJ_CACHED_CONNECT_TIMEOUT  1000
+#endif
+
+/**
+ * Connection statistics
+ */
+typedef struct _AJ_ConnectStats {
+    uint32_t connects;          /**< Successful connects */
+    uint32_t failures;          /**< Failed connects */
+    uint32_t cached;            /**< Connects to the cached daemon address that skipped discovery */
+    uint32_t discovered;        /**< Connects that needed discovery */
+    uint32_t connectTime;       /**< Milliseconds the last successful AJ_Connect() took */
+    uint32_t reconnects;        /**< Successful connects after a disconnect */
+    uint32_t reconnectTime;     /**< Milliseconds from the last disconnect to being connected again */
+    uint32_t maxReconnectTime;  /**< Longest time from a disconnect to being connected again */
+} AJ_ConnectStats;
 
 /**
  * Establish an AllJoyn connection.
@@ -45,6 +73,27 @@ AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t ti
  */
 void AJ_Disconnect(AJ_BusAttachment* bus);
 
+/**
+ * Set the daemon address AJ_Connect() tries before discovery, for example an address provisioned by
+ * the application. The address is saved in NVRAM.
+ *
+ * @param serviceName  The service name passed to AJ_Connect(), NULL for the default name
+ * @param service      The address of the daemon
+ */
+void AJ_SetCachedService(const char* serviceName, const AJ_Service* service);
+
+/**
+ * Forget the cached daemon address so the next AJ_Connect() discovers a daemon.
+ */
+void AJ_ClearCachedService(void);
+
+/**
+ * Get the connection statistics
+ *
+ * @param stats  Returns the statistics
+ */
+void AJ_GetConnectStats(AJ_ConnectStats* stats);
+
 /**
  * Bus authentication password function prototype for requesting a
  * password (to authenticate with the daemon) from the application.
@@ -25,6 +25,9 @@
 /**
  * Computes a 16-bit CRC on a buffer. The caller provides the context for the running CRC.
  *
+ * Define AJ_CRC16_SLICE_BY_8 to use the faster slicing-by-8 implementation, this needs
+ * an extra 3.5K of constant tables. Both implementations compute the same CRC.
+ *
  * @param buffer         buffer over which to compute the CRC
  * @param bufLen         length of the buffer in bytes
  * @param runningCrc     On input the current CRC, on output the updated CRC.
@@ -0,0 +1,111 @@
+#ifndef _AJ_FILTER_H
+#define _AJ_FILTER_H
+/**
+ * @file aj_filter.h
+ * @defgroup aj_filter Early Signal Filtering
+ * @{
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_status.h"
+#include "aj_msg.h"
+
+/*
+ * Signal filters are checked by AJ_UnmarshalMsg() as soon as the header fields of a signal have
+ * been unmarshaled. A signal that is dropped by a filter is discarded without loading, decrypting
+ * or decompressing the body and without looking up the message id, AJ_UnmarshalMsg() returns
+ * AJ_ERR_NO_MATCH.
+ *
+ * Filters are checked in the order they were registered and the first filter that matches decides
+ * what happens to the signal. Signals that do not match any filter get the default action. Signals
+ * from the bus itself (the org.freedesktop.DBus and org.alljoyn.Bus interfaces) are never filtered.
+ */
+
+/**
+ * Maximum number of signal filters that can be registered
+ */
+#define AJ_MAX_SIGNAL_FILTERS  8
+
+#define AJ_SIGNAL_FILTER_ACCEPT  0   /**< Unmarshal the signal as normal */
+#define AJ_SIGNAL_FILTER_DROP    1   /**< Discard the signal */
+
+/**
+ * A signal filter. NULL strings and a zero session id match any value. The strings are not copied
+ * so must remain valid while the filter is registered.
+ */
+typedef struct _AJ_SignalFilter {
+    const char* iface;       /**< Interface name */
+    const char* member;      /**< Signal name */
+    const char* sender;      /**< Unique name of the sender */
+    uint32_t sessionId;      /**< Session id */
+    uint8_t action;          /**< AJ_SIGNAL_FILTER_ACCEPT or AJ_SIGNAL_FILTER_DROP */
+} AJ_SignalFilter;
+
+/**
+ * Signal filter statistics
+ */
+typedef struct _AJ_SignalFilterStats {
+    uint32_t messages;       /**< Signals dropped */
+    uint32_t bytes;          /**< Total length of the signals dropped including the header */
+} AJ_SignalFilterStats;
+
+/**
+ * Register a signal filter. The filter is copied.
+ *
+ * @param filter  The filter to register
+ *
+ * @return
+ *          - AJ_OK if the filter was registered
+ *          - AJ_ERR_RESOURCES if AJ_MAX_SIGNAL_FILTERS filters are already registered
+ */
+AJ_Status AJ_RegisterSignalFilter(const AJ_SignalFilter* filter);
+
+/**
+ * Set the action for signals that do not match any registered filter, the default is
+ * AJ_SIGNAL_FILTER_ACCEPT.
+ *
+ * @param action  AJ_SIGNAL_FILTER_ACCEPT or AJ_SIGNAL_FILTER_DROP
+ */
+void AJ_SetSignalFilterDefault(uint8_t action);
+
+/**
+ * Unregister all signal filters, restore the default action and reset the statistics
+ */
+void AJ_ClearSignalFilters(void);
+
+/**
+ * Get the signal filter statistics
+ *
+ * @return  The statistics since the last call to AJ_ClearSignalFilters()
+ */
+const AJ_SignalFilterStats* AJ_GetSignalFilterStats(void);
+
+/**
+ * Check if a signal that is being unmarshaled should be dropped and if so count it. Only the header
+ * fields of the message are used.
+ *
+ * @param msg  The message being unmarshaled
+ *
+ * @return  TRUE if the message should be discarded
+ */
+uint8_t AJ_DropSignal(const AJ_Message* msg);
+
+/**
+ * @}
+ */
+#endif
@@ -113,6 +113,23 @@ typedef struct _AJ_Object {
 } AJ_Object;
 
 
+/**
+ * The member encodings of the registered interfaces are parsed once by AJ_RegisterObjects() into
+ * descriptors holding the member kind, name length, property access and signatures. Interfaces
+ * that do not fit in the descriptor tables are parsed every time they are used.
+ */
+#ifndef AJ_MAX_INTERFACE_DESCRIPTORS
+#define AJ_MAX_INTERFACE_DESCRIPTORS  32   /**< Maximum number of interfaces with member descriptors */
+#endif
+
+#ifndef AJ_MAX_MEMBER_DESCRIPTORS
+#define AJ_MAX_MEMBER_DESCRIPTORS     128  /**< Maximum number of member descriptors */
+#endif
+
+#ifndef AJ_MEMBER_SIGNATURE_POOL
+#define AJ_MEMBER_SIGNATURE_POOL      384  /**< Space for the member signatures, identical signatures are shared */
+#endif
+
 /*
  * Indicates that an identified member belongs to an application object
  */
@@ -150,6 +167,9 @@ typedef struct _AJ_Object {
  * objects that have methods that this object can call and signals
  * that remote objects emit that this application can receive.
  *
+ * The interface descriptions of the standard, local and proxy objects are parsed into member
+ * descriptors so must not be changed while they are registered.
+ *
  * @param localObjects  A NULL terminated array of object info structs.
  * @param proxyObjects  A NULL terminated array of object info structs.
  */
@@ -177,6 +197,39 @@ void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObj
  */
 AJ_Status AJ_IdentifyMessage(AJ_Message* msg);
 
+/**
+ * Type for a function that identifies method calls and signals for an object list, typically
+ * generated from introspection XML by tools/ajgen.py. The function must only match objects in the
+ * list that are not disabled.
+ *
+ * @param objList  The registered object list the function was generated for
+ * @param msg      The method call or signal to identify
+ *
+ * @return
+ *         - AJ_OK if the message was identified, msg->msgId is set to the object, interface and
+ *           member indices, AJ_IdentifyMessage() adds the object list index.
+ *         - AJ_ERR_SIGNATURE if the member was found but the message signature is wrong
+ *         - AJ_ERR_NO_MATCH if the message does not belong to any of the objects in the list
+ */
+typedef AJ_Status (*AJ_MsgIdLookupFunc)(const AJ_Object* objList, AJ_Message* msg);
+
+#ifndef AJ_MAX_MSGID_LOOKUPS
+#define AJ_MAX_MSGID_LOOKUPS  2   /**< Maximum number of object lists with a message id lookup function */
+#endif
+
+/**
+ * Register a function that replaces the string matching done by AJ_IdentifyMessage() for an object
+ * list. The function is used whenever the object list is registered as the local or proxy objects.
+ *
+ * @param objList  The object list
+ * @param lookup   The lookup function or NULL to go back to string matching
+ *
+ * @return
+ *         - AJ_OK if the function was registered
+ *         - AJ_ERR_RESOURCES if AJ_MAX_MSGID_LOOKUPS functions are already registered
+ */
+AJ_Status AJ_RegisterMsgIdLookup(const AJ_Object* objList, AJ_MsgIdLookupFunc lookup);
+
 /**
  * This function unmarshals the first two arguments of a property SET or GET message, identifies
  * which property the method is accessing and returns the id for the property.
@@ -240,6 +293,14 @@ AJ_Status AJ_InitMessageFromMsgId(AJ_Message* msg, uint32_t msgId, uint8_t msgTy
  */
 AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const char* objPath);
 
+/**
+ * Number of reply contexts, this is the number of method calls that can be waiting for a reply at
+ * the same time.
+ */
+#ifndef AJ_MAX_REPLY_CONTEXTS
+#define AJ_MAX_REPLY_CONTEXTS  2
+#endif
+
 /**
  * Internal function to allocate a reply context for a method call message. Reply contexts are used
  * to associate method replies with method calls. Depending on avaiable system resources the number
@@ -247,12 +308,14 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
  *
  * @param msg      A method call message that needs a reply context
  * @param timeout  The time to wait for a reply  (0 to use the internal default)
+ * @param callback Callback for the reply to an asynchronous method call or NULL
+ * @param context  Context passed to the callback
  *
  * @return   Return AJ_Status
  *         - AJ_OK if the reply context was allocated
  *         - AJ_ERR_RESOURCES if the reply context could not be allocated
  */
-AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout);
+AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout, AJ_MethodReplyCallback callback, void* context);
 
 /**
  * Internal function to release all reply contexts. Called when disconnecting from the bus.
@@ -277,6 +340,16 @@ uint8_t AJ_TimedOutMethodCall(AJ_Message* msg);
  */
 void AJ_ReleaseReplyContext(AJ_Message* msg);
 
+/**
+ * Internal function called by AJ_BusHandleBusMessage() to pass a method reply or a timeout error
+ * to the callback registered by AJ_MarshalMethodCallAsync().
+ *
+ * @param msg  A method reply or error message
+ *
+ * @return  Returns TRUE if the message was passed to a callback, FALSE otherwise.
+ */
+uint8_t AJ_DispatchReply(AJ_Message* msg);
+
 /**
  * Debugging aid prints out the XML for an object table
  */
@@ -52,6 +52,7 @@
  * Message argument flags
  */
 #define AJ_ARRAY_FLAG            0x01   /**< Indicates an argument is an array */
+#define AJ_ARRAY_CURSOR_FLAG     0x02   /**< Indicates an array is being streamed through an AJ_ArrayCursor */
 
 /*
  * Endianess flag. This is the first byte of a message
@@ -66,6 +67,7 @@
 #define AJ_FLAG_NO_REPLY_EXPECTED  0x01    /**< Not expecting a reply */
 #define AJ_FLAG_AUTO_START         0x02    /**< Auto start the service */
 #define AJ_FLAG_ALLOW_REMOTE_MSG   0x04    /**< Allow messeages from remote hosts */
+#define AJ_FLAG_BODY_COMPRESSED    0x08    /**< Body is compressed (see aj_compress.h) */
 #define ALLJOYN_FLAG_SESSIONLESS   0x10    /**< Sessionless message */
 #define AJ_FLAG_GLOBAL_BROADCAST   0x20    /**< Global (bus-to-bus) broadcast */
 #define AJ_FLAG_COMPRESSED         0x40    /**< Header is compressed */
@@ -104,6 +106,30 @@
 #define AJ_HDR_COMPRESSION_TOKEN     0x12  /**< Messages compression token header field type */
 #define AJ_HDR_SESSION_ID            0x13  /**< Session id header field type */
 
+/**
+ * Number of serialized signal and method call headers that are cached for reuse. Marshaling a
+ * message that matches a cached header is a copy of the header plus patching the serial number and
+ * timestamp. Zero disables the cache.
+ */
+#ifndef AJ_MAX_CACHED_HEADERS
+#define AJ_MAX_CACHED_HEADERS  4
+#endif
+
+/**
+ * Maximum size of a cached header including the fixed part and the header pad
+ */
+#ifndef AJ_CACHED_HEADER_SIZE
+#define AJ_CACHED_HEADER_SIZE  192
+#endif
+
+/**
+ * Size of the buffer that collects messages delivered while the transmit side is corked. Zero
+ * disables corking, AJ_CorkMsgs() is then a no-op and messages are sent as they are delivered.
+ */
+#ifndef AJ_CORK_BUFFER_SIZE
+#define AJ_CORK_BUFFER_SIZE  0
+#endif
+
 /**
  * Type for a message argument
  */
@@ -111,7 +137,7 @@ struct _AJ_Arg {
 
     uint8_t typeId;    /**< the argument type */
     uint8_t flags;     /**< non-zero if the value is a variant - values > 1 indicate variant-of-variant etc. */
-    uint16_t len;      /**< length of a string or array in bytes */
+    uint32_t len;      /**< length of a string or array in bytes */
 
     /*
      * Union of the various argument values.
@@ -175,7 +201,7 @@ struct _AJ_Message {
      */
     uint8_t sigOffset;         /**< Offset to current position in the signature */
     uint8_t varOffset;         /**< For variant marshalling/unmarshalling - Offset to start of variant signature */
-    uint16_t bodyBytes;        /**< Running count of the number body bytes written */
+    uint32_t bodyBytes;        /**< Running count of the number body bytes written */
     AJ_BusAttachment* bus;     /**< Bus attachment for this message */
     struct _AJ_Arg* outer;     /**< Container arg current being marshaled */
 
@@ -227,6 +253,32 @@ AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg);
  */
 AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* signature, ...);
 
+/**
+ * Unmarshals an array of structs that have a fixed layout, for example a(ii), a(uuuu) or a(dd), as
+ * an array of C structs. A fixed layout struct has only scalar fields and a wire size that is a
+ * multiple of 8 so there is no padding between the array elements. The whole array is endian
+ * swapped in place and a pointer to the elements in the receive buffer is returned so the elements
+ * are only valid until the message is closed.
+ *
+ * The fields of the C struct must be the wire types in signature order: use uint32_t for booleans.
+ * elemSize is normally sizeof() the C struct and is checked against the wire size so a C struct
+ * with a different layout is rejected. The array must fit in the receive buffer, larger arrays can
+ * be streamed with AJ_UnmarshalArrayCursor() and AJ_UnmarshalArrayChunk().
+ *
+ * @param msg       A pointer to a message that was unmarshaled by an earlier call to AJ_UnmarshalMsg
+ * @param data      Returns a pointer to the array elements
+ * @param elemSize  The size of the C struct
+ * @param numElems  Returns the number of elements in the array
+ *
+ * @return
+ *          - AJ_OK if the array was succesfully unmarshaled.
+ *          - AJ_ERR_SIGNATURE if the next argument is not an array of fixed layout structs of size elemSize
+ *          - AJ_ERR_UNMARSHAL if the array was badly formed
+ *          - AJ_ERR_RESOURCES if the array is too big to unmarshal into the receive buffer
+ *          - AJ_ERR_READ if there was a read failure
+ */
+AJ_Status AJ_UnmarshalStructArray(AJ_Message* msg, const void** data, size_t elemSize, size_t* numElems);
+
 /**
  * Unmarshals data from a message as raw bytes.
  *
@@ -247,6 +299,73 @@ AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* signature, ...);
  */
 AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t* actual);
 
+/**
+ * Cursor for streaming an array that may be larger than the receive buffer
+ */
+typedef struct _AJ_ArrayCursor {
+    AJ_Arg array;        /**< The array container argument, this must be the first member */
+    uint8_t* base;       /**< Receive buffer position of the start of the array, earlier bytes are never moved */
+    uint32_t consumed;   /**< Array bytes consumed before the array data was last moved */
+} AJ_ArrayCursor;
+
+/**
+ * Begin unmarshalling an array argument incrementally. Unlike AJ_UnmarshalContainer() the array
+ * is not loaded into the receive buffer up front: the library refills the buffer as the array is
+ * consumed so the array can be any size.
+ *
+ * For arrays of scalar types call AJ_UnmarshalArrayChunk() to get the elements in chunks. For all
+ * other element types call AJ_UnmarshalArg(), AJ_UnmarshalArgs() or AJ_UnmarshalContainer() for
+ * each element exactly as for an array opened with AJ_UnmarshalContainer(), these return
+ * AJ_ERR_NO_MORE after the last element.
+ *
+ * The header fields and any arguments unmarshaled before the array stay valid, but a chunk or
+ * element is only valid until the next chunk or element is unmarshaled. Each element must fit in
+ * half of the receive buffer space that follows the start of the array. Nested cursors and arrays
+ * inside other arrays are not supported. The bodies of encrypted or compressed messages are loaded
+ * in full before they are unmarshaled so they cannot be larger than the receive buffer.
+ *
+ * @param msg     A pointer to a message that was unmarshaled by an earlier call to AJ_UnmarshalMsg
+ * @param cursor  Returns the cursor for the array
+ *
+ * @return   Return AJ_Status
+ *          - AJ_OK if the array length was succesfully unmarshaled.
+ *          - AJ_ERR_SIGNATURE if the next argument is not an array
+ *          - AJ_ERR_UNEXPECTED if the current container is an array
+ *          - AJ_ERR_UNMARSHAL if the array length is larger than the message body
+ */
+AJ_Status AJ_UnmarshalArrayCursor(AJ_Message* msg, AJ_ArrayCursor* cursor);
+
+/**
+ * Unmarshal the next chunk of elements of an array of scalars or of fixed layout structs (see
+ * AJ_UnmarshalStructArray()) being streamed. The returned data is endian swapped and aligned for
+ * the element type and contains a whole number of elements.
+ *
+ * @param msg     The message being unmarshaled
+ * @param cursor  The array cursor
+ * @param data    Returns a pointer to the elements
+ * @param len     The maximum number of bytes to return
+ * @param actual  Returns the number of bytes returned
+ *
+ * @return   Return AJ_Status
+ *          - AJ_OK if at least one element was returned
+ *          - AJ_ERR_NO_MORE if all the elements have been unmarshaled
+ *          - AJ_ERR_INVALID if len is less than the size of one element
+ *          - AJ_ERR_UNEXPECTED if the array elements are not scalars or fixed layout structs or the
+ *            array is not the current container
+ *          - AJ_ERR_READ if there was a read failure
+ */
+AJ_Status AJ_UnmarshalArrayChunk(AJ_Message* msg, AJ_ArrayCursor* cursor, const void** data, size_t len, size_t* actual);
+
+/**
+ * Finish streaming an array, any elements that have not been unmarshaled are skipped.
+ *
+ * @param msg     The message being unmarshaled
+ * @param cursor  The array cursor
+ *
+ * @return   Return AJ_Status
+ */
+AJ_Status AJ_UnmarshalCloseArrayCursor(AJ_Message* msg, AJ_ArrayCursor* cursor);
+
 /**
  * Begin unmarshalling a container argument.
  *
@@ -316,6 +435,43 @@ typedef uint32_t AJ_SessionId;
  */
 AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout);
 
+/**
+ * Callback for the reply to an asynchronous method call.
+ *
+ * @param reply    The METHOD_RET or ERROR message, for a call that timed out the error name is
+ *                 AJ_ErrTimeout. The callback must not close the message.
+ * @param status   AJ_OK if the reply was accepted. AJ_ERR_SIGNATURE or AJ_ERR_SECURITY if the
+ *                 reply did not have the expected signature or was not encrypted, the reply is
+ *                 discarded so its arguments cannot be unmarshaled.
+ * @param context  The context passed to AJ_MarshalMethodCallAsync()
+ */
+typedef void (*AJ_MethodReplyCallback)(AJ_Message* reply, AJ_Status status, void* context);
+
+/**
+ * Marshal a METHOD_CALL message with a callback for the reply. This allows an application to have
+ * several method calls in flight, up to AJ_MAX_REPLY_CONTEXTS, without handling the replies in its
+ * message loop. Replies and timeout errors are passed to the callback by AJ_BusHandleBusMessage()
+ * so the application must pass messages it does not handle itself to that function.
+ *
+ * @param bus          The bus attachment
+ * @param msg          Pointer to a message structure
+ * @param msgId        The message identifier for this message
+ * @param destination  Bus address of the destination for this message
+ * @param sessionId    The session this message is for.
+ * @param flags        A logical OR of the applicable message flags
+ * @param timeout      Time in milliseconds to allow for a reply to the message before the callback
+ *                     is called with a timeout error message.
+ * @param callback     Function called with the reply
+ * @param context      Context passed to the callback
+ *
+ * @return
+ *          - AJ_OK if a message header was succesfully marshaled
+ *          - AJ_ERR_RESOURCES if the message is too big to marshal into the message buffer or
+ *            if all reply contexts are in use
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_MarshalMethodCallAsync(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout, AJ_MethodReplyCallback callback, void* context);
+
 /**
  * Marshal a SIGNAL message.
  *
@@ -336,6 +492,12 @@ AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t
  */
 AJ_Status AJ_MarshalSignal(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t ttl);
 
+/**
+ * Discard all cached message headers. This is called when the object lists or a proxy object path
+ * change.
+ */
+void AJ_ClearHeaderCache(void);
+
 /**
  * Initialize and marshal a message that is a reply to a method call.
  *
@@ -399,6 +561,41 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg);
  */
 AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining);
 
+/**
+ * Cork the transmit side of a bus attachment. Messages delivered while corked are collected and
+ * written with a single send when AJ_UncorkMsgs() is called, when the cork buffer fills up, or
+ * before AJ_UnmarshalMsg() waits for a message. Use this to batch a burst of signals into one
+ * write, for example corking at the start of a loop iteration and uncorking at the end.
+ *
+ * Only one bus attachment can be corked at a time.
+ *
+ * @param bus  The bus attachment to cork
+ *
+ * @return
+ *          - AJ_OK if the bus attachment is corked or corking is disabled
+ *          - AJ_ERR_RESOURCES if another bus attachment is already corked
+ */
+AJ_Status AJ_CorkMsgs(AJ_BusAttachment* bus);
+
+/**
+ * Send the messages collected since AJ_CorkMsgs() and go back to sending messages as they are
+ * delivered.
+ *
+ * @param bus  The corked bus attachment
+ *
+ * @return
+ *          - AJ_OK if the messages were sent or the bus attachment was not corked
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_UncorkMsgs(AJ_BusAttachment* bus);
+
+/**
+ * Internal function called when disconnecting to drop any corked messages.
+ *
+ * @param bus  The bus attachment that is disconnecting
+ */
+void AJ_ReleaseCorkedMsgs(AJ_BusAttachment* bus);
+
 /**
  * Marshals one or arguments of basic types such as integers, strings, etc. Container types
  * (structs and arrays) must use AJ_MarshalContainer()
@@ -445,6 +642,23 @@ AJ_Arg* AJ_InitArg(AJ_Arg* arg, uint8_t typeId, uint8_t flags, const void* val,
  */
 AJ_Status AJ_MarshalArg(AJ_Message* msg, AJ_Arg* arg);
 
+/**
+ * Marshals an array of C structs as an array of fixed layout structs (see AJ_UnmarshalStructArray())
+ * with one copy into the transmit buffer.
+ *
+ * @param msg       A pointer to the message currently being marshaled
+ * @param data      The array elements
+ * @param elemSize  The size of the C struct, this must match the wire size of the struct
+ * @param numElems  The number of elements in the array
+ *
+ * @return
+ *          - AJ_OK if the array was succesfully marshaled.
+ *          - AJ_ERR_SIGNATURE if the next argument is not an array of fixed layout structs of size elemSize
+ *          - AJ_ERR_RESOURCES if the array is too big to marshal into the message buffer
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_MarshalStructArray(AJ_Message* msg, const void* data, size_t elemSize, size_t numElems);
+
 /**
  * Marshals data for a message as raw bytes. The application is responsible for correctly composing
  * the data according to the wire protocol specification including any padding that may be required
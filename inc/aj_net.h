@@ -53,9 +53,16 @@ void AJ_Net_Down();
 /**
  * Connect to bus at an IPV4 or IPV6 address
  *
+ * @param netSock   The network socket
+ * @param port      The port to connect to
+ * @param addrType  AJ_ADDR_IPV4 or AJ_ADDR_IPV6
+ * @param addr      The address to connect to
+ * @param timeout   Milliseconds to wait for the connection, zero to wait as long as the transport
+ *                  does. Targets that cannot limit the wait ignore the timeout.
+ *
  * @return        Return AJ_Status
  */
-AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr);
+AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr, uint32_t timeout);
 
 /**
  * Disconnect from the bus
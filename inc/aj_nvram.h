@@ -25,6 +25,7 @@
 #include "alljoyn.h"
 
 #define AJ_NVRAM_ID_CREDS_MAX        0x0FFF   /**< Last NVRAM ID reserved for AllJoyn credentials management */
+#define AJ_NVRAM_ID_DAEMON_SERVICE   0x1000   /**< NVRAM ID for the address of the last daemon connected to */
 #define AJ_NVARM_ID_RESERVED_MAX     0x7FFF   /**< Last NVRAM ID reserved for AllJoyn framework and services use */
 #define AJ_NVRAM_ID_FOR_APPS         0x8000   /**< First NVRAM ID available for application used */
 
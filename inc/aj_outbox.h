@@ -0,0 +1,173 @@
+#ifndef _AJ_OUTBOX_H
+#define _AJ_OUTBOX_H
+/**
+ * @file aj_outbox.h
+ * @defgroup aj_outbox Store and Forward Outbox
+ * @{
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_status.h"
+#include "aj_bus.h"
+#include "aj_msg.h"
+
+/*
+ * After AJ_Disconnect() the signals registered with AJ_OutboxSetDurable() are kept in the outbox
+ * instead of being lost. When the bus attachment has connected again AJ_OutboxReplay() sends them
+ * in the order they were delivered, giving each a new serial number and the new unique name of the
+ * bus attachment. Signals with a time to live that has passed are discarded rather than replayed.
+ * Until the outbox is empty durable signals are added to the outbox so they stay in order.
+ *
+ * Only signals that are not part of a session and do not have a compressed header are kept. Body
+ * compression and encryption are applied when the signal is replayed.
+ *
+ * Messages that are not kept fail with AJ_ERR_WRITE while the bus attachment is disconnected.
+ */
+
+/**
+ * Bytes of RAM for the outbox. Zero disables the outbox.
+ */
+#ifndef AJ_OUTBOX_SIZE
+#define AJ_OUTBOX_SIZE  0
+#endif
+
+/**
+ * Bytes of the file the outbox spills into when the RAM is full. Zero for no spill file. The
+ * target provides the file, see AJ_Outbox_MapSpill(). On linux the application must also define
+ * AJ_OUTBOX_SPILL_FILE with the path of the file.
+ */
+#ifndef AJ_OUTBOX_SPILL_SIZE
+#define AJ_OUTBOX_SPILL_SIZE  0
+#endif
+
+/**
+ * Maximum number of durable signals
+ */
+#ifndef AJ_OUTBOX_MAX_DURABLE
+#define AJ_OUTBOX_MAX_DURABLE  8
+#endif
+
+/**
+ * Maximum number of signals AJ_OutboxReplay() sends in one call
+ */
+#ifndef AJ_OUTBOX_BATCH
+#define AJ_OUTBOX_BATCH  16
+#endif
+
+/**
+ * Outbox statistics
+ */
+typedef struct _AJ_OutboxStats {
+    uint32_t depth;          /**< Signals in the outbox */
+    uint32_t bytes;          /**< Bytes in the outbox including the spill file */
+    uint32_t maxBytes;       /**< Most bytes that were ever in the outbox */
+    uint32_t captured;       /**< Signals kept while disconnected */
+    uint32_t spilled;        /**< Signals kept in the spill file */
+    uint32_t dropped;        /**< Signals dropped because the outbox was full or the signal was too big to replay */
+    uint32_t expired;        /**< Signals discarded because their time to live had passed */
+    uint32_t replayed;       /**< Signals replayed */
+    uint32_t replayBytes;    /**< Bytes of the signals replayed */
+    uint32_t replayTime;     /**< Milliseconds between reconnecting and the outbox becoming empty */
+} AJ_OutboxStats;
+
+/**
+ * Make a signal durable so it is kept in the outbox while the bus attachment is disconnected.
+ *
+ * @param msgId    The message id of the signal as passed to AJ_MarshalSignal()
+ * @param durable  TRUE to make the signal durable, FALSE to make it an ordinary signal
+ *
+ * @return
+ *          - AJ_OK if the signal was set
+ *          - AJ_ERR_RESOURCES if there are already AJ_OUTBOX_MAX_DURABLE durable signals
+ */
+AJ_Status AJ_OutboxSetDurable(uint32_t msgId, uint8_t durable);
+
+/**
+ * Send a batch of up to AJ_OUTBOX_BATCH signals from the outbox. Call this after connecting until
+ * it returns AJ_OK, AJ_RunAllJoynService() does this automatically.
+ *
+ * @param bus  The bus attachment
+ *
+ * @return
+ *          - AJ_OK if the outbox is empty
+ *          - AJ_ERR_BUSY if there are more signals to replay
+ *          - AJ_ERR_WRITE if there was a write failure, the signal stays in the outbox
+ */
+AJ_Status AJ_OutboxReplay(AJ_BusAttachment* bus);
+
+/**
+ * Discard everything in the outbox
+ */
+void AJ_OutboxClear(void);
+
+/**
+ * Get the outbox statistics
+ *
+ * @param stats  Returns the statistics
+ */
+void AJ_OutboxGetStats(AJ_OutboxStats* stats);
+
+/**
+ * Internal function that checks if AJ_DeliverMsg() should put a message in the outbox.
+ *
+ * @param msg  The message being delivered
+ *
+ * @return  TRUE if the message is a durable signal and the bus attachment is disconnected or the
+ *          outbox is not empty
+ */
+uint8_t AJ_OutboxCaptures(AJ_Message* msg);
+
+/**
+ * Internal function called by AJ_DeliverMsg() to put a message in the outbox.
+ *
+ * @param msg  The message being delivered
+ *
+ * @return
+ *          - AJ_OK if the message is in the outbox
+ *          - AJ_ERR_RESOURCES if the outbox is full
+ */
+AJ_Status AJ_OutboxMsg(AJ_Message* msg);
+
+/**
+ * Internal function called by AJ_Disconnect(). The transmit buffer of the bus attachment stays
+ * usable so signals can be marshaled while disconnected.
+ *
+ * @param bus  The bus attachment that has disconnected
+ */
+void AJ_OutboxDisconnected(AJ_BusAttachment* bus);
+
+/**
+ * Internal function called by AJ_Connect() once the bus attachment has its unique name.
+ *
+ * @param bus  The bus attachment that has connected
+ */
+void AJ_OutboxConnected(AJ_BusAttachment* bus);
+
+/**
+ * Target function that maps the spill file into memory.
+ *
+ * @param size  Size of the spill file
+ *
+ * @return  The address of the mapped file or NULL if it could not be mapped
+ */
+uint8_t* AJ_Outbox_MapSpill(uint32_t size);
+
+/**
+ * @}
+ */
+#endif
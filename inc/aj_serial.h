@@ -21,6 +21,7 @@
 #ifdef AJ_SERIAL_CONNECTION
 #include "aj_target.h"
 #include "aj_status.h"
+#include "aj_util.h"
 
 /*
  * SLIP encapsulation characters as defined in (the ancient) RFC 1055
@@ -34,7 +35,25 @@
  * maximum and minimum window sizes
  */
 #define MIN_WINDOW_SIZE        1
-#define MAX_WINDOW_SIZE        4
+#define MAX_WINDOW_SIZE        8
+
+/*
+ * Largest window that can be used with a peer that does not support the extended window
+ * mode. Legacy peers use three bit sequence numbers.
+ */
+#define MAX_LEGACY_WINDOW_SIZE 4
+
+/*
+ * SLAP protocol version that introduced the extended window mode: four bit sequence numbers,
+ * windows of up to MAX_WINDOW_SIZE packets and selective acknowledgements.
+ */
+#define SLAP_VERSION_EXTENDED  1
+
+/*
+ * Sequence number masks for the legacy and extended window modes.
+ */
+#define AJ_SERIAL_SEQ_MASK          0x07
+#define AJ_SERIAL_EXTENDED_SEQ_MASK 0x0F
 
 /**
  * Packet header is four bytes.
@@ -81,8 +100,14 @@ typedef struct _AJ_LinkParameters {
     uint8_t maxWindowSize;       /**< Window size configuration parameter */
     uint8_t windowSize;          /**< Negotiated window size */
     uint16_t packetSize;         /**< Packet size configuration parameter */
+    uint8_t seqMask;             /**< Negotiated sequence number mask */
 } AJ_LinkParameters;
 
+/**
+ * TRUE if the extended window mode was negotiated with the peer
+ */
+#define AJ_SERIAL_EXTENDED_MODE() (AJ_SerialLinkParams.protoVersion >= SLAP_VERSION_EXTENDED)
+
 
 /**
  * Struct used for transferring buffers to and from the Rx/Tx interrupts.
@@ -95,6 +120,82 @@ typedef struct __AJ_SlippedBuffer {
     struct __AJ_SlippedBuffer volatile* next;
 } AJ_SlippedBuffer;
 
+/**
+ * Capacity of a slipped buffer ring, must be a power of two larger than MAX_WINDOW_SIZE + 1.
+ */
+#define AJ_SERIAL_RING_SIZE  16
+
+/*
+ * Ring indices are only ever written by one side so C11 atomics with acquire/release
+ * ordering are sufficient. Without C11 atomics we rely on volatile as the linked lists did.
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define AJ_SERIAL_RING_ATOMICS
+typedef atomic_uint AJ_SerialRingIndex;
+#else
+typedef volatile uint32_t AJ_SerialRingIndex;
+#endif
+
+/**
+ * Fixed capacity single-producer/single-consumer ring of slipped buffers used to pass
+ * buffers between the Rx/Tx interrupts and the protocol code without locking.
+ */
+typedef struct _AJ_SlippedBufferRing {
+    AJ_SlippedBuffer* volatile entries[AJ_SERIAL_RING_SIZE];
+    AJ_SerialRingIndex head;   /**< next entry to remove, only written by the consumer */
+    AJ_SerialRingIndex tail;   /**< next free entry, only written by the producer */
+} AJ_SlippedBufferRing;
+
+/**
+ * Initialize a slipped buffer ring to empty.
+ *
+ * @param ring   The ring to initialize
+ */
+void AJ_SerialRingInit(AJ_SlippedBufferRing* ring);
+
+/**
+ * Add a buffer to a ring. Must only be called by the producer.
+ *
+ * @param ring   The ring
+ * @param buf    The buffer to add
+ *
+ * @return  TRUE if the buffer was added, FALSE if the ring is full
+ */
+uint8_t AJ_SerialRingPush(AJ_SlippedBufferRing* ring, AJ_SlippedBuffer* buf);
+
+/**
+ * Remove the oldest buffer from a ring. Must only be called by the consumer.
+ *
+ * @param ring   The ring
+ *
+ * @return  The buffer or NULL if the ring is empty
+ */
+AJ_SlippedBuffer* AJ_SerialRingPop(AJ_SlippedBufferRing* ring);
+
+/**
+ * Check if a ring is empty.
+ *
+ * @param ring   The ring
+ *
+ * @return  TRUE if the ring is empty
+ */
+uint8_t AJ_SerialRingEmpty(AJ_SlippedBufferRing* ring);
+
+/**
+ * Allocate a slipped buffer large enough for a packet of the negotiated packet size.
+ *
+ * @return  The buffer or NULL if the allocation failed
+ */
+AJ_SlippedBuffer* AJ_SerialAllocSlippedBuffer(void);
+
+/**
+ * Remove and free all the buffers in a ring.
+ *
+ * @param ring   The ring
+ */
+void AJ_SerialRingClear(AJ_SlippedBufferRing* ring);
+
 /**
  * Function pointer type for an abstracted serial transmit function
  *
@@ -109,8 +210,38 @@ extern AJ_SerialTxFunc g_AJ_TX;
 
 void ClearSlippedBuffer(volatile AJ_SlippedBuffer* buf);
 
+/**
+ * Scan a buffer for the bytes that are special to SLIP encoding.
+ *
+ * @param buf     The buffer to scan
+ * @param len     The length of the buffer
+ *
+ * @return  The number of bytes at the start of the buffer that are neither BOUNDARY_BYTE
+ *          nor ESCAPE_BYTE. These bytes can be copied as-is by the SLIP encoder and decoder.
+ */
+uint16_t AJ_SerialSlipScan(const uint8_t* buf, uint16_t len);
+
 extern volatile int dataReceived;
 extern volatile int dataSent;
+
+/**
+ * Process received buffers, fill transmit buffers and run the transport timers.
+ */
+void AJ_StateMachine();
+
+/**
+ * Wake up a state machine blocked in AJ_SerialWait. Called by the receive and
+ * transmit callbacks so it must be safe to call from interrupt or signal context.
+ */
+void AJ_SerialSignalEvent(void);
+
+/**
+ * Block until AJ_SerialSignalEvent is called, one of the transport timers is due
+ * or the deadline passes.
+ *
+ * @param deadline  The latest time to return, NULL to only wait for the transport
+ */
+void AJ_SerialWait(AJ_Time* deadline);
 /**
  * global variable for link parameters
  */
@@ -118,12 +249,12 @@ extern AJ_LinkParameters AJ_SerialLinkParams;
 
 /**
  * Determine relative ordering of two sequence numbers. Sequence numbers are
- * modulo 8 so 0 > 7.
+ * modulo 8 (modulo 16 in the extended window mode) so 0 > 7.
  *
  * This is used to test for ACKs and to detect gaps in the sequence of received
  * packets.
  */
-#define SEQ_GT(s1, s2)  (((7 + (s1) - (s2)) & 7) < AJ_SerialLinkParams.windowSize)
+#define SEQ_GT(s1, s2)  (((AJ_SerialLinkParams.seqMask + (s1) - (s2)) & AJ_SerialLinkParams.seqMask) < AJ_SerialLinkParams.windowSize)
 
 
 /**
@@ -192,5 +323,31 @@ AJ_Status AJ_SerialRecv(uint8_t* buffer,
                         uint32_t timeout,
                         uint16_t* recv);
 
+/**
+ * Borrow the unread payload of the next received packet without copying it. The data
+ * stays valid until it is released with AJ_SerialRecvRelease, and must be released
+ * before the next call to AJ_SerialRecv or AJ_SerialRecvBorrow.
+ *
+ * @param data         Returns a pointer to the payload
+ * @param len          Returns the number of contiguous payload bytes available
+ * @param timeout      The amount of time to wait for data to arrive
+ *
+ * @return    - AJ_OK if data is available
+ *            - AJ_ERR_TIMEOUT if no data arrived before the timeout
+ */
+AJ_Status AJ_SerialRecvBorrow(const uint8_t** data,
+                              uint16_t* len,
+                              uint32_t timeout);
+
+/**
+ * Consume borrowed payload. Releasing less than was borrowed leaves the rest to be
+ * read by the next call to AJ_SerialRecv or AJ_SerialRecvBorrow. Releasing zero bytes
+ * of a packet that has nothing left to read, for example one with an empty payload,
+ * consumes the packet.
+ *
+ * @param len          The number of bytes consumed
+ */
+void AJ_SerialRecvRelease(uint16_t len);
+
 #endif /* AJ_SERIAL_CONNECTION */
 #endif /* _AJ_SERIAL_H */
@@ -71,6 +71,25 @@ void AJ_SerialTX_ReceivedAck(uint8_t ack);
  */
 void AJ_SerialTX_ReceivedSeq(uint8_t seq);
 
+/**
+ * This function is called by the receive layer when an explicit ACK carrying selective
+ * acknowledgements has been received in the extended window mode. Bit n of sack is set
+ * if the peer has received packet (ack + n + 1).
+ */
+void AJ_SerialTx_ReceivedSack(uint8_t ack, uint8_t sack);
+
+/**
+ * This function is called by the receive layer to update the selective acknowledgement
+ * bits that are sent with the next explicit ACK.
+ */
+void AJ_SerialTx_SetSelectiveAck(uint8_t sack);
+
+/**
+ * This function is called by the receive layer when a packet has been received out of
+ * order in the extended window mode. An explicit ACK is sent immediately.
+ */
+void AJ_SerialTx_ReceivedOutOfOrder(uint8_t sack);
+
 /**
  * This function is called from the state machine to resend any data packets
  * that have not yet been acked.
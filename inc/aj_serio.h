@@ -27,6 +27,15 @@
 #define AJ_SERIO_RX     1 /**< The receive direction (from the wire) of the serial I/O subsystem */
 #define AJ_SERIO_TX     2 /**< The transmit direction (to the wire) of the serial I/O subsystem */
 
+/**
+ * The number of buffers that can be passed to AJ_TX before the first one has completed.
+ * A target that can queue buffers and write them out together defines this in aj_target.h,
+ * otherwise AJ_TX is only called again from the transmit callback.
+ */
+#ifndef AJ_SERIO_TX_DEPTH
+#define AJ_SERIO_TX_DEPTH  1
+#endif
+
 /**
  * A type for managing serial port configuration
  */
@@ -73,7 +82,8 @@ typedef void (*AJ_SerIORxCompleteFunc)(uint8_t* buf, uint16_t len);
 /**
  * Function pointer type for an abstracted transmit callback function
  *
- * @param buf     The buffer that has had its bytes transmitted out
+ * @param buf     The buffer that has had its bytes transmitted out or NULL if the callback was
+ *                asked for with AJ_ResumeTX and no buffer has completed
  * @param len     The number of bytes actually written
  */
 typedef void (*AJ_SerIOTxCompleteFunc)(uint8_t* buf, uint16_t len);
@@ -111,8 +121,22 @@ void AJ_RX(uint8_t* buf, uint32_t len);
 void AJ_PauseRX();
 void AJ_ResumeRX();
 
+/**
+ * Queue a buffer for transmission. The transmit callback is called once the buffer has
+ * been written, buffers complete in the order they were queued. At most AJ_SERIO_TX_DEPTH
+ * buffers are queued at any time.
+ *
+ * @param buf     The buffer to be transmitted
+ * @param len     The number of bytes to write
+ */
 void AJ_TX(uint8_t* buf, uint32_t len);
 void AJ_PauseTX();
+
+/**
+ * Resume the transmitter. Called from outside the transmit callback this also asks for the
+ * callback to be called with a NULL buffer from the transmit context, so a transmitter that
+ * has gone idle can collect buffers that have been published for it.
+ */
 void AJ_ResumeTX();
 
 #endif /* _AJ_SERIO_H */
@@ -82,6 +82,16 @@
 #define AJ_METHOD_EXCHANGE_GROUP_KEYS  AJ_BUS_MESSAGE_ID(2, 1, 2)    /**< method for exchange group keys */
 #define AJ_METHOD_AUTH_CHALLENGE       AJ_BUS_MESSAGE_ID(2, 1, 3)    /**< method for auth challenge */
 
+/*
+ * Members of /org/alljoyn/Bus/Peer interface org.alljoyn.Bus.Peer.HeaderCompression
+ */
+#define AJ_METHOD_GET_EXPANSION        AJ_BUS_MESSAGE_ID(2, 2, 0)    /**< method for get header expansion */
+
+/*
+ * Members of /org/alljoyn/Bus/Peer interface org.alljoyn.Bus.Peer.BodyCompression
+ */
+#define AJ_METHOD_NEGOTIATE_BODY_COMPRESSION  AJ_BUS_MESSAGE_ID(2, 3, 0)    /**< method for negotiating body compression */
+
 /*
  * Members of interface org.freedesktop.DBus.Introspectable
  */
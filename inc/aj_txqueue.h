@@ -0,0 +1,279 @@
+#ifndef _AJ_TXQUEUE_H
+#define _AJ_TXQUEUE_H
+/**
+ * @file aj_txqueue.h
+ * @defgroup aj_txqueue Non-blocking Transmit Queue
+ * @{
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_status.h"
+#include "aj_bus.h"
+#include "aj_msg.h"
+
+/*
+ * While the transmit queue is running AJ_DeliverMsg() copies each message into the queue and
+ * writes as much of the queue as the transport will take without blocking. The rest is written
+ * by later calls to AJ_DeliverMsg(), by AJ_TxQueueDrain() and while AJ_UnmarshalMsg() waits for a
+ * message, so a congested link does not stall the application.
+ *
+ * What happens to a message when the queue is congested depends on the policy registered for its
+ * message id. Only signals have policies, other messages and signals without a policy wait for room
+ * in the queue. A message that is bigger than the I/O buffer (see AJ_DeliverMsgPartial()) also
+ * waits for room rather than split the message.
+ *
+ * The queue is congested when it holds more than the high watermark, when it holds
+ * AJ_TX_QUEUE_MAX_MSGS messages or when a message does not fit. It stops being congested when it
+ * has drained to half the high watermark and half the maximum number of messages.
+ *
+ * Messages are written in priority order. A new message goes ahead of lower priority messages that
+ * have not started to be written, so a message only ever waits behind one lower priority message.
+ * Method replies, errors and link probes are control messages and everything else is normal unless
+ * a priority is set with AJ_TxQueueSetPriority(). Part of the queue is reserved for control
+ * messages so they still fit when bulk messages have filled the rest.
+ *
+ * A state signal registered with AJ_TxQueueSetStateSignal() only carries the latest value of
+ * something. Signals with the same message id, object path and session replace any earlier signal
+ * that has not started to be written, whether or not the queue is congested. They are also sent no
+ * more often than the minimum interval, a newer signal is held back until the interval has passed.
+ */
+
+/**
+ * Size of the transmit queue in bytes. Zero disables the queue, AJ_TxQueueStart() then returns
+ * AJ_ERR_RESOURCES.
+ */
+#ifndef AJ_TX_QUEUE_SIZE
+#define AJ_TX_QUEUE_SIZE  0
+#endif
+
+/**
+ * Maximum number of messages in the transmit queue
+ */
+#ifndef AJ_TX_QUEUE_MAX_MSGS
+#define AJ_TX_QUEUE_MAX_MSGS  32
+#endif
+
+/**
+ * Bytes of the transmit queue that only control messages can use
+ */
+#ifndef AJ_TX_QUEUE_RESERVE
+#define AJ_TX_QUEUE_RESERVE  (AJ_TX_QUEUE_SIZE / 8)
+#endif
+
+/**
+ * Number of messages in the transmit queue that only control messages can use
+ */
+#ifndef AJ_TX_QUEUE_RESERVE_MSGS
+#define AJ_TX_QUEUE_RESERVE_MSGS  (AJ_TX_QUEUE_MAX_MSGS / 8)
+#endif
+
+/**
+ * Maximum number of state signals, each message id, object path and session is a state signal
+ */
+#ifndef AJ_TX_QUEUE_MAX_STATES
+#define AJ_TX_QUEUE_MAX_STATES  8
+#endif
+
+/**
+ * Largest state signal that can be held back until its minimum interval has passed, bigger signals
+ * are queued as soon as they are delivered
+ */
+#ifndef AJ_TX_QUEUE_STATE_SIZE
+#define AJ_TX_QUEUE_STATE_SIZE  256
+#endif
+
+/**
+ * Longest object path for a state signal including the nul, signals from objects with longer paths
+ * are queued like any other signal
+ */
+#ifndef AJ_TX_QUEUE_STATE_PATH
+#define AJ_TX_QUEUE_STATE_PATH  64
+#endif
+
+/**
+ * Maximum number of message ids with a transmit queue policy or priority
+ */
+#ifndef AJ_TX_QUEUE_MAX_POLICIES
+#define AJ_TX_QUEUE_MAX_POLICIES  8
+#endif
+
+/**
+ * How often in milliseconds AJ_UnmarshalMsg() writes from the queue while it waits for a message
+ */
+#ifndef AJ_TX_QUEUE_POLL
+#define AJ_TX_QUEUE_POLL  10
+#endif
+
+#define AJ_TXQ_WAIT         0   /**< Wait for room in the queue, this is the default */
+#define AJ_TXQ_BUSY         1   /**< AJ_DeliverMsg() returns AJ_ERR_BUSY and the signal is not sent */
+#define AJ_TXQ_DROP_NEWEST  2   /**< The signal is discarded */
+#define AJ_TXQ_DROP_OLDEST  3   /**< The oldest queued signal with the same message id is discarded */
+#define AJ_TXQ_COALESCE     4   /**< The newest queued signal with the same message id is replaced */
+#define AJ_TXQ_LATEST       5   /**< A state signal, see AJ_TxQueueSetStateSignal() */
+
+#define AJ_TXQ_PRIORITY_DEFAULT  0   /**< Priority depends on the message type */
+#define AJ_TXQ_PRIORITY_BULK     1   /**< Written after all other messages */
+#define AJ_TXQ_PRIORITY_NORMAL   2   /**< Method calls and signals */
+#define AJ_TXQ_PRIORITY_CONTROL  3   /**< Method replies, errors and link probes */
+
+/**
+ * Called when the queue becomes congested and again when it has drained
+ *
+ * @param depth      Number of bytes in the queue
+ * @param congested  TRUE if the queue is above the high watermark
+ */
+typedef void (*AJ_TxQueueCallback)(uint32_t depth, uint8_t congested);
+
+/**
+ * Transmit queue statistics
+ */
+typedef struct _AJ_TxQueueStats {
+    uint32_t depth;          /**< Bytes in the queue */
+    uint32_t messages;       /**< Messages in the queue */
+    uint32_t maxDepth;       /**< Most bytes that were ever in the queue */
+    uint32_t dropped;        /**< Signals discarded by AJ_TXQ_DROP_NEWEST and AJ_TXQ_DROP_OLDEST */
+    uint32_t coalesced;      /**< Signals replaced by AJ_TXQ_COALESCE and state signals */
+    uint32_t coalescedBytes; /**< Bytes of the signals that were replaced */
+    uint32_t busy;           /**< Signals rejected with AJ_ERR_BUSY */
+    uint32_t waits;          /**< Times a message had to wait for room in the queue */
+    uint32_t expedited;      /**< Messages queued ahead of lower priority messages */
+} AJ_TxQueueStats;
+
+/**
+ * Start queueing the messages delivered on a bus attachment. Only one bus attachment can have a
+ * transmit queue. If the bus attachment is corked it is uncorked first, the queue already
+ * batches messages into single writes so AJ_CorkMsgs() has no effect while the queue is running.
+ *
+ * @param bus        The bus attachment
+ * @param highWater  Number of queued bytes above which the queue is congested, zero for three
+ *                   quarters of AJ_TX_QUEUE_SIZE
+ * @param callback   Function called when the queue becomes congested and drains again or NULL
+ *
+ * @return
+ *          - AJ_OK if the queue was started
+ *          - AJ_ERR_RESOURCES if the queue is disabled or is in use by another bus attachment
+ *          - AJ_ERR_WRITE if corked messages could not be written
+ */
+AJ_Status AJ_TxQueueStart(AJ_BusAttachment* bus, uint32_t highWater, AJ_TxQueueCallback callback);
+
+/**
+ * Write everything in the queue including held state signals, waiting if needed, and go back to
+ * writing messages as they are delivered.
+ *
+ * @param bus  The bus attachment
+ *
+ * @return
+ *          - AJ_OK if the queue was written
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_TxQueueStop(AJ_BusAttachment* bus);
+
+/**
+ * Write as much of the queue as the transport will take without blocking.
+ *
+ * @param bus  The bus attachment
+ *
+ * @return
+ *          - AJ_OK if the queue is empty
+ *          - AJ_ERR_BUSY if there are still messages in the queue or held state signals
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_TxQueueDrain(AJ_BusAttachment* bus);
+
+/**
+ * Set the policy for a signal when the transmit queue is congested.
+ *
+ * @param msgId   The message id of the signal as passed to AJ_MarshalSignal()
+ * @param policy  One of the AJ_TXQ_ policies, AJ_TXQ_WAIT removes the policy
+ *
+ * @return
+ *          - AJ_OK if the policy was set
+ *          - AJ_ERR_RESOURCES if AJ_TX_QUEUE_MAX_POLICIES message ids already have a policy or priority
+ */
+AJ_Status AJ_TxQueueSetPolicy(uint32_t msgId, uint8_t policy);
+
+/**
+ * Make a signal a state signal. A state signal replaces the signal with the same message id,
+ * object path and session that has not been written yet and is sent at most once every
+ * minInterval milliseconds. Use AJ_TxQueueSetPolicy() with AJ_TXQ_WAIT to make it an ordinary
+ * signal again.
+ *
+ * @param msgId        The message id of the signal as passed to AJ_MarshalSignal()
+ * @param minInterval  Minimum time in milliseconds between signals, zero to only replace unwritten
+ *                     signals
+ *
+ * @return
+ *          - AJ_OK if the signal is now a state signal
+ *          - AJ_ERR_RESOURCES if AJ_TX_QUEUE_MAX_POLICIES message ids already have a policy or priority
+ */
+AJ_Status AJ_TxQueueSetStateSignal(uint32_t msgId, uint32_t minInterval);
+
+/**
+ * Set the priority of a message in the transmit queue.
+ *
+ * @param msgId     The message id as passed to AJ_MarshalSignal() or AJ_MarshalMethodCall(), for
+ *                  replies the message id of the method call
+ * @param priority  One of the AJ_TXQ_PRIORITY_ values, AJ_TXQ_PRIORITY_DEFAULT removes the priority
+ *
+ * @return
+ *          - AJ_OK if the priority was set
+ *          - AJ_ERR_INVALID if the priority is not valid
+ *          - AJ_ERR_RESOURCES if AJ_TX_QUEUE_MAX_POLICIES message ids already have a policy or priority
+ */
+AJ_Status AJ_TxQueueSetPriority(uint32_t msgId, uint8_t priority);
+
+/**
+ * Get the transmit queue statistics, the statistics are reset when the queue is started.
+ *
+ * @param stats  Returns the statistics
+ */
+void AJ_TxQueueGetStats(AJ_TxQueueStats* stats);
+
+/**
+ * Internal function that checks if a bus attachment has a transmit queue.
+ *
+ * @param bus  The bus attachment
+ *
+ * @return  TRUE if messages delivered on the bus attachment are queued
+ */
+uint8_t AJ_TxQueueActive(AJ_BusAttachment* bus);
+
+/**
+ * Internal function called by AJ_DeliverMsg() to queue the part of a message that is in the I/O
+ * buffer.
+ *
+ * @param msg  The message being delivered
+ *
+ * @return
+ *          - AJ_OK if the message was queued, written or discarded by its policy
+ *          - AJ_ERR_BUSY if the queue is congested and the policy for the signal is AJ_TXQ_BUSY
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_TxQueueMsg(AJ_Message* msg);
+
+/**
+ * Internal function called when disconnecting to drop any queued messages.
+ *
+ * @param bus  The bus attachment that is disconnecting
+ */
+void AJ_ReleaseTxQueue(AJ_BusAttachment* bus);
+
+/**
+ * @}
+ */
+#endif
@@ -0,0 +1,609 @@
+#ifndef _AJ_TYPED_H
+#define _AJ_TYPED_H
+/**
+ * @file aj_typed.h
+ * @defgroup aj_typed Typed Marshaling for C++
+ * @{
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+/*
+ * Header only C++11 layer over the marshaling functions in aj_msg.h. The signature of the arguments
+ * is worked out from their C++ types at compile time and the arguments are marshaled and
+ * unmarshaled by inlined code that calls AJ_MarshalArg(), AJ_UnmarshalArg() and the container
+ * functions directly instead of interpreting a signature string.
+ *
+ * C++ type                            Signature
+ * ----------------------------------  ---------
+ * uint8_t                             y
+ * bool                                b
+ * int16_t, uint16_t                   n, q
+ * int32_t, uint32_t                   i, u
+ * int64_t, uint64_t                   x, t
+ * double                              d
+ * const char*, std::string            s
+ * aj::ObjectPath, aj::SignatureString o, g
+ * aj::ArrayView<T> (T scalar)         aT
+ * std::vector<T>                      aT
+ * std::vector<std::pair<K, V> >       a{KV}
+ * std::tuple<T...>                    (T...)
+ *
+ * Unmarshaled const char*, aj::ObjectPath, aj::SignatureString and aj::ArrayView values point
+ * into the receive buffer and are only valid until the message is closed.
+ */
+
+#ifndef __cplusplus
+#error aj_typed.h requires a C++11 compiler
+#endif
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "alljoyn.h"
+}
+
+namespace aj {
+
+/**
+ * An object path argument
+ */
+struct ObjectPath {
+    const char* value;   /**< The object path */
+};
+
+/**
+ * A signature argument
+ */
+struct SignatureString {
+    const char* value;   /**< The signature */
+};
+
+/**
+ * An array of scalars that is marshaled from or unmarshaled into memory owned by someone else
+ */
+template <typename T>
+struct ArrayView {
+    const T* data;       /**< The array elements */
+    size_t count;        /**< The number of elements */
+};
+
+/**
+ * A signature string built at compile time
+ */
+template <char ... C>
+struct Chars {
+    static constexpr char value[sizeof ... (C) + 1] = { C ..., '\0' };   /**< The NUL terminated signature */
+    static constexpr size_t length = sizeof ... (C);                      /**< Length of the signature */
+};
+
+template <char ... C>
+constexpr char Chars<C ...>::value[sizeof ... (C) + 1];
+
+template <char ... C>
+constexpr size_t Chars<C ...>::length;
+
+template <typename ... S>
+struct Concat;
+
+template <>
+struct Concat<> {
+    typedef Chars<> type;
+};
+
+template <char ... A>
+struct Concat<Chars<A ...> > {
+    typedef Chars<A ...> type;
+};
+
+template <char ... A, char ... B, typename ... Rest>
+struct Concat<Chars<A ...>, Chars<B ...>, Rest ...> {
+    typedef typename Concat<Chars<A ..., B ...>, Rest ...>::type type;
+};
+
+/**
+ * Codec<T> provides the signature and the marshal and unmarshal functions for a C++ type. There is
+ * no definition for types that cannot be marshaled so using them fails to compile.
+ */
+template <typename T, typename Enable = void>
+struct Codec;
+
+/*
+ * Scalar types, W is the type of the value in the message
+ */
+template <typename T, typename W, char C>
+struct ScalarCodec {
+    typedef Chars<C> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const T& val)
+    {
+        AJ_Arg arg;
+        W w = static_cast<W>(val);
+        return AJ_MarshalArg(msg, AJ_InitArg(&arg, C, 0, &w, 0));
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, T& val)
+    {
+        AJ_Arg arg;
+        AJ_Status status = AJ_UnmarshalArg(msg, &arg);
+        if (status == AJ_OK) {
+            if ((arg.typeId != C) || (arg.flags & AJ_ARRAY_FLAG)) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            val = static_cast<T>(*static_cast<const W*>(arg.val.v_data));
+        }
+        return status;
+    }
+};
+
+template <> struct Codec<uint8_t> : ScalarCodec<uint8_t, uint8_t, AJ_ARG_BYTE> { };
+template <> struct Codec<bool> : ScalarCodec<bool, uint32_t, AJ_ARG_BOOLEAN> { };
+template <> struct Codec<int16_t> : ScalarCodec<int16_t, int16_t, AJ_ARG_INT16> { };
+template <> struct Codec<uint16_t> : ScalarCodec<uint16_t, uint16_t, AJ_ARG_UINT16> { };
+template <> struct Codec<int32_t> : ScalarCodec<int32_t, int32_t, AJ_ARG_INT32> { };
+template <> struct Codec<uint32_t> : ScalarCodec<uint32_t, uint32_t, AJ_ARG_UINT32> { };
+template <> struct Codec<int64_t> : ScalarCodec<int64_t, int64_t, AJ_ARG_INT64> { };
+template <> struct Codec<uint64_t> : ScalarCodec<uint64_t, uint64_t, AJ_ARG_UINT64> { };
+template <> struct Codec<double> : ScalarCodec<double, double, AJ_ARG_DOUBLE> { };
+
+/**
+ * Scalar types that can be marshaled as a block with AJ_ARRAY_FLAG. Booleans are excluded because
+ * they are 32 bit values in the message.
+ */
+template <typename T> struct IsBlockScalar : std::false_type { };
+template <> struct IsBlockScalar<uint8_t> : std::true_type { };
+template <> struct IsBlockScalar<int16_t> : std::true_type { };
+template <> struct IsBlockScalar<uint16_t> : std::true_type { };
+template <> struct IsBlockScalar<int32_t> : std::true_type { };
+template <> struct IsBlockScalar<uint32_t> : std::true_type { };
+template <> struct IsBlockScalar<int64_t> : std::true_type { };
+template <> struct IsBlockScalar<uint64_t> : std::true_type { };
+template <> struct IsBlockScalar<double> : std::true_type { };
+
+/*
+ * String types
+ */
+template <char C>
+inline AJ_Status MarshalString(AJ_Message* msg, const char* str)
+{
+    AJ_Arg arg;
+    return AJ_MarshalArg(msg, AJ_InitArg(&arg, C, 0, str, 0));
+}
+
+template <char C>
+inline AJ_Status UnmarshalString(AJ_Message* msg, const char*& str)
+{
+    AJ_Arg arg;
+    AJ_Status status = AJ_UnmarshalArg(msg, &arg);
+    if (status == AJ_OK) {
+        if (arg.typeId != C) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        str = arg.val.v_string;
+    }
+    return status;
+}
+
+template <>
+struct Codec<const char*> {
+    typedef Chars<AJ_ARG_STRING> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const char* val)
+    {
+        return MarshalString<AJ_ARG_STRING>(msg, val);
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, const char*& val)
+    {
+        return UnmarshalString<AJ_ARG_STRING>(msg, val);
+    }
+};
+
+template <>
+struct Codec<char*> {
+    typedef Chars<AJ_ARG_STRING> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const char* val)
+    {
+        return MarshalString<AJ_ARG_STRING>(msg, val);
+    }
+};
+
+template <>
+struct Codec<std::string> {
+    typedef Chars<AJ_ARG_STRING> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::string& val)
+    {
+        return MarshalString<AJ_ARG_STRING>(msg, val.c_str());
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::string& val)
+    {
+        const char* str;
+        AJ_Status status = UnmarshalString<AJ_ARG_STRING>(msg, str);
+        if (status == AJ_OK) {
+            val.assign(str);
+        }
+        return status;
+    }
+};
+
+template <>
+struct Codec<ObjectPath> {
+    typedef Chars<AJ_ARG_OBJ_PATH> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const ObjectPath& val)
+    {
+        return MarshalString<AJ_ARG_OBJ_PATH>(msg, val.value);
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, ObjectPath& val)
+    {
+        return UnmarshalString<AJ_ARG_OBJ_PATH>(msg, val.value);
+    }
+};
+
+template <>
+struct Codec<SignatureString> {
+    typedef Chars<AJ_ARG_SIGNATURE> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const SignatureString& val)
+    {
+        return MarshalString<AJ_ARG_SIGNATURE>(msg, val.value);
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, SignatureString& val)
+    {
+        return UnmarshalString<AJ_ARG_SIGNATURE>(msg, val.value);
+    }
+};
+
+/*
+ * Scalar arrays are marshaled and unmarshaled in one go
+ */
+template <typename T>
+inline AJ_Status MarshalBlock(AJ_Message* msg, const T* data, size_t count)
+{
+    AJ_Arg arg;
+    return AJ_MarshalArg(msg, AJ_InitArg(&arg, Codec<T>::Sig::value[0], AJ_ARRAY_FLAG, data, count * sizeof(T)));
+}
+
+template <typename T>
+inline AJ_Status UnmarshalBlock(AJ_Message* msg, const T*& data, size_t& count)
+{
+    AJ_Arg arg;
+    AJ_Status status = AJ_UnmarshalArg(msg, &arg);
+    if (status == AJ_OK) {
+        if ((arg.typeId != Codec<T>::Sig::value[0]) || !(arg.flags & AJ_ARRAY_FLAG)) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        data = static_cast<const T*>(arg.val.v_data);
+        count = arg.len / sizeof(T);
+    }
+    return status;
+}
+
+template <typename T>
+struct Codec<ArrayView<T> > {
+    static_assert(IsBlockScalar<T>::value, "ArrayView elements must be scalars");
+    typedef typename Concat<Chars<AJ_ARG_ARRAY>, typename Codec<T>::Sig>::type Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const ArrayView<T>& val)
+    {
+        return MarshalBlock(msg, val.data, val.count);
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, ArrayView<T>& val)
+    {
+        return UnmarshalBlock(msg, val.data, val.count);
+    }
+};
+
+/*
+ * Vectors of scalars are marshaled as a block, other vectors element by element
+ */
+template <typename T>
+struct Codec<std::vector<T>, typename std::enable_if<IsBlockScalar<T>::value>::type> {
+    typedef typename Concat<Chars<AJ_ARG_ARRAY>, typename Codec<T>::Sig>::type Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::vector<T>& val)
+    {
+        return MarshalBlock(msg, val.empty() ? NULL : &val[0], val.size());
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::vector<T>& val)
+    {
+        const T* data;
+        size_t count;
+        AJ_Status status = UnmarshalBlock(msg, data, count);
+        if (status == AJ_OK) {
+            val.assign(data, data + count);
+        }
+        return status;
+    }
+};
+
+template <typename T>
+struct Codec<std::vector<T>, typename std::enable_if<!IsBlockScalar<T>::value>::type> {
+    typedef typename Concat<Chars<AJ_ARG_ARRAY>, typename Codec<T>::Sig>::type Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::vector<T>& val)
+    {
+        AJ_Arg array;
+        AJ_Status status = AJ_MarshalContainer(msg, &array, AJ_ARG_ARRAY);
+        for (size_t i = 0; (status == AJ_OK) && (i < val.size()); ++i) {
+            status = Codec<T>::Marshal(msg, val[i]);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(msg, &array);
+        }
+        return status;
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::vector<T>& val)
+    {
+        AJ_Arg array;
+        AJ_Status status = AJ_UnmarshalContainer(msg, &array, AJ_ARG_ARRAY);
+        val.clear();
+        while (status == AJ_OK) {
+            T elem;
+            status = Codec<T>::Unmarshal(msg, elem);
+            if (status == AJ_OK) {
+                val.push_back(elem);
+            }
+        }
+        if (status == AJ_ERR_NO_MORE) {
+            status = AJ_UnmarshalCloseContainer(msg, &array);
+        }
+        return status;
+    }
+};
+
+/*
+ * Boolean arrays arrive as a block of 32 bit values so are converted element by element
+ */
+template <>
+struct Codec<std::vector<bool> > {
+    typedef Chars<AJ_ARG_ARRAY, AJ_ARG_BOOLEAN> Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::vector<bool>& val)
+    {
+        std::vector<uint32_t> wire(val.begin(), val.end());
+        AJ_Arg arg;
+        return AJ_MarshalArg(msg, AJ_InitArg(&arg, AJ_ARG_BOOLEAN, AJ_ARRAY_FLAG, wire.empty() ? NULL : &wire[0], wire.size() * sizeof(uint32_t)));
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::vector<bool>& val)
+    {
+        AJ_Arg arg;
+        AJ_Status status = AJ_UnmarshalArg(msg, &arg);
+        if (status == AJ_OK) {
+            const uint32_t* data = static_cast<const uint32_t*>(arg.val.v_data);
+            if ((arg.typeId != AJ_ARG_BOOLEAN) || !(arg.flags & AJ_ARRAY_FLAG)) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            val.assign(data, data + arg.len / sizeof(uint32_t));
+        }
+        return status;
+    }
+};
+
+/*
+ * Dictionary entries, only valid as the element type of an array
+ */
+template <typename K, typename V>
+struct Codec<std::pair<K, V> > {
+    typedef typename Concat<Chars<AJ_ARG_DICT_ENTRY>, typename Codec<K>::Sig, typename Codec<V>::Sig, Chars<'}'> >::type Sig;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::pair<K, V>& val)
+    {
+        AJ_Arg entry;
+        AJ_Status status = AJ_MarshalContainer(msg, &entry, AJ_ARG_DICT_ENTRY);
+        if (status == AJ_OK) {
+            status = Codec<K>::Marshal(msg, val.first);
+        }
+        if (status == AJ_OK) {
+            status = Codec<V>::Marshal(msg, val.second);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(msg, &entry);
+        }
+        return status;
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::pair<K, V>& val)
+    {
+        AJ_Arg entry;
+        AJ_Status status = AJ_UnmarshalContainer(msg, &entry, AJ_ARG_DICT_ENTRY);
+        if (status == AJ_OK) {
+            status = Codec<K>::Unmarshal(msg, val.first);
+        }
+        if (status == AJ_OK) {
+            status = Codec<V>::Unmarshal(msg, val.second);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalCloseContainer(msg, &entry);
+        }
+        return status;
+    }
+};
+
+/*
+ * Structs, the fields are marshaled in order by recursing over the tuple index
+ */
+template <size_t I, size_t N, typename Tuple>
+struct TupleFields {
+    typedef typename std::tuple_element<I, Tuple>::type Field;
+
+    static AJ_Status Marshal(AJ_Message* msg, const Tuple& val)
+    {
+        AJ_Status status = Codec<Field>::Marshal(msg, std::get<I>(val));
+        return (status == AJ_OK) ? TupleFields<I + 1, N, Tuple>::Marshal(msg, val) : status;
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, Tuple& val)
+    {
+        AJ_Status status = Codec<Field>::Unmarshal(msg, std::get<I>(val));
+        return (status == AJ_OK) ? TupleFields<I + 1, N, Tuple>::Unmarshal(msg, val) : status;
+    }
+};
+
+template <size_t N, typename Tuple>
+struct TupleFields<N, N, Tuple> {
+    static AJ_Status Marshal(AJ_Message*, const Tuple&)
+    {
+        return AJ_OK;
+    }
+
+    static AJ_Status Unmarshal(AJ_Message*, Tuple&)
+    {
+        return AJ_OK;
+    }
+};
+
+template <typename ... T>
+struct Codec<std::tuple<T ...> > {
+    typedef typename Concat<Chars<AJ_ARG_STRUCT>, typename Codec<T>::Sig ..., Chars<')'> >::type Sig;
+    typedef TupleFields<0, sizeof ... (T), std::tuple<T ...> > Fields;
+
+    static AJ_Status Marshal(AJ_Message* msg, const std::tuple<T ...>& val)
+    {
+        AJ_Arg structure;
+        AJ_Status status = AJ_MarshalContainer(msg, &structure, AJ_ARG_STRUCT);
+        if (status == AJ_OK) {
+            status = Fields::Marshal(msg, val);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(msg, &structure);
+        }
+        return status;
+    }
+
+    static AJ_Status Unmarshal(AJ_Message* msg, std::tuple<T ...>& val)
+    {
+        AJ_Arg structure;
+        AJ_Status status = AJ_UnmarshalContainer(msg, &structure, AJ_ARG_STRUCT);
+        if (status == AJ_OK) {
+            status = Fields::Unmarshal(msg, val);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalCloseContainer(msg, &structure);
+        }
+        return status;
+    }
+};
+
+/**
+ * The signature of a list of argument types, Signature<uint32_t, std::string>::type::value is "us"
+ */
+template <typename ... T>
+struct Signature {
+    typedef typename Concat<typename Codec<typename std::decay<T>::type>::Sig ...>::type type;
+};
+
+/*
+ * At the top level of a message check the arguments match the rest of the message signature.
+ * Inside containers the checks are done by AJ_MarshalArg() and AJ_UnmarshalArg().
+ */
+template <typename Sig>
+inline bool CheckSignature(const AJ_Message* msg)
+{
+    const char* sig;
+
+    if (msg->outer) {
+        return true;
+    }
+    sig = msg->signature ? msg->signature + msg->sigOffset : "";
+    return strncmp(sig, Sig::value, Sig::length) == 0;
+}
+
+inline AJ_Status MarshalEach(AJ_Message*)
+{
+    return AJ_OK;
+}
+
+template <typename T, typename ... Rest>
+inline AJ_Status MarshalEach(AJ_Message* msg, const T& val, const Rest& ... rest)
+{
+    AJ_Status status = Codec<typename std::decay<T>::type>::Marshal(msg, val);
+    return (status == AJ_OK) ? MarshalEach(msg, rest ...) : status;
+}
+
+inline AJ_Status UnmarshalEach(AJ_Message*)
+{
+    return AJ_OK;
+}
+
+template <typename T, typename ... Rest>
+inline AJ_Status UnmarshalEach(AJ_Message* msg, T& val, Rest& ... rest)
+{
+    AJ_Status status = Codec<T>::Unmarshal(msg, val);
+    return (status == AJ_OK) ? UnmarshalEach(msg, rest ...) : status;
+}
+
+/**
+ * Marshal arguments, the typed equivalent of AJ_MarshalArgs()
+ *
+ * @param msg   The message being marshaled
+ * @param args  The arguments to marshal
+ *
+ * @return
+ *          - AJ_OK if the arguments were marshaled
+ *          - AJ_ERR_SIGNATURE if the argument types do not match the message signature
+ *          - Other errors from AJ_MarshalArg() and AJ_MarshalContainer()
+ */
+template <typename ... T>
+inline AJ_Status MarshalArgs(AJ_Message* msg, const T& ... args)
+{
+    if (!CheckSignature<typename Signature<T ...>::type>(msg)) {
+        return AJ_ERR_SIGNATURE;
+    }
+    return MarshalEach(msg, args ...);
+}
+
+/**
+ * Unmarshal arguments, the typed equivalent of AJ_UnmarshalArgs()
+ *
+ * @param msg   The message being unmarshaled
+ * @param args  Returns the unmarshaled arguments
+ *
+ * @return
+ *          - AJ_OK if the arguments were unmarshaled
+ *          - AJ_ERR_SIGNATURE if the argument types do not match the message signature
+ *          - Other errors from AJ_UnmarshalArg() and AJ_UnmarshalContainer()
+ */
+template <typename ... T>
+inline AJ_Status UnmarshalArgs(AJ_Message* msg, T& ... args)
+{
+    if (!CheckSignature<typename Signature<T ...>::type>(msg)) {
+        return AJ_ERR_SIGNATURE;
+    }
+    return UnmarshalEach(msg, args ...);
+}
+
+}
+
+/**
+ * @}
+ */
+#endif
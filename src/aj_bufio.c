@@ -30,6 +30,7 @@ void AJ_IOBufInit(AJ_IOBuffer* ioBuf, uint8_t* buffer, uint32_t bufLen, uint8_t
     ioBuf->readPtr = buffer;
     ioBuf->writePtr = buffer;
     ioBuf->direction = direction;
+    ioBuf->flags = 0;
     ioBuf->context = context;
 }
 
@@ -26,6 +26,7 @@
 #include "aj_std.h"
 #include "aj_introspect.h"
 #include "aj_peer.h"
+#include "aj_compress.h"
 
 
 /**
@@ -342,6 +343,12 @@ AJ_Status AJ_BusHandleBusMessage(AJ_Message* msg)
     if (!msg->hdr) {
         return AJ_OK;
     }
+    /*
+     * Replies to asynchronous method calls go to their callback, including replies to bus methods
+     */
+    if (AJ_DispatchReply(msg)) {
+        return AJ_OK;
+    }
 
     switch (msg->msgId) {
     case AJ_METHOD_PING:
@@ -388,6 +395,22 @@ AJ_Status AJ_BusHandleBusMessage(AJ_Message* msg)
         status = AJ_PeerHandleExchangeGroupKeysReply(msg);
         break;
 
+    case AJ_METHOD_GET_EXPANSION:
+        status = AJ_HandleGetExpansion(msg, &reply);
+        break;
+
+    case AJ_REPLY_ID(AJ_METHOD_GET_EXPANSION):
+        status = AJ_HandleGetExpansionReply(msg);
+        break;
+
+    case AJ_METHOD_NEGOTIATE_BODY_COMPRESSION:
+        status = AJ_HandleNegotiateBodyCompression(msg, &reply);
+        break;
+
+    case AJ_REPLY_ID(AJ_METHOD_NEGOTIATE_BODY_COMPRESSION):
+        status = AJ_HandleNegotiateBodyCompressionReply(msg);
+        break;
+
     case AJ_REPLY_ID(AJ_METHOD_CANCEL_SESSIONLESS):
         // handle return code here
         status = AJ_OK;
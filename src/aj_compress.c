@@ -0,0 +1,853 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_compress.h"
+#include "aj_msg.h"
+#include "aj_std.h"
+#include "aj_util.h"
+#include "aj_crypto.h"
+#include "aj_debug.h"
+
+#define MAX_NAME_SIZE  15
+
+/*
+ * Timeout for GetExpansion method calls
+ */
+#define EXPANSION_CALL_TIMEOUT  (1000ul * 5)
+
+/*
+ * The string header fields that are replaced by a compression token and their types. The session
+ * id and time-to-live header fields are also compressed.
+ */
+static const uint8_t StringFields[] = { AJ_HDR_OBJ_PATH, AJ_HDR_INTERFACE, AJ_HDR_MEMBER, AJ_HDR_DESTINATION, AJ_HDR_SIGNATURE };
+static const char StringTypes[] = { AJ_ARG_OBJ_PATH, AJ_ARG_STRING, AJ_ARG_STRING, AJ_ARG_STRING, AJ_ARG_SIGNATURE };
+
+#define NUM_STRING_FIELDS  ArraySize(StringFields)
+
+#define FIELD_OBJ_PATH     0
+#define FIELD_INTERFACE    1
+#define FIELD_MEMBER       2
+#define FIELD_DESTINATION  3
+#define FIELD_SIGNATURE    4
+
+typedef struct _CompressionRule {
+    uint32_t token;                          /* The compression token, zero if the rule is not in use */
+    uint32_t serial;                         /* Serial number of an outstanding GetExpansion call */
+    uint32_t lastUsed;                       /* For evicting the least recently used rule */
+    char peer[MAX_NAME_SIZE + 1];            /* Unique name of the peer that allocated the token */
+    uint32_t sessionId;                      /* Session id header field */
+    uint32_t ttl;                            /* Time-to-live header field */
+    uint8_t offset[NUM_STRING_FIELDS];       /* Offset + 1 of each string field, zero if absent */
+    char strings[AJ_COMPRESSION_RULE_SIZE];  /* The string header fields */
+} CompressionRule;
+
+/*
+ * Rules for the headers we compress and for the compressed headers we have received
+ */
+static CompressionRule txRules[AJ_MAX_COMPRESSION_RULES];
+static CompressionRule rxRules[AJ_MAX_COMPRESSION_RULES];
+
+static uint32_t nextToken;
+static uint32_t useCount;
+
+static const char* RuleString(const CompressionRule* rule, size_t field)
+{
+    return rule->offset[field] ? &rule->strings[rule->offset[field] - 1] : NULL;
+}
+
+/*
+ * Get the string header fields of a message, returns the space needed to store them
+ */
+static size_t MsgStrings(const AJ_Message* msg, const char** str, size_t* len)
+{
+    size_t total = 0;
+    size_t i;
+
+    str[FIELD_OBJ_PATH] = msg->objPath;
+    str[FIELD_INTERFACE] = msg->iface;
+    str[FIELD_MEMBER] = msg->member;
+    str[FIELD_DESTINATION] = msg->destination;
+    str[FIELD_SIGNATURE] = msg->signature;
+    for (i = 0; i < NUM_STRING_FIELDS; ++i) {
+        len[i] = 0;
+        if (str[i]) {
+            len[i] = strlen(str[i]);
+            /*
+             * Member names in the interface descriptions are followed by the argument list
+             */
+            if (i == FIELD_MEMBER) {
+                int32_t end = AJ_StringFindFirstOf(str[i], " ");
+                if (end >= 0) {
+                    len[i] = end;
+                }
+            }
+            total += len[i] + 1;
+        }
+    }
+    return total;
+}
+
+static uint8_t RuleMatches(const CompressionRule* rule, const AJ_Message* msg, const char** str, const size_t* len)
+{
+    size_t i;
+
+    if ((rule->sessionId != msg->sessionId) || (rule->ttl != msg->ttl)) {
+        return FALSE;
+    }
+    for (i = 0; i < NUM_STRING_FIELDS; ++i) {
+        const char* s = RuleString(rule, i);
+        if (!s != !str[i]) {
+            return FALSE;
+        }
+        if (s && ((strlen(s) != len[i]) || (memcmp(s, str[i], len[i]) != 0))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static CompressionRule* FindRule(CompressionRule* rules, const char* peer, uint32_t token)
+{
+    size_t i;
+
+    for (i = 0; i < AJ_MAX_COMPRESSION_RULES; ++i) {
+        if (rules[i].token && (rules[i].token == token) && (!peer || (strcmp(rules[i].peer, peer) == 0))) {
+            return &rules[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns an unused rule or evicts the least recently used one
+ */
+static CompressionRule* AllocRule(CompressionRule* rules)
+{
+    CompressionRule* rule = rules;
+    size_t i;
+
+    for (i = 0; i < AJ_MAX_COMPRESSION_RULES; ++i) {
+        if (!rules[i].token) {
+            rule = &rules[i];
+            break;
+        }
+        if (rules[i].lastUsed < rule->lastUsed) {
+            rule = &rules[i];
+        }
+    }
+    memset(rule, 0, sizeof(CompressionRule));
+    rule->lastUsed = ++useCount;
+    return rule;
+}
+
+uint32_t AJ_CompressionToken(const AJ_Message* msg)
+{
+    CompressionRule* rule;
+    const char* str[NUM_STRING_FIELDS];
+    size_t len[NUM_STRING_FIELDS];
+    size_t used = 0;
+    size_t i;
+
+    if (MsgStrings(msg, str, len) > AJ_COMPRESSION_RULE_SIZE) {
+        return 0;
+    }
+    for (i = 0; i < AJ_MAX_COMPRESSION_RULES; ++i) {
+        if (txRules[i].token && RuleMatches(&txRules[i], msg, str, len)) {
+            txRules[i].lastUsed = ++useCount;
+            return txRules[i].token;
+        }
+    }
+    /*
+     * Tokens are never reused so a peer cannot apply a stale expansion to a different header
+     */
+    while (!nextToken) {
+        AJ_RandBytes((uint8_t*)&nextToken, sizeof(nextToken));
+    }
+    rule = AllocRule(txRules);
+    rule->token = nextToken++;
+    if (!nextToken) {
+        nextToken = 1;
+    }
+    rule->sessionId = msg->sessionId;
+    rule->ttl = msg->ttl;
+    for (i = 0; i < NUM_STRING_FIELDS; ++i) {
+        if (str[i]) {
+            rule->offset[i] = (uint8_t)(used + 1);
+            memcpy(&rule->strings[used], str[i], len[i]);
+            used += len[i];
+            rule->strings[used++] = '\0';
+        }
+    }
+    return rule->token;
+}
+
+static void RequestExpansion(AJ_BusAttachment* bus, const char* peer, uint32_t token)
+{
+    CompressionRule* rule;
+    AJ_Message call;
+    AJ_Status status;
+    size_t len = strlen(peer);
+
+    if (len > MAX_NAME_SIZE) {
+        return;
+    }
+    status = AJ_MarshalMethodCall(bus, &call, AJ_METHOD_GET_EXPANSION, peer, 0, 0, EXPANSION_CALL_TIMEOUT);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&call, "u", token);
+    }
+    if (status == AJ_OK) {
+        /*
+         * The rule is pending until the reply arrives
+         */
+        rule = AllocRule(rxRules);
+        rule->token = token;
+        rule->serial = call.hdr->serialNum;
+        memcpy(rule->peer, peer, len + 1);
+        status = AJ_DeliverMsg(&call);
+        if (status != AJ_OK) {
+            rule->token = 0;
+        }
+    }
+}
+
+AJ_Status AJ_ExpandHeader(AJ_Message* msg, uint32_t token)
+{
+    CompressionRule* rule;
+
+    if (!msg->sender) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    rule = FindRule(rxRules, msg->sender, token);
+    if (!rule) {
+        AJ_InfoPrintf(("Requesting expansion for token %u from %s\n", token, msg->sender));
+        RequestExpansion(msg->bus, msg->sender, token);
+        return AJ_ERR_NO_MATCH;
+    }
+    if (rule->serial) {
+        return AJ_ERR_NO_MATCH;
+    }
+    rule->lastUsed = ++useCount;
+    msg->objPath = RuleString(rule, FIELD_OBJ_PATH);
+    msg->iface = RuleString(rule, FIELD_INTERFACE);
+    msg->member = RuleString(rule, FIELD_MEMBER);
+    msg->destination = RuleString(rule, FIELD_DESTINATION);
+    msg->signature = rule->offset[FIELD_SIGNATURE] ? RuleString(rule, FIELD_SIGNATURE) : "";
+    msg->sessionId = rule->sessionId;
+    msg->ttl = rule->ttl;
+    return AJ_OK;
+}
+
+static AJ_Status MarshalField(AJ_Message* msg, uint8_t fieldId, uint8_t typeId, const void* val)
+{
+    AJ_Status status;
+    AJ_Arg field;
+    AJ_Arg arg;
+    char sig[2];
+
+    sig[0] = (char)typeId;
+    sig[1] = '\0';
+    status = AJ_MarshalContainer(msg, &field, AJ_ARG_STRUCT);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "y", fieldId);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalVariant(msg, sig);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArg(msg, AJ_InitArg(&arg, typeId, 0, val, 0));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &field);
+    }
+    return status;
+}
+
+AJ_Status AJ_HandleGetExpansion(AJ_Message* msg, AJ_Message* reply)
+{
+    AJ_Status status;
+    CompressionRule* rule = NULL;
+    AJ_Arg array;
+    uint32_t token;
+    uint16_t ttl;
+    size_t i;
+
+    status = AJ_UnmarshalArgs(msg, "u", &token);
+    if (status == AJ_OK) {
+        rule = FindRule(txRules, NULL, token);
+    }
+    if (!rule) {
+        /*
+         * The rule has been evicted, the peer will get a new token with the next signal
+         */
+        return AJ_MarshalErrorMsg(msg, reply, AJ_ErrRejected);
+    }
+    status = AJ_MarshalReplyMsg(msg, reply);
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(reply, &array, AJ_ARG_ARRAY);
+    }
+    for (i = 0; (status == AJ_OK) && (i < NUM_STRING_FIELDS); ++i) {
+        if (rule->offset[i]) {
+            status = MarshalField(reply, StringFields[i], StringTypes[i], RuleString(rule, i));
+        }
+    }
+    if ((status == AJ_OK) && rule->ttl) {
+        ttl = (uint16_t)rule->ttl;
+        status = MarshalField(reply, AJ_HDR_TIME_TO_LIVE, AJ_ARG_UINT16, &ttl);
+    }
+    if ((status == AJ_OK) && rule->sessionId) {
+        status = MarshalField(reply, AJ_HDR_SESSION_ID, AJ_ARG_UINT32, &rule->sessionId);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(reply, &array);
+    }
+    return status;
+}
+
+static AJ_Status StoreField(CompressionRule* rule, uint8_t fieldId, const AJ_Arg* val, size_t* used)
+{
+    size_t len;
+    size_t i;
+
+    if (fieldId == AJ_HDR_SESSION_ID) {
+        if (val->typeId != AJ_ARG_UINT32) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        rule->sessionId = *val->val.v_uint32;
+        return AJ_OK;
+    }
+    if (fieldId == AJ_HDR_TIME_TO_LIVE) {
+        if (val->typeId != AJ_ARG_UINT16) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        rule->ttl = *val->val.v_uint16;
+        return AJ_OK;
+    }
+    for (i = 0; i < NUM_STRING_FIELDS; ++i) {
+        if (StringFields[i] == fieldId) {
+            if (val->typeId != (uint8_t)StringTypes[i]) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            len = strlen(val->val.v_string) + 1;
+            if ((*used + len) > AJ_COMPRESSION_RULE_SIZE) {
+                return AJ_ERR_RESOURCES;
+            }
+            rule->offset[i] = (uint8_t)(*used + 1);
+            memcpy(&rule->strings[*used], val->val.v_string, len);
+            *used += len;
+            return AJ_OK;
+        }
+    }
+    /*
+     * Ignore fields we don't know
+     */
+    return AJ_OK;
+}
+
+static AJ_Status UnmarshalExpansion(AJ_Message* msg, CompressionRule* rule)
+{
+    AJ_Status status;
+    AJ_Arg array;
+    size_t used = 0;
+
+    status = AJ_UnmarshalContainer(msg, &array, AJ_ARG_ARRAY);
+    while (status == AJ_OK) {
+        AJ_Arg field;
+        AJ_Arg val;
+        const char* sig;
+        uint8_t fieldId;
+
+        status = AJ_UnmarshalContainer(msg, &field, AJ_ARG_STRUCT);
+        if (status != AJ_OK) {
+            break;
+        }
+        status = AJ_UnmarshalArgs(msg, "y", &fieldId);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalVariant(msg, &sig);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArg(msg, &val);
+        }
+        if (status == AJ_OK) {
+            status = StoreField(rule, fieldId, &val, &used);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalCloseContainer(msg, &field);
+        }
+    }
+    if (status == AJ_ERR_NO_MORE) {
+        status = AJ_UnmarshalCloseContainer(msg, &array);
+    }
+    return status;
+}
+
+AJ_Status AJ_HandleGetExpansionReply(AJ_Message* msg)
+{
+    AJ_Status status = AJ_OK;
+    size_t i;
+
+    for (i = 0; i < AJ_MAX_COMPRESSION_RULES; ++i) {
+        CompressionRule* rule = &rxRules[i];
+        if (rule->token && (rule->serial == msg->replySerial)) {
+            if (msg->hdr->msgType == AJ_MSG_ERROR) {
+                status = AJ_ERR_NO_MATCH;
+            } else {
+                status = UnmarshalExpansion(msg, rule);
+            }
+            if (status == AJ_OK) {
+                rule->serial = 0;
+            } else {
+                AJ_ErrPrintf(("No expansion for token %u from %s\n", rule->token, rule->peer));
+                rule->token = 0;
+            }
+            break;
+        }
+    }
+    /*
+     * A missing expansion only costs us the signals that used the token
+     */
+    return AJ_OK;
+}
+
+/*
+ * Body compression uses the LZ4 block format: a sequence is a token byte with the literal length in
+ * the high nibble and the match length - 4 in the low nibble, extra length bytes for lengths >= 15,
+ * the literals, and a 16 bit little endian match offset. The last sequence is just literals.
+ */
+#define LZ_MIN_MATCH      4
+#define LZ_LAST_LITERALS  5    /* The last 5 bytes are always literals */
+#define LZ_MF_LIMIT       12   /* The last match must start at least 12 bytes before the end */
+#define LZ_HASH_BITS      8
+#define LZ_NO_POS         0xFFFF
+
+/*
+ * In-place decompression needs this much space after the decompressed body
+ */
+#define LZ_EXPAND_MARGIN(len)  (((len) >> 8) + 32)
+
+/*
+ * Timeout for Negotiate method calls
+ */
+#define NEGOTIATE_CALL_TIMEOUT  (1000ul * 5)
+
+typedef struct _BodyCompressionPeer {
+    char peer[MAX_NAME_SIZE + 1];  /* Unique name of the peer, empty if the entry is not in use */
+    uint32_t serial;               /* Serial number of an outstanding Negotiate call */
+    uint16_t rxSize;               /* Size of the peer's receive buffer */
+} BodyCompressionPeer;
+
+static BodyCompressionPeer bodyPeers[AJ_MAX_BODY_COMPRESSION_PEERS];
+
+static AJ_BodyCompressionStats bodyStats;
+
+static uint32_t bodyThreshold = AJ_BODY_COMPRESSION_THRESHOLD;
+
+static uint16_t lzHash[1 << LZ_HASH_BITS];
+
+static uint32_t Read32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t LZ_Hash(const uint8_t* p)
+{
+    return (Read32(p) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint32_t PutLength(uint8_t* dst, uint32_t out, uint32_t len)
+{
+    while (len >= 255) {
+        if (dst) {
+            dst[out] = 255;
+        }
+        ++out;
+        len -= 255;
+    }
+    if (dst) {
+        dst[out] = (uint8_t)len;
+    }
+    return out + 1;
+}
+
+/*
+ * Compress a buffer, if dst is NULL this is a dry run that returns the compressed length and the
+ * lead, how far the input must be ahead of the output for compression to work in place. Compressing
+ * in place is safe because the output never overwrites the pending literals or the match window.
+ * Returns zero if the compressed data would not be smaller than the input.
+ */
+static uint32_t LZ_Compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t* lead)
+{
+    uint32_t anchor = 0;
+    uint32_t pos = 0;
+    uint32_t out = 0;
+    uint32_t need = 0;
+    uint32_t lit;
+
+    memset(lzHash, 0xFF, sizeof(lzHash));
+    while ((pos + LZ_MF_LIMIT) <= len) {
+        uint32_t h = LZ_Hash(src + pos);
+        uint32_t cand = lzHash[h];
+        uint32_t end;
+        uint32_t mlen;
+        uint32_t floor;
+
+        lzHash[h] = (uint16_t)pos;
+        /*
+         * The window check must come first, in place the bytes before the window may be gone
+         */
+        if ((cand == LZ_NO_POS) || ((pos - cand) > AJ_BODY_COMPRESSION_WINDOW) || (Read32(src + cand) != Read32(src + pos))) {
+            ++pos;
+            continue;
+        }
+        end = pos + LZ_MIN_MATCH;
+        while ((end < (len - LZ_LAST_LITERALS)) && (src[end] == src[cand + end - pos])) {
+            ++end;
+        }
+        lit = pos - anchor;
+        mlen = end - pos - LZ_MIN_MATCH;
+        if (dst) {
+            dst[out] = (uint8_t)((min(lit, 15) << 4) | min(mlen, 15));
+        }
+        ++out;
+        if (lit >= 15) {
+            out = PutLength(dst, out, lit - 15);
+        }
+        if (out > (anchor + need)) {
+            need = out - anchor;
+        }
+        if (dst) {
+            memmove(dst + out, src + anchor, lit);
+            dst[out + lit] = (uint8_t)(pos - cand);
+            dst[out + lit + 1] = (uint8_t)((pos - cand) >> 8);
+        }
+        out += lit + 2;
+        if (mlen >= 15) {
+            out = PutLength(dst, out, mlen - 15);
+        }
+        /*
+         * Nothing before the window of the next match will be read again
+         */
+        floor = (end > AJ_BODY_COMPRESSION_WINDOW) ? end - AJ_BODY_COMPRESSION_WINDOW : 0;
+        if (out > (floor + need)) {
+            need = out - floor;
+        }
+        if (!dst && (out >= len)) {
+            return 0;
+        }
+        pos = end;
+        anchor = end;
+    }
+    lit = len - anchor;
+    if (dst) {
+        dst[out] = (uint8_t)(min(lit, 15) << 4);
+    }
+    ++out;
+    if (lit >= 15) {
+        out = PutLength(dst, out, lit - 15);
+    }
+    if (out > (anchor + need)) {
+        need = out - anchor;
+    }
+    if (dst) {
+        memmove(dst + out, src + anchor, lit);
+    }
+    out += lit;
+    *lead = need;
+    return (out < len) ? out : 0;
+}
+
+static AJ_Status GetLength(const uint8_t** ip, const uint8_t* ipEnd, uint32_t* len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip == ipEnd) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return AJ_OK;
+}
+
+/*
+ * Decompress in place, the compressed data is at the end of the space for the decompressed data
+ * plus LZ_EXPAND_MARGIN. Corrupt data that would overwrite input that has not been read yet is
+ * rejected.
+ */
+static AJ_Status LZ_Expand(const uint8_t* src, uint32_t srcLen, uint8_t* dst, uint32_t dstLen)
+{
+    const uint8_t* ip = src;
+    const uint8_t* ipEnd = src + srcLen;
+    uint8_t* op = dst;
+    uint8_t* opEnd = dst + dstLen;
+
+    while (ip < ipEnd) {
+        uint8_t token = *ip++;
+        uint32_t len = token >> 4;
+        uint32_t offset;
+
+        if ((len == 15) && (GetLength(&ip, ipEnd, &len) != AJ_OK)) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        if ((len > (uint32_t)(ipEnd - ip)) || (len > (uint32_t)(opEnd - op)) || (op > ip)) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        memmove(op, ip, len);
+        op += len;
+        ip += len;
+        if (ip == ipEnd) {
+            break;
+        }
+        if ((ipEnd - ip) < 2) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        len = token & 0xF;
+        if ((len == 15) && (GetLength(&ip, ipEnd, &len) != AJ_OK)) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        len += LZ_MIN_MATCH;
+        if (!offset || (offset > (uint32_t)(op - dst)) || (len > (uint32_t)(opEnd - op)) || ((op + len) > ip)) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        /*
+         * Matches can overlap the output so copy byte by byte
+         */
+        while (len--) {
+            *op = *(op - offset);
+            ++op;
+        }
+    }
+    return (op == opEnd) ? AJ_OK : AJ_ERR_UNMARSHAL;
+}
+
+static BodyCompressionPeer* FindPeer(const char* peer)
+{
+    size_t i;
+
+    for (i = 0; i < AJ_MAX_BODY_COMPRESSION_PEERS; ++i) {
+        if (bodyPeers[i].peer[0] && (strcmp(bodyPeers[i].peer, peer) == 0)) {
+            return &bodyPeers[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the entry for a peer or an unused entry, NULL if there are none
+ */
+static BodyCompressionPeer* AllocPeer(const char* peer)
+{
+    BodyCompressionPeer* entry = FindPeer(peer);
+    size_t len = strlen(peer);
+    size_t i;
+
+    if (len > MAX_NAME_SIZE) {
+        return NULL;
+    }
+    for (i = 0; !entry && (i < AJ_MAX_BODY_COMPRESSION_PEERS); ++i) {
+        if (!bodyPeers[i].peer[0]) {
+            entry = &bodyPeers[i];
+        }
+    }
+    if (entry) {
+        memset(entry, 0, sizeof(BodyCompressionPeer));
+        memcpy(entry->peer, peer, len + 1);
+    }
+    return entry;
+}
+
+AJ_Status AJ_NegotiateBodyCompression(AJ_BusAttachment* bus, const char* peer)
+{
+    BodyCompressionPeer* entry;
+    AJ_Message call;
+    AJ_Status status;
+
+    entry = AllocPeer(peer);
+    if (!entry) {
+        return AJ_ERR_RESOURCES;
+    }
+    status = AJ_MarshalMethodCall(bus, &call, AJ_METHOD_NEGOTIATE_BODY_COMPRESSION, peer, 0, 0, NEGOTIATE_CALL_TIMEOUT);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&call, "q", bus->sock.rx.bufSize);
+    }
+    if (status == AJ_OK) {
+        entry->serial = call.hdr->serialNum;
+        status = AJ_DeliverMsg(&call);
+    }
+    if (status != AJ_OK) {
+        entry->peer[0] = '\0';
+    }
+    return status;
+}
+
+uint8_t AJ_BodyCompressionNegotiated(const char* peer)
+{
+    BodyCompressionPeer* entry = peer ? FindPeer(peer) : NULL;
+    return entry && !entry->serial;
+}
+
+AJ_Status AJ_HandleNegotiateBodyCompression(AJ_Message* msg, AJ_Message* reply)
+{
+    BodyCompressionPeer* entry = NULL;
+    AJ_Status status;
+    uint16_t rxSize;
+
+    status = AJ_UnmarshalArgs(msg, "q", &rxSize);
+    if ((status == AJ_OK) && msg->sender) {
+        entry = AllocPeer(msg->sender);
+    }
+    if (!entry) {
+        return AJ_MarshalErrorMsg(msg, reply, AJ_ErrRejected);
+    }
+    entry->rxSize = rxSize;
+    status = AJ_MarshalReplyMsg(msg, reply);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(reply, "q", msg->bus->sock.rx.bufSize);
+    }
+    return status;
+}
+
+AJ_Status AJ_HandleNegotiateBodyCompressionReply(AJ_Message* msg)
+{
+    AJ_Status status = AJ_ERR_NO_MATCH;
+    size_t i;
+
+    for (i = 0; i < AJ_MAX_BODY_COMPRESSION_PEERS; ++i) {
+        BodyCompressionPeer* entry = &bodyPeers[i];
+        if (entry->peer[0] && entry->serial && (entry->serial == msg->replySerial)) {
+            if (msg->hdr->msgType != AJ_MSG_ERROR) {
+                status = AJ_UnmarshalArgs(msg, "q", &entry->rxSize);
+            }
+            if (status == AJ_OK) {
+                entry->serial = 0;
+            } else {
+                AJ_ErrPrintf(("Body compression not negotiated with %s\n", entry->peer));
+                entry->peer[0] = '\0';
+            }
+            break;
+        }
+    }
+    /*
+     * Messages to a peer that did not negotiate are simply not compressed
+     */
+    return AJ_OK;
+}
+
+void AJ_SetBodyCompressionThreshold(uint32_t threshold)
+{
+    bodyThreshold = threshold;
+}
+
+const AJ_BodyCompressionStats* AJ_GetBodyCompressionStats(void)
+{
+    return &bodyStats;
+}
+
+void AJ_CompressBody(AJ_Message* msg)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    uint32_t rawLen = msg->hdr->bodyLen;
+    uint8_t* body = ioBuf->writePtr - rawLen;
+    BodyCompressionPeer* entry = msg->destination ? FindPeer(msg->destination) : NULL;
+    uint32_t msgLen = (uint32_t)(ioBuf->writePtr - ioBuf->bufStart);
+    uint32_t len = 0;
+    uint32_t lead;
+
+    /*
+     * The peer must be able to hold the decompressed message
+     */
+    if (entry && !entry->serial && (rawLen >= bodyThreshold) && ((msgLen + LZ_EXPAND_MARGIN(rawLen)) <= entry->rxSize)) {
+        len = LZ_Compress(body, rawLen, NULL, &lead);
+    }
+    /*
+     * Compression is done in place so there must be room to move the body out of the way
+     */
+    if (!len || ((len + sizeof(uint32_t)) >= rawLen) || ((lead + sizeof(uint32_t)) > AJ_IO_BUF_SPACE(ioBuf))) {
+        msg->hdr->flags &= ~AJ_FLAG_BODY_COMPRESSED;
+        ++bodyStats.skipped;
+        return;
+    }
+    memmove(body + sizeof(uint32_t) + lead, body, rawLen);
+    LZ_Compress(body + sizeof(uint32_t) + lead, rawLen, body + sizeof(uint32_t), &lead);
+    memcpy(body, &rawLen, sizeof(uint32_t));
+    msg->hdr->bodyLen = len + sizeof(uint32_t);
+    ioBuf->writePtr = body + msg->hdr->bodyLen;
+    ++bodyStats.compressed;
+    bodyStats.bytesIn += rawLen;
+    bodyStats.bytesOut += msg->hdr->bodyLen;
+}
+
+AJ_Status AJ_ExpandBody(AJ_Message* msg, uint32_t len)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint8_t* body = ioBuf->readPtr;
+    uint8_t* bufEnd = ioBuf->bufStart + ioBuf->bufSize;
+    uint8_t* tail = body + msg->hdr->bodyLen;
+    uint32_t trailing;
+    uint8_t* src;
+    uint32_t rawLen;
+    AJ_Status status;
+
+    if ((len < sizeof(uint32_t)) || (msg->hdr->bodyLen > AJ_IO_BUF_AVAIL(ioBuf))) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    trailing = (uint32_t)(ioBuf->writePtr - tail);
+    rawLen = Read32(body);
+    if (msg->hdr->endianess == AJ_BIG_ENDIAN) {
+        rawLen = (rawLen >> 24) | ((rawLen >> 8) & 0xFF00) | ((rawLen << 8) & 0xFF0000) | (rawLen << 24);
+    }
+    len -= sizeof(uint32_t);
+    if ((rawLen + LZ_EXPAND_MARGIN(len) + trailing) > (uint32_t)(bufEnd - body)) {
+        return AJ_ERR_RESOURCES;
+    }
+    /*
+     * Park any bytes of the next message at the end of the buffer and move the compressed body up
+     * against them.
+     */
+    src = bufEnd - trailing - len;
+    memmove(bufEnd - trailing, tail, trailing);
+    memmove(src, body + sizeof(uint32_t), len);
+    status = LZ_Expand(src, len, body, rawLen);
+    if (status == AJ_OK) {
+        memmove(body + rawLen, bufEnd - trailing, trailing);
+        ioBuf->writePtr = body + rawLen + trailing;
+        msg->hdr->bodyLen = rawLen;
+        msg->bodyBytes = rawLen;
+        ++bodyStats.expanded;
+    } else {
+        /*
+         * Just the bytes of the next message are left
+         */
+        memmove(body, bufEnd - trailing, trailing);
+        ioBuf->writePtr = body + trailing;
+        msg->bodyBytes = 0;
+    }
+    return status;
+}
+
+void AJ_ClearCompressionRules(void)
+{
+    memset(txRules, 0, sizeof(txRules));
+    memset(rxRules, 0, sizeof(rxRules));
+    memset(bodyPeers, 0, sizeof(bodyPeers));
+    memset(&bodyStats, 0, sizeof(bodyStats));
+}
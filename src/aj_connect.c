@@ -31,6 +31,12 @@
 #include "aj_disco.h"
 #include "aj_std.h"
 #include "aj_auth.h"
+#include "aj_compress.h"
+#include "aj_txqueue.h"
+#include "aj_outbox.h"
+#include "aj_nvram.h"
+#include "aj_crc16.h"
+#include "aj_util.h"
 
 /*
  * For testing on host  set this value to 1 to bypass the discovery and connect directly to port
@@ -40,6 +46,106 @@
 
 static const char daemonService[] = "org.alljoyn.BusNode";
 
+#define CACHE_UNKNOWN  0   /* Not read from NVRAM yet */
+#define CACHE_EMPTY    1
+#define CACHE_VALID    2
+
+typedef struct _CachedService {
+    uint16_t nameCrc;      /* CRC of the service name the daemon was discovered with */
+    AJ_Service service;
+} CachedService;
+
+static struct {
+    uint8_t state;
+    CachedService entry;
+} cache;
+
+static struct {
+    AJ_ConnectStats stats;
+    uint8_t connected;     /* A connect succeeded and there has not been a disconnect since */
+    uint8_t reconnecting;  /* Timing a reconnect */
+    AJ_Time disconnected;  /* When the last connection was lost */
+} conn;
+
+static uint16_t NameCrc(const char* serviceName)
+{
+    uint16_t crc = 0;
+    AJ_CRC16_Compute((const uint8_t*)serviceName, (uint16_t)strlen(serviceName), &crc);
+    return crc;
+}
+
+#ifndef AJ_SERIAL_CONNECTION
+/*
+ * Serial connections go straight to the daemon so only discovery uses the cached address
+ */
+static uint8_t GetCachedService(const char* serviceName, AJ_Service* service)
+{
+    if (cache.state == CACHE_UNKNOWN) {
+        cache.state = CACHE_EMPTY;
+        if (AJ_NVRAM_Exist(AJ_NVRAM_ID_DAEMON_SERVICE)) {
+            AJ_NV_DATASET* handle = AJ_NVRAM_Open(AJ_NVRAM_ID_DAEMON_SERVICE, "r", 0);
+            if (handle) {
+                if (AJ_NVRAM_Read(&cache.entry, sizeof(CachedService), handle) == sizeof(CachedService)) {
+                    cache.state = CACHE_VALID;
+                }
+                AJ_NVRAM_Close(handle);
+            }
+        }
+    }
+    if ((cache.state == CACHE_VALID) && (cache.entry.nameCrc == NameCrc(serviceName))) {
+        *service = cache.entry.service;
+        return TRUE;
+    }
+    return FALSE;
+}
+#endif
+
+void AJ_SetCachedService(const char* serviceName, const AJ_Service* service)
+{
+    CachedService entry;
+    AJ_NV_DATASET* handle;
+
+    memset(&entry, 0, sizeof(CachedService));
+    entry.nameCrc = NameCrc(serviceName ? serviceName : daemonService);
+    entry.service.addrTypes = service->addrTypes;
+    entry.service.transportMask = service->transportMask;
+    entry.service.ipv4port = service->ipv4port;
+    entry.service.ipv6port = service->ipv6port;
+    entry.service.ipv4 = service->ipv4;
+    memcpy(entry.service.ipv6, service->ipv6, sizeof(service->ipv6));
+    /*
+     * Only write NVRAM when the address changes
+     */
+    if ((cache.state == CACHE_VALID) && (cache.entry.nameCrc == entry.nameCrc) &&
+        (cache.entry.service.addrTypes == service->addrTypes) && (cache.entry.service.ipv4port == service->ipv4port) &&
+        (cache.entry.service.ipv4 == service->ipv4) && (cache.entry.service.ipv6port == service->ipv6port) &&
+        (memcmp(cache.entry.service.ipv6, service->ipv6, sizeof(service->ipv6)) == 0)) {
+        return;
+    }
+    cache.entry = entry;
+    cache.state = CACHE_VALID;
+    handle = AJ_NVRAM_Open(AJ_NVRAM_ID_DAEMON_SERVICE, "w", sizeof(CachedService));
+    if (handle) {
+        if (AJ_NVRAM_Write(&entry, sizeof(CachedService), handle) != sizeof(CachedService)) {
+            AJ_Printf("Failed to save the daemon address\n");
+        }
+        AJ_NVRAM_Close(handle);
+    }
+}
+
+void AJ_ClearCachedService(void)
+{
+    cache.state = CACHE_EMPTY;
+    if (AJ_NVRAM_Exist(AJ_NVRAM_ID_DAEMON_SERVICE)) {
+        AJ_NVRAM_Delete(AJ_NVRAM_ID_DAEMON_SERVICE);
+    }
+}
+
+void AJ_GetConnectStats(AJ_ConnectStats* stats)
+{
+    *stats = conn.stats;
+}
+
 static uint32_t DefaultBusAuthPwdFunc(uint8_t* buffer, uint32_t bufLen)
 {
     const char* defaultPwd = "1234";
@@ -117,11 +223,70 @@ static AJ_Status AuthAdvance(AJ_SASL_Context* context, AJ_IOBuffer* rxBuf, AJ_IO
     return status;
 }
 
-AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t timeout)
+/*
+ * Authenticate with the daemon and say hello to get our unique name
+ */
+static AJ_Status Handshake(AJ_BusAttachment* bus)
 {
     AJ_Status status;
     AJ_SASL_Context sasl;
+
+    /*
+     * Send initial NUL byte
+     */
+    bus->sock.tx.writePtr[0] = 0;
+    bus->sock.tx.writePtr += 1;
+    status = bus->sock.tx.send(&bus->sock.tx);
+    if (status != AJ_OK) {
+        return status;
+    }
+    AJ_SASL_InitContext(&sasl, mechList, AJ_AUTH_RESPONDER, busAuthPwdFunc);
+    while (TRUE) {
+        status = AuthAdvance(&sasl, &bus->sock.rx, &bus->sock.tx);
+        if ((status != AJ_OK) || (sasl.state == AJ_SASL_FAILED)) {
+            break;
+        }
+        if (sasl.state == AJ_SASL_AUTHENTICATED) {
+            status = SendHello(bus);
+            break;
+        }
+    }
+    if (status == AJ_OK) {
+        AJ_Message helloResponse;
+        status = AJ_UnmarshalMsg(bus, &helloResponse, 5000);
+        if (status == AJ_OK) {
+            /*
+             * The only error we might get is a timeout
+             */
+            if (helloResponse.hdr->msgType == AJ_MSG_ERROR) {
+                status = AJ_ERR_TIMEOUT;
+            } else {
+                AJ_Arg arg;
+                status = AJ_UnmarshalArg(&helloResponse, &arg);
+                if (status == AJ_OK) {
+                    if (arg.len >= (sizeof(bus->uniqueName) - 1)) {
+                        status = AJ_ERR_RESOURCES;
+                    } else {
+                        memcpy(bus->uniqueName, arg.val.v_string, arg.len);
+                        bus->uniqueName[arg.len] = '\0';
+                    }
+                }
+            }
+            AJ_CloseMsg(&helloResponse);
+        }
+    }
+    return status;
+}
+
+AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t timeout)
+{
+    AJ_Status status;
     AJ_Service service;
+    AJ_Time timer;
+    uint8_t cached = FALSE;
+    uint8_t discovered = FALSE;
+
+    AJ_InitTimer(&timer);
     /*
      * Clear the bus struct
      */
@@ -130,6 +295,10 @@ AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t ti
      * Clear stale name->GUID mappings
      */
     AJ_GUID_ClearNameMap();
+    /*
+     * Compression tokens are only meaningful for the unique names on this connection
+     */
+    AJ_ClearCompressionRules();
     /*
      * Host-specific network bring-up procedure. This includes establishing a connection to the
      * network and initializing the I/O buffers.
@@ -164,75 +333,91 @@ AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t ti
 #elif defined AJ_SERIAL_CONNECTION
     // don't bother with discovery, we are connected to a daemon.
 #else
+    /*
+     * Try the daemon we were last connected to before discovering one
+     */
+    if (GetCachedService(serviceName, &service)) {
+        status = AJ_Net_Connect(&bus->sock, service.ipv4port, service.addrTypes & AJ_ADDR_IPV4, &service.ipv4, AJ_CACHED_CONNECT_TIMEOUT);
+        if (status == AJ_OK) {
+            status = Handshake(bus);
+            if (status == AJ_OK) {
+                cached = TRUE;
+                goto ExitConnect;
+            }
+            /*
+             * Something is listening at the cached address but it is not the daemon we want so
+             * forget the address and discover one instead
+             */
+            cache.state = CACHE_EMPTY;
+            AJ_ReleaseReplyContexts();
+            AJ_Net_Disconnect(&bus->sock);
+            memset(bus, 0, sizeof(AJ_BusAttachment));
+        }
+    }
     status = AJ_Discover(serviceName, &service, timeout);
     if (status != AJ_OK) {
         goto ExitConnect;
     }
+    discovered = TRUE;
 #endif
-    status = AJ_Net_Connect(&bus->sock, service.ipv4port, service.addrTypes & AJ_ADDR_IPV4, &service.ipv4);
-    if (status != AJ_OK) {
-        goto ExitConnect;
-    }
-    /*
-     * Send initial NUL byte
-     */
-    bus->sock.tx.writePtr[0] = 0;
-    bus->sock.tx.writePtr += 1;
-    status = bus->sock.tx.send(&bus->sock.tx);
+    status = AJ_Net_Connect(&bus->sock, service.ipv4port, service.addrTypes & AJ_ADDR_IPV4, &service.ipv4, 0);
     if (status != AJ_OK) {
         goto ExitConnect;
     }
-    AJ_SASL_InitContext(&sasl, mechList, AJ_AUTH_RESPONDER, busAuthPwdFunc);
-    while (TRUE) {
-        status = AuthAdvance(&sasl, &bus->sock.rx, &bus->sock.tx);
-        if ((status != AJ_OK) || (sasl.state == AJ_SASL_FAILED)) {
-            break;
-        }
-        if (sasl.state == AJ_SASL_AUTHENTICATED) {
-            status = SendHello(bus);
-            break;
-        }
-    }
-    if (status == AJ_OK) {
-        AJ_Message helloResponse;
-        status = AJ_UnmarshalMsg(bus, &helloResponse, 5000);
-        if (status == AJ_OK) {
-            /*
-             * The only error we might get is a timeout
-             */
-            if (helloResponse.hdr->msgType == AJ_MSG_ERROR) {
-                status = AJ_ERR_TIMEOUT;
-            } else {
-                AJ_Arg arg;
-                status = AJ_UnmarshalArg(&helloResponse, &arg);
-                if (status == AJ_OK) {
-                    if (arg.len >= (sizeof(bus->uniqueName) - 1)) {
-                        status = AJ_ERR_RESOURCES;
-                    } else {
-                        memcpy(bus->uniqueName, arg.val.v_string, arg.len);
-                        bus->uniqueName[arg.len] = '\0';
-                    }
-                }
-            }
-            AJ_CloseMsg(&helloResponse);
-        }
-    }
+    status = Handshake(bus);
 
 ExitConnect:
 
     if (status != AJ_OK) {
         AJ_Printf("AllJoyn connect failed %d\n", status);
+        ++conn.stats.failures;
         AJ_Disconnect(bus);
+    } else {
+        if (discovered) {
+            AJ_SetCachedService(serviceName, &service);
+            ++conn.stats.discovered;
+        }
+        if (cached) {
+            ++conn.stats.cached;
+        }
+        ++conn.stats.connects;
+        conn.stats.connectTime = AJ_GetElapsedTime(&timer, TRUE);
+        if (conn.reconnecting) {
+            conn.stats.reconnectTime = AJ_GetElapsedTime(&conn.disconnected, TRUE);
+            if (conn.stats.reconnectTime > conn.stats.maxReconnectTime) {
+                conn.stats.maxReconnectTime = conn.stats.reconnectTime;
+            }
+            ++conn.stats.reconnects;
+            conn.reconnecting = FALSE;
+        }
+        conn.connected = TRUE;
+        /*
+         * Signals kept in the outbox can now be replayed
+         */
+        AJ_OutboxConnected(bus);
     }
     return status;
 }
 
 void AJ_Disconnect(AJ_BusAttachment* bus)
 {
+    /*
+     * Time how long it takes to connect again
+     */
+    if (conn.connected) {
+        AJ_InitTimer(&conn.disconnected);
+        conn.connected = FALSE;
+        conn.reconnecting = TRUE;
+    }
     /*
      * We won't be getting any more method replies.
      */
     AJ_ReleaseReplyContexts();
+    /*
+     * Corked messages are for the connection that is going away
+     */
+    AJ_ReleaseCorkedMsgs(bus);
+    AJ_ReleaseTxQueue(bus);
     /*
      * Disconnect the network closing sockets etc.
      */
@@ -241,4 +426,8 @@ void AJ_Disconnect(AJ_BusAttachment* bus)
      * Host-specific network shutdown procedure
      */
     AJ_Net_Down();
+    /*
+     * Durable signals are kept in the outbox until we reconnect
+     */
+    AJ_OutboxDisconnected(bus);
 }
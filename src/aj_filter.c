@@ -0,0 +1,113 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_filter.h"
+#include "aj_msg.h"
+#include "aj_util.h"
+
+static AJ_SignalFilter filters[AJ_MAX_SIGNAL_FILTERS];
+static uint8_t numFilters;
+static uint8_t defaultAction = AJ_SIGNAL_FILTER_ACCEPT;
+static AJ_SignalFilterStats filterStats;
+
+/*
+ * Interfaces of signals from the bus that are never filtered
+ */
+static const char* const BusInterfaces[] = { "org.freedesktop.DBus", "org.alljoyn.Bus" };
+
+AJ_Status AJ_RegisterSignalFilter(const AJ_SignalFilter* filter)
+{
+    if (numFilters == AJ_MAX_SIGNAL_FILTERS) {
+        return AJ_ERR_RESOURCES;
+    }
+    filters[numFilters++] = *filter;
+    return AJ_OK;
+}
+
+void AJ_SetSignalFilterDefault(uint8_t action)
+{
+    defaultAction = action;
+}
+
+void AJ_ClearSignalFilters(void)
+{
+    memset(filters, 0, sizeof(filters));
+    numFilters = 0;
+    defaultAction = AJ_SIGNAL_FILTER_ACCEPT;
+    memset(&filterStats, 0, sizeof(filterStats));
+}
+
+const AJ_SignalFilterStats* AJ_GetSignalFilterStats(void)
+{
+    return &filterStats;
+}
+
+/*
+ * A NULL pattern matches anything, a missing header field only matches a NULL pattern
+ */
+static uint8_t MatchField(const char* pattern, const char* field)
+{
+    return !pattern || (field && (strcmp(pattern, field) == 0));
+}
+
+static uint8_t IsBusSignal(const char* iface)
+{
+    size_t i;
+
+    if (!iface) {
+        return FALSE;
+    }
+    for (i = 0; i < ArraySize(BusInterfaces); ++i) {
+        size_t len = strlen(BusInterfaces[i]);
+        if ((strncmp(iface, BusInterfaces[i], len) == 0) && ((iface[len] == '\0') || (iface[len] == '.'))) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+uint8_t AJ_DropSignal(const AJ_Message* msg)
+{
+    uint8_t action = defaultAction;
+    uint8_t i;
+
+    if ((msg->hdr->msgType != AJ_MSG_SIGNAL) || IsBusSignal(msg->iface)) {
+        return FALSE;
+    }
+    if (!numFilters && (action == AJ_SIGNAL_FILTER_ACCEPT)) {
+        return FALSE;
+    }
+    for (i = 0; i < numFilters; ++i) {
+        const AJ_SignalFilter* filter = &filters[i];
+        if (MatchField(filter->iface, msg->iface) &&
+            MatchField(filter->member, msg->member) &&
+            MatchField(filter->sender, msg->sender) &&
+            (!filter->sessionId || (filter->sessionId == msg->sessionId))) {
+            action = filter->action;
+            break;
+        }
+    }
+    if (action != AJ_SIGNAL_FILTER_DROP) {
+        return FALSE;
+    }
+    ++filterStats.messages;
+    filterStats.bytes += sizeof(AJ_MsgHeader) + ((msg->hdr->headerLen + 7) & ~7) + msg->hdr->bodyLen;
+    return TRUE;
+}
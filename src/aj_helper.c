@@ -18,10 +18,18 @@
 #include "alljoyn.h"
 
 #include "aj_link_timeout.h"
+#include "aj_outbox.h"
+#include "aj_crypto.h"
 
 #define UNMARSHAL_TIMEOUT (100 * 1000)
 #define CONNECT_TIMEOUT   (60 * 1000)
-#define CONNECT_PAUSE     (10 * 1000)
+
+/*
+ * The pause between connect attempts starts at CONNECT_PAUSE_MIN and doubles after each failed
+ * attempt up to CONNECT_PAUSE_MAX
+ */
+#define CONNECT_PAUSE_MIN (500)
+#define CONNECT_PAUSE_MAX (10 * 1000)
 
 #define MAX_TIMERS 4
 
@@ -95,6 +103,24 @@ void AJ_CancelTimer(uint32_t id)
 }
 
 
+static uint32_t connectPause;
+
+/*
+ * Back off then pause for a random time between half and all of the backoff so devices that lost
+ * the same daemon don't all try to reconnect at once
+ */
+static void ConnectPause(void)
+{
+    uint32_t pause;
+    uint16_t jitter;
+
+    connectPause = connectPause ? min(connectPause * 2, CONNECT_PAUSE_MAX) : CONNECT_PAUSE_MIN;
+    AJ_RandBytes((uint8_t*)&jitter, sizeof(jitter));
+    pause = (connectPause / 2) + (jitter % ((connectPause / 2) + 1));
+    AJ_WarnPrintf(("Sleeping for %u ms before connecting to the bus\n", pause));
+    AJ_Sleep(pause);
+}
+
 AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* config)
 {
     uint8_t connected = FALSE;
@@ -142,6 +168,12 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
             // if no timers running, wait forever
             timeout = next;
         }
+        /*
+         * Don't wait for messages while there are signals in the outbox to replay
+         */
+        if (AJ_OutboxReplay(bus) == AJ_ERR_BUSY) {
+            timeout = 0;
+        }
 
         status = AJ_UnmarshalMsg(bus, &msg, min(500, timeout));
         if (AJ_ERR_TIMEOUT == status && AJ_ERR_LINK_TIMEOUT == AJ_BusLinkStateProc(bus)) {
@@ -232,9 +264,9 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
                 (config->connection_handler)(connected);
             }
             /*
-             * Sleep a little while before trying to reconnect
+             * Pause briefly before reconnecting, AJ_StartService2() backs off if that fails
              */
-            AJ_Sleep(10 * 1000);
+            ConnectPause();
         }
     }
 
@@ -280,10 +312,10 @@ AJ_Status AJ_StartService2(AJ_BusAttachment* bus,
             AJ_InfoPrintf(("Attempting to connect to bus\n"));
             status = AJ_Connect(bus, daemonName, CONNECT_TIMEOUT);
             if (status != AJ_OK) {
-                AJ_WarnPrintf(("Failed to connect to bus sleeping for %d seconds\n", CONNECT_PAUSE / 1000));
-                AJ_Sleep(CONNECT_PAUSE);
+                ConnectPause();
                 continue;
             }
+            connectPause = 0;
             AJ_InfoPrintf(("AllJoyn service connected to bus\n"));
         }
         /*
@@ -401,10 +433,10 @@ AJ_Status AJ_StartClient2(AJ_BusAttachment* bus,
             AJ_InfoPrintf(("Attempting to connect to bus\n"));
             status = AJ_Connect(bus, daemonName, CONNECT_TIMEOUT);
             if (status != AJ_OK) {
-                AJ_WarnPrintf(("Failed to connect to bus sleeping for %d seconds\n", CONNECT_PAUSE / 1000));
-                AJ_Sleep(CONNECT_PAUSE);
+                ConnectPause();
                 continue;
             }
+            connectPause = 0;
             AJ_InfoPrintf(("AllJoyn client connected to bus\n"));
         }
         /*
@@ -29,7 +29,15 @@
  */
 const AJ_Object* objectLists[3] = { AJ_StandardObjects, NULL, NULL };
 
-#define NUM_REPLY_CONTEXTS   2
+/*
+ * Message id lookup functions registered for object lists
+ */
+typedef struct _MsgIdLookup {
+    const AJ_Object* objList;
+    AJ_MsgIdLookupFunc lookup;
+} MsgIdLookup;
+
+static MsgIdLookup msgIdLookups[AJ_MAX_MSGID_LOOKUPS];
 
 #define DEFAULT_REPLY_TIMEOUT   1000 * 20
 
@@ -41,9 +49,21 @@ typedef struct _ReplyContext {
     uint32_t timeout;    /**< How long to wait for a reply */
     uint32_t serial;     /**< Serial number for the reply message */
     uint32_t messageId;  /**< The unique message id for the call */
+    AJ_MethodReplyCallback callback; /**< Callback for an asynchronous method call */
+    void* context;       /**< Context passed to the callback */
 } ReplyContext;
 
-static ReplyContext replyContexts[NUM_REPLY_CONTEXTS];
+static ReplyContext replyContexts[AJ_MAX_REPLY_CONTEXTS];
+
+/*
+ * Callback for the reply that is currently being unmarshaled. Only one message is unmarshaled at a
+ * time so the callback is held here between AJ_UnmarshalMsg() and AJ_BusHandleBusMessage().
+ */
+static struct {
+    uint32_t serial;
+    AJ_MethodReplyCallback callback;
+    void* context;
+} pendingReply;
 
 /**
  * Function used by XML generator to push generated XML
@@ -519,6 +539,189 @@ static AJ_Status ComposeSignature(const char* encoding, char direction, char* si
     return AJ_OK;
 }
 
+/*
+ * Pre-parsed member encoding
+ */
+typedef struct _MemberDescriptor {
+    uint16_t inSig;       /* Offset of the method call or property signature in the signature pool */
+    uint16_t outSig;      /* Offset of the signal, method reply or property signature in the signature pool */
+    uint8_t nameLen;      /* Length of the member name */
+    uint8_t kind;         /* SIGNAL, METHOD or PROPERTY */
+    uint8_t access;       /* WRITE_ONLY, READ_WRITE or READ_ONLY for properties */
+} MemberDescriptor;
+
+typedef struct _InterfaceDescriptor {
+    AJ_InterfaceDescription iface;  /* The interface description */
+    uint16_t first;                 /* Index of the descriptor for the first member */
+} InterfaceDescriptor;
+
+static InterfaceDescriptor ifaceDescriptors[AJ_MAX_INTERFACE_DESCRIPTORS];
+static uint8_t numIfaceDescriptors;
+static MemberDescriptor memberDescriptors[AJ_MAX_MEMBER_DESCRIPTORS];
+static uint16_t numMemberDescriptors;
+/*
+ * Offset zero is the empty signature
+ */
+static char sigPool[AJ_MEMBER_SIGNATURE_POOL];
+static uint16_t sigPoolLen;
+
+#define NO_SIGNATURE 0xFFFF
+
+/*
+ * Compose a signature from a member encoding and add it to the signature pool. Returns the offset
+ * of the signature in the pool or NO_SIGNATURE if there is no space.
+ */
+static uint16_t PoolSignature(const char* encoding, char direction)
+{
+    char sig[64];
+    size_t len;
+    uint16_t pos;
+
+    if (ComposeSignature(encoding, direction, sig, sizeof(sig)) != AJ_OK) {
+        return NO_SIGNATURE;
+    }
+    /*
+     * Share the signature with any signature or signature suffix already in the pool
+     */
+    for (pos = 0; pos < sigPoolLen; ++pos) {
+        if (strcmp(&sigPool[pos], sig) == 0) {
+            return pos;
+        }
+    }
+    len = strlen(sig) + 1;
+    if ((sigPoolLen + len) > sizeof(sigPool)) {
+        return NO_SIGNATURE;
+    }
+    memcpy(&sigPool[sigPoolLen], sig, len);
+    pos = sigPoolLen;
+    sigPoolLen += (uint16_t)len;
+    return pos;
+}
+
+/*
+ * Parse the member encodings of an interface into member descriptors
+ */
+static void DescribeInterface(AJ_InterfaceDescription iface)
+{
+    InterfaceDescriptor* ifaceDesc;
+    uint16_t first = numMemberDescriptors;
+    uint16_t poolLen = sigPoolLen;
+    const char* const* member;
+    uint8_t i;
+
+    for (i = 0; i < numIfaceDescriptors; ++i) {
+        if (ifaceDescriptors[i].iface == iface) {
+            return;
+        }
+    }
+    if (numIfaceDescriptors == AJ_MAX_INTERFACE_DESCRIPTORS) {
+        return;
+    }
+    for (member = iface + 1; *member; ++member) {
+        const char* encoding = *member;
+        MemberDescriptor* md = &memberDescriptors[numMemberDescriptors];
+        int32_t nameLen = AJ_StringFindFirstOf(encoding + 1, " <=>");
+
+        if (numMemberDescriptors == AJ_MAX_MEMBER_DESCRIPTORS) {
+            break;
+        }
+        if (nameLen < 0) {
+            nameLen = (int32_t)strlen(encoding + 1);
+        }
+        md->kind = MEMBER_TYPE(*encoding);
+        md->nameLen = (uint8_t)nameLen;
+        if (md->kind == PROPERTY) {
+            md->access = encoding[1 + nameLen];
+            md->inSig = PoolSignature(encoding + 1, md->access);
+            md->outSig = md->inSig;
+        } else {
+            md->access = 0;
+            md->inSig = PoolSignature(encoding + 1, IN_ARG);
+            md->outSig = PoolSignature(encoding + 1, OUT_ARG);
+        }
+        if ((nameLen > 255) || (md->inSig == NO_SIGNATURE) || (md->outSig == NO_SIGNATURE)) {
+            break;
+        }
+        ++numMemberDescriptors;
+    }
+    /*
+     * All or nothing, an interface that doesn't fit is parsed when it is used
+     */
+    if (*member) {
+        numMemberDescriptors = first;
+        sigPoolLen = poolLen;
+        return;
+    }
+    ifaceDesc = &ifaceDescriptors[numIfaceDescriptors++];
+    ifaceDesc->iface = iface;
+    ifaceDesc->first = first;
+}
+
+static void DescribeObjects(const AJ_Object* list)
+{
+    if (list) {
+        while (list->path) {
+            const AJ_InterfaceDescription* iface = list->interfaces;
+            if (iface) {
+                while (*iface) {
+                    DescribeInterface(*iface++);
+                }
+            }
+            ++list;
+        }
+    }
+}
+
+/*
+ * Get the member descriptors for an interface, NULL if the interface was not described
+ */
+static const MemberDescriptor* FindDescriptors(AJ_InterfaceDescription iface)
+{
+    uint8_t i;
+
+    for (i = 0; i < numIfaceDescriptors; ++i) {
+        if (ifaceDescriptors[i].iface == iface) {
+            return &memberDescriptors[ifaceDescriptors[i].first];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Get the member descriptor for a message id that has already been validated
+ */
+static const MemberDescriptor* MsgIdDescriptor(uint32_t msgId)
+{
+    const AJ_Object* obj = &objectLists[(uint8_t)(msgId >> 24)][(uint8_t)(msgId >> 16)];
+    const MemberDescriptor* md = FindDescriptors(obj->interfaces[(uint8_t)(msgId >> 8)]);
+    return md ? &md[(uint8_t)msgId] : NULL;
+}
+
+static uint8_t MatchName(const char* encoding, const MemberDescriptor* md, const char* name)
+{
+    return (strncmp(encoding + 1, name, md->nameLen) == 0) && (name[md->nameLen] == '\0');
+}
+
+/*
+ * Match a method call or signal against a member descriptor and check the signature
+ */
+static AJ_Status MatchDescriptor(const char* encoding, const MemberDescriptor* md, const AJ_Message* msg)
+{
+    const char* sig = msg->signature ? msg->signature : "";
+
+    if (msg->hdr->msgType == AJ_MSG_METHOD_CALL) {
+        if ((md->kind != METHOD) || !MatchName(encoding, md, msg->member)) {
+            return AJ_ERR_NO_MATCH;
+        }
+        return (strcmp(&sigPool[md->inSig], sig) == 0) ? AJ_OK : AJ_ERR_SIGNATURE;
+    } else {
+        if ((md->kind != SIGNAL) || !MatchName(encoding, md, msg->member)) {
+            return AJ_ERR_NO_MATCH;
+        }
+        return (strcmp(&sigPool[md->outSig], sig) == 0) ? AJ_OK : AJ_ERR_SIGNATURE;
+    }
+}
+
 static AJ_Status MatchProp(const char* member, const char* prop, uint8_t op, char* sig, size_t len)
 {
     const char* encoding = member;
@@ -543,6 +746,28 @@ static AJ_Status MatchProp(const char* member, const char* prop, uint8_t op, cha
     return ComposeSignature(member, *encoding, sig, len);
 }
 
+static AJ_Status MatchPropDescriptor(const char* encoding, const MemberDescriptor* md, const char* prop, uint8_t op, char* sig, size_t len)
+{
+    const char* propSig = &sigPool[md->inSig];
+    size_t sigLen;
+
+    if ((md->kind != PROPERTY) || !MatchName(encoding, md, prop)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    if ((op == AJ_PROP_GET) && (md->access == WRITE_ONLY)) {
+        return AJ_ERR_DISALLOWED;
+    }
+    if ((op == AJ_PROP_SET) && (md->access == READ_ONLY)) {
+        return AJ_ERR_DISALLOWED;
+    }
+    sigLen = strlen(propSig);
+    if (sigLen >= len) {
+        return AJ_ERR_RESOURCES;
+    }
+    memcpy(sig, propSig, sigLen + 1);
+    return AJ_OK;
+}
+
 static uint32_t MatchMember(const char* encoding, const AJ_Message* msg)
 {
     const char* member = msg->member;
@@ -597,14 +822,20 @@ static AJ_Status LookupMessageId(const AJ_Object* list, AJ_Message* msg, uint8_t
                 uint8_t iIndex;
                 AJ_InterfaceDescription desc = FindInterface(obj->interfaces, msg->iface, &iIndex);
                 if (desc) {
+                    const MemberDescriptor* md = FindDescriptors(desc);
                     uint8_t mIndex = 0;
                     *secure = SecurityApplies(*desc, obj, list);
                     /*
                      * Skip the interface name and iterate over the members of the interface
                      */
                     while (*(++desc)) {
-                        if (MatchMember(*desc, msg)) {
-                            AJ_Status status = CheckSignature(*desc, msg);
+                        AJ_Status status;
+                        if (md) {
+                            status = MatchDescriptor(*desc, &md[mIndex], msg);
+                        } else {
+                            status = MatchMember(*desc, msg) ? CheckSignature(*desc, msg) : AJ_ERR_NO_MATCH;
+                        }
+                        if (status != AJ_ERR_NO_MATCH) {
                             if (status == AJ_OK) {
                                 msg->msgId = (pIndex << 16) | (iIndex << 8) | mIndex;
                             }
@@ -694,6 +925,7 @@ AJ_Status AJ_MarshalPropertyArgs(AJ_Message* msg, uint32_t propId)
     AJ_Status status;
     const char* iface;
     const char* prop;
+    const MemberDescriptor* md;
     uint8_t secure;
     size_t pos;
     AJ_Arg arg;
@@ -702,6 +934,7 @@ AJ_Status AJ_MarshalPropertyArgs(AJ_Message* msg, uint32_t propId)
     if (status != AJ_OK) {
         return status;
     }
+    md = MsgIdDescriptor(propId);
     if (secure) {
         msg->hdr->flags |= AJ_FLAG_ENCRYPTED;
     }
@@ -712,16 +945,20 @@ AJ_Status AJ_MarshalPropertyArgs(AJ_Message* msg, uint32_t propId)
     /*
      * Marshal property name
      */
-    pos = AJ_StringFindFirstOf(prop, "<=>");
+    pos = md ? md->nameLen : AJ_StringFindFirstOf(prop, "<=>");
     AJ_InitArg(&arg, AJ_ARG_STRING, 0, prop, pos);
     status = AJ_MarshalArg(msg, &arg);
     /*
      * If setting a property handle the variant setup
      */
     if ((status == AJ_OK) && ((msg->msgId & 0xFF) == AJ_PROP_SET)) {
-        char sig[16];
-        ComposeSignature(prop, prop[pos], sig, sizeof(sig));
-        status = AJ_MarshalVariant(msg, sig);
+        if (md) {
+            status = AJ_MarshalVariant(msg, &sigPool[md->inSig]);
+        } else {
+            char sig[16];
+            ComposeSignature(prop, prop[pos], sig, sizeof(sig));
+            status = AJ_MarshalVariant(msg, sig);
+        }
     }
     return status;
 }
@@ -785,12 +1022,18 @@ AJ_Status AJ_InitMessageFromMsgId(AJ_Message* msg, uint32_t msgId, uint8_t msgTy
             }
         }
         /*
-         * Compose the signature from information in the member encoding.
+         * Use the pre-parsed signature or compose the signature from information in the member
+         * encoding.
          */
         if (status == AJ_OK) {
-            status = ComposeSignature(member, direction, msgSignature, sizeof(msgSignature));
-            if (status == AJ_OK) {
-                msg->signature = msgSignature;
+            const MemberDescriptor* md = MsgIdDescriptor(msgId);
+            if (md) {
+                msg->signature = &sigPool[(direction == IN_ARG) ? md->inSig : md->outSig];
+            } else {
+                status = ComposeSignature(member, direction, msgSignature, sizeof(msgSignature));
+                if (status == AJ_OK) {
+                    msg->signature = msgSignature;
+                }
             }
         }
     }
@@ -818,7 +1061,13 @@ static AJ_Status CheckReturnSignature(AJ_Message* msg, uint32_t msgId)
      * Nothing to check for error messages
      */
     if (msg->hdr->msgType != AJ_MSG_ERROR) {
-        status = CheckSignature(member, msg);
+        const MemberDescriptor* md = MsgIdDescriptor(msgId);
+        if (md) {
+            const char* sig = msg->signature ? msg->signature : "";
+            status = (strcmp(&sigPool[md->outSig], sig) == 0) ? AJ_OK : AJ_ERR_SIGNATURE;
+        } else {
+            status = CheckSignature(member, msg);
+        }
     }
     if (status == AJ_OK) {
         msg->msgId = AJ_REPLY_ID(msgId);
@@ -836,6 +1085,34 @@ static ReplyContext* FindReplyContext(uint32_t serial) {
     return NULL;
 }
 
+/*
+ * Release a reply context holding on to the callback if this was an asynchronous method call
+ */
+static void ReleaseReplyContext(ReplyContext* repCtx)
+{
+    pendingReply.serial = repCtx->callback ? repCtx->serial : 0;
+    pendingReply.callback = repCtx->callback;
+    pendingReply.context = repCtx->context;
+    repCtx->serial = 0;
+    repCtx->callback = NULL;
+}
+
+/*
+ * Release the reply context for a reply that is going to be discarded. The reply never reaches
+ * AJ_BusHandleBusMessage() so an asynchronous caller is told why right away.
+ */
+static void RejectReply(AJ_Message* msg, ReplyContext* repCtx, AJ_Status status)
+{
+    AJ_MethodReplyCallback callback = repCtx->callback;
+
+    repCtx->serial = 0;
+    repCtx->callback = NULL;
+    if (callback) {
+        msg->msgId = AJ_REPLY_ID(repCtx->messageId);
+        callback(msg, status, repCtx->context);
+    }
+}
+
 AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig, size_t len)
 {
     AJ_Status status = AJ_ERR_NO_MATCH;
@@ -860,6 +1137,7 @@ AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig,
         uint8_t iIndex;
         AJ_InterfaceDescription desc = FindInterface(obj->interfaces, iface, &iIndex);
         if (desc) {
+            const MemberDescriptor* md = FindDescriptors(desc);
             uint8_t mIndex = 0;
             /*
              * Security is based on the interface the property is defined on.
@@ -869,7 +1147,11 @@ AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig,
              * Iterate over the interface members to locate the property is being accessed.
              */
             while (*(++desc)) {
-                status = MatchProp(*desc, prop, msg->msgId & 0xFF, sig, len);
+                if (md) {
+                    status = MatchPropDescriptor(*desc, &md[mIndex], prop, msg->msgId & 0xFF, sig, len);
+                } else {
+                    status = MatchProp(*desc, prop, msg->msgId & 0xFF, sig, len);
+                }
                 if (status != AJ_ERR_NO_MATCH) {
                     if (status == AJ_OK) {
                         *propId = (oIndex << 24) | (pIndex << 16) | (iIndex << 8) | mIndex;
@@ -891,6 +1173,48 @@ AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig,
     return status;
 }
 
+AJ_Status AJ_RegisterMsgIdLookup(const AJ_Object* objList, AJ_MsgIdLookupFunc lookup)
+{
+    MsgIdLookup* slot = NULL;
+    size_t i;
+
+    for (i = 0; i < ArraySize(msgIdLookups); ++i) {
+        if (msgIdLookups[i].objList == objList) {
+            slot = &msgIdLookups[i];
+            break;
+        }
+        if (!slot && !msgIdLookups[i].objList) {
+            slot = &msgIdLookups[i];
+        }
+    }
+    if (!slot) {
+        return lookup ? AJ_ERR_RESOURCES : AJ_OK;
+    }
+    slot->objList = lookup ? objList : NULL;
+    slot->lookup = lookup;
+    return AJ_OK;
+}
+
+/*
+ * Identify a message with a lookup function registered for the object list
+ */
+static AJ_Status LookupGenerated(const AJ_Object* list, AJ_Message* msg, uint8_t* secure)
+{
+    size_t i;
+
+    for (i = 0; list && (i < ArraySize(msgIdLookups)); ++i) {
+        if (msgIdLookups[i].objList == list) {
+            AJ_Status status = msgIdLookups[i].lookup(list, msg);
+            if (status == AJ_OK) {
+                const AJ_Object* obj = &list[(uint8_t)(msg->msgId >> 16)];
+                *secure = SecurityApplies(obj->interfaces[(uint8_t)(msg->msgId >> 8)][0], obj, list);
+            }
+            return status;
+        }
+    }
+    return LookupMessageId(list, msg, secure);
+}
+
 AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
 {
     AJ_Status status = AJ_ERR_NO_MATCH;
@@ -908,7 +1232,7 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
          */
         for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
             secure = FALSE;
-            status = LookupMessageId(objectLists[oIndex], msg, &secure);
+            status = LookupGenerated(objectLists[oIndex], msg, &secure);
             if (status == AJ_OK) {
                 msg->msgId |= (oIndex << 24);
                 AJ_InfoPrintf(("Identified message %x\n", msg->msgId));
@@ -933,12 +1257,17 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
         }
     } else {
         ReplyContext* repCtx = FindReplyContext(msg->replySerial);
+        pendingReply.serial = 0;
         if (repCtx) {
             status = CheckReturnSignature(msg, repCtx->messageId);
             /*
              * Release the reply context
              */
-            repCtx->serial = 0;
+            if (status == AJ_OK) {
+                ReleaseReplyContext(repCtx);
+            } else {
+                RejectReply(msg, repCtx, status);
+            }
         }
     }
     return status;
@@ -946,8 +1275,22 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
 
 void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObjects)
 {
+    size_t i;
+
     objectLists[AJ_APP_ID_FLAG] = localObjects;
     objectLists[AJ_PRX_ID_FLAG] = proxyObjects;
+    AJ_ClearHeaderCache();
+    /*
+     * Parse the member encodings of all the interfaces
+     */
+    numIfaceDescriptors = 0;
+    numMemberDescriptors = 0;
+    sigPool[0] = '\0';
+    sigPoolLen = 1;
+    for (i = 0; i < ArraySize(objectLists); ++i) {
+        DescribeObjects(objectLists[i]);
+    }
+    AJ_InfoPrintf(("AJ_RegisterObjects(): %u interfaces %u members %u signature bytes\n", numIfaceDescriptors, numMemberDescriptors, sigPoolLen));
 }
 
 AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const char* objPath)
@@ -965,10 +1308,11 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
         }
     }
     proxyObjects[pIndex].path = objPath;
+    AJ_ClearHeaderCache();
     return AJ_OK;
 }
 
-AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
+AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout, AJ_MethodReplyCallback callback, void* context)
 {
     if (msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED) {
         /*
@@ -984,6 +1328,8 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
             repCtx->serial = msg->hdr->serialNum;
             repCtx->messageId = msg->msgId;
             repCtx->timeout = timeout ? timeout : DEFAULT_REPLY_TIMEOUT;
+            repCtx->callback = callback;
+            repCtx->context = context;
             AJ_InitTimer(&repCtx->callTime);
             return AJ_OK;
         } else {
@@ -999,6 +1345,7 @@ void AJ_ReleaseReplyContext(AJ_Message* msg)
         ReplyContext* repCtx = FindReplyContext(msg->hdr->serialNum);
         if (repCtx) {
             repCtx->serial = 0;
+            repCtx->callback = NULL;
         }
     }
 }
@@ -1017,7 +1364,7 @@ uint8_t AJ_TimedOutMethodCall(AJ_Message* msg)
             /*
              * Release the reply context
              */
-            repCtx->serial = 0;
+            ReleaseReplyContext(repCtx);
             return TRUE;
         }
     }
@@ -1027,4 +1374,16 @@ uint8_t AJ_TimedOutMethodCall(AJ_Message* msg)
 void AJ_ReleaseReplyContexts(void)
 {
     memset(replyContexts, 0, sizeof(replyContexts));
+    memset(&pendingReply, 0, sizeof(pendingReply));
+}
+
+uint8_t AJ_DispatchReply(AJ_Message* msg)
+{
+    if (pendingReply.serial && (pendingReply.serial == msg->replySerial)) {
+        AJ_MethodReplyCallback callback = pendingReply.callback;
+        pendingReply.serial = 0;
+        callback(msg, AJ_OK, pendingReply.context);
+        return TRUE;
+    }
+    return FALSE;
 }
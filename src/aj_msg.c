@@ -31,6 +31,10 @@
 #include "aj_std.h"
 #include "aj_debug.h"
 #include "aj_bus.h"
+#include "aj_compress.h"
+#include "aj_filter.h"
+#include "aj_txqueue.h"
+#include "aj_outbox.h"
 
 #if HOST_IS_LITTLE_ENDIAN
 #define HOST_ENDIANESS AJ_LITTLE_ENDIAN
@@ -74,6 +78,13 @@ static const uint8_t TypeForHdr[] = {
     AJ_ARG_UINT32       /* AJ_HDR_SESSION_ID        */
 };
 
+/*
+ * The header fields that are replaced by a compression token
+ */
+#define IsCompressedField(f) (((f) == AJ_HDR_OBJ_PATH) || ((f) == AJ_HDR_INTERFACE) || ((f) == AJ_HDR_MEMBER) || \
+                              ((f) == AJ_HDR_DESTINATION) || ((f) == AJ_HDR_SIGNATURE) || \
+                              ((f) == AJ_HDR_TIME_TO_LIVE) || ((f) == AJ_HDR_SESSION_ID))
+
 #define AJ_SCALAR    0x10
 #define AJ_CONTAINER 0x20
 #define AJ_STRING    0x40
@@ -210,6 +221,79 @@ static void EndianSwap(AJ_Message* msg, uint8_t typeId, void* data, uint32_t num
     }
 }
 
+/*
+ * Returns the size of a struct with only scalar fields whose size is a multiple of 8. Because
+ * structs are 8 byte aligned there is no padding between the elements of an array of these structs
+ * so the wire layout of the array is the same as an array of the equivalent C struct. Returns zero
+ * for any other type.
+ */
+static uint32_t FixedStructSize(const char* sig)
+{
+    uint32_t size = 0;
+
+    if (*sig++ != AJ_ARG_STRUCT) {
+        return 0;
+    }
+    while (*sig != AJ_STRUCT_CLOSE) {
+        uint8_t typeId = (uint8_t)*sig++;
+        uint32_t sz;
+
+        if (!typeId || !IsScalarType(typeId)) {
+            return 0;
+        }
+        sz = SizeOfType(typeId);
+        size = ((size + sz - 1) & ~(sz - 1)) + sz;
+    }
+    return (size & 7) ? 0 : size;
+}
+
+/*
+ * Endian swap an array of fixed layout structs. Structs where all the fields are the same size are
+ * swapped in one go.
+ */
+static void EndianSwapStructs(AJ_Message* msg, const char* sig, uint8_t* data, uint32_t num)
+{
+    if (msg->hdr->endianess != HOST_ENDIANESS) {
+        uint32_t size = FixedStructSize(sig);
+        const char* field;
+
+        for (field = sig + 2; *field != AJ_STRUCT_CLOSE; ++field) {
+            if (SizeOfType(*field) != SizeOfType(sig[1])) {
+                break;
+            }
+        }
+        if (*field == AJ_STRUCT_CLOSE) {
+            EndianSwap(msg, sig[1], data, (num * size) / SizeOfType(sig[1]));
+            return;
+        }
+        while (num--) {
+            uint32_t offset = 0;
+            for (field = sig + 1; *field != AJ_STRUCT_CLOSE; ++field) {
+                uint32_t sz = SizeOfType(*field);
+                offset = (offset + sz - 1) & ~(sz - 1);
+                EndianSwap(msg, *field, data + offset, 1);
+                offset += sz;
+            }
+            data += size;
+        }
+    }
+}
+
+/*
+ * Returns the signature of the next argument to be marshaled or unmarshaled
+ */
+static const char* NextArgSignature(AJ_Message* msg, AJ_IOBuffer* ioBuf)
+{
+    if (msg->varOffset) {
+        uint8_t* base = (ioBuf->direction == AJ_IO_BUF_RX) ? ioBuf->readPtr : ioBuf->writePtr;
+        return (const char*)(base - msg->varOffset);
+    } else if (msg->outer) {
+        return msg->outer->sigPtr;
+    } else {
+        return msg->signature + msg->sigOffset;
+    }
+}
+
 /*
  * Computes total size of a message - note header is padded to an 8 byte boundary
  */
@@ -314,7 +398,21 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
          * Write the final body length to the header
          */
         msg->hdr->bodyLen = msg->bodyBytes;
+        /*
+         * Durable signals are kept while disconnected and until earlier ones have been replayed
+         */
+        if (AJ_OutboxCaptures(msg)) {
+            status = AJ_OutboxMsg(msg);
+            memset(msg, 0, sizeof(AJ_Message));
+            return status;
+        }
         AJ_DumpMsg("SENDING", msg, TRUE);
+        /*
+         * Compress before encrypting, encrypted data does not compress
+         */
+        if (msg->hdr->flags & AJ_FLAG_BODY_COMPRESSED) {
+            AJ_CompressBody(msg);
+        }
         if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
             status = EncryptMessage(msg);
         }
@@ -327,13 +425,122 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
         }
     }
     if (status == AJ_OK) {
-        //#pragma calls = AJ_Net_Send
-        status = ioBuf->send(ioBuf);
+        if (AJ_TxQueueActive(msg->bus)) {
+            status = AJ_TxQueueMsg(msg);
+        } else {
+            //#pragma calls = AJ_Net_Send
+            status = ioBuf->send(ioBuf);
+        }
     }
     memset(msg, 0, sizeof(AJ_Message));
     return status;
 }
 
+#if AJ_CORK_BUFFER_SIZE
+/*
+ * Messages delivered while the tx buffer is corked are collected in the cork buffer
+ */
+static struct {
+    AJ_IOBuffer* ioBuf;   /* The corked tx buffer or NULL */
+    AJ_TxFunc send;       /* The send function the cork replaced */
+    AJ_IOBuffer buf;      /* Collects the corked messages */
+    uint8_t data[AJ_CORK_BUFFER_SIZE];
+} cork;
+
+/*
+ * Send the collected messages in one write
+ */
+static AJ_Status FlushCork(uint8_t flags)
+{
+    AJ_Status status = AJ_OK;
+
+    if (AJ_IO_BUF_AVAIL(&cork.buf)) {
+        cork.buf.context = cork.ioBuf->context;
+        cork.buf.flags = flags;
+        //#pragma calls = AJ_Net_Send
+        status = cork.send(&cork.buf);
+        AJ_IO_BUF_RESET(&cork.buf);
+    }
+    return status;
+}
+
+/*
+ * Replaces the send function of the corked tx buffer
+ */
+static AJ_Status CorkSend(AJ_IOBuffer* ioBuf)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t tx = AJ_IO_BUF_AVAIL(ioBuf);
+
+    /*
+     * The data we are about to collect follows what is flushed here
+     */
+    if (tx > AJ_IO_BUF_SPACE(&cork.buf)) {
+        status = FlushCork(AJ_IO_BUF_MORE);
+    }
+    if (status == AJ_OK) {
+        if (tx > AJ_IO_BUF_SPACE(&cork.buf)) {
+            /*
+             * Too big to collect so send it as is
+             */
+            ioBuf->flags = 0;
+            //#pragma calls = AJ_Net_Send
+            status = cork.send(ioBuf);
+        } else {
+            memcpy(cork.buf.writePtr, ioBuf->readPtr, tx);
+            cork.buf.writePtr += tx;
+            AJ_IO_BUF_RESET(ioBuf);
+        }
+    }
+    return status;
+}
+#endif
+
+AJ_Status AJ_CorkMsgs(AJ_BusAttachment* bus)
+{
+#if AJ_CORK_BUFFER_SIZE
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+
+    /*
+     * The transmit queue already batches messages
+     */
+    if (AJ_TxQueueActive(bus)) {
+        return AJ_OK;
+    }
+    if (cork.ioBuf) {
+        return (cork.ioBuf == ioBuf) ? AJ_OK : AJ_ERR_RESOURCES;
+    }
+    AJ_IOBufInit(&cork.buf, cork.data, sizeof(cork.data), AJ_IO_BUF_TX, NULL);
+    cork.ioBuf = ioBuf;
+    cork.send = ioBuf->send;
+    ioBuf->send = CorkSend;
+#endif
+    return AJ_OK;
+}
+
+AJ_Status AJ_UncorkMsgs(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+#if AJ_CORK_BUFFER_SIZE
+    if (cork.ioBuf == &bus->sock.tx) {
+        status = FlushCork(0);
+        cork.ioBuf->send = cork.send;
+        cork.ioBuf = NULL;
+    }
+#endif
+    return status;
+}
+
+void AJ_ReleaseCorkedMsgs(AJ_BusAttachment* bus)
+{
+#if AJ_CORK_BUFFER_SIZE
+    if (cork.ioBuf == &bus->sock.tx) {
+        cork.ioBuf->send = cork.send;
+        cork.ioBuf = NULL;
+    }
+#endif
+}
+
 /*
  * Timeout after we have started to unmarshal a message
  */
@@ -342,7 +549,7 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
 /*
  * Make sure we have the required number of bytes in the I/O buffer
  */
-static AJ_Status LoadBytes(AJ_IOBuffer* ioBuf, uint16_t numBytes, uint8_t pad)
+static AJ_Status LoadBytes(AJ_IOBuffer* ioBuf, uint32_t numBytes, uint8_t pad)
 {
     AJ_Status status = AJ_OK;
 
@@ -413,6 +620,7 @@ static AJ_Status WriteBytes(AJ_Message* msg, const void* data, size_t numBytes,
         }
         memcpy(ioBuf->writePtr, data, canWrite);
         ioBuf->writePtr += canWrite;
+        data = (const uint8_t*)data + canWrite;
         numBytes -= canWrite;
     }
     return status;
@@ -436,7 +644,7 @@ AJ_Status AJ_CloseMsg(AJ_Message* msg)
          * Skip any unconsumed bytes
          */
         while (msg->bodyBytes) {
-            uint16_t sz = AJ_IO_BUF_AVAIL(ioBuf);
+            uint32_t sz = AJ_IO_BUF_AVAIL(ioBuf);
             sz = min(sz, msg->bodyBytes);
             if (!sz) {
                 AJ_IO_BUF_RESET(ioBuf);
@@ -553,7 +761,7 @@ static AJ_Status UnmarshalArray(AJ_Message* msg, const char** sig, AJ_Arg* arg,
         /*
          * For scalar types we do an inplace endian swap (if needed) and return a pointer into the read buffer.
          */
-        EndianSwap(msg, typeId, (void*)arg->val.v_data, arg->len);
+        EndianSwap(msg, typeId, (void*)arg->val.v_data, arg->len / SizeOfType(typeId));
         ioBuf->readPtr += numBytes;
         arg->typeId = typeId;
         arg->flags = AJ_ARRAY_FLAG;
@@ -650,6 +858,164 @@ static AJ_Status Unmarshal(AJ_Message* msg, const char** sig, AJ_Arg* arg)
     return status;
 }
 
+/*
+ * Set a header field value in a message that is being unmarshaled
+ */
+static void SetHeaderField(AJ_Message* msg, uint8_t fieldId, const void* val, uint32_t* token)
+{
+    switch (fieldId) {
+    case AJ_HDR_OBJ_PATH:
+        msg->objPath = (const char*)val;
+        break;
+
+    case AJ_HDR_INTERFACE:
+        msg->iface = (const char*)val;
+        break;
+
+    case AJ_HDR_MEMBER:
+        msg->member = (const char*)val;
+        break;
+
+    case AJ_HDR_ERROR_NAME:
+        msg->error = (const char*)val;
+        break;
+
+    case AJ_HDR_REPLY_SERIAL:
+        msg->replySerial = *((const uint32_t*)val);
+        break;
+
+    case AJ_HDR_DESTINATION:
+        msg->destination = (const char*)val;
+        break;
+
+    case AJ_HDR_SENDER:
+        msg->sender = (const char*)val;
+        break;
+
+    case AJ_HDR_SIGNATURE:
+        msg->signature = (const char*)val;
+        break;
+
+    case AJ_HDR_TIMESTAMP:
+        msg->timestamp = *((const uint32_t*)val);
+        break;
+
+    case AJ_HDR_TIME_TO_LIVE:
+        msg->ttl = *((const uint16_t*)val);
+        break;
+
+    case AJ_HDR_SESSION_ID:
+        msg->sessionId = *((const uint32_t*)val);
+        break;
+
+    case AJ_HDR_COMPRESSION_TOKEN:
+        *token = *((const uint32_t*)val);
+        break;
+
+    case AJ_HDR_HANDLES:
+    default:
+        /* Ignored */
+        break;
+    }
+}
+
+/*
+ * Fast path for unmarshaling the header fields once the entire header is in the receive buffer.
+ * Fields with a string, signature, uint32 or uint16 value are decoded in place with a bounds check
+ * against the end of the header. Decoding stops at the first field with any other signature leaving
+ * the read pointer at the start of that field for the generic unmarshaler.
+ */
+static AJ_Status UnmarshalHeaderFields(AJ_Message* msg, const uint8_t* endOfHeader, uint32_t* token)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint8_t swap = (msg->hdr->endianess != HOST_ENDIANESS);
+    uint8_t* pos = ioBuf->readPtr;
+
+    while (pos < endOfHeader) {
+        /*
+         * Header fields are "(yv)" structs so are 8 byte aligned. The variant signature is always one
+         * byte long so the value that follows is 4 byte aligned.
+         */
+        uint8_t* field = ioBuf->bufStart + (((uint32_t)(pos - ioBuf->bufStart) + 7) & ~7);
+        uint8_t* val = field + 4;
+        uint8_t fieldId;
+        uint32_t avail;
+        uint32_t len;
+
+        if (val > endOfHeader) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        fieldId = field[0];
+        if ((field[1] != 1) || (field[3] != 0)) {
+            ioBuf->readPtr = field;
+            return AJ_OK;
+        }
+        if ((fieldId <= AJ_HDR_SESSION_ID) && (TypeForHdr[fieldId] != field[2])) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        avail = (uint32_t)(endOfHeader - val);
+        switch (field[2]) {
+        case AJ_ARG_STRING:
+        case AJ_ARG_OBJ_PATH:
+            if (avail < 5) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            len = *((uint32_t*)val);
+            if (swap) {
+                len = ENDSWAP32(len);
+            }
+            if ((len > (avail - 5)) || val[4 + len]) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            val += 4;
+            pos = val + len + 1;
+            break;
+
+        case AJ_ARG_SIGNATURE:
+            if (avail < 2) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            len = val[0];
+            if ((len > (avail - 2)) || val[1 + len]) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            val += 1;
+            pos = val + len + 1;
+            break;
+
+        case AJ_ARG_UINT32:
+        case AJ_ARG_INT32:
+            if (avail < 4) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            if (swap) {
+                uint32_t v = *((uint32_t*)val);
+                *((uint32_t*)val) = ENDSWAP32(v);
+            }
+            pos = val + 4;
+            break;
+
+        case AJ_ARG_UINT16:
+            if (avail < 2) {
+                return AJ_ERR_UNMARSHAL;
+            }
+            if (swap) {
+                uint16_t v = *((uint16_t*)val);
+                *((uint16_t*)val) = ENDSWAP16(v);
+            }
+            pos = val + 2;
+            break;
+
+        default:
+            ioBuf->readPtr = field;
+            return AJ_OK;
+        }
+        SetHeaderField(msg, fieldId, val, token);
+    }
+    ioBuf->readPtr = pos;
+    return AJ_OK;
+}
+
 static const AJ_MsgHeader internalErrorHdr = { HOST_ENDIANESS, AJ_MSG_ERROR, 0, 0, 0, 1, 0 };
 
 AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
@@ -658,6 +1024,7 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     AJ_IOBuffer* ioBuf = &bus->sock.rx;
     uint8_t* endOfHeader;
     uint32_t hdrPad;
+    uint32_t token = 0;
     /*
      * Clear message then set the bus
      */
@@ -668,12 +1035,40 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      * Move any unconsumed data to the start of the I/O buffer
      */
     AJ_IOBufRebase(ioBuf);
+#if AJ_CORK_BUFFER_SIZE
+    /*
+     * Flush corked messages before waiting for a message, a corked method call would otherwise
+     * never get a reply.
+     */
+    if ((cork.ioBuf == &bus->sock.tx) && (AJ_IO_BUF_AVAIL(ioBuf) < sizeof(AJ_MsgHeader))) {
+        status = FlushCork(0);
+        if (status != AJ_OK) {
+            return status;
+        }
+    }
+#endif
     /*
      * Load the message header
      */
     while (AJ_IO_BUF_AVAIL(ioBuf) < sizeof(AJ_MsgHeader)) {
+        uint32_t wait = timeout;
+        /*
+         * Keep writing queued messages while waiting for a message
+         */
+        if (AJ_TxQueueActive(bus)) {
+            status = AJ_TxQueueDrain(bus);
+            if (status == AJ_ERR_BUSY) {
+                wait = min(timeout, AJ_TX_QUEUE_POLL);
+            } else if (status != AJ_OK) {
+                return status;
+            }
+        }
         //#pragma calls = AJ_Net_Recv
-        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), timeout);
+        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), wait);
+        if ((status == AJ_ERR_TIMEOUT) && (wait < timeout)) {
+            timeout -= wait;
+            continue;
+        }
         if (status != AJ_OK) {
             /*
              * If there were no messages to receive check if we have any methods call that have
@@ -730,13 +1125,19 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      */
     msg->signature = "";
     /*
-     * We have the header in the buffer now we can unmarshal the header fields
+     * We have the header in the buffer now we can unmarshal the header fields. The fast path decodes
+     * the fields directly from the buffer, any field it does not handle is unmarshaled generically.
      */
     endOfHeader = ioBuf->bufStart + sizeof(AJ_MsgHeader) + msg->hdr->headerLen;
     while (ioBuf->readPtr < endOfHeader) {
         const char* fieldSig;
         uint8_t fieldId;
         AJ_Arg hdrVal;
+
+        status = UnmarshalHeaderFields(msg, endOfHeader, &token);
+        if ((status != AJ_OK) || (ioBuf->readPtr >= endOfHeader)) {
+            break;
+        }
         /*
          * Custom unmarshal the header field - signature is "(yv)" so starts off with STRUCT aligment.
          */
@@ -761,59 +1162,16 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
             status = AJ_ERR_UNMARSHAL;
             break;
         }
-        /*
-         * Set the field value in the message
-         */
-        switch (fieldId) {
-        case AJ_HDR_OBJ_PATH:
-            msg->objPath = hdrVal.val.v_objPath;
-            break;
-
-        case AJ_HDR_INTERFACE:
-            msg->iface = hdrVal.val.v_string;
-            break;
-
-        case AJ_HDR_MEMBER:
-            msg->member = hdrVal.val.v_string;
-            break;
-
-        case AJ_HDR_ERROR_NAME:
-            msg->error = hdrVal.val.v_string;
-            break;
-
-        case AJ_HDR_REPLY_SERIAL:
-            msg->replySerial = *(hdrVal.val.v_uint32);
-            break;
-
-        case AJ_HDR_DESTINATION:
-            msg->destination = hdrVal.val.v_string;
-            break;
-
-        case AJ_HDR_SENDER:
-            msg->sender = hdrVal.val.v_string;
-            break;
-
-        case AJ_HDR_SIGNATURE:
-            msg->signature = hdrVal.val.v_signature;
-            break;
-
-        case AJ_HDR_TIMESTAMP:
-            msg->timestamp = *(hdrVal.val.v_uint32);
-            break;
-
-        case AJ_HDR_TIME_TO_LIVE:
-            msg->ttl = *(hdrVal.val.v_uint32);
-            break;
-
-        case AJ_HDR_SESSION_ID:
-            msg->sessionId = *(hdrVal.val.v_uint32);
-            break;
-
-        case AJ_HDR_HANDLES:
-        case AJ_HDR_COMPRESSION_TOKEN:
-        default:
-            /* Ignored */
-            break;
+        SetHeaderField(msg, fieldId, hdrVal.val.v_data, &token);
+    }
+    /*
+     * Only signals can be compressed, the compressed fields come from the sender's expansion rule
+     */
+    if ((status == AJ_OK) && (msg->hdr->flags & AJ_FLAG_COMPRESSED)) {
+        if ((msg->hdr->msgType != AJ_MSG_SIGNAL) || !token) {
+            status = AJ_ERR_UNMARSHAL;
+        } else {
+            status = AJ_ExpandHeader(msg, token);
         }
     }
     if (status == AJ_OK) {
@@ -822,6 +1180,14 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
          * Consume the header pad bytes.
          */
         ioBuf->readPtr += hdrPad;
+        /*
+         * Check if the application wants this signal before doing any work on the body. A dropped
+         * signal has its body skipped by AJ_CloseMsg() below.
+         */
+        if (AJ_DropSignal(msg)) {
+            AJ_CloseMsg(msg);
+            return AJ_ERR_NO_MATCH;
+        }
         /*
          * If the message is encrypted load the entire message body and decrypt it.
          */
@@ -831,6 +1197,16 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
                 status = DecryptMessage(msg);
             }
         }
+        /*
+         * If the body is compressed load the entire body and decompress it in place, the MAC of an
+         * encrypted message is discarded.
+         */
+        if ((status == AJ_OK) && (msg->hdr->flags & AJ_FLAG_BODY_COMPRESSED)) {
+            status = LoadBytes(ioBuf, msg->hdr->bodyLen, 0);
+            if (status == AJ_OK) {
+                status = AJ_ExpandBody(msg, msg->hdr->bodyLen - ((msg->hdr->flags & AJ_FLAG_ENCRYPTED) ? MAC_LENGTH : 0));
+            }
+        }
         /*
          * Toggle the AUTO_START flag so in the API no flags == 0
          *
@@ -863,14 +1239,220 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     return status;
 }
 
-AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
+/*
+ * Number of bytes of an array that have been unmarshaled
+ */
+static uint32_t ArrayConsumed(AJ_IOBuffer* ioBuf, const AJ_Arg* array)
+{
+    uint32_t len = (uint32_t)(ioBuf->readPtr - (uint8_t*)array->val.v_data);
+    if (array->flags & AJ_ARRAY_CURSOR_FLAG) {
+        len += ((const AJ_ArrayCursor*)array)->consumed;
+    }
+    return len;
+}
+
+/*
+ * Move the unread bytes of a streamed array back towards the start of the array to make room to
+ * receive more. The bytes are moved a multiple of 8 so the wire alignment is preserved.
+ */
+static void SlideArray(AJ_IOBuffer* ioBuf, AJ_ArrayCursor* cursor)
+{
+    uint32_t avail = AJ_IO_BUF_AVAIL(ioBuf);
+    uint8_t* dest = cursor->base + ((ioBuf->readPtr - cursor->base) & 7);
+
+    if (ioBuf->readPtr != dest) {
+        cursor->consumed += (uint32_t)(ioBuf->readPtr - (uint8_t*)cursor->array.val.v_data);
+        memmove(dest, ioBuf->readPtr, avail);
+        ioBuf->readPtr = dest;
+        ioBuf->writePtr = dest + avail;
+        cursor->array.val.v_data = dest;
+    }
+}
+
+/*
+ * Called before each element of a streamed array is unmarshaled
+ */
+static void RefillArray(AJ_IOBuffer* ioBuf, AJ_ArrayCursor* cursor)
+{
+    uint8_t* bufEnd = ioBuf->bufStart + ioBuf->bufSize;
+    uint32_t remaining = cursor->array.len - ArrayConsumed(ioBuf, &cursor->array);
+
+    if (!AJ_IO_BUF_AVAIL(ioBuf)) {
+        SlideArray(ioBuf, cursor);
+        /*
+         * Read ahead as much of the array as we can, errors are reported by LoadBytes
+         */
+        if (remaining) {
+            //#pragma calls = AJ_Net_Recv
+            ioBuf->recv(ioBuf, min(remaining, AJ_IO_BUF_SPACE(ioBuf)), UNMARSHAL_TIMEOUT);
+        }
+    } else if ((uint32_t)(bufEnd - ioBuf->readPtr) < ((uint32_t)(bufEnd - cursor->base) / 2)) {
+        SlideArray(ioBuf, cursor);
+    }
+}
+
+AJ_Status AJ_UnmarshalArrayCursor(AJ_Message* msg, AJ_ArrayCursor* cursor)
 {
     AJ_Status status;
     AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
     AJ_Arg* container = msg->outer;
     uint8_t* argStart = ioBuf->readPtr;
+    const char* sig;
+    uint32_t consumed;
+    uint32_t numBytes;
+
+    memset(cursor, 0, sizeof(AJ_ArrayCursor));
+    if (container) {
+        if (container->typeId == AJ_ARG_ARRAY) {
+            return AJ_ERR_UNEXPECTED;
+        }
+        sig = container->sigPtr;
+    } else {
+        sig = msg->signature + msg->sigOffset;
+    }
+    if (*sig != AJ_ARG_ARRAY) {
+        return AJ_ERR_SIGNATURE;
+    }
+    ++sig;
+    status = LoadBytes(ioBuf, 4, PadForType(AJ_ARG_ARRAY, ioBuf));
+    if (status != AJ_OK) {
+        return status;
+    }
+    EndianSwap(msg, AJ_ARG_UINT32, ioBuf->readPtr, 1);
+    numBytes = *((uint32_t*)ioBuf->readPtr);
+    ioBuf->readPtr += 4;
+    status = LoadBytes(ioBuf, 0, PadForType(*sig, ioBuf));
+    if (status != AJ_OK) {
+        return status;
+    }
+    consumed = (uint32_t)(ioBuf->readPtr - argStart);
+    if ((consumed + numBytes) > msg->bodyBytes) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    msg->bodyBytes -= consumed;
+    cursor->array.typeId = AJ_ARG_ARRAY;
+    cursor->array.flags = AJ_ARRAY_CURSOR_FLAG;
+    cursor->array.len = numBytes;
+    cursor->array.val.v_data = ioBuf->readPtr;
+    cursor->array.sigPtr = sig;
+    cursor->array.container = container;
+    cursor->base = ioBuf->readPtr;
+    msg->outer = &cursor->array;
+    /*
+     * Consume the array signature
+     */
+    sig += CompleteTypeSigLen(sig);
+    if (container) {
+        container->sigPtr = sig;
+    } else {
+        msg->sigOffset = (uint8_t)(sig - msg->signature);
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_UnmarshalArrayChunk(AJ_Message* msg, AJ_ArrayCursor* cursor, const void** data, size_t len, size_t* actual)
+{
+    AJ_Status status;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint8_t typeId = *cursor->array.sigPtr;
+    uint32_t size;
+    uint32_t remaining;
+    uint32_t avail;
+
+    if (msg->outer != &cursor->array) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    size = IsScalarType(typeId) ? SizeOfType(typeId) : FixedStructSize(cursor->array.sigPtr);
+    if (!size) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    remaining = cursor->array.len - ArrayConsumed(ioBuf, &cursor->array);
+    if (!remaining) {
+        return AJ_ERR_NO_MORE;
+    }
+    if (len < size) {
+        return AJ_ERR_INVALID;
+    }
+    RefillArray(ioBuf, cursor);
+    len = min(len, remaining);
+    len = min(len, (size_t)(ioBuf->bufStart + ioBuf->bufSize - ioBuf->readPtr));
+    /*
+     * Return what has already been received rather than waiting for more
+     */
+    avail = AJ_IO_BUF_AVAIL(ioBuf);
+    if (avail >= size) {
+        len = min(len, avail);
+    }
+    len -= len % size;
+    status = LoadBytes(ioBuf, (uint32_t)len, 0);
+    if (status == AJ_OK) {
+        if (typeId == AJ_ARG_STRUCT) {
+            EndianSwapStructs(msg, cursor->array.sigPtr, ioBuf->readPtr, (uint32_t)len / size);
+        } else {
+            EndianSwap(msg, typeId, ioBuf->readPtr, (uint32_t)len / size);
+        }
+        *data = ioBuf->readPtr;
+        *actual = len;
+        ioBuf->readPtr += len;
+        msg->bodyBytes -= (uint32_t)len;
+    }
+    return status;
+}
+
+AJ_Status AJ_UnmarshalCloseArrayCursor(AJ_Message* msg, AJ_ArrayCursor* cursor)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint32_t remaining;
+
+    if (msg->outer != &cursor->array) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    /*
+     * Skip the elements that were not unmarshaled
+     */
+    remaining = cursor->array.len - ArrayConsumed(ioBuf, &cursor->array);
+    while (remaining) {
+        uint32_t sz;
+
+        RefillArray(ioBuf, cursor);
+        sz = min(remaining, AJ_IO_BUF_AVAIL(ioBuf));
+        if (!sz) {
+            sz = min(remaining, (uint32_t)(ioBuf->bufStart + ioBuf->bufSize - ioBuf->readPtr));
+            status = LoadBytes(ioBuf, sz, 0);
+            if (status != AJ_OK) {
+                break;
+            }
+        }
+        ioBuf->readPtr += sz;
+        msg->bodyBytes -= sz;
+        remaining -= sz;
+    }
+    /*
+     * Make room for the arguments that follow the array
+     */
+    SlideArray(ioBuf, cursor);
+    msg->outer = cursor->array.container;
+    return status;
+}
+
+AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
+{
+    AJ_Status status;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    AJ_Arg* container = msg->outer;
+    uint8_t* argStart;
     size_t consumed;
 
+    /*
+     * Make room for the next element of a streamed array, but not for the value of a variant
+     * element which follows the variant signature.
+     */
+    if (container && (container->flags & AJ_ARRAY_CURSOR_FLAG) && !msg->varOffset) {
+        RefillArray(ioBuf, (AJ_ArrayCursor*)container);
+    }
+    argStart = ioBuf->readPtr;
+
     if (msg->varOffset) {
         /*
          * Unmarshaling a variant - get the signature from the I/O buffer
@@ -883,7 +1465,7 @@ AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
          * Unmarshaling a component of a container use the container's signature
          */
         if (container->typeId == AJ_ARG_ARRAY) {
-            size_t len = (uint16_t)(ioBuf->readPtr - (uint8_t*)container->val.v_data);
+            size_t len = ArrayConsumed(ioBuf, container);
             /*
              * Return an error status if there are no more array elements.
              */
@@ -912,7 +1494,7 @@ AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
          */
         status = AJ_ERR_READ;
     } else {
-        msg->bodyBytes -= (uint16_t)consumed;
+        msg->bodyBytes -= (uint32_t)consumed;
     }
     return status;
 }
@@ -966,6 +1548,34 @@ AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* sig, ...)
     return status;
 }
 
+AJ_Status AJ_UnmarshalStructArray(AJ_Message* msg, const void** data, size_t elemSize, size_t* numElems)
+{
+    AJ_Status status;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    const char* sig = NextArgSignature(msg, ioBuf);
+    AJ_Arg arg;
+
+    if ((sig[0] != AJ_ARG_ARRAY) || !elemSize || (FixedStructSize(sig + 1) != elemSize)) {
+        return AJ_ERR_SIGNATURE;
+    }
+    /*
+     * This loads the entire array into the receive buffer leaving the read pointer at the first element
+     */
+    status = AJ_UnmarshalArg(msg, &arg);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if ((arg.len % elemSize) || (arg.len > msg->bodyBytes)) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    EndianSwapStructs(msg, arg.sigPtr, ioBuf->readPtr, arg.len / (uint32_t)elemSize);
+    *data = ioBuf->readPtr;
+    *numElems = arg.len / elemSize;
+    ioBuf->readPtr += arg.len;
+    msg->bodyBytes -= arg.len;
+    return AJ_OK;
+}
+
 AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t* actual)
 {
     AJ_Status status;
@@ -1016,7 +1626,7 @@ AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t
     /*
      * If we try to load more than the buffer size we will get an error
      */
-    status = LoadBytes(ioBuf, (uint16_t)min(len, ioBuf->bufSize), 0);
+    status = LoadBytes(ioBuf, (uint32_t)min(len, ioBuf->bufSize), 0);
     if (status == AJ_OK) {
         sz = AJ_IO_BUF_AVAIL(ioBuf);
         if (sz < len) {
@@ -1025,7 +1635,7 @@ AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t
         *data = ioBuf->readPtr;
         *actual = len;
         ioBuf->readPtr += len;
-        msg->bodyBytes -= (uint16_t)len;
+        msg->bodyBytes -= (uint32_t)len;
     }
     return status;
 }
@@ -1060,7 +1670,7 @@ AJ_Status AJ_UnmarshalCloseContainer(AJ_Message* msg, AJ_Arg* arg)
         /*
          * Check that all the array elements have been unmarshaled
          */
-        size_t len = (uint16_t)(ioBuf->readPtr - (uint8_t*)arg->val.v_data);
+        size_t len = ArrayConsumed(ioBuf, arg);
         if (len != arg->len) {
             return AJ_ERR_UNMARSHAL;
         }
@@ -1136,12 +1746,18 @@ static AJ_Status Marshal(AJ_Message* msg, const char** sig, AJ_Arg* arg)
         return AJ_ERR_NULL;
     }
     *sig += 1;
-    if (IsScalarType(arg->typeId)) {
+    if (IsScalarType(arg->typeId) || ((arg->typeId == AJ_ARG_STRUCT) && (arg->flags & AJ_ARRAY_FLAG))) {
         if (arg->flags & AJ_ARRAY_FLAG) {
             if ((typeId != AJ_ARG_ARRAY) || (**sig != arg->typeId)) {
                 return AJ_ERR_MARSHAL;
             }
-            *sig += 1;
+            /*
+             * Arrays of structs are written in one go so the structs must have a fixed layout
+             */
+            if ((arg->typeId == AJ_ARG_STRUCT) && !FixedStructSize(*sig)) {
+                return AJ_ERR_MARSHAL;
+            }
+            *sig += CompleteTypeSigLen(*sig);
             sz = arg->len;
             status = WriteBytes(msg, &sz, 4, pad);
             if (status == AJ_OK) {
@@ -1202,13 +1818,148 @@ static AJ_Status Marshal(AJ_Message* msg, const char** sig, AJ_Arg* arg)
     return status;
 }
 
+#if AJ_MAX_CACHED_HEADERS
+/*
+ * A serialized message header. The header fields are found by their offsets in the header data.
+ */
+typedef struct _CachedHeader {
+    uint32_t msgId;                          /* Message id of the header */
+    uint32_t sessionId;                      /* Session id the header was marshaled for */
+    uint32_t lastUsed;                       /* For evicting the least recently used header */
+    uint16_t len;                            /* Length of the header data, zero if not in use */
+    uint8_t msgType;                         /* Method call or signal */
+    uint8_t flags;                           /* Flags the header was marshaled with */
+    uint8_t offset[AJ_HDR_SESSION_ID + 1];   /* Offset of each header field value, zero if absent */
+    uint8_t data[AJ_CACHED_HEADER_SIZE];     /* The header as it is marshaled into the I/O buffer */
+} CachedHeader;
+
+static CachedHeader cachedHeaders[AJ_MAX_CACHED_HEADERS];
+static uint32_t headerTick;
+
+/*
+ * Compare a string header field of a cached header
+ */
+static uint8_t MatchCachedField(const CachedHeader* entry, uint8_t fieldId, const char* str)
+{
+    uint8_t offset = entry->offset[fieldId];
+    if (!offset) {
+        return str == NULL;
+    }
+    return str && (strcmp((const char*)&entry->data[offset], str) == 0);
+}
+
+/*
+ * Return the value of a string header field of a cached header
+ */
+static const char* CachedField(const CachedHeader* entry, uint8_t fieldId)
+{
+    uint8_t offset = entry->offset[fieldId];
+    return offset ? (const char*)&entry->data[offset] : NULL;
+}
+
+/*
+ * Marshal a message header by copying a cached header that was marshaled for the same message id,
+ * destination, session id, flags and sender. The time-to-live is part of the cached header but the
+ * timestamp must be updated.
+ */
+static uint8_t MarshalCachedHeader(AJ_Message* msg, uint8_t msgType, uint32_t msgId, uint8_t flags)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    CachedHeader* entry = NULL;
+    uint32_t i;
+
+    for (i = 0; i < AJ_MAX_CACHED_HEADERS; ++i) {
+        CachedHeader* e = &cachedHeaders[i];
+        if (e->len && (e->msgId == msgId) && (e->msgType == msgType) && (e->flags == flags) &&
+            (e->sessionId == msg->sessionId) && ((e->offset[AJ_HDR_TIME_TO_LIVE] != 0) == (msg->ttl != 0)) &&
+            MatchCachedField(e, AJ_HDR_DESTINATION, msg->destination) &&
+            MatchCachedField(e, AJ_HDR_SENDER, AJ_GetUniqueName(msg->bus))) {
+            entry = e;
+            break;
+        }
+    }
+    if (!entry || (entry->len > ioBuf->bufSize)) {
+        return FALSE;
+    }
+    entry->lastUsed = ++headerTick;
+
+    AJ_IO_BUF_RESET(ioBuf);
+    memcpy(ioBuf->bufStart, entry->data, entry->len);
+    ioBuf->writePtr += entry->len;
+    msg->hdr = (AJ_MsgHeader*)ioBuf->bufStart;
+
+    msg->msgId = msgId;
+    msg->objPath = CachedField(entry, AJ_HDR_OBJ_PATH);
+    msg->iface = CachedField(entry, AJ_HDR_INTERFACE);
+    msg->member = CachedField(entry, AJ_HDR_MEMBER);
+    msg->signature = entry->offset[AJ_HDR_SIGNATURE] ? CachedField(entry, AJ_HDR_SIGNATURE) : "";
+
+    do { msg->hdr->serialNum = msg->bus->serial++; } while (msg->bus->serial == 1);
+    if (msg->ttl) {
+        AJ_Time timer;
+        timer.seconds = 0;
+        timer.milliseconds = 0;
+        msg->timestamp = AJ_GetElapsedTime(&timer, FALSE);
+        *((uint32_t*)(ioBuf->bufStart + entry->offset[AJ_HDR_TIMESTAMP])) = msg->timestamp;
+        *((uint16_t*)(ioBuf->bufStart + entry->offset[AJ_HDR_TIME_TO_LIVE])) = (uint16_t)msg->ttl;
+    }
+    return TRUE;
+}
+
+/*
+ * Save the header that was just marshaled replacing the least recently used cached header
+ */
+static void CacheHeader(AJ_Message* msg, uint8_t msgType, uint32_t msgId, uint8_t flags, const uint8_t* offset)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    uint32_t len = (uint32_t)(ioBuf->writePtr - ioBuf->bufStart);
+    CachedHeader* entry = &cachedHeaders[0];
+    uint32_t i;
+
+    if (len > AJ_CACHED_HEADER_SIZE) {
+        return;
+    }
+    for (i = 1; i < AJ_MAX_CACHED_HEADERS; ++i) {
+        if (cachedHeaders[i].lastUsed < entry->lastUsed) {
+            entry = &cachedHeaders[i];
+        }
+    }
+    entry->msgId = msgId;
+    entry->sessionId = msg->sessionId;
+    entry->lastUsed = ++headerTick;
+    entry->len = (uint16_t)len;
+    entry->msgType = msgType;
+    entry->flags = flags;
+    memcpy(entry->offset, offset, sizeof(entry->offset));
+    memcpy(entry->data, ioBuf->bufStart, len);
+}
+#endif
+
+void AJ_ClearHeaderCache(void)
+{
+#if AJ_MAX_CACHED_HEADERS
+    memset(cachedHeaders, 0, sizeof(cachedHeaders));
+#endif
+}
+
 static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, uint8_t flags)
 {
     AJ_Status status = AJ_OK;
     AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
     uint8_t fieldId;
     uint8_t secure = FALSE;
-
+    uint32_t token = 0;
+#if AJ_MAX_CACHED_HEADERS
+    uint8_t offset[AJ_HDR_SESSION_ID + 1];
+    uint8_t cacheable = ((msgType == AJ_MSG_METHOD_CALL) || (msgType == AJ_MSG_SIGNAL)) && !(flags & AJ_FLAG_COMPRESSED);
+
+    if (cacheable) {
+        if (MarshalCachedHeader(msg, msgType, msgId, flags)) {
+            return AJ_OK;
+        }
+        memset(offset, 0, sizeof(offset));
+    }
+#endif
     /*
      * Use the msgId to lookup information in the object and interface descriptions to
      * initialize the message header fields.
@@ -1217,6 +1968,17 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
     if (status != AJ_OK) {
         return status;
     }
+    /*
+     * Only signals can be compressed
+     */
+    if (flags & AJ_FLAG_COMPRESSED) {
+        if (msgType == AJ_MSG_SIGNAL) {
+            token = AJ_CompressionToken(msg);
+        }
+        if (!token) {
+            flags &= ~AJ_FLAG_COMPRESSED;
+        }
+    }
 
     AJ_IO_BUF_RESET(ioBuf);
 
@@ -1254,6 +2016,12 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
         if (typeId == AJ_ARG_INVALID) {
             continue;
         }
+        /*
+         * Skip the fields that are replaced by the compression token
+         */
+        if (token && IsCompressedField(fieldId)) {
+            continue;
+        }
         InitArg(&hdrVal, typeId, NULL);
         switch (fieldId) {
         case AJ_HDR_OBJ_PATH:
@@ -1320,8 +2088,13 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
             }
             break;
 
-        case AJ_HDR_HANDLES:
         case AJ_HDR_COMPRESSION_TOKEN:
+            if (token) {
+                hdrVal.val.v_uint32 = &token;
+            }
+            break;
+
+        case AJ_HDR_HANDLES:
         default:
             continue;
         }
@@ -1339,6 +2112,20 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
         buf[2] = typeId;
         buf[3] = 0;
         WriteBytes(msg, buf, 4, PadForType(AJ_ARG_STRUCT, ioBuf));
+#if AJ_MAX_CACHED_HEADERS
+        /*
+         * Record where the field value is, the value of a string field follows its length
+         */
+        if (cacheable) {
+            uint32_t pos = (uint32_t)(ioBuf->writePtr - ioBuf->bufStart);
+            if ((typeId == AJ_ARG_STRING) || (typeId == AJ_ARG_OBJ_PATH)) {
+                pos += 4;
+            } else if (typeId == AJ_ARG_SIGNATURE) {
+                pos += 1;
+            }
+            offset[fieldId] = (pos < AJ_CACHED_HEADER_SIZE) ? (uint8_t)pos : 0;
+        }
+#endif
         /*
          * Now marshal the field value
          */
@@ -1354,6 +2141,11 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
          */
         status = WritePad(msg, (8 - msg->hdr->headerLen) & 7);
     }
+#if AJ_MAX_CACHED_HEADERS
+    if ((status == AJ_OK) && cacheable) {
+        CacheHeader(msg, msgType, msgId, flags, offset);
+    }
+#endif
     return status;
 }
 
@@ -1397,7 +2189,7 @@ AJ_Status AJ_MarshalArg(AJ_Message* msg, AJ_Arg* arg)
         msg->sigOffset = (uint8_t)(sig - msg->signature);
     }
     if (status == AJ_OK) {
-        msg->bodyBytes += (uint16_t)(ioBuf->writePtr - argStart);
+        msg->bodyBytes += (uint32_t)(ioBuf->writePtr - argStart);
     } else {
         AJ_ReleaseReplyContext(msg);
     }
@@ -1412,7 +2204,7 @@ AJ_Arg* AJ_InitArg(AJ_Arg* arg, uint8_t typeId, uint8_t flags, const void* val,
     } else {
         arg->typeId = typeId;
         arg->flags = flags;
-        arg->len = (uint16_t)len;
+        arg->len = (uint32_t)len;
         arg->val.v_data = (void*)val;
         arg->sigPtr = NULL;
         arg->container = NULL;
@@ -1502,6 +2294,10 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining)
      * Set the body length in the header buffer.
      */
     msg->hdr->bodyLen = (uint32_t)(msg->bodyBytes + pad + bytesRemaining);
+    /*
+     * The body is not all in the buffer so it cannot be compressed
+     */
+    msg->hdr->flags &= ~AJ_FLAG_BODY_COMPRESSED;
     AJ_DumpMsg("SENDING(partial)", msg, FALSE);
     /*
      * The buffer space occupied by the header is going to be overwritten
@@ -1521,6 +2317,20 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining)
     return AJ_OK;
 }
 
+AJ_Status AJ_MarshalStructArray(AJ_Message* msg, const void* data, size_t elemSize, size_t numElems)
+{
+    const char* sig = NextArgSignature(msg, &msg->bus->sock.tx);
+    AJ_Arg arg;
+
+    if ((sig[0] != AJ_ARG_ARRAY) || !elemSize || (FixedStructSize(sig + 1) != elemSize)) {
+        return AJ_ERR_SIGNATURE;
+    }
+    InitArg(&arg, AJ_ARG_STRUCT, data);
+    arg.flags = AJ_ARRAY_FLAG;
+    arg.len = (uint32_t)(elemSize * numElems);
+    return AJ_MarshalArg(msg, &arg);
+}
+
 AJ_Status AJ_MarshalRaw(AJ_Message* msg, const void* data, size_t len)
 {
     if (msg->hdr) {
@@ -1564,7 +2374,7 @@ AJ_Status AJ_MarshalCloseContainer(AJ_Message* msg, AJ_Arg* arg)
         /*
          * The length we marshal does not include the length field itself.
          */
-        arg->len = (uint16_t)(ioBuf->writePtr - (uint8_t*)arg->val.v_data) - 4;
+        arg->len = (uint32_t)(ioBuf->writePtr - (uint8_t*)arg->val.v_data) - 4;
         /*
          * If the array element is 8 byte aligned and the array is not empty check if there was
          * padding after the length. The length we marshal should not include the padding.
@@ -1607,6 +2417,11 @@ AJ_Status AJ_MarshalVariant(AJ_Message* msg, const char* sig)
 }
 
 AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout)
+{
+    return AJ_MarshalMethodCallAsync(bus, msg, msgId, destination, sessionId, flags, timeout, NULL, NULL);
+}
+
+AJ_Status AJ_MarshalMethodCallAsync(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout, AJ_MethodReplyCallback callback, void* context)
 {
     AJ_Status status;
 
@@ -1616,7 +2431,7 @@ AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t
     msg->sessionId = sessionId;
     status = MarshalMsg(msg, AJ_MSG_METHOD_CALL, msgId, flags);
     if (status == AJ_OK) {
-        status = AJ_AllocReplyContext(msg, timeout);
+        status = AJ_AllocReplyContext(msg, timeout, callback, context);
     }
     return status;
 }
@@ -0,0 +1,518 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_outbox.h"
+#include "aj_bufio.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+
+static uint32_t durable[AJ_OUTBOX_MAX_DURABLE];
+static uint16_t numDurable;
+
+static int32_t FindDurable(uint32_t msgId)
+{
+    int32_t i;
+
+    for (i = 0; i < numDurable; ++i) {
+        if (durable[i] == msgId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AJ_Status AJ_OutboxSetDurable(uint32_t msgId, uint8_t isDurable)
+{
+    int32_t i = FindDurable(msgId);
+
+    if (isDurable && (i < 0)) {
+        if (numDurable == AJ_OUTBOX_MAX_DURABLE) {
+            return AJ_ERR_RESOURCES;
+        }
+        durable[numDurable++] = msgId;
+    } else if (!isDurable && (i >= 0)) {
+        durable[i] = durable[--numDurable];
+    }
+    return AJ_OK;
+}
+
+#if AJ_OUTBOX_SIZE
+
+/*
+ * Signals are stored as records back to back, each record is 8 byte aligned so the signal it holds
+ * has the same alignment as when it was marshaled
+ */
+typedef struct {
+    uint32_t msgId;
+    uint32_t captured;   /* When the signal was delivered */
+    uint32_t ttl;        /* Time to live of the signal or zero */
+    uint32_t len;        /* Length of the signal that follows */
+} Record;
+
+#define RECORD_SIZE(len)  ((sizeof(Record) + (len) + 7) & ~7)
+
+/*
+ * The RAM and the spill file are each a region, records are removed from the head and added at
+ * the tail
+ */
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+} Region;
+
+static uint64_t ramData[AJ_OUTBOX_SIZE / 8];
+
+static struct {
+    AJ_BusAttachment* bus;     /* The bus attachment that disconnected */
+    uint8_t disconnected;      /* Durable signals are kept until reconnected */
+    uint8_t replaying;         /* A signal is being replayed so must not be kept again */
+    uint8_t timing;            /* Timing how long the replay takes */
+    uint8_t* txData;           /* Transmit buffer of the bus attachment */
+    uint16_t txSize;
+    AJ_Time clock;             /* Started on the first disconnect */
+    uint8_t clockStarted;
+    uint32_t connected;        /* When the bus attachment reconnected */
+    Region ram;
+    Region spill;
+    uint8_t spillFailed;       /* The spill file could not be mapped so only the RAM is used */
+    AJ_OutboxStats stats;
+} outbox;
+
+static uint32_t Now(void)
+{
+    return AJ_GetElapsedTime(&outbox.clock, TRUE);
+}
+
+/*
+ * The timestamp header field, the same clock AJ_MarshalMsg() uses
+ */
+static uint32_t Timestamp(void)
+{
+    AJ_Time timer;
+
+    timer.seconds = 0;
+    timer.milliseconds = 0;
+    return AJ_GetElapsedTime(&timer, FALSE);
+}
+
+/*
+ * Records in RAM are always older than records in the spill file
+ */
+static Region* Oldest(void)
+{
+    if (outbox.ram.head != outbox.ram.tail) {
+        return &outbox.ram;
+    }
+    if (outbox.spill.head != outbox.spill.tail) {
+        return &outbox.spill;
+    }
+    return NULL;
+}
+
+static AJ_Status Store(Region* region, AJ_Message* msg, const uint8_t* data, uint32_t len)
+{
+    uint32_t size = RECORD_SIZE(len);
+    Record* rec;
+
+    if ((region->tail + size) > region->size) {
+        /*
+         * Move the records down to the start of the region to make room
+         */
+        if ((region->tail - region->head + size) > region->size) {
+            return AJ_ERR_RESOURCES;
+        }
+        memmove(region->data, region->data + region->head, region->tail - region->head);
+        region->tail -= region->head;
+        region->head = 0;
+    }
+    rec = (Record*)(region->data + region->tail);
+    rec->msgId = msg->msgId;
+    rec->captured = Now();
+    rec->ttl = msg->ttl;
+    rec->len = len;
+    memcpy(rec + 1, data, len);
+    region->tail += size;
+    return AJ_OK;
+}
+
+static void Remove(Region* region)
+{
+    Record* rec = (Record*)(region->data + region->head);
+
+    --outbox.stats.depth;
+    outbox.stats.bytes -= rec->len;
+    region->head += RECORD_SIZE(rec->len);
+    if (region->head == region->tail) {
+        region->head = 0;
+        region->tail = 0;
+    }
+}
+
+/*
+ * Length of a header field including its field code and signature, zero if the field is not valid
+ */
+static uint32_t FieldLen(const uint8_t* field, uint32_t avail)
+{
+    uint32_t len;
+
+    if ((avail < 6) || (field[1] != 1) || (field[3] != 0)) {
+        return 0;
+    }
+    switch (field[2]) {
+    case AJ_ARG_STRING:
+    case AJ_ARG_OBJ_PATH:
+        len = (avail < 8) ? avail + 1 : 8 + *((const uint32_t*)(field + 4)) + 1;
+        break;
+
+    case AJ_ARG_SIGNATURE:
+        len = 4 + 1 + field[4] + 1;
+        break;
+
+    case AJ_ARG_UINT32:
+        len = 8;
+        break;
+
+    case AJ_ARG_UINT16:
+        len = 6;
+        break;
+
+    default:
+        return 0;
+    }
+    return (len <= avail) ? len : 0;
+}
+
+/*
+ * Zero pad to the next 8 byte boundary
+ */
+static uint32_t Pad(uint8_t* data, uint32_t pos)
+{
+    while (pos & 7) {
+        data[pos++] = 0;
+    }
+    return pos;
+}
+
+/*
+ * Rebuild a signal in the transmit buffer with a new serial number and the current unique name as
+ * the sender and deliver it. A signal with a time to live is stamped with the current time and
+ * only gets what is left of its time to live after waiting in the outbox.
+ */
+static AJ_Status Replay(AJ_BusAttachment* bus, Record* rec, uint32_t waited)
+{
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    const uint8_t* src = (const uint8_t*)(rec + 1);
+    const AJ_MsgHeader* srcHdr = (const AJ_MsgHeader*)src;
+    const char* sender = AJ_GetUniqueName(bus);
+    uint32_t senderLen = sender ? (uint32_t)strlen(sender) : 0;
+    uint32_t hdrEnd = sizeof(AJ_MsgHeader) + srcHdr->headerLen;
+    uint32_t body = (hdrEnd + 7) & ~7;
+    uint32_t pos = sizeof(AJ_MsgHeader);
+    uint32_t out = sizeof(AJ_MsgHeader);
+    uint8_t* dst;
+    AJ_Message msg;
+    AJ_Status status;
+
+    if ((body + srcHdr->bodyLen) != rec->len) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    /*
+     * Room for the signal plus a sender field with padding
+     */
+    if ((rec->len + 8 + senderLen + 1 + 14) > ioBuf->bufSize) {
+        return AJ_ERR_RESOURCES;
+    }
+    AJ_IO_BUF_RESET(ioBuf);
+    dst = ioBuf->bufStart;
+    memset(&msg, 0, sizeof(AJ_Message));
+    msg.bus = bus;
+    msg.msgId = rec->msgId;
+    msg.hdr = (AJ_MsgHeader*)dst;
+    memcpy(dst, src, sizeof(AJ_MsgHeader));
+    /*
+     * Header fields are 8 byte aligned so copying them to an 8 byte boundary keeps their alignment
+     */
+    while (pos < hdrEnd) {
+        const uint8_t* field = src + pos;
+        uint32_t len = FieldLen(field, hdrEnd - pos);
+
+        if (!len) {
+            return AJ_ERR_UNMARSHAL;
+        }
+        if (field[0] != AJ_HDR_SENDER) {
+            uint8_t* val;
+            out = Pad(dst, out);
+            memcpy(dst + out, field, len);
+            val = dst + out + 4;
+            switch (field[0]) {
+            case AJ_HDR_OBJ_PATH:
+                msg.objPath = (const char*)val + 4;
+                break;
+
+            case AJ_HDR_INTERFACE:
+                msg.iface = (const char*)val + 4;
+                break;
+
+            case AJ_HDR_MEMBER:
+                msg.member = (const char*)val + 4;
+                break;
+
+            case AJ_HDR_DESTINATION:
+                msg.destination = (const char*)val + 4;
+                break;
+
+            case AJ_HDR_SIGNATURE:
+                msg.signature = (const char*)val + 1;
+                break;
+
+            case AJ_HDR_TIMESTAMP:
+                msg.timestamp = Timestamp();
+                *((uint32_t*)val) = msg.timestamp;
+                break;
+
+            case AJ_HDR_TIME_TO_LIVE:
+                msg.ttl = rec->ttl - waited;
+                *((uint16_t*)val) = (uint16_t)msg.ttl;
+                break;
+            }
+            out += len;
+        }
+        pos = (pos + len + 7) & ~7;
+    }
+    if (sender) {
+        out = Pad(dst, out);
+        dst[out] = AJ_HDR_SENDER;
+        dst[out + 1] = 1;
+        dst[out + 2] = AJ_ARG_STRING;
+        dst[out + 3] = 0;
+        *((uint32_t*)(dst + out + 4)) = senderLen;
+        memcpy(dst + out + 8, sender, senderLen + 1);
+        out += 8 + senderLen + 1;
+    }
+    msg.hdr->headerLen = out - sizeof(AJ_MsgHeader);
+    out = Pad(dst, out);
+    memcpy(dst + out, src + body, srcHdr->bodyLen);
+    ioBuf->writePtr = dst + out + srcHdr->bodyLen;
+    msg.bodyBytes = srcHdr->bodyLen;
+    /*
+     * Serial number cannot be zero
+     */
+    do { msg.hdr->serialNum = bus->serial++; } while (bus->serial == 1);
+
+    outbox.replaying = TRUE;
+    status = AJ_DeliverMsg(&msg);
+    outbox.replaying = FALSE;
+    return status;
+}
+
+/*
+ * Replaces the send function of the transmit buffer while disconnected
+ */
+static AJ_Status DisconnectedSend(AJ_IOBuffer* buf)
+{
+    AJ_IO_BUF_RESET(buf);
+    return AJ_ERR_WRITE;
+}
+
+uint8_t AJ_OutboxCaptures(AJ_Message* msg)
+{
+    if (outbox.replaying || (msg->bus != outbox.bus) || (!outbox.disconnected && !Oldest())) {
+        return FALSE;
+    }
+    if ((msg->hdr->msgType != AJ_MSG_SIGNAL) || msg->sessionId || (msg->hdr->flags & AJ_FLAG_COMPRESSED)) {
+        return FALSE;
+    }
+    return FindDurable(msg->msgId) >= 0;
+}
+
+AJ_Status AJ_OutboxMsg(AJ_Message* msg)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    const uint8_t* data = (const uint8_t*)msg->hdr;
+    uint32_t len = (uint32_t)(ioBuf->writePtr - data);
+    AJ_Status status = AJ_ERR_RESOURCES;
+
+    if (!outbox.ram.data) {
+        outbox.ram.data = (uint8_t*)ramData;
+        outbox.ram.size = sizeof(ramData);
+    }
+    /*
+     * Once signals go to the spill file they keep going there until it is empty so the records
+     * stay in order
+     */
+    if (outbox.spill.head == outbox.spill.tail) {
+        status = Store(&outbox.ram, msg, data, len);
+    }
+#if AJ_OUTBOX_SPILL_SIZE
+    if ((status != AJ_OK) && !outbox.spillFailed) {
+        /*
+         * Only try to map the spill file once, if that fails keep using the RAM
+         */
+        if (!outbox.spill.data) {
+            outbox.spill.data = AJ_Outbox_MapSpill(AJ_OUTBOX_SPILL_SIZE);
+            if (!outbox.spill.data) {
+                AJ_ErrPrintf(("AJ_OutboxMsg(): Failed to map the spill file\n"));
+                outbox.spillFailed = TRUE;
+            }
+            outbox.spill.size = outbox.spill.data ? AJ_OUTBOX_SPILL_SIZE : 0;
+        }
+        status = Store(&outbox.spill, msg, data, len);
+        if (status == AJ_OK) {
+            ++outbox.stats.spilled;
+        }
+    }
+#endif
+    if (status == AJ_OK) {
+        ++outbox.stats.captured;
+        ++outbox.stats.depth;
+        outbox.stats.bytes += len;
+        if (outbox.stats.bytes > outbox.stats.maxBytes) {
+            outbox.stats.maxBytes = outbox.stats.bytes;
+        }
+    } else {
+        ++outbox.stats.dropped;
+    }
+    AJ_IO_BUF_RESET(ioBuf);
+    return status;
+}
+
+AJ_Status AJ_OutboxReplay(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+    Region* region;
+    uint32_t batch;
+
+    for (batch = 0; (batch < AJ_OUTBOX_BATCH) && ((region = Oldest()) != NULL); ++batch) {
+        Record* rec = (Record*)(region->data + region->head);
+        uint32_t waited = Now() - rec->captured;
+
+        if (rec->ttl && (waited >= rec->ttl)) {
+            ++outbox.stats.expired;
+        } else {
+            status = Replay(bus, rec, waited);
+            if ((status == AJ_ERR_RESOURCES) || (status == AJ_ERR_UNMARSHAL)) {
+                AJ_ErrPrintf(("Dropping signal %x from the outbox\n", rec->msgId));
+                ++outbox.stats.dropped;
+                status = AJ_OK;
+            } else if (status != AJ_OK) {
+                break;
+            } else {
+                ++outbox.stats.replayed;
+                outbox.stats.replayBytes += rec->len;
+            }
+        }
+        Remove(region);
+    }
+    if (status == AJ_OK) {
+        if (Oldest()) {
+            status = AJ_ERR_BUSY;
+        } else if (outbox.timing) {
+            outbox.stats.replayTime = Now() - outbox.connected;
+            outbox.timing = FALSE;
+        }
+    }
+    return status;
+}
+
+void AJ_OutboxClear(void)
+{
+    outbox.ram.head = outbox.ram.tail = 0;
+    outbox.spill.head = outbox.spill.tail = 0;
+    outbox.stats.depth = 0;
+    outbox.stats.bytes = 0;
+    outbox.timing = FALSE;
+}
+
+void AJ_OutboxGetStats(AJ_OutboxStats* stats)
+{
+    *stats = outbox.stats;
+}
+
+void AJ_OutboxDisconnected(AJ_BusAttachment* bus)
+{
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+
+    if (!outbox.clockStarted) {
+        AJ_InitTimer(&outbox.clock);
+        outbox.clockStarted = TRUE;
+    }
+    outbox.bus = bus;
+    outbox.disconnected = TRUE;
+    outbox.timing = FALSE;
+    /*
+     * A failed connect clears the bus attachment so remember the transmit buffer
+     */
+    if (ioBuf->bufStart) {
+        outbox.txData = ioBuf->bufStart;
+        outbox.txSize = ioBuf->bufSize;
+    }
+    if (outbox.txData) {
+        AJ_IOBufInit(ioBuf, outbox.txData, outbox.txSize, AJ_IO_BUF_TX, NULL);
+        ioBuf->send = DisconnectedSend;
+    }
+}
+
+void AJ_OutboxConnected(AJ_BusAttachment* bus)
+{
+    outbox.bus = bus;
+    outbox.disconnected = FALSE;
+    if (Oldest()) {
+        outbox.connected = Now();
+        outbox.timing = TRUE;
+    }
+}
+
+#else
+
+uint8_t AJ_OutboxCaptures(AJ_Message* msg)
+{
+    return FALSE;
+}
+
+AJ_Status AJ_OutboxMsg(AJ_Message* msg)
+{
+    return AJ_ERR_RESOURCES;
+}
+
+AJ_Status AJ_OutboxReplay(AJ_BusAttachment* bus)
+{
+    return AJ_OK;
+}
+
+void AJ_OutboxClear(void)
+{
+}
+
+void AJ_OutboxGetStats(AJ_OutboxStats* stats)
+{
+    memset(stats, 0, sizeof(AJ_OutboxStats));
+}
+
+void AJ_OutboxDisconnected(AJ_BusAttachment* bus)
+{
+}
+
+void AJ_OutboxConnected(AJ_BusAttachment* bus)
+{
+}
+
+#endif
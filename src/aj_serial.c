@@ -20,11 +20,14 @@
 #include "aj_target.h"
 #include "aj_status.h"
 #include "aj_serial.h"
+#include "aj_serio.h"
 #include "aj_serial_rx.h"
 #include "aj_serial_tx.h"
 #include "aj_timer.h"
+#include "aj_util.h"
+#include "aj_semaphore.h"
 
-#define SLAP_VERSION 0
+#define SLAP_VERSION SLAP_VERSION_EXTENDED
 
 /**
  * global variable for link parameters
@@ -43,7 +46,7 @@ AJ_LinkParameters AJ_SerialLinkParams;
 
 
 #define LINK_PACKET_SIZE    4
-#define NEGO_PACKET_SIZE    3
+#define NEGO_PACKET_SIZE    4
 
 /** link packet types */
 typedef enum {
@@ -70,6 +73,16 @@ static const char ResuPkt[LINK_PACKET_SIZE] = "RESU";
  */
 static AJ_Time sendLinkPacketTime;
 
+/**
+ * Signalled by the receive and transmit callbacks to wake up AJ_SerialWait
+ */
+static AJ_Semaphore* serialEvent;
+
+/**
+ * Longest time AJ_SerialWait blocks without checking the transport again
+ */
+#define SERIAL_MAX_WAIT  1000
+
 
 /**
  * link configuration information
@@ -87,7 +100,7 @@ static void ScheduleLinkControlPacket(uint32_t timeout);
 /********* end of forward declarations *************/
 
 // Converge the remote endpoint's values with my own
-static void ProcessNegoPacket(const uint8_t* buffer)
+static void ProcessNegoPacket(const uint8_t* buffer, uint16_t len)
 {
     uint16_t max_payload;
     uint8_t proto_version;
@@ -117,18 +130,26 @@ static void ProcessNegoPacket(const uint8_t* buffer)
         window_size = 4;
         break;
 
-    case 4:
+    case 3:
         window_size = 8;
         break;
-
-    default:
-        AJ_Printf("Invalid window size: %u\n", window_size);
-        break;
     }
 
+    if (AJ_SERIAL_EXTENDED_MODE() && (len >= LINK_PACKET_SIZE + NEGO_PACKET_SIZE)) {
+        /*
+         * Peers that support the extended window mode send their real window size in the
+         * extension byte.
+         */
+        window_size = min(buffer[7], MAX_WINDOW_SIZE);
+        AJ_SerialLinkParams.seqMask = AJ_SERIAL_EXTENDED_SEQ_MASK;
+    } else {
+        window_size = min(window_size, MAX_LEGACY_WINDOW_SIZE);
+        AJ_SerialLinkParams.protoVersion = min(AJ_SerialLinkParams.protoVersion, SLAP_VERSION_EXTENDED - 1);
+        AJ_SerialLinkParams.seqMask = AJ_SERIAL_SEQ_MASK;
+    }
 
     AJ_Printf("Read max window size: %u\n", window_size);
-    AJ_SerialLinkParams.windowSize = min(AJ_SerialLinkParams.maxWindowSize, window_size);
+    AJ_SerialLinkParams.windowSize = min(AJ_SerialLinkParams.maxWindowSize, max(window_size, MIN_WINDOW_SIZE));
 }
 
 static void SendNegotiationPacket(const char* pkt_type)
@@ -144,7 +165,11 @@ static void SendNegotiationPacket(const char* pkt_type)
     NegotiationPacket[4] = (AJ_SerialLinkParams.packetSize & 0xFF00) >> 8;
     NegotiationPacket[5] = (AJ_SerialLinkParams.packetSize & 0x00FF);
 
-    switch (AJ_SerialLinkParams.maxWindowSize) {
+    /*
+     * Legacy peers cannot use a window larger than MAX_LEGACY_WINDOW_SIZE so that is the
+     * most we advertise in the two bit window size field.
+     */
+    switch (min(AJ_SerialLinkParams.maxWindowSize, MAX_LEGACY_WINDOW_SIZE)) {
     case 1:
         encoded_window_size = 0;
         break;
@@ -157,15 +182,17 @@ static void SendNegotiationPacket(const char* pkt_type)
         encoded_window_size = 2;
         break;
 
-    case 8:
-        encoded_window_size = 3;
-        break;
-
     default:
+        encoded_window_size = 1;
         break;
     }
 
     NegotiationPacket[6] = (AJ_SerialLinkParams.protoVersion << 2) | encoded_window_size;
+    /*
+     * Extension byte: the window size we support in the extended window mode. Legacy peers
+     * ignore this byte.
+     */
+    NegotiationPacket[7] = AJ_SerialLinkParams.maxWindowSize;
     AJ_SerialTX_EnqueueCtrl(NegotiationPacket, sizeof(NegotiationPacket), AJ_SERIAL_CTRL);
 }
 
@@ -278,9 +305,10 @@ void AJ_Serial_LinkPacket(uint8_t* buffer, uint16_t len)
         if (pktType == CONN_PKT) {
             AJ_SerialTX_EnqueueCtrl((uint8_t*) AcptPkt, sizeof(AcptPkt), AJ_SERIAL_CTRL);
         } else if (pktType == NEGO_PKT) {
-            ProcessNegoPacket(buffer);
+            ProcessNegoPacket(buffer, len);
             SendNegotiationPacket(NrspPkt);
         } else if (pktType == NRSP_PKT) {
+            ProcessNegoPacket(buffer, len);
             AJ_Printf("Received nego response - Moving to LINK_ACTIVE\n");
             AJ_SerialLinkParams.linkState = AJ_LINK_ACTIVE;
         }
@@ -291,7 +319,7 @@ void AJ_Serial_LinkPacket(uint8_t* buffer, uint16_t len)
          * In the initialized state we need to respond to nego-resp packets.
          */
         if (pktType == NEGO_PKT) {
-            ProcessNegoPacket(buffer);
+            ProcessNegoPacket(buffer, len);
             SendNegotiationPacket(NrspPkt);
         }
         break;
@@ -315,11 +343,16 @@ AJ_Status AJ_SerialInit(const char* ttyName,
 
     AJ_Printf("Initializing serial transport\n");
 
+    if (!serialEvent) {
+        serialEvent = AJ_SemaphoreCreate(NULL, 0);
+    }
+
     /** Initialize protocol default values */
     AJ_SerialLinkParams.protoVersion = SLAP_VERSION;
     AJ_SerialLinkParams.maxWindowSize = windowSize;
-    AJ_SerialLinkParams.windowSize = windowSize;
+    AJ_SerialLinkParams.windowSize = min(windowSize, MAX_LEGACY_WINDOW_SIZE);
     AJ_SerialLinkParams.packetSize = packetSize;
+    AJ_SerialLinkParams.seqMask = AJ_SERIAL_SEQ_MASK;
     AJ_SerialLinkParams.linkState = AJ_LINK_UNINITIALIZED;
 
     /** Initialize serial ports */
@@ -348,8 +381,13 @@ AJ_Status AJ_SerialInit(const char* ttyName,
 
 void AJ_SerialShutdown(void)
 {
+    AJ_SerialIOShutdown();
     AJ_SerialTX_Shutdown();
     AJ_SerialRX_Shutdown();
+    if (serialEvent) {
+        AJ_SemaphoreDestroy(serialEvent);
+        serialEvent = NULL;
+    }
 }
 
 
@@ -375,13 +413,6 @@ void AJ_StateMachine()
         AJ_ProcessRxBufferList();
     }
 
-    if (dataSent) {
-        /* There is space in the transmit free list, queue up more buffers to be
-         * sent if there are SLAP packets to be sent
-         */
-        AJ_FillTxBufferList();
-    }
-
     if (AJ_CompareTime(resendTime, now) < 0) {
         /* Resend any data packets that have not been acked */
         ResendPackets();
@@ -400,6 +431,156 @@ void AJ_StateMachine()
         /* Time to send a link packet to get the Link to the active state. */
         SendLinkPacket();
     }
+
+    /* Filling the transmit buffers comes last so the packets queued above go out
+     * now rather than the next time the state machine is woken up.
+     */
+    if (dataSent) {
+        /* There is space in the transmit free list, queue up more buffers to be
+         * sent if there are SLAP packets to be sent
+         */
+        AJ_FillTxBufferList();
+    }
+}
+
+void AJ_SerialSignalEvent(void)
+{
+    if (serialEvent) {
+        AJ_SemaphoreUnlock(serialEvent);
+    }
+}
+
+/**
+ * Reduce a wait so it ends no later than a deadline. Deadlines can be AJ_TIMER_FOREVER
+ * so they are compared before taking the difference.
+ */
+static uint32_t WaitUntil(AJ_Time* deadline, AJ_Time* now, uint32_t wait)
+{
+    AJ_Time end = *now;
+
+    if (AJ_CompareTime(*deadline, *now) < 0) {
+        return 0;
+    }
+    AJ_TimeAddOffset(&end, wait);
+    if (AJ_CompareTime(*deadline, end) >= 0) {
+        return wait;
+    }
+    // the state machine acts on timers that have passed so wait at least a tick
+    return max(AJ_GetTimeDifference(deadline, now), 1);
+}
+
+void AJ_SerialWait(AJ_Time* deadline)
+{
+    AJ_Time now;
+    uint32_t wait = SERIAL_MAX_WAIT;
+
+    if (dataReceived || !serialEvent) {
+        return;
+    }
+    AJ_InitTimer(&now);
+    if (deadline) {
+        wait = WaitUntil(deadline, &now, wait);
+    }
+    wait = WaitUntil(&resendTime, &now, wait);
+    wait = WaitUntil(&ackTime, &now, wait);
+    wait = WaitUntil(&sendLinkPacketTime, &now, wait);
+    if (wait) {
+        AJ_SemaphoreWaitTimed(serialEvent, wait);
+    }
+}
+
+/*
+ * Word at a time test for a byte value in a 32 bit word
+ */
+#define HAS_ZERO_BYTE(v)  (((v) - 0x01010101UL) & ~(v) & 0x80808080UL)
+#define HAS_BYTE(v, b)    HAS_ZERO_BYTE((v) ^ (0x01010101UL * (b)))
+
+uint16_t AJ_SerialSlipScan(const uint8_t* buf, uint16_t len)
+{
+    uint16_t i = 0;
+    uint32_t w;
+
+    /*
+     * Test four bytes at a time, memcpy handles unaligned buffers.
+     */
+    while ((len - i) >= sizeof(w)) {
+        memcpy(&w, buf + i, sizeof(w));
+        if (HAS_BYTE(w, BOUNDARY_BYTE) || HAS_BYTE(w, ESCAPE_BYTE)) {
+            break;
+        }
+        i += sizeof(w);
+    }
+    while ((i < len) && (buf[i] != BOUNDARY_BYTE) && (buf[i] != ESCAPE_BYTE)) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef AJ_SERIAL_RING_ATOMICS
+#define RING_LOAD(idx, order)       atomic_load_explicit(&(idx), order)
+#define RING_STORE(idx, val, order) atomic_store_explicit(&(idx), val, order)
+#else
+#define RING_LOAD(idx, order)       (idx)
+#define RING_STORE(idx, val, order) ((idx) = (val))
+#endif
+
+void AJ_SerialRingInit(AJ_SlippedBufferRing* ring)
+{
+    memset((void*)ring->entries, 0, sizeof(ring->entries));
+    RING_STORE(ring->head, 0, memory_order_relaxed);
+    RING_STORE(ring->tail, 0, memory_order_relaxed);
+}
+
+uint8_t AJ_SerialRingPush(AJ_SlippedBufferRing* ring, AJ_SlippedBuffer* buf)
+{
+    uint32_t tail = RING_LOAD(ring->tail, memory_order_relaxed);
+
+    if ((tail - RING_LOAD(ring->head, memory_order_acquire)) == AJ_SERIAL_RING_SIZE) {
+        return FALSE;
+    }
+    ring->entries[tail & (AJ_SERIAL_RING_SIZE - 1)] = buf;
+    RING_STORE(ring->tail, tail + 1, memory_order_release);
+    return TRUE;
+}
+
+AJ_SlippedBuffer* AJ_SerialRingPop(AJ_SlippedBufferRing* ring)
+{
+    AJ_SlippedBuffer* buf;
+    uint32_t head = RING_LOAD(ring->head, memory_order_relaxed);
+
+    if (head == RING_LOAD(ring->tail, memory_order_acquire)) {
+        return NULL;
+    }
+    buf = ring->entries[head & (AJ_SERIAL_RING_SIZE - 1)];
+    RING_STORE(ring->head, head + 1, memory_order_release);
+    return buf;
+}
+
+uint8_t AJ_SerialRingEmpty(AJ_SlippedBufferRing* ring)
+{
+    return RING_LOAD(ring->head, memory_order_acquire) == RING_LOAD(ring->tail, memory_order_acquire);
+}
+
+AJ_SlippedBuffer* AJ_SerialAllocSlippedBuffer(void)
+{
+    AJ_SlippedBuffer* buf = AJ_Malloc(sizeof(AJ_SlippedBuffer));
+
+    if (buf) {
+        buf->buffer = AJ_Malloc(SLIPPED_LEN(AJ_SerialLinkParams.packetSize));
+        buf->actualLen = 0;
+        buf->allocatedLen = SLIPPED_LEN(AJ_SerialLinkParams.packetSize);
+        buf->next = NULL;
+    }
+    return buf;
+}
+
+void AJ_SerialRingClear(AJ_SlippedBufferRing* ring)
+{
+    AJ_SlippedBuffer* buf;
+
+    while ((buf = AJ_SerialRingPop(ring)) != NULL) {
+        ClearSlippedBuffer(buf);
+    }
 }
 
 void ClearSlippedBuffer(volatile AJ_SlippedBuffer* buf)
@@ -46,21 +46,30 @@ typedef enum {
 typedef struct _RX_PKT {
     uint8_t* buffer;
     uint16_t len;
+    uint16_t crc;       /* running CRC over the first crcLen bytes */
+    uint16_t crcLen;
+    uint16_t readOffset;  /* payload bytes already consumed by AJ_SerialRecv */
     PKT_STATE state;
     struct _RX_PKT volatile* next;
 } RX_PKT;
 
 
+/*
+ * Payload bytes of a received packet not yet consumed
+ */
+#define RX_UNREAD_LEN(pkt) ((pkt)->len - AJ_SERIAL_HDR_LEN - AJ_CRC_LEN - (pkt)->readOffset)
+#define RX_UNREAD_PTR(pkt) ((pkt)->buffer + AJ_SERIAL_HDR_LEN + (pkt)->readOffset)
+
 static RX_PKT volatile* RxPacket;
 static RX_PKT volatile* RxRecv;
 static RX_PKT volatile* RxFreeList;
 
-//Linked list of free buffers that can be used to recieve data.
-static AJ_SlippedBuffer volatile* bufferRxFreeList;
-//Linked list of received slipped buffers
-static AJ_SlippedBuffer volatile* bufferRxQueue;
-// the buffer currently being sent
-static AJ_SlippedBuffer volatile* pendingRecvBuffer;
+// Free buffers that can be used to recieve data, produced by the state machine and consumed by the receive callback
+static AJ_SlippedBufferRing bufferRxFreeRing;
+// Received slipped buffers, produced by the receive callback and consumed by the state machine
+static AJ_SlippedBufferRing bufferRxQueue;
+// the buffer currently being received into
+static AJ_SlippedBuffer* volatile pendingRecvBuffer;
 
 /**
  * number of received packets waiting to be delivered to the upper layers
@@ -72,31 +81,24 @@ static uint8_t volatile pendingRecv;
  */
 static uint8_t expectedSeq;
 
+/**
+ * Packets received out of order in the extended window mode, indexed by sequence number.
+ * They are held here until the missing packets arrive.
+ */
+static RX_PKT volatile* RxReorder[AJ_SERIAL_EXTENDED_SEQ_MASK + 1];
+
 void AJ_ReceiveCallback(uint8_t* buffer, uint16_t bytesRead)
 {
-    // move pendingRecvBuffer from the pending list to the free list
-    // it will be reused
-
-    dataReceived = 1;
-    if (bufferRxQueue == NULL) {
-        bufferRxQueue = pendingRecvBuffer;
-    } else {
-        volatile AJ_SlippedBuffer* buf = bufferRxQueue;
-        while (buf->next != NULL) {
-            buf = buf->next;
-        }
-
-        buf->next = pendingRecvBuffer;
-    }
-
-    pendingRecvBuffer->next = NULL;
+    // queue pendingRecvBuffer for the state machine, there are never more buffers
+    // than the ring can hold so this cannot fail.
     pendingRecvBuffer->actualLen = bytesRead;
-    pendingRecvBuffer = bufferRxFreeList;
+    AJ_SerialRingPush(&bufferRxQueue, pendingRecvBuffer);
+    dataReceived = 1;
+    AJ_SerialSignalEvent();
 
-    // if anything is pending, send it!
+    // if there is a free buffer, keep receiving!
+    pendingRecvBuffer = AJ_SerialRingPop(&bufferRxFreeRing);
     if (pendingRecvBuffer != NULL) {
-        bufferRxFreeList = bufferRxFreeList->next;
-        pendingRecvBuffer->next = NULL;
         AJ_RX(pendingRecvBuffer->buffer, pendingRecvBuffer->allocatedLen);
         AJ_ResumeRX();
     }
@@ -145,10 +147,14 @@ static void DeleteRxPacket(volatile RX_PKT* pkt)
 
 void AJ_SerialRX_Shutdown(void)
 {
-    ClearSlippedBuffer(bufferRxFreeList);
-    bufferRxFreeList = NULL;
-    ClearSlippedBuffer(bufferRxQueue);
-    bufferRxQueue = NULL;
+    int i;
+
+    for (i = 0; i < ArraySize(RxReorder); ++i) {
+        DeleteRxPacket(RxReorder[i]);
+        RxReorder[i] = NULL;
+    }
+    AJ_SerialRingClear(&bufferRxFreeRing);
+    AJ_SerialRingClear(&bufferRxQueue);
     ClearSlippedBuffer(pendingRecvBuffer);
     pendingRecvBuffer = NULL;
 
@@ -167,7 +173,6 @@ AJ_Status AJ_SerialRX_Init(void)
 {
     int i;
     RX_PKT volatile* prev;
-    AJ_SlippedBuffer volatile* prevBuf = NULL;
 
     if (AJ_SerialLinkParams.packetSize == 0) {
         return AJ_ERR_FAILURE;
@@ -179,6 +184,7 @@ AJ_Status AJ_SerialRX_Init(void)
     RxPacket = NULL;
     pendingRecv = 0;
     expectedSeq = 0;
+    memset((void*)RxReorder, 0, sizeof(RxReorder));
 
     /*
      * The maximum frame size is the packet length plus the header length plus
@@ -199,20 +205,14 @@ AJ_Status AJ_SerialRX_Init(void)
         RxFreeList->next = prev;
     }
 
-    bufferRxFreeList = NULL;
+    AJ_SerialRingInit(&bufferRxFreeRing);
+    AJ_SerialRingInit(&bufferRxQueue);
     for (i = 0; i < AJ_SerialLinkParams.maxWindowSize + 1; i++) {
-        prevBuf = bufferRxFreeList;
-        bufferRxFreeList = AJ_Malloc(sizeof(AJ_SlippedBuffer));
-        bufferRxFreeList->buffer = AJ_Malloc(SLIPPED_LEN(AJ_SerialLinkParams.packetSize));
-        bufferRxFreeList->actualLen = 0;
-        bufferRxFreeList->allocatedLen = SLIPPED_LEN(AJ_SerialLinkParams.packetSize);
-        bufferRxFreeList->next = prevBuf;
+        AJ_SerialRingPush(&bufferRxFreeRing, AJ_SerialAllocSlippedBuffer());
     }
 
     AJ_SetRxCB(&AJ_ReceiveCallback);
-    pendingRecvBuffer = bufferRxFreeList;
-    bufferRxFreeList = bufferRxFreeList->next;
-    pendingRecvBuffer->next = NULL;
+    pendingRecvBuffer = AJ_SerialRingPop(&bufferRxFreeRing);
     AJ_RX(pendingRecvBuffer->buffer, pendingRecvBuffer->allocatedLen);
     AJ_ResumeRX();
 
@@ -245,6 +245,7 @@ void AJ_SerialReturnPacketToFreeList(volatile RX_PKT* pkt)
 AJ_Status AJ_SerialRX_Reset(void)
 {
     RX_PKT volatile* pkt;
+    int i;
     /*
      * Put ACL packets back on the free list.
      */
@@ -253,6 +254,10 @@ AJ_Status AJ_SerialRX_Reset(void)
         RxRecv = RxRecv->next;
         AJ_SerialReturnPacketToFreeList(pkt);
     }
+    for (i = 0; i < ArraySize(RxReorder); ++i) {
+        AJ_SerialReturnPacketToFreeList(RxReorder[i]);
+        RxReorder[i] = NULL;
+    }
 
     AJ_DebugCheckPacketList(RxFreeList, "RxFreeList reset");
     AJ_DebugCheckPacketList(RxRecv, "RxRecv during reset");
@@ -264,6 +269,66 @@ AJ_Status AJ_SerialRX_Reset(void)
     return AJ_OK;
 }
 
+/**
+ * Consume bytes from the packet at the head of the receive queue, the packet is
+ * returned to the free list once all of its payload has been consumed.
+ */
+static void ConsumeRecv(uint16_t num)
+{
+    RX_PKT volatile* pkt = RxRecv;
+
+    if (num == RX_UNREAD_LEN(pkt)) {
+        // we used a full packet
+        // put that packet back on the RxFreeList, decrement pendingRecv, and send Ack.
+        RxRecv = RxRecv->next;
+        AJ_SerialReturnPacketToFreeList(pkt);
+        AJ_DebugCheckPacketList(RxFreeList, "RxFreeList serialrecv AFTER FULL PACKET");
+        AJ_DebugCheckPacketList(RxRecv, "RxRecv serialrecv AFTER FULL PACKET");
+        AJ_DebugCheckPacketList(RxPacket, "RxFreeList serialrecv AFTER FULL PACKET");
+        --pendingRecv;
+    } else {
+        // remember how far we got, the rest is read from here next time
+        pkt->readOffset += num;
+    }
+}
+
+AJ_Status AJ_SerialRecvBorrow(const uint8_t** data, uint16_t* len, uint32_t timeout)
+{
+    AJ_Time now;
+    AJ_Time readTimeoutTimeStamp;
+
+    AJ_InitTimer(&readTimeoutTimeStamp);
+    AJ_TimeAddOffset(&readTimeoutTimeStamp, timeout);
+    AJ_InitTimer(&now);
+    while (!RxRecv) {
+        if (AJ_CompareTime(readTimeoutTimeStamp, now) <= 0) {
+            *len = 0;
+            return AJ_ERR_TIMEOUT;
+        }
+        // Running state machine, waiting for RxRecv to get another buffer.
+        AJ_StateMachine();
+        if (!RxRecv) {
+            AJ_SerialWait(&readTimeoutTimeStamp);
+        }
+        AJ_InitTimer(&now);
+    }
+    *data = RX_UNREAD_PTR(RxRecv);
+    *len = RX_UNREAD_LEN(RxRecv);
+    return AJ_OK;
+}
+
+void AJ_SerialRecvRelease(uint16_t len)
+{
+    /*
+     * Releasing nothing leaves a partly read packet where it is but a packet with nothing left to
+     * read, such as one with an empty payload, must be consumed or it would be borrowed forever
+     */
+    if (RxRecv && (len || !RX_UNREAD_LEN(RxRecv))) {
+        AJ_ASSERT(len <= RX_UNREAD_LEN(RxRecv));
+        ConsumeRecv(len);
+    }
+}
+
 AJ_Status AJ_SerialRecv(uint8_t* buffer,
                         uint16_t req,
                         uint32_t timeout,
@@ -285,34 +350,22 @@ AJ_Status AJ_SerialRecv(uint8_t* buffer,
          */
         while (RxRecv && len) {
             RX_PKT volatile* pkt = RxRecv;
-            uint16_t num = min(pkt->len - 6, len);
+            uint16_t num = min(RX_UNREAD_LEN(pkt), len);
             AJ_DebugCheckPacketList(RxFreeList, "RxFreeList serialrecv");
             AJ_DebugCheckPacketList(RxRecv, "RxRecv during serialrecv");
             AJ_DebugCheckPacketList(RxPacket, "RxPacket during serialrecv");
 
-            AJ_DebugDumpSerialRecv("AJ_SerialRecv", pkt->buffer, num + 4);
+            AJ_DebugDumpSerialRecv("AJ_SerialRecv", RX_UNREAD_PTR(pkt), num);
 
-            memcpy(buffer + (req - len), pkt->buffer + 4,  num);
+            memcpy(buffer + (req - len), RX_UNREAD_PTR(pkt), num);
             len -= num;
-
-            if (num == (pkt->len - 6)) {   /// use pkt->len, because we might have eaten out of this buffer already
-                // we used a full packet
-                // put that packet back on the RxFreeList, decrement pendingRecv, and send Ack.
-                RxRecv = RxRecv->next;
-                AJ_SerialReturnPacketToFreeList(pkt);
-                AJ_DebugCheckPacketList(RxFreeList, "RxFreeList serialrecv AFTER FULL PACKET");
-                AJ_DebugCheckPacketList(RxRecv, "RxRecv serialrecv AFTER FULL PACKET");
-                AJ_DebugCheckPacketList(RxPacket, "RxFreeList serialrecv AFTER FULL PACKET");
-                --pendingRecv;
-
-            } else {
-                // move the data in the buffer over, then return from this function.
-                memmove(pkt->buffer + 4, pkt->buffer + 4 + num, pkt->len - num);
-                pkt->len -= num;
-            }
+            ConsumeRecv(num);
         }
         // Running state machine, waiting for RxRecv to get another buffer.
         AJ_StateMachine();
+        if (len && !RxRecv) {
+            AJ_SerialWait(&readTimeoutTimeStamp);
+        }
         AJ_InitTimer(&now);
     }
 
@@ -327,6 +380,63 @@ AJ_Status AJ_SerialRecv(uint8_t* buffer,
 }
 
 
+/**
+ * Bring the running CRC of a packet being received up to date. The last two bytes
+ * received are excluded because they may turn out to be the CRC itself.
+ */
+static void UpdateRxCrc(RX_PKT volatile* pkt)
+{
+    uint16_t crc;
+
+    if (pkt->len > (pkt->crcLen + AJ_CRC_LEN)) {
+        crc = pkt->crc;
+        AJ_CRC16_Compute(pkt->buffer + pkt->crcLen, pkt->len - AJ_CRC_LEN - pkt->crcLen, &crc);
+        pkt->crc = crc;
+        pkt->crcLen = pkt->len - AJ_CRC_LEN;
+    }
+}
+
+/**
+ * Append a packet to the receive queue for the upper layers.
+ */
+static void QueueRecvPacket(RX_PKT volatile* pkt)
+{
+    RX_PKT volatile* last;
+
+    pkt->next = NULL;
+    pkt->readOffset = 0;
+    /*
+     * Add to the end of the receive queue.
+     */
+    if (RxRecv == NULL) {
+        RxRecv = pkt;
+    } else {
+        last = RxRecv;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = pkt;
+    }
+    ++pendingRecv; // we now have another packet enqueued.
+}
+
+/**
+ * Compose the selective acknowledgement bits for the packets held in the reorder
+ * buffer: bit n is set if packet (expectedSeq + n + 1) has been received.
+ */
+static uint8_t SelectiveAckBits(void)
+{
+    uint8_t sack = 0;
+    uint8_t i;
+
+    for (i = 1; i < AJ_SerialLinkParams.windowSize; ++i) {
+        if (RxReorder[(expectedSeq + i) & AJ_SerialLinkParams.seqMask] != NULL) {
+            sack |= (1 << (i - 1));
+        }
+    }
+    return sack;
+}
+
 /**
  * This function checks packet integrity and forwards good packets to the appropriate
  * upper-layer interface.
@@ -342,7 +452,6 @@ static void CompletePacket()
     uint8_t checksum;
     uint8_t* rcvdCrc = &pkt->buffer[pkt->len - 2];
     uint8_t checkCrc[2];
-    uint16_t crc = AJ_SERIAL_CRC_INIT;
 
     if (pkt->len < AJ_SERIAL_HDR_LEN) {
         /*
@@ -371,10 +480,10 @@ static void CompletePacket()
     //AJ_Printf("Rx %d, seq=%d, ack=%d\n", pktType, seq, ack);
 
     /*
-     * Compute the CRC on the packet header and payload.
+     * Complete the CRC on the packet header and payload.
      */
-    AJ_CRC16_Compute(pkt->buffer, pkt->len - 2, &crc);
-    AJ_CRC16_Complete(crc, checkCrc);
+    UpdateRxCrc(pkt);
+    AJ_CRC16_Complete(pkt->crc, checkCrc);
 
     /*
      * Check the computed and received CRC's match.
@@ -407,15 +516,37 @@ static void CompletePacket()
      */
     AJ_SerialTx_ReceivedAck(ack);
 
+    /*
+     * In the extended window mode an explicit ACK may carry selective acknowledgements.
+     */
+    if ((pktType == AJ_SERIAL_ACK) && (expectedLen > 0) && AJ_SERIAL_EXTENDED_MODE()) {
+        AJ_SerialTx_ReceivedSack(ack, pkt->buffer[AJ_SERIAL_HDR_LEN]);
+    }
+
     if (pktType == AJ_SERIAL_DATA) {
         /*
          * If a reliable packet does not have the expected sequence number, then
-         * it is either a repeated packet or we missed a packet. In either case,
-         * we must ignore the packet but we need to ACK repeated packets.
+         * it is either a repeated packet or we missed a packet. In the legacy mode
+         * we must ignore the packet but we need to ACK repeated packets. In the
+         * extended window mode packets received ahead of a missing packet are held
+         * until the missing packet is resent.
          */
         if (seq != expectedSeq) {
             if (SEQ_GT(seq, expectedSeq)) {
                 AJ_Printf("Missing packet - expected = %d, got %d\n", expectedSeq, seq);
+                /*
+                 * One free packet is always kept back for the missing packet.
+                 */
+                if (AJ_SERIAL_EXTENDED_MODE() &&
+                    (((seq - expectedSeq) & AJ_SerialLinkParams.seqMask) < AJ_SerialLinkParams.windowSize) &&
+                    (RxFreeList != NULL) && (RxFreeList->next != NULL) && (RxReorder[seq] == NULL)) {
+                    RxReorder[seq] = pkt;
+                    pkt->next = NULL;
+                    RxPacket = RxFreeList;
+                    RxFreeList = RxFreeList->next;
+                    RxPacket->next = NULL;
+                    AJ_SerialTx_ReceivedOutOfOrder(SelectiveAckBits());
+                }
             } else {
                 AJ_Printf("Repeated packet seq = %d, expected %d\n", seq, expectedSeq);
                 AJ_SerialTx_ReceivedSeq(seq);
@@ -423,26 +554,24 @@ static void CompletePacket()
         } else {
             if (RxFreeList != NULL) {
                 // push the RxPacket on to the back of the RxRecv list.
-                RX_PKT volatile* last;
-                expectedSeq = (expectedSeq + 1) & 0x07;
-                /*
-                 * Add to the end of the receive queue.
-                 */
-                if (RxRecv == NULL) {
-                    RxRecv = pkt;
-                } else {
-                    last = RxRecv;
-                    while (last->next != NULL) {
-                        last = last->next;
-                    }
-                    last->next = pkt;
-                }
-                pkt->next = NULL;
+                expectedSeq = (expectedSeq + 1) & AJ_SerialLinkParams.seqMask;
+                QueueRecvPacket(pkt);
                 RxPacket = RxFreeList;
                 RxFreeList = RxFreeList->next;
                 RxPacket->next = NULL;
 
-                ++pendingRecv; // we now have another packet enqueued.
+                /*
+                 * Deliver any packets that were waiting for this one.
+                 */
+                while (RxReorder[expectedSeq] != NULL) {
+                    QueueRecvPacket(RxReorder[expectedSeq]);
+                    RxReorder[expectedSeq] = NULL;
+                    seq = expectedSeq;
+                    expectedSeq = (expectedSeq + 1) & AJ_SerialLinkParams.seqMask;
+                }
+                if (AJ_SERIAL_EXTENDED_MODE()) {
+                    AJ_SerialTx_SetSelectiveAck(SelectiveAckBits());
+                }
                 AJ_SerialTx_ReceivedSeq(seq);
             }
         }
@@ -459,16 +588,23 @@ static void CompletePacket()
 static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
 {
     uint8_t rx;
+    uint8_t* boundary;
+    uint16_t run;
+    uint16_t space;
 
-    while (bytes-- > 0) {
-        rx = *buffer++;
+    while (bytes > 0) {
         switch (RxPacket->state) {
         case PACKET_FLUSH:
             /*
              * If we are not at a packet boundary as expected, then we need to flush
              * the receive system until we see a closing packet boundary.
              */
-            if (rx == BOUNDARY_BYTE) {
+            boundary = memchr(buffer, BOUNDARY_BYTE, bytes);
+            if (boundary == NULL) {
+                bytes = 0;
+            } else {
+                bytes -= (boundary - buffer) + 1;
+                buffer = boundary + 1;
                 RxPacket->state = PACKET_NEW;
             }
             break;
@@ -478,6 +614,8 @@ static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
              * If we are not at a packet boundary as expected we need to flush
              * rx until we see a closing packet boundary.
              */
+            rx = *buffer++;
+            --bytes;
             if (rx == BOUNDARY_BYTE) {
                 RxPacket->state = PACKET_OPEN;
             } else {
@@ -485,13 +623,22 @@ static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
                 AJ_Printf("AJ_SerialRx_Receive: Flushing input at %2x\n", rx);
             }
             RxPacket->len = 0;
+            RxPacket->crc = AJ_SERIAL_CRC_INIT;
+            RxPacket->crcLen = 0;
             break;
 
         case PACKET_ESCAPE:
             /*
              * Handle a SLIP escape sequence.
              */
+            rx = *buffer++;
+            --bytes;
             RxPacket->state = PACKET_OPEN;
+            if (RxPacket->len == maxRxFrameSize) {
+                RxPacket->state = PACKET_NEW;
+                AJ_Printf("AJ_SerialRx_Receive: Packet overrun %d\n", RxPacket->len);
+                break;
+            }
             if (rx == BOUNDARY_SUBSTITUTE) {
                 RxPacket->buffer[RxPacket->len++] = BOUNDARY_BYTE;
                 break;
@@ -511,9 +658,35 @@ static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
             break;
 
         case PACKET_OPEN:
+            /*
+             * Transfer runs of bytes that are not SLIP encoded in bulk.
+             */
+            run = AJ_SerialSlipScan(buffer, bytes);
+            if (run) {
+                space = maxRxFrameSize - RxPacket->len;
+                if (run > space) {
+                    /*
+                     * Packet overrun: discard the packet.
+                     */
+                    memcpy(RxPacket->buffer + RxPacket->len, buffer, space);
+                    RxPacket->len += space;
+                    buffer += space + 1;
+                    bytes -= space + 1;
+                    RxPacket->state = PACKET_NEW;
+                    AJ_Printf("AJ_SerialRx_Receive: Packet overrun %d\n", RxPacket->len);
+                    break;
+                }
+                memcpy(RxPacket->buffer + RxPacket->len, buffer, run);
+                RxPacket->len += run;
+                buffer += run;
+                bytes -= run;
+                break;
+            }
             /*
              * Decode received bytes and transfer them to the receive packet.
              */
+            rx = *buffer++;
+            --bytes;
             if (rx == BOUNDARY_BYTE) {
                 RX_PKT volatile* pkt = RxPacket;
                 pkt->state = PACKET_NEW;
@@ -523,25 +696,19 @@ static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
                 // the packet will be put back on the RxFreeList when the upper layer has retrieved it.
                 break;
             }
-            if (rx == ESCAPE_BYTE) {
-                RxPacket->state = PACKET_ESCAPE;
-                break;
-            }
-            if (RxPacket->len == maxRxFrameSize) {
-                /*
-                 * Packet overrun: discard the packet.
-                 */
-                RxPacket->state = PACKET_NEW;
-                AJ_Printf("AJ_SerialRx_Receive: Packet overrun %d\n", RxPacket->len);
-                break;
-            }
-            RxPacket->buffer[RxPacket->len++] = rx;
+            RxPacket->state = PACKET_ESCAPE;
             break;
 
         default:
             assert(FALSE);
         }
     }
+    /*
+     * Compute the CRC on what we have received while it is still in the cache.
+     */
+    if ((RxPacket->state == PACKET_OPEN) || (RxPacket->state == PACKET_ESCAPE)) {
+        UpdateRxCrc(RxPacket);
+    }
     /*
      * Only read as many bytes as we can consume.
      */
@@ -550,37 +717,39 @@ static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
 
 void AJ_ProcessRxBufferList()
 {
-    AJ_SlippedBuffer volatile* currentSlippedBuffer;
+    AJ_SlippedBuffer* currentSlippedBuffer;
 
     if (!RxFreeList) {
         return;
     }
 
-    AJ_PauseTX();
-    while (bufferRxQueue && RxFreeList) {
-        // Pull the head off the queue.
-        currentSlippedBuffer = bufferRxQueue;
-        bufferRxQueue = bufferRxQueue->next;
-        AJ_ResumeRX();
-
+    /*
+     * Clear the flag before draining the queue so a buffer queued while we are
+     * draining it is not missed.
+     */
+    dataReceived = FALSE;
+    while (RxFreeList && ((currentSlippedBuffer = AJ_SerialRingPop(&bufferRxQueue)) != NULL)) {
         UART_RxComplete(currentSlippedBuffer->buffer, currentSlippedBuffer->actualLen);
-        AJ_PauseTX();
 
+        /*
+         * The receive callback stops receiving when it runs out of free buffers so
+         * the hand-over of the buffer back to the receiver is the only step that needs
+         * the receive interrupt paused.
+         */
+        AJ_PauseRX();
         if (pendingRecvBuffer == NULL) {
-            //Free list was previously NULL, so re-enable reading
+            //Free ring was previously empty, so re-enable reading
             //Save a pointer to the recv buffer, so we can keep track when the AJ_RecieveCallback occurs.
             pendingRecvBuffer = currentSlippedBuffer;
-            pendingRecvBuffer->next = NULL;
             AJ_RX(pendingRecvBuffer->buffer, pendingRecvBuffer->allocatedLen);
         } else {
-            currentSlippedBuffer->next = bufferRxFreeList;
-            bufferRxFreeList = currentSlippedBuffer;
+            AJ_SerialRingPush(&bufferRxFreeRing, currentSlippedBuffer);
         }
+        AJ_ResumeRX();
     }
 
-    if (!bufferRxQueue) {
-        dataReceived = FALSE;
+    if (!AJ_SerialRingEmpty(&bufferRxQueue)) {
+        dataReceived = TRUE;
     }
-    AJ_ResumeRX();
 }
 #endif /* AJ_SERIAL_CONNECTION */
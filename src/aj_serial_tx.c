@@ -20,6 +20,7 @@
 #include "aj_target.h"
 #include "aj_status.h"
 #include "aj_serial.h"
+#include "aj_serio.h"
 #include "aj_serial_rx.h"
 #include "aj_serial_tx.h"
 #include "aj_crc16.h"
@@ -27,10 +28,17 @@
 #include "aj_timer.h"
 
 /**
- * how long to wait for an acknowledgement before resending a packet
+ * how long to wait for an acknowledgement before resending a packet, until
+ * the round trip time has been measured
  */
 #define TX_RESEND_TIMEOUT    200
 
+/**
+ * bounds for the resend timeout derived from the measured round trip time
+ */
+#define TX_RESEND_MIN_TIMEOUT  (TX_ACK_TIMEOUT + 50)
+#define TX_RESEND_MAX_TIMEOUT  4000
+
 /**
  * Throughput may be improved by always ack'ing received packets immediately.
  */
@@ -50,6 +58,9 @@ typedef struct _TxPkt {
     uint8_t seq;
     uint8_t type;
     uint8_t* payload;
+    AJ_Time sentTime;   /* when the packet was (last) sent */
+    uint8_t retries;    /* number of times the packet has been resent */
+    uint8_t sacked;     /* packet has been selectively acknowledged */
 } TxPkt;
 
 
@@ -73,23 +84,50 @@ static TxPkt volatile* txFreeList;
  */
 static TxPkt volatile* txUnreliable;
 
-/* Linked list of slipped buffers to be transmitted */
-static AJ_SlippedBuffer volatile* bufferTxPending;
+/* Slipped buffers to be transmitted, produced by the state machine and
+ * consumed by the Transmit callback
+ */
+static AJ_SlippedBufferRing bufferTxPending;
 
-/* Linked list of buffers that can be filled with slipped SLAP packets
- * and transferred into bufferTxPending
+/* Buffers that can be filled with slipped SLAP packets and transferred
+ * into bufferTxPending, produced by the Transmit callback and consumed by
+ * the state machine
  */
-static AJ_SlippedBuffer volatile* bufferTxFreeList;
+static AJ_SlippedBufferRing bufferTxFreeRing;
 
-/* The buffer currently being sent by the Transmit callback
+/* Buffers handed to the serial I/O layer with AJ_TX in the order they will
+ * complete. Only used by the Transmit callback.
  */
-static AJ_SlippedBuffer volatile* pendingSendBuffer;
+static AJ_SlippedBufferRing bufferTxSending;
+static uint8_t volatile txSendingCount;
 
 /**
  * current transmit sequence number
  */
 static uint8_t txSeqNum;
 
+/**
+ * number of data packets that have been queued but not yet acknowledged
+ */
+static uint8_t txDataPending;
+
+/**
+ * Smoothed round trip time (scaled by 8) and round trip time variation (scaled by 4)
+ */
+static uint32_t srtt;
+static uint32_t rttvar;
+
+/**
+ * current resend timeout, adapted to the measured round trip time
+ */
+static uint32_t resendTimeout;
+
+/**
+ * Selective acknowledgement carried in explicit ACK packets in the extended window
+ * mode. Bit n is set if packet (ack + n + 1) has been received out of order.
+ */
+static uint8_t sackBits[1];
+
 
 /**
  * number of received packets waiting to be ACKed
@@ -154,6 +192,11 @@ AJ_Status AJ_SerialTX_Init()
     resendPrimed = FALSE;
     pendingAcks = 0;
     currentTxAck = 0;
+    txDataPending = 0;
+    srtt = 0;
+    rttvar = 0;
+    resendTimeout = TX_RESEND_TIMEOUT;
+    sackBits[0] = 0;
 
     /*
      * Data packets: To maximize throughput we need as many packets as the
@@ -166,20 +209,14 @@ AJ_Status AJ_SerialTX_Init()
         txFreeList->next = prev;
     }
 
-    AJ_SlippedBuffer volatile* prevBuf = NULL;
-    bufferTxFreeList = NULL;
+    AJ_SerialRingInit(&bufferTxFreeRing);
+    AJ_SerialRingInit(&bufferTxPending);
+    AJ_SerialRingInit(&bufferTxSending);
+    txSendingCount = 0;
     for (i = 0; i < AJ_SerialLinkParams.maxWindowSize; i++) {
-        prevBuf = bufferTxFreeList;
-        bufferTxFreeList = AJ_Malloc(sizeof(AJ_SlippedBuffer));
-
-        bufferTxFreeList->buffer = AJ_Malloc(SLIPPED_LEN(AJ_SerialLinkParams.packetSize)); //TODO: calculate slipped length based on packet size
-        bufferTxFreeList->actualLen = 0;
-        bufferTxFreeList->allocatedLen = SLIPPED_LEN(AJ_SerialLinkParams.packetSize);
-        bufferTxFreeList->next = prevBuf;
+        AJ_SerialRingPush(&bufferTxFreeRing, AJ_SerialAllocSlippedBuffer());
     }
 
-    prevBuf = bufferTxFreeList;
-
     /*
      * Buffer for unreliable packets
      */
@@ -219,12 +256,10 @@ void AJ_SerialTX_Shutdown(void)
     DeleteTxPacket(txUnreliable);
     txUnreliable = NULL;
 
-    ClearSlippedBuffer(bufferTxFreeList);
-    bufferTxFreeList = NULL;
-    ClearSlippedBuffer(bufferTxPending);
-    bufferTxPending = NULL;
-    ClearSlippedBuffer(pendingSendBuffer);
-    pendingSendBuffer = NULL;
+    AJ_SerialRingClear(&bufferTxFreeRing);
+    AJ_SerialRingClear(&bufferTxPending);
+    AJ_SerialRingClear(&bufferTxSending);
+    txSendingCount = 0;
 }
 
 /**
@@ -269,19 +304,49 @@ AJ_Status AJ_SerialTX_Reset(void)
     txSeqNum = 0;
     pendingAcks = 0;
     currentTxAck = 0;
-    txSeqNum = 0;
+    txDataPending = 0;
+    srtt = 0;
+    rttvar = 0;
+    resendTimeout = TX_RESEND_TIMEOUT;
+    sackBits[0] = 0;
     resendPrimed = FALSE;
     return AJ_OK;
 }
 
 
+/**
+ * Update the resend timeout from a round trip time sample using the usual smoothed
+ * round trip time and variance estimators (RFC 6298).
+ */
+static void UpdateResendTimeout(uint32_t rtt)
+{
+    if (srtt == 0) {
+        srtt = rtt << 3;
+        rttvar = rtt << 1;
+    } else {
+        int32_t delta = (int32_t)rtt - (int32_t)(srtt >> 3);
+        srtt += delta;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        rttvar += delta - (rttvar >> 2);
+    }
+    resendTimeout = (srtt >> 3) + rttvar;
+    resendTimeout = max(resendTimeout, TX_RESEND_MIN_TIMEOUT);
+    resendTimeout = min(resendTimeout, TX_RESEND_MAX_TIMEOUT);
+}
+
 /**
  * This function is called if an acknowledgement is not received within the required
  * timeout period.
  */
 void ResendPackets()
 {
-    TxPkt volatile* last;
+    TxPkt volatile* pkt;
+    TxPkt volatile* resend = NULL;
+    TxPkt volatile* last = NULL;
+    TxPkt volatile* keep = NULL;
+    TxPkt volatile* keepLast = NULL;
 
     /*
      * Re-register the send timeout callback, it will not be primed until it
@@ -298,26 +363,49 @@ void ResendPackets()
         return;
     }
     /*
-     * To preserve packet order, all unacknowleged packets must be resent. This
-     * simply means moving packets on txSent to the head of txQueue.
+     * Back off the resend timeout, the link is either lossy or slower than we thought.
      */
-    if (txSent != NULL) {
-        last = txSent;
-        while (last->next != NULL) {
-            last = last->next;
+    resendTimeout = min(resendTimeout * 2, TX_RESEND_MAX_TIMEOUT);
+    /*
+     * In the legacy mode all unacknowleged packets must be resent to preserve packet
+     * order. In the extended window mode the receiver holds on to packets received out
+     * of order so we only resend packets that have not been selectively acknowledged.
+     * Either way this means moving packets from txSent to the head of txQueue.
+     */
+    while (txSent != NULL) {
+        pkt = txSent;
+        txSent = txSent->next;
+        pkt->next = NULL;
+        if (pkt->sacked && AJ_SERIAL_EXTENDED_MODE()) {
+            if (keep == NULL) {
+                keep = pkt;
+            } else {
+                keepLast->next = pkt;
+            }
+            keepLast = pkt;
+        } else {
+            ++pkt->retries;
+            if (resend == NULL) {
+                resend = pkt;
+            } else {
+                last->next = pkt;
+            }
+            last = pkt;
         }
+    }
+    txSent = keep;
+
+    if (resend != NULL) {
         /*
          * Put resend packets after the unreliable packet.
          */
         if (txQueue == txUnreliable) {
             last->next = txQueue->next;
-            txQueue->next = last;
+            txQueue->next = resend;
         } else {
             last->next = txQueue;
-            txQueue = txSent;
+            txQueue = resend;
         }
-
-        txSent = NULL;
     }
 }
 
@@ -357,10 +445,12 @@ static void QueueReliable(TxPkt volatile* pkt)
 
     pkt->seq = txSeqNum;
     pkt->next = NULL;
+    pkt->retries = 0;
+    pkt->sacked = FALSE;
     /*
      * updates sequence number
      */
-    txSeqNum = (txSeqNum + 1) & 0x7;
+    txSeqNum = (txSeqNum + 1) & AJ_SerialLinkParams.seqMask;
     /*
      * Add to the end of the transmit queue.
      */
@@ -376,21 +466,29 @@ static void QueueReliable(TxPkt volatile* pkt)
 }
 
 
+/*
+ * No more data can be queued until an ack arrives or the link comes up
+ */
+#define TX_WINDOW_CLOSED() (!txFreeList || (txDataPending >= AJ_SerialLinkParams.windowSize) || (AJ_SerialLinkParams.linkState != AJ_LINK_ACTIVE))
+
 AJ_Status AJ_SerialSend(uint8_t* buffer,
                         uint16_t bufLen)
 {
     uint16_t len = bufLen;
 
     while (len) {
-        // wait until there is space to send a packet.
-        if (!txFreeList || AJ_SerialLinkParams.linkState != AJ_LINK_ACTIVE) {
+        // wait until there is space in the window to send a packet.
+        if (TX_WINDOW_CLOSED()) {
             AJ_StateMachine();
+            if (TX_WINDOW_CLOSED()) {
+                AJ_SerialWait(NULL);
+            }
             continue;
         }
         /*
          * Fill as many packets as we can
          */
-        while (txFreeList && len) {
+        while (txFreeList && (txDataPending < AJ_SerialLinkParams.windowSize) && len) {
             uint16_t num = min(AJ_SerialLinkParams.packetSize, len);
             TxPkt volatile* pkt = txFreeList;
 
@@ -399,6 +497,7 @@ AJ_Status AJ_SerialSend(uint8_t* buffer,
             pkt->len  = num;
             memcpy(pkt->payload, buffer + (bufLen - len), num);
 
+            ++txDataPending;
             QueueReliable(pkt);
             len -= num;
         }
@@ -424,30 +523,61 @@ void AJ_SerialTX_EnqueueCtrl(const uint8_t* packet,
     QueueUnreliable();
 }
 
+/*
+ * Queue an explicit ACK, in the extended window mode the ACK also carries the selective
+ * acknowledgement bits if there are any.
+ */
+static void EnqueueAck(void)
+{
+    if (AJ_SERIAL_EXTENDED_MODE() && sackBits[0]) {
+        AJ_SerialTX_EnqueueCtrl(sackBits, sizeof(sackBits), AJ_SERIAL_ACK);
+    } else {
+        AJ_SerialTX_EnqueueCtrl(NULL, 0, AJ_SERIAL_ACK);
+    }
+}
+
+/*
+ * Apply SLIP encoding to data and, if crc is not NULL, add the data to the running CRC.
+ * Runs of bytes that do not need escaping are copied in bulk and the CRC is computed
+ * on each run while it is in the cache.
+ */
 static uint16_t SlipBytes(AJ_SlippedBuffer volatile* slip,
-                          uint8_t* data,
-                          uint16_t len)
+                          const uint8_t* data,
+                          uint16_t len,
+                          uint16_t* crc)
 {
-    uint16_t i;
+    uint16_t i = 0;
+    uint16_t run;
     uint8_t b;
 
-    for (i = 0; i < len; ++i) {
+    while (i < len) {
         if (slip->actualLen == slip->allocatedLen) {
             assert(FALSE);
             break;
         }
-        b = *data++;
-        if ((b == BOUNDARY_BYTE) || (b == ESCAPE_BYTE)) {
-            /*
-             * need room for two bytes
-             */
-            if ((slip->actualLen + 1) == slip->allocatedLen) {
-                break;
+        run = AJ_SerialSlipScan(data + i, len - i);
+        run = min(run, slip->allocatedLen - slip->actualLen);
+        if (run) {
+            memcpy(slip->buffer + slip->actualLen, data + i, run);
+            if (crc) {
+                AJ_CRC16_Compute(data + i, run, crc);
             }
-            slip->buffer[slip->actualLen++] = ESCAPE_BYTE;
-            b = (b == ESCAPE_BYTE) ? ESCAPE_SUBSTITUTE : BOUNDARY_SUBSTITUTE;
+            slip->actualLen += run;
+            i += run;
+            continue;
+        }
+        /*
+         * need room for two bytes
+         */
+        if ((slip->actualLen + 1) == slip->allocatedLen) {
+            break;
+        }
+        b = data[i++];
+        if (crc) {
+            AJ_CRC16_Compute(&b, 1, crc);
         }
-        slip->buffer[slip->actualLen++] = b;
+        slip->buffer[slip->actualLen++] = ESCAPE_BYTE;
+        slip->buffer[slip->actualLen++] = (b == ESCAPE_BYTE) ? ESCAPE_SUBSTITUTE : BOUNDARY_SUBSTITUTE;
     }
     return i;
 }
@@ -524,12 +654,10 @@ void ConvertPacketToBytes(AJ_SlippedBuffer volatile* slip, TxPkt volatile* txCur
     header[2] = txCurrent->len >> 8;
     header[3] = txCurrent->len & 0x00FF;
 
-    AJ_CRC16_Compute(header, ArraySize(header), &crc);
-    AJ_CRC16_Compute(txCurrent->payload, txCurrent->len, &crc);
-    SlipBytes(slip, header, 4);
-    SlipBytes(slip, txCurrent->payload, txCurrent->len);
+    SlipBytes(slip, header, 4, &crc);
+    SlipBytes(slip, txCurrent->payload, txCurrent->len, &crc);
     AJ_CRC16_Complete(crc, crcBytes);
-    SlipBytes(slip, crcBytes, 2);
+    SlipBytes(slip, crcBytes, 2, NULL);
     slip->buffer[slip->actualLen++] = BOUNDARY_BYTE;
 }
 
@@ -542,46 +670,109 @@ void ConvertPacketToBytes(AJ_SlippedBuffer volatile* slip, TxPkt volatile* txCur
 void AJ_SerialTx_ReceivedAck(uint8_t ack)
 {
     TxPkt volatile* ackedPkt = NULL;
+    TxPkt volatile* pkt;
+    TxPkt volatile* prev = NULL;
 
     if (txSent == NULL) {
         return;
     }
 
     /*
-     * Remove acknowledged packets from sent queue.
+     * Remove acknowledged packets from sent queue. Resent packets are appended to the
+     * sent queue so it is not necessarily in sequence number order.
      */
-    while ((txSent != NULL) && SEQ_GT(ack, txSent->seq)) {
-        ackedPkt = txSent;
-        txSent = txSent->next;
+    pkt = txSent;
+    while (pkt != NULL) {
+        if (!SEQ_GT(ack, pkt->seq)) {
+            prev = pkt;
+            pkt = pkt->next;
+            continue;
+        }
+        ackedPkt = pkt;
+        pkt = pkt->next;
+        if (prev == NULL) {
+            txSent = pkt;
+        } else {
+            prev->next = pkt;
+        }
         //AJ_Printf("Releasing seq=%d (acked by %d)\n", ackedPkt->seq, ack);
 
         assert(ackedPkt->type == AJ_SERIAL_DATA);
+        /*
+         * Only packets that were sent once give an unambiguous round trip time.
+         */
+        if (!ackedPkt->retries && !ackedPkt->sacked) {
+            UpdateResendTimeout(AJ_GetElapsedTime((AJ_Time*)&ackedPkt->sentTime, TRUE));
+        }
         /*
          * Return pkt to ACL free list.
          */
         ackedPkt->next = txFreeList;
         txFreeList = ackedPkt;
+        --txDataPending;
+    }
 
-        /*
-         * If all packet have been ack'd, halt the resend timer and return.
-         */
-        if (txSent == NULL) {
-            AJ_InitTimer(&resendTime);
-            AJ_TimeAddOffset(&resendTime, AJ_TIMER_FOREVER);
-            resendPrimed = FALSE;
-            return;
-        }
+    /*
+     * If all packet have been ack'd, halt the resend timer and return.
+     */
+    if (txSent == NULL) {
+        AJ_InitTimer(&resendTime);
+        AJ_TimeAddOffset(&resendTime, AJ_TIMER_FOREVER);
+        resendPrimed = FALSE;
+        return;
     }
     /*
      * Reset the resend timer if one or more packets were ack'd.
      */
     if (ackedPkt != NULL) {
         AJ_InitTimer(&resendTime);
-        AJ_TimeAddOffset(&resendTime, TX_RESEND_TIMEOUT);
+        AJ_TimeAddOffset(&resendTime, resendTimeout);
         resendPrimed = TRUE;
     }
 }
 
+/**
+ * This function is called by the receive layer when an explicit ACK carrying selective
+ * acknowledgement bits has been received in the extended window mode. Bit n of sack is
+ * set if the peer has received packet (ack + n + 1).
+ */
+void AJ_SerialTx_ReceivedSack(uint8_t ack, uint8_t sack)
+{
+    TxPkt volatile* pkt;
+    uint8_t offset;
+
+    for (pkt = txSent; pkt != NULL; pkt = pkt->next) {
+        offset = (pkt->seq - ack) & AJ_SerialLinkParams.seqMask;
+        if ((offset > 0) && (offset < AJ_SerialLinkParams.windowSize) && (sack & (1 << (offset - 1)))) {
+            if (!pkt->sacked && !pkt->retries) {
+                UpdateResendTimeout(AJ_GetElapsedTime((AJ_Time*)&pkt->sentTime, TRUE));
+            }
+            pkt->sacked = TRUE;
+        }
+    }
+}
+
+/**
+ * This function is called by the receive layer to update the selective acknowledgement
+ * bits sent with the next explicit ACK.
+ */
+void AJ_SerialTx_SetSelectiveAck(uint8_t sack)
+{
+    sackBits[0] = sack;
+}
+
+/**
+ * This function is called by the receive layer when a packet has been received out of
+ * order. An explicit ACK carrying the selective acknowledgement is sent right away so the
+ * peer does not resend the packets we already have.
+ */
+void AJ_SerialTx_ReceivedOutOfOrder(uint8_t sack)
+{
+    sackBits[0] = sack;
+    pendingAcks = 0;
+    EnqueueAck();
+}
+
 
 /*
  * Send a explicit ACK (acknowledgement).
@@ -590,7 +781,7 @@ void SendAck()
 {
     if (pendingAcks) {
         pendingAcks = 0;
-        AJ_SerialTX_EnqueueCtrl(NULL, 0, AJ_SERIAL_ACK);
+        EnqueueAck();
     }
     /*
      * Disable explicit ack.
@@ -611,11 +802,11 @@ void AJ_SerialTx_ReceivedSeq(uint8_t seq)
      * the ack count.
      */
     if (!SEQ_GT(currentTxAck, seq)) {
-        currentTxAck = (seq + 1) & 0x7;
+        currentTxAck = (seq + 1) & AJ_SerialLinkParams.seqMask;
     }
 
 #ifdef ALWAYS_ACK
-    AJ_SerialTX_EnqueueCtrl(NULL, 0, AJ_SERIAL_ACK);
+    EnqueueAck();
 #else
     ++pendingAcks;
 
@@ -635,47 +826,69 @@ void AJ_SerialTx_ReceivedSeq(uint8_t seq)
      * If we have hit our pending ACK limit send a explicit ACK packet immediately.
      */
     if (pendingAcks == AJ_SerialLinkParams.windowSize) {
-        AJ_SerialTX_EnqueueCtrl(NULL, 0, AJ_SERIAL_ACK);
+        EnqueueAck();
     }
 #endif
 }
 
+/**
+ * Hand pending buffers to the serial I/O layer until it has AJ_SERIO_TX_DEPTH
+ * buffers queued. Only called from the Transmit callback, which is the one
+ * consumer of the pending ring.
+ *
+ * @return  The number of buffers queued
+ */
+static uint8_t StartSending(void)
+{
+    AJ_SlippedBuffer* buf;
+    uint8_t started = 0;
+
+    while ((txSendingCount < AJ_SERIO_TX_DEPTH) && ((buf = AJ_SerialRingPop(&bufferTxPending)) != NULL)) {
+        AJ_SerialRingPush(&bufferTxSending, buf);
+        ++txSendingCount;
+        ++started;
+        AJ_TX(buf->buffer, buf->actualLen);
+    }
+    return started;
+}
+
 void AJ_TransmitCallback(uint8_t* buffer, uint16_t bytesWritten)
 {
-    dataSent = 1;
-    AJ_ASSERT((buffer == pendingSendBuffer->buffer) && (bytesWritten == pendingSendBuffer->actualLen));
-    // put pendingSendBuffer on the free list
-    pendingSendBuffer->next = bufferTxFreeList;
-    bufferTxFreeList = pendingSendBuffer;
-    pendingSendBuffer = bufferTxPending;
-    if (pendingSendBuffer != NULL) {
-        bufferTxPending = bufferTxPending->next;
-        pendingSendBuffer->next = NULL;
-        AJ_TX(pendingSendBuffer->buffer, pendingSendBuffer->actualLen);
+    /*
+     * A NULL buffer means nothing completed, the state machine published buffers
+     * to the pending ring and called AJ_ResumeTX.
+     */
+    if (buffer) {
+        AJ_SlippedBuffer* sent = AJ_SerialRingPop(&bufferTxSending);
+
+        AJ_ASSERT(sent && (buffer == sent->buffer) && (bytesWritten == sent->actualLen));
+        --txSendingCount;
+        // put the sent buffer on the free ring
+        AJ_SerialRingPush(&bufferTxFreeRing, sent);
+        dataSent = 1;
+        AJ_SerialSignalEvent();
+    }
+    if (StartSending()) {
         AJ_ResumeTX();
     }
 }
 
 void AJ_FillTxBufferList()
 {
-    AJ_SlippedBuffer volatile* currentSlippedBuffer;
+    AJ_SlippedBuffer* currentSlippedBuffer;
 
     if (!txQueue) {
         return;
     }
 
-    AJ_PauseTX();
-
-    while (bufferTxFreeList && txQueue) {
+    /*
+     * Clear the flag before filling so a buffer freed while we are filling is not
+     * missed.
+     */
+    dataSent = FALSE;
+    while (txQueue && ((currentSlippedBuffer = AJ_SerialRingPop(&bufferTxFreeRing)) != NULL)) {
         // Pull the head off the queue.
         TxPkt volatile* txCurrent;
-        currentSlippedBuffer = bufferTxFreeList;
-        bufferTxFreeList = bufferTxFreeList->next;
-        currentSlippedBuffer->next  = NULL;
-
-        if (pendingSendBuffer != NULL) {
-            AJ_ResumeTX();
-        }
 
         txCurrent = txQueue;
         txQueue = txQueue->next;
@@ -694,40 +907,27 @@ void AJ_FillTxBufferList()
                 last->next = txCurrent;
             }
 
+            AJ_InitTimer((AJ_Time*)&txCurrent->sentTime);
             if (!resendPrimed) {
                 AJ_InitTimer(&resendTime);
-                AJ_TimeAddOffset(&resendTime, TX_RESEND_TIMEOUT);
-                resendPrimed = FALSE;
-            }
-        }
-        AJ_PauseTX();
-        //put the buffer on the pending list
-        if (pendingSendBuffer == NULL) {
-            //Free list was previously NULL, so re-enable reading
-            //Save a pointer to the recv buffer, so we can keep track when the AJ_RecieveCallback occurs.
-            pendingSendBuffer = currentSlippedBuffer;
-            //pendingSendBuffer->next = NULL;
-            AJ_TX(pendingSendBuffer->buffer, pendingSendBuffer->actualLen);
-        } else {
-            if (bufferTxPending != NULL) {
-                volatile AJ_SlippedBuffer* buf = bufferTxPending;
-                while (buf->next != NULL) {
-                    buf = buf->next;
-                }
-                buf->next = currentSlippedBuffer;
-            } else {
-                bufferTxPending = currentSlippedBuffer;
+                AJ_TimeAddOffset(&resendTime, resendTimeout);
+                resendPrimed = TRUE;
             }
         }
+        //put the buffer on the pending ring, there are never more buffers than
+        //the ring can hold so this cannot fail.
+        AJ_SerialRingPush(&bufferTxPending, currentSlippedBuffer);
     }
 
-    if (!bufferTxFreeList) {
-        dataSent = FALSE;
+    if (!AJ_SerialRingEmpty(&bufferTxFreeRing)) {
+        dataSent = TRUE;
     }
 
-    if (pendingSendBuffer != NULL) {
-        AJ_ResumeTX();
-    }
+    /*
+     * The Transmit callback stops when the pending ring is empty so wake the
+     * transmitter, it collects the buffers from the pending ring itself.
+     */
+    AJ_ResumeTX();
 }
 
 #endif /* AJ_SERIAL_CONNECTION */
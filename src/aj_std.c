@@ -43,6 +43,8 @@ static const char DaemonInterface[] = "org.alljoyn.Daemon";
 static const char PeerObjectPath[] = "/org/alljoyn/Bus/Peer";
 static const char PeerSessionInterface[] = "org.alljoyn.Bus.Peer.Session";
 static const char PeerAuthInterface[] = "org.alljoyn.Bus.Peer.Authentication";
+static const char PeerHeaderCompressionInterface[] = "org.alljoyn.Bus.Peer.HeaderCompression";
+static const char PeerBodyCompressionInterface[] = "org.alljoyn.Bus.Peer.BodyCompression";
 
 
 
@@ -134,9 +136,23 @@ static const char* const PeerAuthIface[] = {
     NULL
 };
 
+static const char* const PeerHeaderCompressionIface[] = {
+    PeerHeaderCompressionInterface,
+    "?GetExpansion <u >a(yv)",
+    NULL
+};
+
+static const char* const PeerBodyCompressionIface[] = {
+    PeerBodyCompressionInterface,
+    "?Negotiate <q >q",
+    NULL
+};
+
 static const AJ_InterfaceDescription PeerIfaces[] = {
     PeerSessionIface,
     PeerAuthIface,
+    PeerHeaderCompressionIface,
+    PeerBodyCompressionIface,
     NULL
 };
 
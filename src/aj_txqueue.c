@@ -0,0 +1,774 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+#include "aj_txqueue.h"
+#include "aj_bufio.h"
+#include "aj_std.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_crc16.h"
+
+/*
+ * Policy and priority registered for a message id, the entry is unused if both are the defaults
+ */
+typedef struct {
+    uint32_t msgId;
+    uint32_t interval;   /* Minimum interval for a state signal */
+    uint8_t policy;
+    uint8_t priority;
+} MsgPolicy;
+
+static MsgPolicy policies[AJ_TX_QUEUE_MAX_POLICIES];
+
+#define IN_USE(p)  ((p)->policy || (p)->priority)
+
+/*
+ * Find the entry for a message id, optionally claiming an unused entry for it
+ */
+static MsgPolicy* FindPolicy(uint32_t msgId, uint8_t create)
+{
+    MsgPolicy* unused = NULL;
+    size_t i;
+
+    for (i = 0; i < ArraySize(policies); ++i) {
+        if (IN_USE(&policies[i]) && (policies[i].msgId == msgId)) {
+            return &policies[i];
+        }
+        if (!unused && !IN_USE(&policies[i])) {
+            unused = &policies[i];
+        }
+    }
+    if (create && unused) {
+        unused->msgId = msgId;
+        return unused;
+    }
+    return NULL;
+}
+
+AJ_Status AJ_TxQueueSetPolicy(uint32_t msgId, uint8_t policy)
+{
+    MsgPolicy* entry = FindPolicy(msgId, policy != AJ_TXQ_WAIT);
+
+    if (entry) {
+        entry->policy = policy;
+        return AJ_OK;
+    }
+    return (policy == AJ_TXQ_WAIT) ? AJ_OK : AJ_ERR_RESOURCES;
+}
+
+AJ_Status AJ_TxQueueSetStateSignal(uint32_t msgId, uint32_t minInterval)
+{
+    MsgPolicy* entry = FindPolicy(msgId, TRUE);
+
+    if (!entry) {
+        return AJ_ERR_RESOURCES;
+    }
+    entry->policy = AJ_TXQ_LATEST;
+    entry->interval = minInterval;
+    return AJ_OK;
+}
+
+AJ_Status AJ_TxQueueSetPriority(uint32_t msgId, uint8_t priority)
+{
+    MsgPolicy* entry;
+
+    if (priority > AJ_TXQ_PRIORITY_CONTROL) {
+        return AJ_ERR_INVALID;
+    }
+    entry = FindPolicy(msgId, priority != AJ_TXQ_PRIORITY_DEFAULT);
+    if (entry) {
+        entry->priority = priority;
+        return AJ_OK;
+    }
+    return (priority == AJ_TXQ_PRIORITY_DEFAULT) ? AJ_OK : AJ_ERR_RESOURCES;
+}
+
+#if AJ_TX_QUEUE_SIZE
+
+/*
+ * A message in the queue, messages are stored back to back in the order they will be written
+ */
+typedef struct {
+    uint32_t msgId;     /* Message id of the message */
+    uint32_t offset;    /* Offset of the message in the queue */
+    uint32_t len;       /* Bytes of the message in the queue */
+    uint8_t policy;     /* Policy for the message */
+    uint8_t priority;   /* Priority of the message */
+    uint8_t open;       /* The rest of the message has not been delivered yet */
+    uint8_t state;      /* One more than the index of the state for a state signal */
+} QueueEntry;
+
+/*
+ * Latest value of a state signal. The key is the message id, the session and the object path, the
+ * CRC of the path is compared first. A signal that arrives before the minimum interval has passed
+ * is held here until it has.
+ */
+typedef struct {
+    uint32_t msgId;
+    uint32_t sessionId;
+    uint16_t pathCrc;
+    char path[AJ_TX_QUEUE_STATE_PATH];
+    uint8_t inUse;
+    uint8_t priority;              /* Priority of the held signal */
+    uint32_t interval;             /* Minimum interval between signals */
+    uint32_t lastQueued;           /* When a signal was last queued */
+    uint16_t held;                 /* Length of the held signal or zero */
+    uint8_t data[AJ_TX_QUEUE_STATE_SIZE];
+} StateSignal;
+
+/*
+ * The part of the queue that messages other than control messages can use
+ */
+#define MAX_QUEUED_BYTES  (AJ_TX_QUEUE_SIZE - AJ_TX_QUEUE_RESERVE)
+#define MAX_QUEUED_MSGS   (AJ_TX_QUEUE_MAX_MSGS - AJ_TX_QUEUE_RESERVE_MSGS)
+
+static struct {
+    AJ_IOBuffer* ioBuf;            /* The tx buffer being queued or NULL */
+    AJ_TxFunc send;                /* The send function the queue replaced */
+    AJ_TxQueueCallback callback;   /* Called when the queue becomes congested and drains again */
+    uint32_t highWater;            /* Bytes above which the queue is congested */
+    uint8_t congested;             /* The queue is above the high watermark */
+    uint32_t len;                  /* Bytes in the queue */
+    uint32_t written;              /* Bytes at the start of the queue that have been written */
+    uint16_t numEntries;
+    QueueEntry entries[AJ_TX_QUEUE_MAX_MSGS];
+    AJ_TxQueueStats stats;
+    AJ_Time clock;                 /* Started with the queue, times state signals */
+    uint16_t numHeld;              /* Number of held state signals */
+    StateSignal states[AJ_TX_QUEUE_MAX_STATES];
+    uint8_t data[AJ_TX_QUEUE_SIZE];
+} txq;
+
+static uint8_t PolicyFor(uint32_t msgId)
+{
+    MsgPolicy* entry = FindPolicy(msgId, FALSE);
+    return entry ? entry->policy : AJ_TXQ_WAIT;
+}
+
+/*
+ * Replies, errors and link probes are control messages unless a priority has been set
+ */
+static uint8_t PriorityFor(uint32_t msgId, uint8_t msgType)
+{
+    MsgPolicy* entry = FindPolicy(msgId, FALSE);
+
+    if (entry && entry->priority) {
+        return entry->priority;
+    }
+    if ((msgType == AJ_MSG_METHOD_RET) || (msgType == AJ_MSG_ERROR) || (msgId == AJ_SIGNAL_PROBE_REQ) || (msgId == AJ_SIGNAL_PROBE_ACK)) {
+        return AJ_TXQ_PRIORITY_CONTROL;
+    }
+    return AJ_TXQ_PRIORITY_NORMAL;
+}
+
+static QueueEntry* OpenEntry(void)
+{
+    if (txq.numEntries && txq.entries[txq.numEntries - 1].open) {
+        return &txq.entries[txq.numEntries - 1];
+    } else {
+        return NULL;
+    }
+}
+
+/*
+ * Check there is room for some more bytes, either adding to the open message or as a new message.
+ * Only control messages can use the reserved part of the queue.
+ */
+static uint8_t Fits(uint32_t len, uint8_t priority)
+{
+    uint8_t control = (priority == AJ_TXQ_PRIORITY_CONTROL);
+
+    if ((txq.len + len) > (control ? AJ_TX_QUEUE_SIZE : MAX_QUEUED_BYTES)) {
+        return FALSE;
+    }
+    return OpenEntry() || (txq.numEntries < (control ? AJ_TX_QUEUE_MAX_MSGS : MAX_QUEUED_MSGS));
+}
+
+static void CheckWatermark(void)
+{
+    uint32_t depth = txq.len - txq.written;
+
+    txq.stats.depth = depth;
+    txq.stats.messages = txq.numEntries;
+    if (depth > txq.stats.maxDepth) {
+        txq.stats.maxDepth = depth;
+    }
+    /*
+     * Running out of entries also counts as congestion
+     */
+    if (!txq.congested && ((depth > txq.highWater) || (txq.numEntries >= MAX_QUEUED_MSGS))) {
+        txq.congested = TRUE;
+        if (txq.callback) {
+            txq.callback(depth, TRUE);
+        }
+    } else if (txq.congested && (depth <= (txq.highWater / 2)) && (txq.numEntries <= (MAX_QUEUED_MSGS / 2))) {
+        txq.congested = FALSE;
+        if (txq.callback) {
+            txq.callback(depth, FALSE);
+        }
+    }
+}
+
+/*
+ * Remove messages from the queue closing up the gap they leave
+ */
+static void RemoveEntries(uint16_t first, uint16_t count)
+{
+    QueueEntry* entry = &txq.entries[first];
+    uint32_t start = entry->offset;
+    uint32_t gap = (entry[count - 1].offset + entry[count - 1].len) - start;
+    uint16_t i;
+
+    memmove(txq.data + start, txq.data + start + gap, txq.len - start - gap);
+    txq.len -= gap;
+    if (start < txq.written) {
+        txq.written -= gap;
+    }
+    txq.numEntries -= count;
+    memmove(entry, entry + count, (txq.numEntries - first) * sizeof(QueueEntry));
+    for (i = first; i < txq.numEntries; ++i) {
+        txq.entries[i].offset -= gap;
+    }
+}
+
+/*
+ * Write queued bytes, returns AJ_ERR_BUSY if the transport would block before the queue is empty
+ */
+static AJ_Status Write(uint8_t flags)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer buf;
+    uint16_t done;
+
+    while ((status == AJ_OK) && (txq.written < txq.len)) {
+        uint32_t tx = min(txq.len - txq.written, 0xFFFF);
+
+        AJ_IOBufInit(&buf, txq.data + txq.written, tx, AJ_IO_BUF_TX, txq.ioBuf->context);
+        buf.writePtr += tx;
+        buf.flags = flags;
+        //#pragma calls = AJ_Net_Send
+        status = txq.send(&buf);
+        if (status == AJ_OK) {
+            /*
+             * Send functions reset the buffer when everything was sent
+             */
+            if (AJ_IO_BUF_AVAIL(&buf)) {
+                tx = (uint32_t)(buf.readPtr - buf.bufStart);
+            }
+            if (!tx) {
+                status = AJ_ERR_BUSY;
+            }
+            txq.written += tx;
+        }
+    }
+    /*
+     * Remove the messages that have been completely written
+     */
+    for (done = 0; done < txq.numEntries; ++done) {
+        QueueEntry* entry = &txq.entries[done];
+        if (entry->open || ((entry->offset + entry->len) > txq.written)) {
+            break;
+        }
+    }
+    if (done) {
+        RemoveEntries(0, done);
+    }
+    CheckWatermark();
+    return status;
+}
+
+/*
+ * Add bytes to the open message or add a new message ahead of any lower priority messages that
+ * have not started to be written
+ */
+static QueueEntry* Append(AJ_IOBuffer* ioBuf, uint32_t msgId, uint8_t policy, uint8_t priority, uint8_t open)
+{
+    QueueEntry* entry = OpenEntry();
+    uint32_t len = AJ_IO_BUF_AVAIL(ioBuf);
+    uint32_t offset = txq.len;
+
+    if (!entry) {
+        uint16_t pos = txq.numEntries;
+        uint16_t i;
+
+        while (pos) {
+            entry = &txq.entries[pos - 1];
+            if ((entry->priority >= priority) || entry->open || (entry->offset < txq.written)) {
+                break;
+            }
+            --pos;
+        }
+        if (pos < txq.numEntries) {
+            offset = txq.entries[pos].offset;
+            memmove(txq.data + offset + len, txq.data + offset, txq.len - offset);
+            memmove(&txq.entries[pos + 1], &txq.entries[pos], (txq.numEntries - pos) * sizeof(QueueEntry));
+            for (i = pos + 1; i <= txq.numEntries; ++i) {
+                txq.entries[i].offset += len;
+            }
+            ++txq.stats.expedited;
+        }
+        ++txq.numEntries;
+        entry = &txq.entries[pos];
+        entry->offset = offset;
+        entry->len = 0;
+        entry->state = 0;
+    }
+    entry->msgId = msgId;
+    entry->policy = policy;
+    entry->priority = priority;
+    entry->open = open;
+    memcpy(txq.data + offset, ioBuf->readPtr, len);
+    entry->len += len;
+    txq.len += len;
+    AJ_IO_BUF_RESET(ioBuf);
+    return entry;
+}
+
+/*
+ * Queue bytes that are part of a message, waiting for room if necessary
+ */
+static AJ_Status Enqueue(AJ_IOBuffer* ioBuf, uint32_t msgId, uint8_t policy, uint8_t priority, uint8_t open)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t len = AJ_IO_BUF_AVAIL(ioBuf);
+
+    if (!Fits(len, priority)) {
+        ++txq.stats.waits;
+        status = Write(0);
+    }
+    if (status == AJ_OK) {
+        if (Fits(len, priority)) {
+            Append(ioBuf, msgId, policy, priority, open);
+            status = Write(AJ_IO_BUF_NONBLOCK);
+            if (status == AJ_ERR_BUSY) {
+                status = AJ_OK;
+            }
+        } else {
+            QueueEntry* entry = OpenEntry();
+            /*
+             * Too big for the queue but everything queued has been written
+             */
+            if (entry) {
+                entry->open = open;
+            }
+            ioBuf->flags = 0;
+            //#pragma calls = AJ_Net_Send
+            status = txq.send(ioBuf);
+            Write(AJ_IO_BUF_NONBLOCK);
+        }
+    }
+    return status;
+}
+
+/*
+ * Find a queued signal that has not started to be written
+ */
+static int32_t FindUnwritten(uint32_t msgId, uint8_t newest)
+{
+    int32_t i;
+
+    for (i = 0; i < txq.numEntries; ++i) {
+        int32_t n = newest ? (txq.numEntries - 1 - i) : i;
+        QueueEntry* entry = &txq.entries[n];
+        if ((entry->msgId == msgId) && !entry->open && (entry->offset >= txq.written)) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Apply the policy for a signal when the queue is congested. Returns AJ_ERR_NO_MATCH if the
+ * signal should be queued after all.
+ */
+static AJ_Status ApplyPolicy(AJ_IOBuffer* ioBuf, uint32_t msgId, uint8_t policy, uint8_t priority)
+{
+    uint32_t len = AJ_IO_BUF_AVAIL(ioBuf);
+    int32_t i;
+
+    switch (policy) {
+    case AJ_TXQ_BUSY:
+        ++txq.stats.busy;
+        AJ_IO_BUF_RESET(ioBuf);
+        return AJ_ERR_BUSY;
+
+    case AJ_TXQ_DROP_OLDEST:
+        i = FindUnwritten(msgId, FALSE);
+        if (i >= 0) {
+            RemoveEntries((uint16_t)i, 1);
+            ++txq.stats.dropped;
+        }
+        if (Fits(len, priority)) {
+            return AJ_ERR_NO_MATCH;
+        }
+        break;
+
+    case AJ_TXQ_COALESCE:
+        i = FindUnwritten(msgId, TRUE);
+        if (i >= 0) {
+            QueueEntry* entry = &txq.entries[i];
+            if (entry->len == len) {
+                memcpy(txq.data + entry->offset, ioBuf->readPtr, len);
+                AJ_IO_BUF_RESET(ioBuf);
+                ++txq.stats.coalesced;
+                txq.stats.coalescedBytes += len;
+                return AJ_OK;
+            }
+            if ((txq.len - entry->len + len) <= MAX_QUEUED_BYTES) {
+                txq.stats.coalescedBytes += entry->len;
+                RemoveEntries((uint16_t)i, 1);
+                Append(ioBuf, msgId, policy, priority, FALSE);
+                ++txq.stats.coalesced;
+                return AJ_OK;
+            }
+        } else if (Fits(len, priority)) {
+            return AJ_ERR_NO_MATCH;
+        }
+        break;
+    }
+    ++txq.stats.dropped;
+    AJ_IO_BUF_RESET(ioBuf);
+    return AJ_OK;
+}
+
+/*
+ * Find the state for a signal, if there is no state for the signal a state that is not holding
+ * or queueing a signal is reused
+ */
+static StateSignal* FindState(AJ_Message* msg, uint32_t now, uint32_t interval)
+{
+    StateSignal* reuse = NULL;
+    const char* path = msg->objPath ? msg->objPath : "";
+    size_t pathLen = strlen(path);
+    uint16_t crc = 0;
+    uint16_t i;
+
+    if (pathLen >= AJ_TX_QUEUE_STATE_PATH) {
+        return NULL;
+    }
+    AJ_CRC16_Compute((const uint8_t*)path, (uint16_t)pathLen, &crc);
+    for (i = 0; i < AJ_TX_QUEUE_MAX_STATES; ++i) {
+        StateSignal* state = &txq.states[i];
+        if (state->inUse && (state->msgId == msg->msgId) && (state->sessionId == msg->sessionId) && (state->pathCrc == crc) && (strcmp(state->path, path) == 0)) {
+            return state;
+        }
+        if (!state->held && (!reuse || !state->inUse || (reuse->inUse && ((int32_t)(state->lastQueued - reuse->lastQueued) < 0)))) {
+            reuse = state;
+        }
+    }
+    /*
+     * A state with a queued signal that has not been written cannot be reused
+     */
+    if (reuse && reuse->inUse) {
+        for (i = 0; i < txq.numEntries; ++i) {
+            if ((txq.entries[i].state == (uint8_t)(reuse - txq.states) + 1) && (txq.entries[i].offset >= txq.written)) {
+                return NULL;
+            }
+        }
+    }
+    if (reuse) {
+        reuse->msgId = msg->msgId;
+        reuse->sessionId = msg->sessionId;
+        reuse->pathCrc = crc;
+        memcpy(reuse->path, path, pathLen + 1);
+        reuse->inUse = TRUE;
+        /*
+         * The first signal does not have to wait
+         */
+        reuse->lastQueued = now - interval;
+    }
+    return reuse;
+}
+
+/*
+ * Queue a state signal if there is room
+ */
+static uint8_t QueueState(StateSignal* state, AJ_IOBuffer* ioBuf, uint32_t now)
+{
+    QueueEntry* entry;
+
+    if (!Fits(AJ_IO_BUF_AVAIL(ioBuf), state->priority)) {
+        return FALSE;
+    }
+    entry = Append(ioBuf, state->msgId, AJ_TXQ_LATEST, state->priority, FALSE);
+    entry->state = (uint8_t)(state - txq.states) + 1;
+    state->lastQueued = now;
+    return TRUE;
+}
+
+/*
+ * Queue held state signals once their interval has passed or unconditionally if forced
+ */
+static void ReleaseHeld(uint8_t force)
+{
+    uint32_t now = AJ_GetElapsedTime(&txq.clock, TRUE);
+    uint16_t i;
+
+    for (i = 0; txq.numHeld && (i < AJ_TX_QUEUE_MAX_STATES); ++i) {
+        StateSignal* state = &txq.states[i];
+        if (state->held && (force || ((now - state->lastQueued) >= state->interval))) {
+            AJ_IOBuffer buf;
+            AJ_IOBufInit(&buf, state->data, state->held, AJ_IO_BUF_TX, NULL);
+            buf.writePtr += state->held;
+            if (QueueState(state, &buf, now)) {
+                state->held = 0;
+                --txq.numHeld;
+            }
+        }
+    }
+}
+
+/*
+ * Replace the unwritten signal for a state signal, queue it if the interval has passed or else hold
+ * it. Returns AJ_ERR_NO_MATCH if the signal should be queued like any other signal.
+ */
+static AJ_Status QueueLatest(AJ_IOBuffer* ioBuf, AJ_Message* msg, uint8_t priority)
+{
+    uint32_t interval = FindPolicy(msg->msgId, FALSE)->interval;
+    uint32_t now = AJ_GetElapsedTime(&txq.clock, TRUE);
+    StateSignal* state = FindState(msg, now, interval);
+    uint32_t len = AJ_IO_BUF_AVAIL(ioBuf);
+    uint16_t i;
+
+    if (!state) {
+        return AJ_ERR_NO_MATCH;
+    }
+    state->interval = interval;
+    state->priority = priority;
+    if (state->held) {
+        ++txq.stats.coalesced;
+        txq.stats.coalescedBytes += state->held;
+        state->held = 0;
+        --txq.numHeld;
+    } else {
+        for (i = 0; i < txq.numEntries; ++i) {
+            QueueEntry* entry = &txq.entries[i];
+            if ((entry->state == (uint8_t)(state - txq.states) + 1) && !entry->open && (entry->offset >= txq.written)) {
+                ++txq.stats.coalesced;
+                txq.stats.coalescedBytes += entry->len;
+                if (entry->len == len) {
+                    memcpy(txq.data + entry->offset, ioBuf->readPtr, len);
+                    AJ_IO_BUF_RESET(ioBuf);
+                    return AJ_OK;
+                }
+                RemoveEntries(i, 1);
+                /*
+                 * The replacement takes the place of the old signal so the interval still applies
+                 */
+                if (QueueState(state, ioBuf, state->lastQueued)) {
+                    return AJ_OK;
+                }
+                break;
+            }
+        }
+    }
+    if (((now - state->lastQueued) >= state->interval) && QueueState(state, ioBuf, now)) {
+        return AJ_OK;
+    }
+    if (len > AJ_TX_QUEUE_STATE_SIZE) {
+        return AJ_ERR_NO_MATCH;
+    }
+    memcpy(state->data, ioBuf->readPtr, len);
+    state->held = (uint16_t)len;
+    ++txq.numHeld;
+    AJ_IO_BUF_RESET(ioBuf);
+    return AJ_OK;
+}
+
+/*
+ * Replaces the send function of the tx buffer, this is called for the parts of a message that
+ * does not fit in the I/O buffer.
+ */
+static AJ_Status QueueSend(AJ_IOBuffer* ioBuf)
+{
+    return Enqueue(ioBuf, AJ_INVALID_MSG_ID, AJ_TXQ_WAIT, AJ_TXQ_PRIORITY_NORMAL, TRUE);
+}
+
+AJ_Status AJ_TxQueueMsg(AJ_Message* msg)
+{
+    AJ_IOBuffer* ioBuf = txq.ioBuf;
+    uint8_t policy = AJ_TXQ_WAIT;
+    uint8_t priority;
+    AJ_Status status;
+
+    /*
+     * Only signals that were marshaled in one piece have policies. The header of a message that
+     * was delivered in pieces has already been queued so only its message id is known.
+     */
+    if (msg->hdr && (msg->hdr->msgType == AJ_MSG_SIGNAL) && !OpenEntry()) {
+        policy = PolicyFor(msg->msgId);
+    }
+    priority = PriorityFor(msg->msgId, msg->hdr ? msg->hdr->msgType : 0);
+    if (txq.numHeld) {
+        ReleaseHeld(FALSE);
+    }
+    /*
+     * Make room by writing what we can
+     */
+    status = Write(AJ_IO_BUF_NONBLOCK);
+    if (status == AJ_ERR_BUSY) {
+        status = AJ_OK;
+    }
+    if ((status == AJ_OK) && (policy == AJ_TXQ_LATEST)) {
+        status = QueueLatest(ioBuf, msg, priority);
+        if (status != AJ_ERR_NO_MATCH) {
+            CheckWatermark();
+            return status;
+        }
+        /*
+         * Too big to hold or no state available so the signal waits like any other message
+         */
+        status = AJ_OK;
+        policy = AJ_TXQ_WAIT;
+    }
+    if ((status == AJ_OK) && (policy != AJ_TXQ_WAIT) && (txq.congested || !Fits(AJ_IO_BUF_AVAIL(ioBuf), priority))) {
+        status = ApplyPolicy(ioBuf, msg->msgId, policy, priority);
+        if (status != AJ_ERR_NO_MATCH) {
+            CheckWatermark();
+            return status;
+        }
+        status = AJ_OK;
+    }
+    if (status == AJ_OK) {
+        status = Enqueue(ioBuf, msg->msgId, policy, priority, FALSE);
+    }
+    return status;
+}
+
+AJ_Status AJ_TxQueueStart(AJ_BusAttachment* bus, uint32_t highWater, AJ_TxQueueCallback callback)
+{
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    AJ_Status status;
+
+    if (txq.ioBuf) {
+        return (txq.ioBuf == ioBuf) ? AJ_OK : AJ_ERR_RESOURCES;
+    }
+    status = AJ_UncorkMsgs(bus);
+    if (status == AJ_OK) {
+        memset(&txq, 0, sizeof(txq));
+        txq.ioBuf = ioBuf;
+        txq.send = ioBuf->send;
+        txq.highWater = highWater ? highWater : (AJ_TX_QUEUE_SIZE / 4) * 3;
+        txq.callback = callback;
+        AJ_InitTimer(&txq.clock);
+        ioBuf->send = QueueSend;
+    }
+    return status;
+}
+
+AJ_Status AJ_TxQueueStop(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+
+    if (AJ_TxQueueActive(bus)) {
+        ReleaseHeld(TRUE);
+        status = Write(0);
+        /*
+         * Held signals that did not fit before are written now there is room
+         */
+        if ((status == AJ_OK) && txq.numHeld) {
+            ReleaseHeld(TRUE);
+            status = Write(0);
+        }
+        AJ_ReleaseTxQueue(bus);
+    }
+    return status;
+}
+
+AJ_Status AJ_TxQueueDrain(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+
+    if (AJ_TxQueueActive(bus)) {
+        if (txq.numHeld) {
+            ReleaseHeld(FALSE);
+        }
+        status = Write(AJ_IO_BUF_NONBLOCK);
+        /*
+         * Held state signals still have to be written
+         */
+        if ((status == AJ_OK) && txq.numHeld) {
+            status = AJ_ERR_BUSY;
+        }
+    }
+    return status;
+}
+
+void AJ_TxQueueGetStats(AJ_TxQueueStats* stats)
+{
+    *stats = txq.stats;
+}
+
+uint8_t AJ_TxQueueActive(AJ_BusAttachment* bus)
+{
+    return txq.ioBuf && (txq.ioBuf == &bus->sock.tx);
+}
+
+void AJ_ReleaseTxQueue(AJ_BusAttachment* bus)
+{
+    if (AJ_TxQueueActive(bus)) {
+        txq.ioBuf->send = txq.send;
+        txq.ioBuf = NULL;
+        txq.len = 0;
+        txq.written = 0;
+        txq.numEntries = 0;
+        txq.numHeld = 0;
+        txq.congested = FALSE;
+        memset(txq.states, 0, sizeof(txq.states));
+    }
+}
+
+#else
+
+AJ_Status AJ_TxQueueMsg(AJ_Message* msg)
+{
+    return msg->bus->sock.tx.send(&msg->bus->sock.tx);
+}
+
+AJ_Status AJ_TxQueueStart(AJ_BusAttachment* bus, uint32_t highWater, AJ_TxQueueCallback callback)
+{
+    return AJ_ERR_RESOURCES;
+}
+
+AJ_Status AJ_TxQueueStop(AJ_BusAttachment* bus)
+{
+    return AJ_OK;
+}
+
+AJ_Status AJ_TxQueueDrain(AJ_BusAttachment* bus)
+{
+    return AJ_OK;
+}
+
+void AJ_TxQueueGetStats(AJ_TxQueueStats* stats)
+{
+    memset(stats, 0, sizeof(AJ_TxQueueStats));
+}
+
+uint8_t AJ_TxQueueActive(AJ_BusAttachment* bus)
+{
+    return FALSE;
+}
+
+void AJ_ReleaseTxQueue(AJ_BusAttachment* bus)
+{
+}
+
+#endif
@@ -35,7 +35,6 @@
 
 #define BITRATE B115200
 #define AJ_SERIAL_WINDOW_SIZE   4
-#define AJ_SERIAL_ENABLE_CRC    1
 #define AJ_SERIAL_PACKET_SIZE   1000 + AJ_SERIAL_HDR_LEN
 
 AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
@@ -88,7 +87,7 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 static uint8_t rxData[1024];
 static uint8_t txData[1024];
 
-AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr)
+AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr, uint32_t timeout)
 {
     int ret = 0;
 
@@ -131,7 +130,7 @@ void AJ_Net_MCastDown(AJ_NetSocket* netSock)
 
 AJ_Status AJ_Net_Up()
 {
-    AJ_Status status = AJ_SerialInit("/dev/ttyUSB0", BITRATE, AJ_SERIAL_WINDOW_SIZE, AJ_SERIAL_ENABLE_CRC, AJ_SERIAL_PACKET_SIZE);
+    AJ_Status status = AJ_SerialInit("/dev/ttyUSB0", BITRATE, AJ_SERIAL_WINDOW_SIZE, AJ_SERIAL_PACKET_SIZE);
     AJ_Sleep(3000);  // wait a while for the link configuration to complete
     return status;
 }
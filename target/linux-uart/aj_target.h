@@ -53,6 +53,13 @@
     #define AJ_SERIAL_CONNECTION   TRUE
 #endif
 
+/*
+ * The I/O thread backend writes every queued buffer with one writev
+ */
+#ifdef AJ_SERIAL_IO_THREAD
+    #define AJ_SERIO_TX_DEPTH  MAX_WINDOW_SIZE
+#endif
+
 #ifndef NDEBUG
     #define AJ_Printf(fmat, ...) \
     do { printf(fmat, ## __VA_ARGS__); } while (0)
@@ -24,6 +24,7 @@
 #include "aj_semaphore.h"
 #include <semaphore.h>
 #include <errno.h>
+#include <time.h>
 
 const uint32_t AJ_SEMAPHORE_TAKEN = 1;
 
@@ -37,8 +38,11 @@ AJ_Semaphore* AJ_SemaphoreCreate(char* name,
     AJ_Semaphore* ret = (AJ_Semaphore*) AJ_Malloc(sizeof(AJ_Semaphore));
     if (ret) {
         sem_init(&ret->sem, 0, count);
-        ret->name = (char*) AJ_Malloc(strlen(name) + 1);
-        strcpy(ret->name, name);
+        ret->name = NULL;
+        if (name) {
+            ret->name = (char*) AJ_Malloc(strlen(name) + 1);
+            strcpy(ret->name, name);
+        }
     }
     return ret;
 }
@@ -76,8 +80,21 @@ AJ_Status AJ_SemaphoreWaitTimed(AJ_Semaphore* sem,
     if (sem && sem->name) {
         AJ_Printf("AJ_SemaphoreWaitTimed %s\n", sem->name);
     }
-    assert(0);
-    return AJ_ERR_UNEXPECTED;
+
+    struct timespec ts;
+    int s;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000;
+    }
+    while ((s = sem_timedwait(&sem->sem, &ts)) == -1 && errno == EINTR) {
+        continue; // the wait was interrupted, probably by the timer, so wait again.
+    }
+
+    return (s == 0) ? AJ_OK : AJ_ERR_TIMEOUT;
 }
 
 
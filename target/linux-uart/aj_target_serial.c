@@ -19,12 +19,20 @@
 
 #include "aj_target.h"
 #include "aj_status.h"
+#include "aj_serial.h"
+#include "aj_serio.h"
 #include "aj_serial_rx.h"
 #include "aj_serial_tx.h"
 #include "aj_debug.h"
 
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
+#ifdef AJ_SERIAL_IO_THREAD
+#include <pthread.h>
+#include <sys/uio.h>
+#endif
 
 #ifdef AJ_DEBUG_SERIAL_TARGET
 #define AJ_DebugDumpSerialRX(a, b, c) AJ_DumpBytes(a, b, c)
@@ -35,41 +43,514 @@
 #endif
 
 
-int g_fdRead;
+int g_fdRead = -1;
+
+void __AJ_TX(uint8_t* buf, uint32_t len);
+
+static AJ_SerIORxCompleteFunc rxCallback;
+static AJ_SerIOTxCompleteFunc txCallback;
+static AJ_SerialTxFunc txSerialTransmit = __AJ_TX;
+
+/*
+ * The buffer the next read goes into, set by AJ_RX
+ */
+static uint8_t* volatile rxBuffer;
+static volatile uint32_t rxBufferLen;
+
+void AJ_SetRxCB(AJ_SerIORxCompleteFunc rx_cb)
+{
+    rxCallback = rx_cb;
+}
+
+void AJ_SetTxCB(AJ_SerIOTxCompleteFunc tx_cb)
+{
+    txCallback = tx_cb;
+}
+
+void AJ_SetTxSerialTransmit(AJ_SerialTxFunc tx_func)
+{
+    txSerialTransmit = tx_func;
+}
+
+/*
+ * How long to wait for room in the tty output buffer before trying the write again
+ */
+#define TX_WAIT_MS  100
+
+/*
+ * The tty is non-blocking so when its output buffer is full wait until it can take more rather
+ * than spinning on EAGAIN
+ */
+static void WaitWritable(void)
+{
+    struct pollfd fd;
+
+    fd.fd = g_fdRead;
+    fd.events = POLLOUT;
+    fd.revents = 0;
+    poll(&fd, 1, TX_WAIT_MS);
+}
+
+/**
+ * Write a buffer to the tty, this is the default serial transmit function.
+ */
+void __AJ_TX(uint8_t* buf, uint32_t len)
+{
+    AJ_DebugDumpSerialTX("AJ_UART_Tx", buf, len);
+    while (len) {
+        ssize_t ret = write(g_fdRead, buf, len);
+        if (ret < 0) {
+            if (errno == EAGAIN) {
+                WaitWritable();
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            AJ_Printf("Error writing!!!\n");
+            return;
+        }
+        buf += ret;
+        len -= ret;
+    }
+}
+
+AJ_Status AJ_UART_Tx(uint8_t* buffer, uint16_t len)
+{
+    __AJ_TX(buffer, len);
+    return AJ_OK;
+}
+
+#ifndef AJ_SERIAL_IO_THREAD
+
+/*
+ * SIGIO backend: reads happen in the signal handler, writes are done synchronously
+ * by the state machine.
+ */
 
 static struct sigaction saHandler;
 
+/*
+ * Set while the receive callback runs in the signal handler, the callback pauses
+ * and resumes the receiver itself.
+ */
+static volatile sig_atomic_t inSignalHandler;
+
+/*
+ * The buffer waiting to be written and a flag that stops the transmit callback from
+ * recursing into AJ_ResumeTX
+ */
+static uint8_t* volatile txBuffer;
+static volatile uint32_t txBufferLen;
+static volatile uint8_t txRunning;
+
+static void BlockSIGIO(int how)
+{
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGIO);
+    sigprocmask(how, &set, NULL);
+}
+
 void AJ_Serial_SignalHandlerIO(int status)
 {
-    //Disable interrupt
-    sigaction(SIGIO, NULL, &saHandler);
-    uint8_t buf[128];
-    int16_t bytes;
-
-    fd_set fds;
-    int maxFd = -1;
-    int rc = 0;
-    struct timeval tv = { 0, 0 };
-
-    FD_ZERO(&fds);
-    FD_SET((int)g_fdRead, &fds);
-    maxFd = max(maxFd, g_fdRead);
-
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    if (rc > 0) {
-        bytes = read(g_fdRead, buf, sizeof(buf));
-        if (bytes < 0) {
-            AJ_Printf("Error reading!!!\n");
-        } else if (bytes > 0) {
-            AJ_DebugDumpSerialRX("AJ_UART_Rx", buf, bytes);
-            OI_UART_RxComplete(buf, bytes);
+    inSignalHandler = TRUE;
+    /*
+     * Keep reading while there is a buffer to read into, if we run out of buffers the
+     * data stays in the tty until AJ_ResumeRX is called.
+     */
+    while (rxBuffer) {
+        uint8_t* buf = rxBuffer;
+        ssize_t bytes = read(g_fdRead, buf, rxBufferLen);
+        if (bytes <= 0) {
+            if ((bytes < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+                AJ_Printf("Error reading!!!\n");
+            }
+            break;
         }
+        AJ_DebugDumpSerialRX("AJ_UART_Rx", buf, bytes);
+        rxBuffer = NULL;
+        rxCallback(buf, bytes);
     }
-    //Re-enable interrupt
+    inSignalHandler = FALSE;
+}
+
+static AJ_Status SerialIOStart(void)
+{
+    // set up a signal handler to do something when serial port data arrives
+    memset(&saHandler, 0, sizeof(saHandler));
+    saHandler.sa_handler = AJ_Serial_SignalHandlerIO;
+    saHandler.sa_flags = SA_RESTART;
+    sigemptyset(&saHandler.sa_mask);
+    sigaction(SIGIO, &saHandler, NULL);
+
+    fcntl(g_fdRead, F_SETOWN, getpid()); // let this process receive SIGIO.
+    fcntl(g_fdRead, F_SETFL, FASYNC | O_NONBLOCK); // let things happen async
+    return AJ_OK;
+}
+
+AJ_Status AJ_SerialIOShutdown(void)
+{
+    BlockSIGIO(SIG_BLOCK);
+    fcntl(g_fdRead, F_SETFL, 0);
+    saHandler.sa_handler = SIG_IGN;
     sigaction(SIGIO, &saHandler, NULL);
+    rxBuffer = NULL;
+    txBuffer = NULL;
+    BlockSIGIO(SIG_UNBLOCK);
+    return AJ_OK;
+}
+
+void AJ_RX(uint8_t* buf, uint32_t len)
+{
+    rxBufferLen = len;
+    rxBuffer = buf;
+}
+
+void AJ_PauseRX()
+{
+    if (!inSignalHandler) {
+        BlockSIGIO(SIG_BLOCK);
+    }
+}
+
+void AJ_ResumeRX()
+{
+    if (!inSignalHandler) {
+        /*
+         * SIGIO is only raised when data arrives so pick up anything that arrived
+         * while there was no buffer to read into.
+         */
+        BlockSIGIO(SIG_BLOCK);
+        AJ_Serial_SignalHandlerIO(SIGIO);
+        BlockSIGIO(SIG_UNBLOCK);
+    }
+}
+
+void AJ_TX(uint8_t* buf, uint32_t len)
+{
+    txBufferLen = len;
+    txBuffer = buf;
+}
+
+void AJ_PauseTX()
+{
+}
 
+void AJ_ResumeTX()
+{
+    if (txRunning) {
+        return;
+    }
+    txRunning = TRUE;
+    if (!txBuffer) {
+        /*
+         * Nothing queued, give the transmit callback a chance to queue something
+         */
+        txCallback(NULL, 0);
+    }
+    while (txBuffer) {
+        uint8_t* buf = txBuffer;
+        uint32_t len = txBufferLen;
+        txBuffer = NULL;
+        txSerialTransmit(buf, len);
+        txCallback(buf, len);
+    }
+    txRunning = FALSE;
 }
 
+#else /* AJ_SERIAL_IO_THREAD */
+
+/*
+ * Thread backend: a reader thread blocks in poll/read and a writer thread writes all the
+ * queued buffers with a single writev. The callbacks run on these threads with the lock
+ * for their direction held, pausing a direction defers its callbacks.
+ */
+
+static pthread_t rxThread;
+static pthread_t txThread;
+static pthread_mutex_t rxLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t txLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rxCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t txCond = PTHREAD_COND_INITIALIZER;
+static uint8_t rxPaused;
+static uint8_t txPaused;
+static uint8_t txKick;
+static volatile uint8_t ioRunning;
+
+/*
+ * Written to wake the reader thread from poll on shutdown
+ */
+static int wakeFds[2] = { -1, -1 };
+
+typedef struct _TxEntry {
+    uint8_t* buf;
+    uint32_t len;
+} TxEntry;
+
+static TxEntry txEntries[AJ_SERIO_TX_DEPTH];
+static uint32_t txHead;
+static uint32_t txTail;
+
+#define ON_THREAD(t)  (ioRunning && pthread_equal(pthread_self(), (t)))
+
+static void* SerialReadThread(void* arg)
+{
+    struct pollfd fds[2];
+
+    fds[0].fd = g_fdRead;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFds[0];
+    fds[1].events = POLLIN;
+
+    pthread_mutex_lock(&rxLock);
+    while (ioRunning) {
+        uint8_t* buf = rxBuffer;
+        uint32_t len = rxBufferLen;
+        ssize_t bytes = 0;
+
+        if (!buf) {
+            pthread_cond_wait(&rxCond, &rxLock);
+            continue;
+        }
+        /*
+         * Nobody else touches the receive buffer until the callback has been called so
+         * the lock is not held while we wait for data.
+         */
+        pthread_mutex_unlock(&rxLock);
+        if ((poll(fds, 2, -1) > 0) && (fds[0].revents & (POLLIN | POLLERR | POLLHUP))) {
+            bytes = read(g_fdRead, buf, len);
+            if ((bytes < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+                AJ_Printf("Error reading!!!\n");
+                AJ_Sleep(10);
+            }
+        }
+        pthread_mutex_lock(&rxLock);
+        if (bytes > 0) {
+            while (rxPaused && ioRunning) {
+                pthread_cond_wait(&rxCond, &rxLock);
+            }
+            AJ_DebugDumpSerialRX("AJ_UART_Rx", buf, bytes);
+            rxBuffer = NULL;
+            rxCallback(buf, bytes);
+        }
+    }
+    pthread_mutex_unlock(&rxLock);
+    return NULL;
+}
+
+/**
+ * Write the queued buffers with as few system calls as possible
+ */
+static void WriteBuffers(struct iovec* iov, int count)
+{
+    int i;
+
+    if (txSerialTransmit != __AJ_TX) {
+        /*
+         * Someone has hooked the transmit function, it gets the buffers one at a time
+         */
+        for (i = 0; i < count; ++i) {
+            txSerialTransmit(iov[i].iov_base, iov[i].iov_len);
+        }
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        AJ_DebugDumpSerialTX("AJ_UART_Tx", iov[i].iov_base, iov[i].iov_len);
+    }
+    while (count) {
+        ssize_t ret = writev(g_fdRead, iov, count);
+        if (ret < 0) {
+            if (errno == EAGAIN) {
+                WaitWritable();
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            AJ_Printf("Error writing!!!\n");
+            return;
+        }
+        /*
+         * Skip over what was written, a partial write leaves us part way into a buffer
+         */
+        while (count && ((size_t)ret >= iov->iov_len)) {
+            ret -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count) {
+            iov->iov_base = (uint8_t*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+}
+
+static void* SerialWriteThread(void* arg)
+{
+    struct iovec iov[AJ_SERIO_TX_DEPTH];
+
+    pthread_mutex_lock(&txLock);
+    while (ioRunning) {
+        uint32_t count = txTail - txHead;
+        uint32_t i;
+
+        if (txKick && !txPaused) {
+            /*
+             * AJ_ResumeTX was called, the callback queues anything that is waiting
+             */
+            txKick = FALSE;
+            txCallback(NULL, 0);
+            continue;
+        }
+        if (count == 0) {
+            pthread_cond_wait(&txCond, &txLock);
+            continue;
+        }
+        for (i = 0; i < count; ++i) {
+            TxEntry* entry = &txEntries[(txHead + i) % AJ_SERIO_TX_DEPTH];
+            iov[i].iov_base = entry->buf;
+            iov[i].iov_len = entry->len;
+        }
+        pthread_mutex_unlock(&txLock);
+        WriteBuffers(iov, count);
+        pthread_mutex_lock(&txLock);
+        while (txPaused && ioRunning) {
+            pthread_cond_wait(&txCond, &txLock);
+        }
+        /*
+         * The callback queues the next buffers, they go out with the next writev
+         */
+        for (i = 0; i < count; ++i) {
+            TxEntry entry = txEntries[txHead % AJ_SERIO_TX_DEPTH];
+            ++txHead;
+            txCallback(entry.buf, entry.len);
+        }
+    }
+    pthread_mutex_unlock(&txLock);
+    return NULL;
+}
+
+static AJ_Status SerialIOStart(void)
+{
+    if (pipe(wakeFds) != 0) {
+        return AJ_ERR_DRIVER;
+    }
+    rxBuffer = NULL;
+    rxPaused = FALSE;
+    txPaused = FALSE;
+    txKick = FALSE;
+    txHead = txTail = 0;
+    ioRunning = TRUE;
+    if (pthread_create(&rxThread, NULL, SerialReadThread, NULL) != 0) {
+        ioRunning = FALSE;
+        return AJ_ERR_DRIVER;
+    }
+    if (pthread_create(&txThread, NULL, SerialWriteThread, NULL) != 0) {
+        AJ_SerialIOShutdown();
+        return AJ_ERR_DRIVER;
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_SerialIOShutdown(void)
+{
+    if (!ioRunning) {
+        return AJ_OK;
+    }
+    pthread_mutex_lock(&rxLock);
+    pthread_mutex_lock(&txLock);
+    ioRunning = FALSE;
+    pthread_cond_broadcast(&rxCond);
+    pthread_cond_broadcast(&txCond);
+    pthread_mutex_unlock(&txLock);
+    pthread_mutex_unlock(&rxLock);
+    if (write(wakeFds[1], "", 1) != 1) {
+        AJ_Printf("Failed to wake reader thread\n");
+    }
+    pthread_join(rxThread, NULL);
+    pthread_join(txThread, NULL);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+    rxBuffer = NULL;
+    txHead = txTail = 0;
+    return AJ_OK;
+}
+
+void AJ_RX(uint8_t* buf, uint32_t len)
+{
+    if (ON_THREAD(rxThread)) {
+        rxBufferLen = len;
+        rxBuffer = buf;
+    } else {
+        pthread_mutex_lock(&rxLock);
+        rxBufferLen = len;
+        rxBuffer = buf;
+        pthread_cond_signal(&rxCond);
+        pthread_mutex_unlock(&rxLock);
+    }
+}
+
+void AJ_PauseRX()
+{
+    if (!ON_THREAD(rxThread)) {
+        pthread_mutex_lock(&rxLock);
+        rxPaused = TRUE;
+        pthread_mutex_unlock(&rxLock);
+    }
+}
+
+void AJ_ResumeRX()
+{
+    if (!ON_THREAD(rxThread)) {
+        pthread_mutex_lock(&rxLock);
+        rxPaused = FALSE;
+        pthread_cond_signal(&rxCond);
+        pthread_mutex_unlock(&rxLock);
+    }
+}
+
+void AJ_TX(uint8_t* buf, uint32_t len)
+{
+    uint8_t onThread = ON_THREAD(txThread);
+
+    if (!onThread) {
+        pthread_mutex_lock(&txLock);
+    }
+    AJ_ASSERT((txTail - txHead) < AJ_SERIO_TX_DEPTH);
+    txEntries[txTail % AJ_SERIO_TX_DEPTH].buf = buf;
+    txEntries[txTail % AJ_SERIO_TX_DEPTH].len = len;
+    ++txTail;
+    if (!onThread) {
+        pthread_cond_signal(&txCond);
+        pthread_mutex_unlock(&txLock);
+    }
+}
+
+void AJ_PauseTX()
+{
+    if (!ON_THREAD(txThread)) {
+        pthread_mutex_lock(&txLock);
+        txPaused = TRUE;
+        pthread_mutex_unlock(&txLock);
+    }
+}
+
+void AJ_ResumeTX()
+{
+    if (!ON_THREAD(txThread)) {
+        pthread_mutex_lock(&txLock);
+        txPaused = FALSE;
+        txKick = TRUE;
+        pthread_cond_signal(&txCond);
+        pthread_mutex_unlock(&txLock);
+    }
+}
+
+#endif /* AJ_SERIAL_IO_THREAD */
+
 /**
  * This function initialized the UART piece of the transport.
  */
@@ -100,25 +581,7 @@ AJ_Status AJ_SerialTargetInit(const char* ttyName, uint16_t bitRate)
     tcsetattr(g_fdRead, TCSANOW, &tioNew);
     tcflush(g_fdRead, TCIOFLUSH);
 
-    // set up a signal handler to do something when serial port data arrives
-    memset(&saHandler, 0, sizeof(saHandler));
-    saHandler.sa_handler = AJ_Serial_SignalHandlerIO;
-    sigemptyset(&saHandler.sa_mask);
-    sigaction(SIGIO, &saHandler, NULL);
-
-    fcntl(g_fdRead, F_SETOWN, getpid()); // let this process receive SIGIO.
-    fcntl(g_fdRead, F_SETFL, FASYNC); // let things happen async
-
-    return AJ_OK;
-}
-
-
-
-AJ_Status AJ_UART_Tx(uint8_t* buffer, uint16_t len)
-{
-    AJ_DebugDumpSerialTX("AJ_UART_Tx", buffer, len);
-    write(g_fdRead, buffer, len);
-    return AJ_OK;
+    return SerialIOStart();
 }
 
 
@@ -163,5 +626,3 @@ void OI_HCIIfc_SendCompleted(uint8_t sendType,
     AJ_Printf("OI_HCIIfc_SendCompleted senstype:%d status %u\n", sendType, status);
     g_SendCompleted = 1;
 }
-
-
@@ -23,14 +23,17 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <time.h>
 
 #include "aj_target.h"
 #include "aj_bufio.h"
 #include "aj_net.h"
 #include "aj_util.h"
+#include "aj_txqueue.h"
 
 #define INVALID_SOCKET (-1)
 
@@ -56,8 +59,27 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
 
     assert(buf->direction == AJ_IO_BUF_TX);
 
-    if (tx > 0) {
-        ret = send((int)buf->context, buf->readPtr, tx, 0);
+    while (tx > 0) {
+        /*
+         * A peer that closed the connection is reported as a write error rather than a SIGPIPE
+         */
+        int flags = MSG_NOSIGNAL;
+        if (buf->flags & AJ_IO_BUF_MORE) {
+            flags |= MSG_MORE;
+        }
+        if (buf->flags & AJ_IO_BUF_NONBLOCK) {
+            flags |= MSG_DONTWAIT;
+        }
+        ret = send((int)buf->context, buf->readPtr, tx, flags);
+        if ((ret == -1) && (buf->flags & AJ_IO_BUF_NONBLOCK) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            /*
+             * Nothing could be sent without blocking, the caller will try again later
+             */
+            break;
+        }
+        if ((ret == -1) && (errno == EINTR)) {
+            continue;
+        }
         if (ret == -1) {
 #ifndef NDEBUG
             fprintf(stderr, "send() failed: %s\n", strerror(errno));
@@ -65,6 +87,13 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
             return AJ_ERR_WRITE;
         }
         buf->readPtr += ret;
+        tx -= ret;
+        /*
+         * A non-blocking send leaves what was not sent in the buffer, a blocking send keeps going
+         */
+        if (buf->flags & AJ_IO_BUF_NONBLOCK) {
+            break;
+        }
     }
     if (AJ_IO_BUF_AVAIL(buf) == 0) {
         AJ_IO_BUF_RESET(buf);
@@ -110,7 +139,36 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 static uint8_t rxData[1024];
 static uint8_t txData[1024];
 
-AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr)
+/*
+ * Connect without blocking for longer than the timeout then put the socket back in blocking mode
+ */
+static int ConnectTimeout(int sock, struct sockaddr* addr, socklen_t addrSize, uint32_t timeout)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    int ret;
+
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    ret = connect(sock, addr, addrSize);
+    if ((ret < 0) && (errno == EINPROGRESS)) {
+        struct timeval tv = { timeout / 1000, (timeout % 1000) * 1000 };
+        fd_set fds;
+
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        ret = -1;
+        if (select(sock + 1, NULL, &fds, NULL, &tv) == 1) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if ((getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0) && !err) {
+                ret = 0;
+            }
+        }
+    }
+    fcntl(sock, F_SETFL, flags);
+    return ret;
+}
+
+AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr, uint32_t timeout)
 {
     int ret;
     struct sockaddr_storage addrBuf;
@@ -136,13 +194,22 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
         memcpy(sa->sin6_addr.s6_addr, addr, sizeof(sa->sin6_addr.s6_addr));
         addrSize = sizeof(*sa);
     }
-    ret = connect(tcpSock, (struct sockaddr*)&addrBuf, addrSize);
+    ret = timeout ? ConnectTimeout(tcpSock, (struct sockaddr*)&addrBuf, addrSize, timeout) : connect(tcpSock, (struct sockaddr*)&addrBuf, addrSize);
     if (ret < 0) {
 #ifndef NDEBUG
         fprintf(stderr, "connect() failed: %d\n", ret);
 #endif
+        close(tcpSock);
         return AJ_ERR_CONNECT;
     } else {
+#if AJ_CORK_BUFFER_SIZE || AJ_TX_QUEUE_SIZE
+        int nodelay = 1;
+        /*
+         * Messages are batched by corking or the transmit queue so don't let Nagle hold back a
+         * message that follows one the daemon doesn't reply to, such as Hello after BEGIN
+         */
+        setsockopt(tcpSock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+#endif
         AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)tcpSock);
         netSock->rx.recv = AJ_Net_Recv;
         AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)tcpSock);
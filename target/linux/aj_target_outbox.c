@@ -0,0 +1,54 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "aj_target.h"
+#include "aj_outbox.h"
+
+#if AJ_OUTBOX_SPILL_SIZE
+
+/*
+ * The spill file only needs to outlive a disconnect so it is truncated when it is mapped. There is
+ * no default path so spilling never creates a file the application did not ask for.
+ */
+#ifndef AJ_OUTBOX_SPILL_FILE
+#error AJ_OUTBOX_SPILL_FILE must be defined when AJ_OUTBOX_SPILL_SIZE is non-zero
+#endif
+
+uint8_t* AJ_Outbox_MapSpill(uint32_t size)
+{
+    void* addr;
+    int fd = open(AJ_OUTBOX_SPILL_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (addr == MAP_FAILED) ? NULL : (uint8_t*)addr;
+}
+
+#endif
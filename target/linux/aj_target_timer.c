@@ -23,16 +23,14 @@
 #include "aj_util.h"
 #include <signal.h>
 #include <time.h>
+#ifdef AJ_TIMERFD
+#include <errno.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#endif
 
 
 
-static AJ_Time globalClock;
-static AJ_Timer* TimerList = NULL;
-static AJ_Timer* InactiveTimerList = NULL;
-static uint32_t TimerId = 0;
-static timer_t globalTimer;
-static struct sigevent sigev;
-
 void _AJ_DebugCheckTimerList(AJ_Timer* list)
 {
     // BUGBUG take a lock
@@ -73,73 +71,6 @@ void _AJ_DumpTimerList(AJ_Timer* list)
 #endif
 
 
-static void AJ_GlobalTimerStop()
-{
-    struct itimerspec ts;
-    // FYI: setting to zero will turn off the alarm
-    ts.it_value.tv_sec = 0;
-    ts.it_value.tv_nsec = 0;
-    ts.it_interval.tv_sec = 0;
-    ts.it_interval.tv_nsec = 0;
-    timer_settime(globalTimer, TIMER_ABSTIME, &ts, NULL);
-}
-
-static void AJ_GlobalTimerStart()
-{
-    AJ_DumpTimerList(TimerList);
-    AJ_DumpTimerList(InactiveTimerList);
-
-    struct itimerspec ts;
-    // FYI: setting to zero will turn off the alarm
-    ts.it_value.tv_sec = TimerList->timeNextRaised.seconds;
-    ts.it_value.tv_nsec = TimerList->timeNextRaised.milliseconds * 1000000LL;
-    ts.it_interval.tv_sec = 0;
-//    ts.it_interval.tv_nsec = 0;
-    ts.it_interval.tv_nsec = 1000000; // 1 millisecond resolution
-
-    //int settime =
-    timer_settime(globalTimer, TIMER_ABSTIME, &ts, NULL);
-    AJ_DebugTimerPrintf("timer_settime next time raised will be %u\n", ts.it_value.tv_sec);
-}
-
-static void AJ_GlobalTimerHandler(sigval_t value)
-{
-    if (!TimerList) {
-        AJ_GlobalTimerStop();
-        AJ_Printf("turn off alarm, there is no timer\n");
-    } else {
-        AJ_Time now;
-        AJ_InitTimer(&now);
-
-        AJ_Timer* top = TimerList;
-        // if tops time < now, then run the callback...
-
-        if (AJ_CompareTime(top->timeNextRaised, now) < 1) {
-            TimerList = top->next;
-            // move to the top of the inactive timer list, semi-MRU
-            top->next = InactiveTimerList;
-            InactiveTimerList = top;
-            (top->callback)(top->id, top->context);
-        } else {
-//            AJ_Printf("AJ_GlobalTimerHandler without something to do yet.\n");
-        }
-    }
-
-}
-
-static void AJ_GlobalTimerInit(void)
-{
-    sigev.sigev_notify = SIGEV_THREAD;
-    sigev.sigev_notify_function = &AJ_GlobalTimerHandler;
-
-//    int create;
-    timer_create(CLOCK_MONOTONIC, &sigev, &globalTimer);
-//    AJ_DebugTimerPrintf("global timer create returned %d id is 0x%lX\n", create, (long)globalTimer);
-
-    AJ_InitTimer(&globalClock);
-}
-
-
 AJ_Timer* AJ_TimerInit(uint32_t timeout,
                        AJ_TimerCallback timerCallback,
                        void* context,
@@ -226,6 +157,86 @@ AJ_Timer* AJ_TimerRemoveFromList(AJ_Timer** list, uint32_t timerId)
 }
 
 
+#ifndef AJ_TIMERFD
+
+/*
+ * Timers are kept in lists sorted by expiry time and driven by a POSIX timer
+ */
+
+static AJ_Time globalClock;
+static AJ_Timer* TimerList = NULL;
+static AJ_Timer* InactiveTimerList = NULL;
+static uint32_t TimerId = 0;
+static timer_t globalTimer;
+static struct sigevent sigev;
+
+static void AJ_GlobalTimerStop()
+{
+    struct itimerspec ts;
+    // FYI: setting to zero will turn off the alarm
+    ts.it_value.tv_sec = 0;
+    ts.it_value.tv_nsec = 0;
+    ts.it_interval.tv_sec = 0;
+    ts.it_interval.tv_nsec = 0;
+    timer_settime(globalTimer, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void AJ_GlobalTimerStart()
+{
+    AJ_DumpTimerList(TimerList);
+    AJ_DumpTimerList(InactiveTimerList);
+
+    struct itimerspec ts;
+    // FYI: setting to zero will turn off the alarm
+    ts.it_value.tv_sec = TimerList->timeNextRaised.seconds;
+    ts.it_value.tv_nsec = TimerList->timeNextRaised.milliseconds * 1000000LL;
+    ts.it_interval.tv_sec = 0;
+//    ts.it_interval.tv_nsec = 0;
+    ts.it_interval.tv_nsec = 1000000; // 1 millisecond resolution
+
+    //int settime =
+    timer_settime(globalTimer, TIMER_ABSTIME, &ts, NULL);
+    AJ_DebugTimerPrintf("timer_settime next time raised will be %u\n", ts.it_value.tv_sec);
+}
+
+static void AJ_GlobalTimerHandler(sigval_t value)
+{
+    if (!TimerList) {
+        AJ_GlobalTimerStop();
+        AJ_Printf("turn off alarm, there is no timer\n");
+    } else {
+        AJ_Time now;
+        AJ_InitTimer(&now);
+
+        AJ_Timer* top = TimerList;
+        // if tops time < now, then run the callback...
+
+        if (AJ_CompareTime(top->timeNextRaised, now) < 1) {
+            TimerList = top->next;
+            // move to the top of the inactive timer list, semi-MRU
+            top->next = InactiveTimerList;
+            InactiveTimerList = top;
+            (top->callback)(top->id, top->context);
+        } else {
+//            AJ_Printf("AJ_GlobalTimerHandler without something to do yet.\n");
+        }
+    }
+
+}
+
+static void AJ_GlobalTimerInit(void)
+{
+    sigev.sigev_notify = SIGEV_THREAD;
+    sigev.sigev_notify_function = &AJ_GlobalTimerHandler;
+
+//    int create;
+    timer_create(CLOCK_MONOTONIC, &sigev, &globalTimer);
+//    AJ_DebugTimerPrintf("global timer create returned %d id is 0x%lX\n", create, (long)globalTimer);
+
+    AJ_InitTimer(&globalClock);
+}
+
+
 AJ_Status AJ_TimerRegister(uint32_t timeout,
                            AJ_TimerCallback timerCallback,
                            void* context,
@@ -238,6 +249,7 @@ AJ_Status AJ_TimerRegister(uint32_t timeout,
         TimerId++;
     }
 
+    *timerId = TimerId++;
     AJ_Timer* timer = AJ_TimerInit(timeout, timerCallback, context, *timerId);
     AJ_TimerInsertInList(&TimerList, timer);
 
@@ -307,3 +319,265 @@ void AJ_TimerCancel(uint32_t timerId, uint8_t keep)
     // BUGBUG release a lock
 }
 
+#else /* AJ_TIMERFD */
+
+/*
+ * Timers come from a fixed pool and the running ones are kept in a binary heap ordered by
+ * expiry time. A timerfd is armed for the timer at the top of the heap so the timer thread
+ * only wakes up when a timer is actually due.
+ */
+
+/*
+ * Maximum number of timers that can be registered at the same time, fired timers stay
+ * registered until they are cancelled so they can be refreshed.
+ */
+#ifndef AJ_TIMER_POOL_SIZE
+#define AJ_TIMER_POOL_SIZE  64
+#endif
+
+#define NOT_IN_HEAP  0xFFFF
+
+static AJ_Timer timerPool[AJ_TIMER_POOL_SIZE];
+static AJ_Timer* timerFreeList;
+static AJ_Timer* timerHeap[AJ_TIMER_POOL_SIZE];
+static uint16_t heapPos[AJ_TIMER_POOL_SIZE];
+static uint16_t heapCount;
+static uint32_t timerGeneration;
+static int timerFd = -1;
+static pthread_t timerThread;
+static pthread_mutex_t timerLock = PTHREAD_MUTEX_INITIALIZER;
+
+#define POOL_INDEX(t) ((t) - timerPool)
+
+static void HeapSet(uint16_t pos, AJ_Timer* timer)
+{
+    timerHeap[pos] = timer;
+    heapPos[POOL_INDEX(timer)] = pos;
+}
+
+static void HeapSiftUp(uint16_t pos)
+{
+    AJ_Timer* timer = timerHeap[pos];
+
+    while (pos > 0) {
+        uint16_t parent = (pos - 1) / 2;
+        if (AJ_CompareTime(timerHeap[parent]->timeNextRaised, timer->timeNextRaised) <= 0) {
+            break;
+        }
+        HeapSet(pos, timerHeap[parent]);
+        pos = parent;
+    }
+    HeapSet(pos, timer);
+}
+
+static void HeapSiftDown(uint16_t pos)
+{
+    AJ_Timer* timer = timerHeap[pos];
+
+    while (TRUE) {
+        uint16_t child = 2 * pos + 1;
+        if (child >= heapCount) {
+            break;
+        }
+        if (((child + 1) < heapCount) && (AJ_CompareTime(timerHeap[child + 1]->timeNextRaised, timerHeap[child]->timeNextRaised) < 0)) {
+            ++child;
+        }
+        if (AJ_CompareTime(timer->timeNextRaised, timerHeap[child]->timeNextRaised) <= 0) {
+            break;
+        }
+        HeapSet(pos, timerHeap[child]);
+        pos = child;
+    }
+    HeapSet(pos, timer);
+}
+
+static void HeapInsert(AJ_Timer* timer)
+{
+    HeapSet(heapCount++, timer);
+    HeapSiftUp(heapCount - 1);
+}
+
+static void HeapRemove(AJ_Timer* timer)
+{
+    uint16_t pos = heapPos[POOL_INDEX(timer)];
+
+    heapPos[POOL_INDEX(timer)] = NOT_IN_HEAP;
+    if (pos != --heapCount) {
+        HeapSet(pos, timerHeap[heapCount]);
+        HeapSiftDown(pos);
+        HeapSiftUp(heapPos[POOL_INDEX(timerHeap[pos])]);
+    }
+}
+
+/**
+ * Find a registered timer, the pool index is encoded in the timer id
+ */
+static AJ_Timer* TimerLookup(uint32_t timerId)
+{
+    AJ_Timer* timer;
+
+    if (timerId == 0) {
+        return NULL;
+    }
+    timer = &timerPool[(timerId - 1) % AJ_TIMER_POOL_SIZE];
+    return (timer->id == timerId) ? timer : NULL;
+}
+
+/**
+ * Arm the timerfd for the earliest timer, must be called with the lock held
+ */
+static void TimerArm(void)
+{
+    struct itimerspec ts;
+
+    memset(&ts, 0, sizeof(ts));
+    if (heapCount) {
+        ts.it_value.tv_sec = timerHeap[0]->timeNextRaised.seconds;
+        ts.it_value.tv_nsec = timerHeap[0]->timeNextRaised.milliseconds * 1000000LL;
+        if (!ts.it_value.tv_sec && !ts.it_value.tv_nsec) {
+            // zero would disarm the timer
+            ts.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &ts, NULL);
+}
+
+static void* TimerThread(void* arg)
+{
+    while (TRUE) {
+        uint64_t expirations;
+        AJ_Time now;
+
+        if (read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            // re-armed after it expired but before we read it
+            continue;
+        }
+        pthread_mutex_lock(&timerLock);
+        AJ_InitTimer(&now);
+        while (heapCount && (AJ_CompareTime(timerHeap[0]->timeNextRaised, now) < 1)) {
+            AJ_Timer* top = timerHeap[0];
+            uint32_t id = top->id;
+            AJ_TimerCallback* callback = top->callback;
+            void* context = top->context;
+
+            // the timer stays registered so it can be refreshed
+            HeapRemove(top);
+            // the callback may register, refresh or cancel timers
+            pthread_mutex_unlock(&timerLock);
+            callback(id, context);
+            pthread_mutex_lock(&timerLock);
+            AJ_InitTimer(&now);
+        }
+        TimerArm();
+        pthread_mutex_unlock(&timerLock);
+    }
+    return NULL;
+}
+
+static AJ_Status TimerServiceInit(void)
+{
+    int i;
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerFd < 0) {
+        AJ_Printf("timerfd_create failed %d\n", errno);
+        return AJ_ERR_RESOURCES;
+    }
+    timerFreeList = NULL;
+    for (i = AJ_TIMER_POOL_SIZE - 1; i >= 0; --i) {
+        timerPool[i].id = 0;
+        timerPool[i].next = timerFreeList;
+        timerFreeList = &timerPool[i];
+        heapPos[i] = NOT_IN_HEAP;
+    }
+    heapCount = 0;
+    if (pthread_create(&timerThread, NULL, TimerThread, NULL) != 0) {
+        close(timerFd);
+        timerFd = -1;
+        return AJ_ERR_RESOURCES;
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_TimerRegister(uint32_t timeout,
+                           AJ_TimerCallback timerCallback,
+                           void* context,
+                           uint32_t* timerId)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Timer* timer;
+
+    pthread_mutex_lock(&timerLock);
+    if (timerFd < 0) {
+        status = TimerServiceInit();
+    }
+    if ((status == AJ_OK) && !timerFreeList) {
+        AJ_Printf("AJ_TimerRegister no free timers\n");
+        status = AJ_ERR_RESOURCES;
+    }
+    if (status == AJ_OK) {
+        timer = timerFreeList;
+        timerFreeList = timer->next;
+        timer->next = NULL;
+        timer->id = (uint32_t)POOL_INDEX(timer) + 1 + AJ_TIMER_POOL_SIZE * (++timerGeneration % (0xFFFFFFFF / AJ_TIMER_POOL_SIZE));
+        timer->callback = timerCallback;
+        timer->context = context;
+        AJ_InitTimer(&timer->timeNextRaised);
+        AJ_TimeAddOffset(&timer->timeNextRaised, timeout);
+        HeapInsert(timer);
+        TimerArm();
+        *timerId = timer->id;
+    }
+    pthread_mutex_unlock(&timerLock);
+    return status;
+}
+
+AJ_Status AJ_TimerRefresh(uint32_t timerId,
+                          uint32_t timeout)
+{
+    AJ_Timer* timer;
+
+    AJ_DebugTimerPrintf("AJ_TimerRefresh id 0x%lx timeout %ld\n", timerId, timeout);
+    pthread_mutex_lock(&timerLock);
+    timer = TimerLookup(timerId);
+    if (timer) {
+        // set the trigger time to now + timeout.
+        AJ_InitTimer(&timer->timeNextRaised);
+        AJ_TimeAddOffset(&timer->timeNextRaised, timeout);
+        if (heapPos[POOL_INDEX(timer)] == NOT_IN_HEAP) {
+            HeapInsert(timer);
+        } else {
+            HeapSiftDown(heapPos[POOL_INDEX(timer)]);
+            HeapSiftUp(heapPos[POOL_INDEX(timer)]);
+        }
+        TimerArm();
+    } else {
+        AJ_Printf("ERROR! refreshing a non existant timer %u!\n", timerId);
+    }
+    pthread_mutex_unlock(&timerLock);
+    return AJ_OK;
+}
+
+void AJ_TimerCancel(uint32_t timerId, uint8_t keep)
+{
+    AJ_Timer* timer;
+
+    AJ_DebugTimerPrintf("AJ_TimerCancel id %d\n", timerId);
+    pthread_mutex_lock(&timerLock);
+    timer = TimerLookup(timerId);
+    if (timer) {
+        if (heapPos[POOL_INDEX(timer)] != NOT_IN_HEAP) {
+            HeapRemove(timer);
+            TimerArm();
+        }
+        if (!keep) {
+            // return the timer to the pool
+            timer->id = 0;
+            timer->next = timerFreeList;
+            timerFreeList = timer;
+        }
+    }
+    pthread_mutex_unlock(&timerLock);
+}
+
+#endif /* AJ_TIMERFD */
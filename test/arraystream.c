@@ -0,0 +1,465 @@
+/**
+ * @file  Streaming unmarshal of arrays much larger than the receive buffer
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "alljoyn.h"
+#include "testpipe.h"
+
+static const char* const bulkInterface[] = {
+    "org.alljoyn.arraystream_test",
+    "!Bulk >ay >u >a(us) >at >as",
+    "!Small >ay >u",
+    NULL
+};
+
+static const AJ_InterfaceDescription bulkInterfaces[] = {
+    bulkInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/arraystream_test", bulkInterfaces },
+    { NULL }
+};
+
+#define APP_BULK   AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_SMALL  AJ_APP_MESSAGE_ID(0, 0, 1)
+
+#define BUFFER_SIZE    1024
+
+/*
+ * Each array is 1000 times the size of the receive buffer
+ */
+#define BLOB_BYTES     (1000 * BUFFER_SIZE)
+#define NUM_RECORDS    (1000 * BUFFER_SIZE / 20)
+#define NUM_SAMPLES    (1000 * BUFFER_SIZE / 8)
+#define SKIPPED_BYTES  (1000 * BUFFER_SIZE)
+
+#define MAGIC          0x600DF00D
+
+static const char PeerA[] = ":1a.2";
+static const char PeerB[] = ":1b.3";
+
+/*
+ * Blocking in-memory link from the sending thread to the receiver
+ */
+typedef struct _BlockingPipe {
+    uint8_t data[4096];
+    uint32_t head;
+    uint32_t tail;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} BlockingPipe;
+
+static BlockingPipe pipeAtoB = { { 0 }, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static uint8_t txDataA[BUFFER_SIZE];
+static uint8_t rxDataA[BUFFER_SIZE];
+static uint8_t txDataB[BUFFER_SIZE];
+static uint8_t rxDataB[BUFFER_SIZE];
+
+static AJ_BusAttachment busA;
+static AJ_BusAttachment busB;
+
+static uint32_t failures;
+
+static AJ_Status BlockingSend(AJ_IOBuffer* buf)
+{
+    BlockingPipe* pipe = (BlockingPipe*)buf->context;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        uint32_t space = sizeof(pipe->data) - (pipe->tail - pipe->head);
+        uint32_t len = min(AJ_IO_BUF_AVAIL(buf), space);
+        uint32_t i;
+
+        for (i = 0; i < len; ++i) {
+            pipe->data[(pipe->tail + i) % sizeof(pipe->data)] = buf->readPtr[i];
+        }
+        pipe->tail += len;
+        buf->readPtr += len;
+        pthread_cond_broadcast(&pipe->cond);
+        if (AJ_IO_BUF_AVAIL(buf)) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status BlockingRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    BlockingPipe* pipe = (BlockingPipe*)buf->context;
+    struct timespec ts;
+    uint32_t rx;
+    uint32_t i;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += 1 + timeout / 1000;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->tail == pipe->head) {
+        if (pthread_cond_timedwait(&pipe->cond, &pipe->lock, &ts)) {
+            pthread_mutex_unlock(&pipe->lock);
+            return AJ_ERR_TIMEOUT;
+        }
+    }
+    rx = min(AJ_IO_BUF_SPACE(buf), len);
+    rx = min(rx, pipe->tail - pipe->head);
+    for (i = 0; i < rx; ++i) {
+        buf->writePtr[i] = pipe->data[(pipe->head + i) % sizeof(pipe->data)];
+    }
+    buf->writePtr += rx;
+    pipe->head += rx;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    return AJ_OK;
+}
+
+/*
+ * The shared test pipe fails a write that does not fit, this link is narrower than a bulk message
+ * so the sender waits for the receiver instead
+ */
+static void InitBus(AJ_BusAttachment* bus, const char* name, uint8_t* tx, uint8_t* rx, BlockingPipe* out, BlockingPipe* in)
+{
+    TestPipeInitBus(bus, name, tx, BUFFER_SIZE, rx, BUFFER_SIZE, NULL, NULL);
+    bus->sock.tx.context = out;
+    bus->sock.tx.send = BlockingSend;
+    bus->sock.rx.context = in;
+    bus->sock.rx.recv = BlockingRecv;
+}
+
+static uint8_t BlobByte(uint32_t i)
+{
+    return (uint8_t)(i * 7 + (i >> 10));
+}
+
+static void RecordName(uint32_t i, char* name)
+{
+    sprintf(name, "record-%u", i * 13);
+}
+
+/*
+ * Writes the body of the Bulk signal with AJ_MarshalRaw, or just counts the bytes if msg is NULL.
+ * The offset is relative to the start of the body which is 8 byte aligned.
+ */
+typedef struct _BodyWriter {
+    AJ_Message* msg;
+    uint32_t offset;
+    uint8_t buf[256];
+    uint32_t len;
+} BodyWriter;
+
+static void Flush(BodyWriter* w)
+{
+    if (w->msg && w->len) {
+        if (AJ_MarshalRaw(w->msg, w->buf, w->len) != AJ_OK) {
+            ++failures;
+        }
+    }
+    w->len = 0;
+}
+
+static void Put(BodyWriter* w, const void* data, uint32_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (len--) {
+        if (w->len == sizeof(w->buf)) {
+            Flush(w);
+        }
+        w->buf[w->len++] = p ? *p++ : 0;
+        ++w->offset;
+    }
+}
+
+static void Align(BodyWriter* w, uint32_t alignment)
+{
+    Put(w, NULL, (alignment - w->offset) & (alignment - 1));
+}
+
+static void PutU32(BodyWriter* w, uint32_t v)
+{
+    Align(w, 4);
+    Put(w, &v, 4);
+}
+
+static void PutString(BodyWriter* w, const char* str)
+{
+    PutU32(w, (uint32_t)strlen(str));
+    Put(w, str, (uint32_t)strlen(str) + 1);
+}
+
+/*
+ * Writes an array length, the length does not include the padding before the first element
+ */
+static void PutArrayLen(BodyWriter* w, uint32_t len, uint32_t alignment)
+{
+    PutU32(w, len);
+    Align(w, alignment);
+}
+
+static uint32_t WriteBody(AJ_Message* msg)
+{
+    BodyWriter w;
+    char name[32];
+    uint32_t len;
+    uint32_t i;
+
+    memset(&w, 0, sizeof(w));
+    w.msg = msg;
+    /*
+     * ay
+     */
+    PutArrayLen(&w, BLOB_BYTES, 1);
+    for (i = 0; i < BLOB_BYTES; ++i) {
+        uint8_t b = BlobByte(i);
+        Put(&w, &b, 1);
+    }
+    /*
+     * u
+     */
+    PutU32(&w, MAGIC);
+    /*
+     * a(us), the array length is worked out first
+     */
+    len = 0;
+    for (i = 0; i < NUM_RECORDS; ++i) {
+        len = (len + 7) & ~7;
+        RecordName(i, name);
+        len += 4 + 4 + strlen(name) + 1;
+    }
+    PutArrayLen(&w, len, 8);
+    for (i = 0; i < NUM_RECORDS; ++i) {
+        Align(&w, 8);
+        PutU32(&w, i);
+        RecordName(i, name);
+        PutString(&w, name);
+    }
+    /*
+     * at
+     */
+    PutArrayLen(&w, NUM_SAMPLES * 8, 8);
+    for (i = 0; i < NUM_SAMPLES; ++i) {
+        uint64_t v = ((uint64_t)i << 32) | (i ^ 0x5A5A5A5A);
+        Put(&w, &v, 8);
+    }
+    /*
+     * as, the receiver skips this one
+     */
+    PutArrayLen(&w, SKIPPED_BYTES, 4);
+    for (i = 0; i < SKIPPED_BYTES / 8; ++i) {
+        PutString(&w, "abc");
+    }
+    Flush(&w);
+    return w.offset;
+}
+
+static void* SendThread(void* arg)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&busA, &msg, APP_BULK, PeerB, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsgPartial(&msg, WriteBody(NULL));
+    }
+    if (status == AJ_OK) {
+        WriteBody(&msg);
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("Send failed %s\n", AJ_StatusText(status));
+        ++failures;
+    }
+    return NULL;
+}
+
+#define CHECK(x) do { AJ_Status s = (x); if (s != AJ_OK) { AJ_Printf("%s failed %s\n", # x, AJ_StatusText(s)); return 1; } } while (0)
+
+static int ReceiveBulk(void)
+{
+    AJ_Message msg;
+    AJ_ArrayCursor cursor;
+    AJ_Arg record;
+    const void* data;
+    size_t actual;
+    uint32_t magic;
+    uint32_t total;
+    uint32_t i;
+    AJ_Status status;
+
+    CHECK(AJ_UnmarshalMsg(&busB, &msg, 5000));
+    if (msg.msgId != APP_BULK) {
+        AJ_Printf("Unexpected message %08x\n", msg.msgId);
+        return 1;
+    }
+    /*
+     * The array is far larger than the receive buffer so AJ_UnmarshalContainer cannot load it
+     */
+    total = 0;
+    CHECK(AJ_UnmarshalArrayCursor(&msg, &cursor));
+    if (cursor.array.len != BLOB_BYTES) {
+        AJ_Printf("Wrong blob length %u\n", cursor.array.len);
+        return 1;
+    }
+    while ((status = AJ_UnmarshalArrayChunk(&msg, &cursor, &data, 4096, &actual)) == AJ_OK) {
+        for (i = 0; i < actual; ++i) {
+            if (((const uint8_t*)data)[i] != BlobByte(total + i)) {
+                AJ_Printf("Blob mismatch at %u\n", total + i);
+                return 1;
+            }
+        }
+        total += actual;
+    }
+    if ((status != AJ_ERR_NO_MORE) || (total != BLOB_BYTES)) {
+        AJ_Printf("Blob ended at %u %s\n", total, AJ_StatusText(status));
+        return 1;
+    }
+    CHECK(AJ_UnmarshalCloseArrayCursor(&msg, &cursor));
+    AJ_Printf("ay: %u bytes streamed through a %u byte buffer\n", total, BUFFER_SIZE);
+
+    CHECK(AJ_UnmarshalArgs(&msg, "u", &magic));
+    if (magic != MAGIC) {
+        AJ_Printf("Wrong value after the blob %x\n", magic);
+        return 1;
+    }
+
+    /*
+     * Structs are unmarshaled one at a time
+     */
+    CHECK(AJ_UnmarshalArrayCursor(&msg, &cursor));
+    for (i = 0; ; ++i) {
+        uint32_t index;
+        const char* name;
+        char expect[32];
+
+        status = AJ_UnmarshalContainer(&msg, &record, AJ_ARG_STRUCT);
+        if (status != AJ_OK) {
+            break;
+        }
+        CHECK(AJ_UnmarshalArgs(&msg, "us", &index, &name));
+        CHECK(AJ_UnmarshalCloseContainer(&msg, &record));
+        RecordName(i, expect);
+        if ((index != i) || strcmp(name, expect)) {
+            AJ_Printf("Record %u mismatch %u %s\n", i, index, name);
+            return 1;
+        }
+    }
+    if ((status != AJ_ERR_NO_MORE) || (i != NUM_RECORDS)) {
+        AJ_Printf("Records ended at %u %s\n", i, AJ_StatusText(status));
+        return 1;
+    }
+    CHECK(AJ_UnmarshalCloseContainer(&msg, &cursor.array));
+    AJ_Printf("a(us): %u records (%u bytes) streamed\n", i, cursor.array.len);
+
+    /*
+     * Eight byte elements must stay aligned as the buffer is refilled
+     */
+    total = 0;
+    CHECK(AJ_UnmarshalArrayCursor(&msg, &cursor));
+    while ((status = AJ_UnmarshalArrayChunk(&msg, &cursor, &data, 1000, &actual)) == AJ_OK) {
+        const uint64_t* v = (const uint64_t*)data;
+        if (((size_t)data & 7) || (actual & 7)) {
+            AJ_Printf("Misaligned chunk\n");
+            return 1;
+        }
+        for (i = 0; i < actual / 8; ++i, ++total) {
+            if (v[i] != (((uint64_t)total << 32) | (total ^ 0x5A5A5A5A))) {
+                AJ_Printf("Sample %u mismatch\n", total);
+                return 1;
+            }
+        }
+    }
+    if ((status != AJ_ERR_NO_MORE) || (total != NUM_SAMPLES)) {
+        AJ_Printf("Samples ended at %u %s\n", total, AJ_StatusText(status));
+        return 1;
+    }
+    CHECK(AJ_UnmarshalCloseArrayCursor(&msg, &cursor));
+    AJ_Printf("at: %u samples streamed\n", total);
+
+    /*
+     * Closing the cursor skips the rest of the array
+     */
+    CHECK(AJ_UnmarshalArrayCursor(&msg, &cursor));
+    CHECK(AJ_UnmarshalArgs(&msg, "s", &data));
+    CHECK(AJ_UnmarshalCloseArrayCursor(&msg, &cursor));
+
+    /*
+     * The header fields were never moved
+     */
+    if (!msg.sender || strcmp(msg.sender, PeerA) || strcmp(msg.member, "Bulk") || msg.bodyBytes) {
+        AJ_Printf("Header fields were overwritten\n");
+        return 1;
+    }
+    CHECK(AJ_CloseMsg(&msg));
+    return 0;
+}
+
+int AJ_Main(void)
+{
+    pthread_t thread;
+    uint8_t bigBuf[BUFFER_SIZE];
+    AJ_Message msg;
+    AJ_Arg arg;
+    int rc;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    InitBus(&busA, PeerA, txDataA, rxDataA, &pipeAtoB, NULL);
+    InitBus(&busB, PeerB, txDataB, rxDataB, NULL, &pipeAtoB);
+
+    pthread_create(&thread, NULL, SendThread, NULL);
+    rc = ReceiveBulk();
+    pthread_join(thread, NULL);
+
+    /*
+     * Arrays that fit in the buffer are still unmarshaled in one go
+     */
+    if (!rc) {
+        memset(bigBuf, 0xA5, sizeof(bigBuf));
+        AJ_MarshalSignal(&busA, &msg, APP_SMALL, PeerB, 0, 0, 0);
+        AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, bigBuf, 600));
+        AJ_MarshalArgs(&msg, "u", MAGIC);
+        AJ_DeliverMsg(&msg);
+        if ((AJ_UnmarshalMsg(&busB, &msg, 1000) != AJ_OK) || (AJ_UnmarshalArg(&msg, &arg) != AJ_OK) || (arg.len != 600)) {
+            AJ_Printf("Small array failed\n");
+            rc = 1;
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    if (rc || failures) {
+        AJ_Printf("arraystream FAILED\n");
+        return 1;
+    }
+    AJ_Printf("arraystream PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
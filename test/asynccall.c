@@ -0,0 +1,494 @@
+/**
+ * @file  Asynchronous method calls with completion callbacks against an in-process echo service
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "testpipe.h"
+
+/*
+ * The service and the client disagree on the signature of the Mismatch reply
+ */
+static const char* const echoInterface[] = {
+    "org.alljoyn.async_test",
+    "?Echo in<s out>s",
+    "?Drop in<s",
+    "?Mismatch in<s out>u",
+    NULL
+};
+
+static const char* const echoProxyInterface[] = {
+    "org.alljoyn.async_test",
+    "?Echo in<s out>s",
+    "?Drop in<s",
+    "?Mismatch in<s out>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription echoInterfaces[] = {
+    echoInterface,
+    NULL
+};
+
+static const AJ_InterfaceDescription echoProxyInterfaces[] = {
+    echoProxyInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/async_test", echoInterfaces },
+    { NULL }
+};
+
+static const AJ_Object ProxyObjects[] = {
+    { "/org/alljoyn/async_test", echoProxyInterfaces },
+    { NULL }
+};
+
+#define APP_ECHO  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_DROP  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_MISMATCH  AJ_APP_MESSAGE_ID(0, 0, 2)
+
+#define PRX_ECHO  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_DROP  AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define PRX_MISMATCH  AJ_PRX_MESSAGE_ID(0, 0, 2)
+
+#define SERVICE_NAME  ":1a.3"
+
+#define BENCH_CALLS    1000
+#define CHECK_CALLS    8
+
+/*
+ * Simulated round trip time in milliseconds between the client and the echo service
+ */
+#define ROUND_TRIP     1
+
+/*
+ * A byte queue in each direction between the client and the service
+ */
+static TestPipe toService;
+static TestPipe toClient;
+
+static uint8_t clientTx[1024];
+static uint8_t clientRx[1024];
+static uint8_t serviceTx[1024];
+static uint8_t serviceRx[1024];
+
+static AJ_BusAttachment client;
+static AJ_BusAttachment service;
+
+static uint32_t failures;
+
+typedef struct {
+    char expect[16];
+    AJ_Status status;
+    uint32_t done;
+} CallResult;
+
+/*
+ * The echo service replies to every Echo call, replies to Mismatch calls with the wrong signature,
+ * acknowledges AdvertiseName calls and silently drops every Drop call
+ */
+static void RunService(void)
+{
+    while (!TEST_PIPE_EMPTY(&toService)) {
+        AJ_Message call;
+        AJ_Status status = AJ_UnmarshalMsg(&service, &call, 0);
+        if (status != AJ_OK) {
+            AJ_Printf("service failed %s\n", AJ_StatusText(status));
+            ++failures;
+            return;
+        }
+        if (call.msgId == APP_ECHO) {
+            AJ_Message reply;
+            char* str;
+            status = AJ_UnmarshalArgs(&call, "s", &str);
+            if (status == AJ_OK) {
+                status = AJ_MarshalReplyMsg(&call, &reply);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&reply, "s", str);
+            }
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+        } else if ((call.msgId == APP_MISMATCH) || (call.msgId == AJ_METHOD_ADVERTISE_NAME)) {
+            AJ_Message reply;
+            status = AJ_MarshalReplyMsg(&call, &reply);
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&reply, "u", 1);
+            }
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+        }
+        AJ_CloseMsg(&call);
+    }
+}
+
+/*
+ * When the client has nothing to receive the calls it has sent make a round trip through the
+ * service.
+ */
+static AJ_Status ClientRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    if (TEST_PIPE_EMPTY(&toClient) && !TEST_PIPE_EMPTY(&toService)) {
+        AJ_Sleep(ROUND_TRIP);
+        RunService();
+    }
+    if (TEST_PIPE_EMPTY(&toClient)) {
+        AJ_Sleep(timeout);
+        return AJ_ERR_TIMEOUT;
+    }
+    return TestPipeRecv(buf, len, timeout);
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static void OnReply(AJ_Message* reply, AJ_Status status, void* context)
+{
+    CallResult* result = (CallResult*)context;
+
+    if (status != AJ_OK) {
+        result->status = status;
+    } else if (reply->hdr->msgType == AJ_MSG_ERROR) {
+        result->status = strcmp(reply->error, AJ_ErrTimeout) ? AJ_ERR_FAILURE : AJ_ERR_TIMEOUT;
+    } else if (reply->msgId != AJ_REPLY_ID(PRX_ECHO)) {
+        result->status = AJ_ERR_NO_MATCH;
+    } else {
+        char* str;
+        result->status = AJ_UnmarshalArgs(reply, "s", &str);
+        if ((result->status == AJ_OK) && strcmp(str, result->expect)) {
+            result->status = AJ_ERR_UNMARSHAL;
+        }
+    }
+    ++result->done;
+}
+
+static void OnBenchReply(AJ_Message* reply, AJ_Status status, void* context)
+{
+    if ((status == AJ_OK) && (reply->hdr->msgType == AJ_MSG_METHOD_RET)) {
+        ++(*(uint32_t*)context);
+    } else {
+        Fail("bench reply", AJ_ERR_FAILURE);
+    }
+}
+
+static AJ_Status Call(uint32_t msgId, const char* str, uint32_t timeout, AJ_MethodReplyCallback callback, void* context)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalMethodCallAsync(&client, &msg, msgId, SERVICE_NAME, 0, 0, timeout, callback, context);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "s", str);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal one message on the client and let the bus message handler dispatch it
+ */
+static AJ_Status Pump(uint32_t timeout)
+{
+    AJ_Message msg;
+    AJ_Status status = AJ_UnmarshalMsg(&client, &msg, timeout);
+
+    if (status == AJ_OK) {
+        status = AJ_BusHandleBusMessage(&msg);
+        AJ_CloseMsg(&msg);
+    }
+    return (status == AJ_ERR_TIMEOUT) ? AJ_OK : status;
+}
+
+/*
+ * Pipelined calls must all complete, each with its own reply
+ */
+static void CheckReplies(void)
+{
+    CallResult results[CHECK_CALLS];
+    uint32_t num = min(CHECK_CALLS, AJ_MAX_REPLY_CONTEXTS);
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+    uint32_t done = 0;
+    uint32_t loops = 0;
+
+    memset(results, 0, sizeof(results));
+    for (i = 0; (status == AJ_OK) && (i < num); ++i) {
+        sprintf(results[i].expect, "call %u", i);
+        status = Call(PRX_ECHO, results[i].expect, 0, OnReply, &results[i]);
+    }
+    while ((status == AJ_OK) && (done < num) && (++loops < 100)) {
+        status = Pump(10);
+        for (done = 0, i = 0; i < num; ++i) {
+            done += results[i].done;
+        }
+    }
+    if ((status == AJ_OK) && (done != num)) {
+        status = AJ_ERR_TIMEOUT;
+    }
+    for (i = 0; (status == AJ_OK) && (i < num); ++i) {
+        if (results[i].done != 1) {
+            status = AJ_ERR_FAILURE;
+        } else {
+            status = results[i].status;
+        }
+    }
+    if (status != AJ_OK) {
+        Fail("pipelined replies", status);
+    }
+}
+
+/*
+ * A call that never gets a reply must complete with a timeout error
+ */
+static void CheckTimeout(void)
+{
+    CallResult result;
+    AJ_Status status;
+    uint32_t loops = 0;
+
+    memset(&result, 0, sizeof(result));
+    status = Call(PRX_DROP, "dropped", 20, OnReply, &result);
+    while ((status == AJ_OK) && !result.done && (++loops < 100)) {
+        status = Pump(10);
+    }
+    if ((status == AJ_OK) && (result.status != AJ_ERR_TIMEOUT)) {
+        status = result.done ? result.status : AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("timeout", status);
+    }
+}
+
+/*
+ * A reply with the wrong signature is discarded but the callback is still told about it
+ */
+static void CheckMismatch(void)
+{
+    CallResult result;
+    AJ_Status status;
+    uint32_t loops = 0;
+
+    memset(&result, 0, sizeof(result));
+    status = Call(PRX_MISMATCH, "mismatch", 0, OnReply, &result);
+    while ((status == AJ_OK) && !result.done && (++loops < 100)) {
+        /*
+         * The discarded reply is also reported by AJ_UnmarshalMsg()
+         */
+        status = Pump(10);
+        if (status == AJ_ERR_SIGNATURE) {
+            status = AJ_OK;
+        }
+    }
+    if ((status == AJ_OK) && (result.status != AJ_ERR_SIGNATURE)) {
+        status = result.done ? AJ_ERR_FAILURE : AJ_ERR_TIMEOUT;
+    }
+    if (status != AJ_OK) {
+        Fail("signature mismatch", status);
+    }
+}
+
+static void OnAdvertiseReply(AJ_Message* reply, AJ_Status status, void* context)
+{
+    CallResult* result = (CallResult*)context;
+
+    if (status != AJ_OK) {
+        result->status = status;
+    } else if (reply->msgId != AJ_REPLY_ID(AJ_METHOD_ADVERTISE_NAME)) {
+        result->status = AJ_ERR_NO_MATCH;
+    } else {
+        uint32_t disposition;
+        result->status = AJ_UnmarshalArgs(reply, "u", &disposition);
+        if ((result->status == AJ_OK) && (disposition != 1)) {
+            result->status = AJ_ERR_UNMARSHAL;
+        }
+    }
+    ++result->done;
+}
+
+/*
+ * Replies to bus methods that AJ_BusHandleBusMessage() handles itself still go to the callback
+ */
+static void CheckBusMethod(void)
+{
+    CallResult result;
+    AJ_Message msg;
+    AJ_Status status;
+    uint32_t loops = 0;
+
+    memset(&result, 0, sizeof(result));
+    status = AJ_MarshalMethodCallAsync(&client, &msg, AJ_METHOD_ADVERTISE_NAME, SERVICE_NAME, 0, 0, 0, OnAdvertiseReply, &result);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "sq", "org.alljoyn.async_test", AJ_TRANSPORT_ANY);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    while ((status == AJ_OK) && !result.done && (++loops < 100)) {
+        status = Pump(10);
+    }
+    if (status == AJ_OK) {
+        status = result.done ? result.status : AJ_ERR_TIMEOUT;
+    }
+    if (status != AJ_OK) {
+        Fail("bus method", status);
+    }
+}
+
+/*
+ * Running out of reply contexts is reported so the caller can hold back further calls
+ */
+static void CheckResources(void)
+{
+    uint32_t completed = 0;
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+    uint32_t loops = 0;
+
+    for (i = 0; (status == AJ_OK) && (i < AJ_MAX_REPLY_CONTEXTS); ++i) {
+        status = Call(PRX_ECHO, "fill", 0, OnBenchReply, &completed);
+    }
+    if (status == AJ_OK) {
+        status = Call(PRX_ECHO, "overflow", 0, OnBenchReply, &completed);
+        status = (status == AJ_ERR_RESOURCES) ? AJ_OK : AJ_ERR_FAILURE;
+    }
+    while ((status == AJ_OK) && (completed < AJ_MAX_REPLY_CONTEXTS) && (++loops < 1000)) {
+        status = Pump(10);
+    }
+    if ((status == AJ_OK) && (completed != AJ_MAX_REPLY_CONTEXTS)) {
+        status = AJ_ERR_TIMEOUT;
+    }
+    if (status != AJ_OK) {
+        Fail("resources", status);
+    }
+}
+
+/*
+ * Replies to calls made without a callback still go to the application
+ */
+static void CheckSyncCall(void)
+{
+    AJ_Message msg;
+    AJ_Status status;
+    char* str;
+
+    status = AJ_MarshalMethodCall(&client, &msg, PRX_ECHO, SERVICE_NAME, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "s", "sync");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&client, &msg, 10);
+    }
+    if (status == AJ_OK) {
+        if (msg.msgId != AJ_REPLY_ID(PRX_ECHO)) {
+            status = AJ_ERR_NO_MATCH;
+        } else if (AJ_DispatchReply(&msg)) {
+            status = AJ_ERR_FAILURE;
+        } else {
+            status = AJ_UnmarshalArgs(&msg, "s", &str);
+            if ((status == AJ_OK) && strcmp(str, "sync")) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail("sync call", status);
+    }
+}
+
+static void CallBench(uint32_t inFlight)
+{
+    char name[32];
+    AJ_Time timer;
+    AJ_Status status = AJ_OK;
+    uint32_t issued = 0;
+    uint32_t completed = 0;
+    uint32_t elapsed;
+
+    sprintf(name, "%u calls in flight", inFlight);
+    if (inFlight > AJ_MAX_REPLY_CONTEXTS) {
+        AJ_Printf("%-32s skipped, only %u reply contexts\n", name, AJ_MAX_REPLY_CONTEXTS);
+        return;
+    }
+    AJ_InitTimer(&timer);
+    while ((status == AJ_OK) && (completed < BENCH_CALLS)) {
+        while ((status == AJ_OK) && ((issued - completed) < inFlight) && (issued < BENCH_CALLS)) {
+            status = Call(PRX_ECHO, "ping", 0, OnBenchReply, &completed);
+            ++issued;
+        }
+        if (status == AJ_OK) {
+            status = Pump(100);
+        }
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_Printf("%-32s %u calls in %u ms, %u calls/sec\n", name, BENCH_CALLS, elapsed,
+              elapsed ? (uint32_t)(((uint64_t)BENCH_CALLS * 1000) / elapsed) : 0);
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, ProxyObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    TestPipeInitBus(&client, ":1a.2", clientTx, sizeof(clientTx), clientRx, sizeof(clientRx), &toService, &toClient);
+    client.sock.rx.recv = ClientRecv;
+    TestPipeInitBus(&service, SERVICE_NAME, serviceTx, sizeof(serviceTx), serviceRx, sizeof(serviceRx), &toClient, &toService);
+
+    CheckReplies();
+    CheckTimeout();
+    CheckMismatch();
+    CheckBusMethod();
+    CheckResources();
+    CheckSyncCall();
+
+    CallBench(1);
+    CallBench(8);
+    CallBench(64);
+
+    AJ_Printf("asynccall %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
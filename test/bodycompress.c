@@ -0,0 +1,377 @@
+/**
+ * @file  Body compression round trip test and benchmark over a simulated 115200 baud link
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alljoyn.h"
+#include "aj_compress.h"
+#include "testpipe.h"
+
+static const char* const reportInterface[] = {
+    "org.alljoyn.bodycompress_test",
+    "!Report >s",
+    "!Samples >ai",
+    "!Blob >ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription reportInterfaces[] = {
+    reportInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/bodycompress_test", reportInterfaces },
+    { NULL }
+};
+
+#define APP_REPORT   AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_SAMPLES  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_BLOB     AJ_APP_MESSAGE_ID(0, 0, 2)
+
+static const char PeerB[] = ":1b.3";
+
+/*
+ * Simulated serial link, 8N1 framing puts 10 bits on the wire for every byte
+ */
+#define LINK_BITRATE   115200
+#define BITS_PER_BYTE  10
+
+#define NUM_MESSAGES   50
+#define MAX_PAYLOAD    640
+
+static TestPipe pipeAtoB;
+static TestPipe pipeBtoA;
+
+static uint8_t txDataA[1024];
+static uint8_t rxDataA[1024];
+static uint8_t txDataB[1024];
+static uint8_t rxDataB[1024];
+
+static AJ_BusAttachment busA;
+static AJ_BusAttachment busB;
+
+static uint8_t payload[MAX_PAYLOAD];
+static uint32_t payloadLen;
+
+static uint32_t received;
+static uint32_t failures;
+
+/*
+ * A status report as text
+ */
+static void MakeReport(uint32_t seq)
+{
+    uint32_t i;
+
+    payloadLen = 0;
+    for (i = 0; (payloadLen + 64) < MAX_PAYLOAD; ++i) {
+        payloadLen += sprintf((char*)&payload[payloadLen], "{\"sensor\":\"temp%u\",\"value\":%u,\"unit\":\"C\",\"ok\":true},",
+                              i, 20 + ((seq + i * 7) % 13));
+    }
+}
+
+/*
+ * Slowly varying readings from an ADC
+ */
+static void MakeSamples(uint32_t seq)
+{
+    uint32_t i;
+    int32_t* samples = (int32_t*)payload;
+
+    payloadLen = 128 * sizeof(int32_t);
+    for (i = 0; i < 128; ++i) {
+        samples[i] = 2048 + (int32_t)((seq + i) / 16);
+    }
+}
+
+/*
+ * Random bytes do not compress
+ */
+static void MakeBlob(uint32_t seq)
+{
+    uint32_t i;
+
+    payloadLen = 512;
+    for (i = 0; i < payloadLen; ++i) {
+        payload[i] = (uint8_t)rand();
+    }
+}
+
+static AJ_Status SendPayload(uint32_t msgId, uint8_t flags)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Arg arg;
+
+    status = AJ_MarshalSignal(&busA, &msg, msgId, PeerB, 0, flags, 0);
+    if (status == AJ_OK) {
+        if (msgId == APP_REPORT) {
+            status = AJ_MarshalArgs(&msg, "s", payload);
+        } else if (msgId == APP_SAMPLES) {
+            status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_INT32, AJ_ARRAY_FLAG, payload, payloadLen));
+        } else {
+            status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, payload, payloadLen));
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static void CheckPayload(AJ_Message* msg)
+{
+    AJ_Status status;
+    const void* data = NULL;
+    size_t len = 0;
+
+    if (msg->msgId == APP_REPORT) {
+        const char* str;
+        status = AJ_UnmarshalArgs(msg, "s", &str);
+        data = str;
+        len = (status == AJ_OK) ? strlen(str) : 0;
+    } else {
+        AJ_Arg arg;
+        status = AJ_UnmarshalArg(msg, &arg);
+        data = arg.val.v_data;
+        len = arg.len;
+    }
+    if ((status != AJ_OK) || (len != payloadLen) || (memcmp(data, payload, len) != 0)) {
+        AJ_Printf("Bad message body %s\n", AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    ++received;
+}
+
+/*
+ * Deliver everything queued in either direction
+ */
+static void Pump(void)
+{
+    while ((pipeAtoB.tail != pipeAtoB.head) || (pipeBtoA.tail != pipeBtoA.head)) {
+        AJ_Message msg;
+        AJ_Status status;
+
+        while ((status = AJ_UnmarshalMsg(&busB, &msg, 0)) != AJ_ERR_TIMEOUT) {
+            if (status != AJ_OK) {
+                AJ_Printf("B: AJ_UnmarshalMsg returned %s\n", AJ_StatusText(status));
+                ++failures;
+                return;
+            }
+            if (msg.hdr->msgType == AJ_MSG_SIGNAL) {
+                CheckPayload(&msg);
+            } else {
+                AJ_BusHandleBusMessage(&msg);
+            }
+            AJ_CloseMsg(&msg);
+        }
+        while ((status = AJ_UnmarshalMsg(&busA, &msg, 0)) != AJ_ERR_TIMEOUT) {
+            if (status != AJ_OK) {
+                AJ_Printf("A: AJ_UnmarshalMsg returned %s\n", AJ_StatusText(status));
+                ++failures;
+                return;
+            }
+            AJ_BusHandleBusMessage(&msg);
+            AJ_CloseMsg(&msg);
+        }
+    }
+}
+
+/*
+ * Returns the link time in milliseconds for sending NUM_MESSAGES messages, elapsed is the time
+ * in milliseconds it took to marshal, compress and unmarshal them.
+ */
+static uint32_t RunPass(uint32_t msgId, void (*make)(uint32_t), uint8_t flags, uint32_t* wire, uint32_t* elapsed)
+{
+    uint32_t i;
+    AJ_Time timer;
+
+    received = 0;
+    *wire = pipeAtoB.wire;
+    AJ_InitTimer(&timer);
+    for (i = 0; i < NUM_MESSAGES; ++i) {
+        make(i);
+        SendPayload(msgId, flags);
+        Pump();
+    }
+    *elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    *wire = pipeAtoB.wire - *wire;
+    if (received != NUM_MESSAGES) {
+        AJ_Printf("Received %u of %u messages\n", received, NUM_MESSAGES);
+        ++failures;
+    }
+    return (uint32_t)(((uint64_t)*wire * BITS_PER_BYTE * 1000) / LINK_BITRATE);
+}
+
+static void Benchmark(const char* name, uint32_t msgId, void (*make)(uint32_t))
+{
+    const AJ_BodyCompressionStats* stats = AJ_GetBodyCompressionStats();
+    uint32_t plainWire;
+    uint32_t packedWire;
+    uint32_t plainMs;
+    uint32_t packedMs;
+    uint32_t plainElapsed;
+    uint32_t packedElapsed;
+    uint32_t bytesIn = stats->bytesIn;
+    uint32_t bytesOut = stats->bytesOut;
+    uint32_t compressed = stats->compressed;
+
+    plainMs = RunPass(msgId, make, 0, &plainWire, &plainElapsed);
+    packedMs = RunPass(msgId, make, AJ_FLAG_BODY_COMPRESSED, &packedWire, &packedElapsed);
+    bytesIn = stats->bytesIn - bytesIn;
+    bytesOut = stats->bytesOut - bytesOut;
+    compressed = stats->compressed - compressed;
+
+    AJ_Printf("%s: %u bytes/msg, %u of %u compressed, body ratio %u%%, wire %u -> %u bytes, link time at %u baud %u -> %u ms, compression %u us/msg\n",
+              name, payloadLen, compressed, NUM_MESSAGES, bytesIn ? (bytesOut * 100) / bytesIn : 100,
+              plainWire, packedWire, LINK_BITRATE, plainMs, packedMs,
+              ((packedElapsed - min(plainElapsed, packedElapsed)) * 1000) / NUM_MESSAGES);
+}
+
+/*
+ * Round trip bodies with lots of different shapes through the in-place compressor
+ */
+static void RoundTrips(void)
+{
+    const AJ_BodyCompressionStats* stats = AJ_GetBodyCompressionStats();
+    uint32_t compressed = stats->compressed;
+    uint32_t i;
+    uint32_t j;
+
+    received = 0;
+    for (i = 0; i < 400; ++i) {
+        uint32_t run = 1 + (i % 23);
+        uint32_t alphabet = 2 + (i % 7);
+
+        payloadLen = 128 + (i * 37) % (MAX_PAYLOAD - 128);
+        for (j = 0; j < payloadLen; ++j) {
+            if ((i & 3) == 0) {
+                payload[j] = (uint8_t)(j / run);
+            } else if ((i & 3) == 1) {
+                payload[j] = (uint8_t)(rand() % alphabet);
+            } else if ((i & 3) == 2) {
+                payload[j] = (j < run * 8) ? (uint8_t)rand() : payload[j - run * 8];
+            } else {
+                payload[j] = ((rand() % 4) == 0) ? (uint8_t)rand() : 'a';
+            }
+        }
+        SendPayload(APP_BLOB, AJ_FLAG_BODY_COMPRESSED);
+        Pump();
+    }
+    if (received != 400) {
+        AJ_Printf("Round trips: received %u of 400\n", received);
+        ++failures;
+    }
+    AJ_Printf("Round trips: %u of 400 bodies compressed\n", stats->compressed - compressed);
+}
+
+int AJ_Main(void)
+{
+    const AJ_BodyCompressionStats* stats = AJ_GetBodyCompressionStats();
+    uint32_t skipped;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+    AJ_ClearCompressionRules();
+
+    TestPipeInitBus(&busA, ":1a.2", txDataA, sizeof(txDataA), rxDataA, sizeof(rxDataA), &pipeAtoB, &pipeBtoA);
+    TestPipeInitBus(&busB, PeerB, txDataB, sizeof(txDataB), rxDataB, sizeof(rxDataB), &pipeBtoA, &pipeAtoB);
+
+    /*
+     * The flag is ignored until compression has been negotiated
+     */
+    MakeReport(0);
+    received = 0;
+    SendPayload(APP_REPORT, AJ_FLAG_BODY_COMPRESSED);
+    Pump();
+    if ((received != 1) || (stats->skipped != 1) || stats->compressed) {
+        AJ_Printf("Compressed a body before negotiating\n");
+        ++failures;
+    }
+
+    AJ_NegotiateBodyCompression(&busA, PeerB);
+    Pump();
+    if (!AJ_BodyCompressionNegotiated(PeerB) || !AJ_BodyCompressionNegotiated(":1a.2")) {
+        AJ_Printf("Body compression was not negotiated\n");
+        ++failures;
+    }
+
+    Benchmark("Report (text)", APP_REPORT, MakeReport);
+    Benchmark("Samples (ai)", APP_SAMPLES, MakeSamples);
+    skipped = stats->skipped;
+    Benchmark("Blob (random)", APP_BLOB, MakeBlob);
+    if ((stats->skipped - skipped) != NUM_MESSAGES) {
+        AJ_Printf("Random bodies should not be compressed\n");
+        ++failures;
+    }
+
+    /*
+     * Bodies below the threshold are not compressed
+     */
+    AJ_SetBodyCompressionThreshold(1024);
+    skipped = stats->skipped;
+    MakeReport(0);
+    received = 0;
+    SendPayload(APP_REPORT, AJ_FLAG_BODY_COMPRESSED);
+    Pump();
+    if ((received != 1) || (stats->skipped != skipped + 1)) {
+        AJ_Printf("Compressed a body below the threshold\n");
+        ++failures;
+    }
+    AJ_SetBodyCompressionThreshold(AJ_BODY_COMPRESSION_THRESHOLD);
+
+    RoundTrips();
+
+    /*
+     * Corrupt compressed bodies are discarded
+     */
+    {
+        AJ_Message msg;
+        uint32_t i;
+
+        for (i = 0; i < 100; ++i) {
+            MakeReport(i);
+            SendPayload(APP_REPORT, AJ_FLAG_BODY_COMPRESSED);
+            pipeAtoB.data[pipeAtoB.tail - 1 - (rand() % 200)] ^= (uint8_t)(1 + rand() % 255);
+            if (AJ_UnmarshalMsg(&busB, &msg, 0) == AJ_OK) {
+                AJ_CloseMsg(&msg);
+            }
+            pipeAtoB.head = 0;
+            pipeAtoB.tail = 0;
+            AJ_IO_BUF_RESET(&busB.sock.rx);
+        }
+    }
+
+    if (failures) {
+        AJ_Printf("bodycompress FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("bodycompress PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
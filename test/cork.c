@@ -0,0 +1,414 @@
+/**
+ * @file  Corked signal bursts batched into single writes
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/tcp.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_net.h"
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.cork_test",
+    "!Reading seq>u value>i name>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/cork_test", sensorInterfaces },
+    { NULL }
+};
+
+#define APP_READING  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define PRX_READING  AJ_PRX_MESSAGE_ID(0, 0, 0)
+
+/*
+ * A burst of readings fits in the cork buffer
+ */
+#define BURST_SIGNALS   24
+#define BENCH_BURSTS    2000
+
+/*
+ * Enough signals to overflow the cork buffer several times
+ */
+#define OVERFLOW_SIGNALS  200
+
+/*
+ * Everything sent is appended to the wire, the receive function replays it
+ */
+typedef struct _Wire {
+    uint8_t data[0x10000];
+    uint32_t len;
+    uint32_t pos;
+    uint32_t sends;
+    uint32_t moreSends;
+    uint8_t lastFlags;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    ++wire.sends;
+    if (buf->flags & AJ_IO_BUF_MORE) {
+        ++wire.moreSends;
+    }
+    wire.lastFlags = buf->flags;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos), len);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static void InitBus(AJ_TxFunc send, void* context)
+{
+    AJ_ReleaseCorkedMsgs(&bus);
+    memset(&wire, 0, sizeof(wire));
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, context);
+    bus.sock.tx.send = send;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+}
+
+static AJ_Status SendReading(uint32_t seq)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_READING, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "uis", seq, -(int32_t)seq, "temperature");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal readings from the wire checking they arrive in sequence
+ */
+static AJ_Status ReceiveReadings(uint32_t first, uint32_t num)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t seq;
+
+    for (seq = first; (status == AJ_OK) && (seq < first + num); ++seq) {
+        AJ_Message msg;
+        uint32_t rxSeq;
+        int32_t value;
+        char* name;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != APP_READING)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "uis", &rxSeq, &value, &name);
+            if ((status == AJ_OK) && ((rxSeq != seq) || (value != -(int32_t)seq) || strcmp(name, "temperature"))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            AJ_CloseMsg(&msg);
+        }
+    }
+    return status;
+}
+
+/*
+ * A corked burst is one write when uncorked
+ */
+static void CheckBurst(void)
+{
+    AJ_Status status;
+    uint32_t i;
+
+    InitBus(TxFunc, NULL);
+    status = AJ_CorkMsgs(&bus);
+    for (i = 0; (status == AJ_OK) && (i < BURST_SIGNALS); ++i) {
+        status = SendReading(i);
+    }
+    if ((status == AJ_OK) && wire.sends) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = AJ_UncorkMsgs(&bus);
+    }
+    if ((status == AJ_OK) && ((wire.sends != 1) || wire.moreSends)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, BURST_SIGNALS);
+    }
+    /*
+     * Once uncorked messages are sent as they are delivered
+     */
+    if (status == AJ_OK) {
+        status = SendReading(BURST_SIGNALS);
+    }
+    if ((status == AJ_OK) && (wire.sends != 2)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("burst", status);
+    }
+}
+
+/*
+ * Filling the cork buffer flushes it with the more hint set, the final flush clears the hint
+ */
+static void CheckOverflow(void)
+{
+    AJ_Status status;
+    uint32_t i;
+
+    InitBus(TxFunc, NULL);
+    status = AJ_CorkMsgs(&bus);
+    for (i = 0; (status == AJ_OK) && (i < OVERFLOW_SIGNALS); ++i) {
+        status = SendReading(i);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UncorkMsgs(&bus);
+    }
+    if ((status == AJ_OK) && ((wire.sends < 2) || (wire.moreSends != (wire.sends - 1)) || wire.lastFlags)) {
+        status = AJ_ERR_FAILURE;
+    }
+    /*
+     * Each flush except the last is at least half full
+     */
+    if ((status == AJ_OK) && (wire.sends > ((wire.len / (AJ_CORK_BUFFER_SIZE / 2)) + 1))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, OVERFLOW_SIGNALS);
+    }
+    if (status != AJ_OK) {
+        Fail("overflow", status);
+    }
+}
+
+/*
+ * Waiting for a message flushes corked messages
+ */
+static void CheckUnmarshalFlush(void)
+{
+    AJ_Status status;
+
+    InitBus(TxFunc, NULL);
+    status = AJ_CorkMsgs(&bus);
+    if (status == AJ_OK) {
+        status = SendReading(7);
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(7, 1);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UncorkMsgs(&bus);
+    }
+    if ((status == AJ_OK) && (wire.sends != 1)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("unmarshal flush", status);
+    }
+}
+
+/*
+ * The benchmark writes to a TCP loopback connection, a thread drains the other end
+ */
+static uint32_t syscalls;
+static uint32_t bytesSent;
+static uint32_t bytesRecv;
+
+static AJ_Status CountingSend(AJ_IOBuffer* buf)
+{
+    ++syscalls;
+    bytesSent += AJ_IO_BUF_AVAIL(buf);
+    return AJ_Net_Send(buf);
+}
+
+static void* Drain(void* arg)
+{
+    int sock = (int)(intptr_t)arg;
+    uint8_t buf[4096];
+    ssize_t ret;
+
+    while ((ret = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        bytesRecv += (uint32_t)ret;
+    }
+    return NULL;
+}
+
+static uint32_t SegmentsOut(int sock)
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    memset(&info, 0, sizeof(info));
+    if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) {
+        return 0;
+    }
+    return info.tcpi_data_segs_out;
+}
+
+static void BurstBench(const char* name, uint8_t corked)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    pthread_t drainer;
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t segments;
+    uint32_t signals = BURST_SIGNALS * BENCH_BURSTS;
+    uint32_t i;
+    int listener;
+    int sender;
+    int receiver;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    sender = socket(AF_INET, SOCK_STREAM, 0);
+    if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&addr, &addrLen) != 0) ||
+        (connect(sender, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+        ((receiver = accept(listener, NULL, NULL)) < 0)) {
+        Fail(name, AJ_ERR_CONNECT);
+        close(listener);
+        close(sender);
+        return;
+    }
+    pthread_create(&drainer, NULL, Drain, (void*)(intptr_t)receiver);
+
+    InitBus(CountingSend, (void*)(intptr_t)sender);
+    syscalls = 0;
+    bytesSent = 0;
+    bytesRecv = 0;
+    segments = SegmentsOut(sender);
+
+    AJ_InitTimer(&timer);
+    for (i = 0; (status == AJ_OK) && (i < signals); ++i) {
+        if (corked && ((i % BURST_SIGNALS) == 0)) {
+            status = AJ_CorkMsgs(&bus);
+        }
+        if (status == AJ_OK) {
+            status = SendReading(i);
+        }
+        if ((status == AJ_OK) && corked && ((i % BURST_SIGNALS) == (BURST_SIGNALS - 1))) {
+            status = AJ_UncorkMsgs(&bus);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    segments = SegmentsOut(sender) - segments;
+
+    shutdown(sender, SHUT_WR);
+    pthread_join(drainer, NULL);
+    close(sender);
+    close(receiver);
+    close(listener);
+
+    if ((status == AJ_OK) && (bytesRecv != bytesSent)) {
+        status = AJ_ERR_READ;
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_Printf("%-32s %u signals in %u ms, %u ns/signal, %u.%02u signals/send, %u.%02u signals/packet\n",
+              name, signals, elapsed, (uint32_t)(((uint64_t)elapsed * 1000000) / signals),
+              signals / syscalls, ((signals * 100) / syscalls) % 100,
+              segments ? signals / segments : 0, segments ? ((signals * 100) / segments) % 100 : 0);
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, AppObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+#if AJ_CORK_BUFFER_SIZE
+    CheckBurst();
+    CheckOverflow();
+    CheckUnmarshalFlush();
+#else
+    AJ_Printf("Corking is disabled, AJ_CORK_BUFFER_SIZE is zero\n");
+#endif
+
+    BurstBench("uncorked", FALSE);
+    BurstBench("corked bursts", TRUE);
+
+    AJ_Printf("cork %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @file  CRC16 correctness and throughput test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alljoyn.h"
+#include "aj_crc16.h"
+#include "aj_util.h"
+
+#define BENCH_BYTES  (64 * 1024 * 1024)
+
+/*
+ * Initial value of the running CRC as used by the serial transport
+ */
+#define CRC16_INIT   0xFFFF
+
+static uint8_t data[4096 + 8];
+
+/*
+ * Bit at a time reference implementation of the SLAP CRC (reflected CRC-CCITT)
+ */
+static uint16_t ReferenceCRC(const uint8_t* buf, uint16_t len, uint16_t crc)
+{
+    int i;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (i = 0; i < 8; ++i) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static int Verify(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < 20000; ++i) {
+        uint16_t offset = rand() % 8;
+        uint16_t len = rand() % (sizeof(data) - offset);
+        uint16_t split = len ? rand() % len : 0;
+        uint16_t crc = CRC16_INIT;
+        uint16_t expect = ReferenceCRC(data + offset, len, CRC16_INIT);
+
+        /*
+         * Compute in two pieces to check the running CRC is carried over correctly
+         */
+        AJ_CRC16_Compute(data + offset, split, &crc);
+        AJ_CRC16_Compute(data + offset + split, len - split, &crc);
+        if (crc != expect) {
+            AJ_Printf("CRC mismatch offset=%u len=%u split=%u got %04x expected %04x\n", offset, len, split, crc, expect);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void Bench(uint16_t len)
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t total = 0;
+    uint16_t crc = CRC16_INIT;
+
+    AJ_InitTimer(&timer);
+    while (total < BENCH_BYTES) {
+        AJ_CRC16_Compute(data, len, &crc);
+        total += len;
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_Printf("len %4u: %u bytes in %u ms, %u KB/sec (crc %04x)\n", len, total, elapsed,
+              elapsed ? (uint32_t)(((uint64_t)total * 1000 / elapsed) / 1024) : 0, crc);
+}
+
+int AJ_Main(void)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)rand();
+    }
+
+#ifdef AJ_CRC16_SLICE_BY_8
+    AJ_Printf("CRC16 slicing-by-8\n");
+#else
+    AJ_Printf("CRC16 byte table\n");
+#endif
+
+    if (!Verify()) {
+        AJ_Printf("CRC16 test FAILED\n");
+        return 1;
+    }
+    AJ_Printf("CRC16 matches reference implementation\n");
+
+    /*
+     * Typical SLAP packet sizes
+     */
+    Bench(8);
+    Bench(104);
+    Bench(256);
+    Bench(1024);
+    Bench(4096);
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,394 @@
+/**
+ * @file  Member descriptor and signature checking test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+
+static const char* const testInterface[] = {
+    "org.alljoyn.alljoyn_test",
+    "?my_ping inStr<s outStr>s",
+    "?time_ping <u <q >u >q",
+    "?no_args",
+    "!my_signal >a{ys}",
+    "!my_signal_ex >s >i",
+    "@ro_val>i",
+    "@rw_val=s",
+    "@wo_val<u",
+    NULL
+};
+
+/*
+ * The same interface with a different signature for my_signal
+ */
+static const char* const changedInterface[] = {
+    "org.alljoyn.alljoyn_test",
+    "?my_ping inStr<s outStr>s",
+    "?time_ping <u <q >u >q",
+    "?no_args",
+    "!my_signal >as",
+    "!my_signal_ex >s >i",
+    "@ro_val>i",
+    "@rw_val=s",
+    "@wo_val<u",
+    NULL
+};
+
+static const AJ_InterfaceDescription testInterfaces[] = {
+    AJ_PropertiesIface,
+    testInterface,
+    NULL
+};
+
+static const AJ_InterfaceDescription changedInterfaces[] = {
+    AJ_PropertiesIface,
+    changedInterface,
+    NULL
+};
+
+static const AJ_Object TestObjects[] = {
+    { "/org/alljoyn/alljoyn_test", testInterfaces },
+    { NULL }
+};
+
+static const AJ_Object ChangedObjects[] = {
+    { "/org/alljoyn/alljoyn_test", changedInterfaces },
+    { NULL }
+};
+
+#define PRX_GET_PROP       AJ_PRX_MESSAGE_ID(0, 0, AJ_PROP_GET)
+#define PRX_SET_PROP       AJ_PRX_MESSAGE_ID(0, 0, AJ_PROP_SET)
+#define PRX_MY_PING        AJ_PRX_MESSAGE_ID(0, 1, 0)
+#define PRX_TIME_PING      AJ_PRX_MESSAGE_ID(0, 1, 1)
+#define PRX_NO_ARGS        AJ_PRX_MESSAGE_ID(0, 1, 2)
+#define PRX_MY_SIGNAL      AJ_PRX_MESSAGE_ID(0, 1, 3)
+#define PRX_MY_SIGNAL_EX   AJ_PRX_MESSAGE_ID(0, 1, 4)
+#define PRX_RO_VAL         AJ_PRX_PROPERTY_ID(0, 1, 5)
+#define PRX_RW_VAL         AJ_PRX_PROPERTY_ID(0, 1, 6)
+#define PRX_WO_VAL         AJ_PRX_PROPERTY_ID(0, 1, 7)
+
+/*
+ * Messages sent to the proxy objects are received by the identical local objects
+ */
+#define APP_ID(prx)  (((prx) & 0x00FFFFFF) | (AJ_APP_ID_FLAG << 24))
+
+static const char ServiceName[] = "org.alljoyn.svclite";
+
+/*
+ * Loopback wire
+ */
+static uint8_t wire[2048];
+static uint32_t wireLen;
+static uint32_t wirePos;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wireLen + tx) > sizeof(wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire + wireLen, buf->readPtr, tx);
+    wireLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), wireLen - wirePos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire + wirePos, rx);
+    buf->writePtr += rx;
+    wirePos += rx;
+    if (wirePos == wireLen) {
+        wirePos = 0;
+        wireLen = 0;
+    }
+    return AJ_OK;
+}
+
+static void Fail(const char* test, const char* what)
+{
+    AJ_Printf("%s: %s\n", test, what);
+    ++failures;
+}
+
+/*
+ * Receive a message and check the message id it was identified as
+ */
+static AJ_Status Receive(const char* test, AJ_Message* msg, uint32_t msgId, const char* sig)
+{
+    AJ_Status status = AJ_UnmarshalMsg(&bus, msg, 0);
+
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (msg->msgId != msgId) {
+        AJ_Printf("%s: expected msgId %08x got %08x\n", test, msgId, msg->msgId);
+        ++failures;
+    }
+    if (strcmp(msg->signature, sig)) {
+        AJ_Printf("%s: expected signature \"%s\" got \"%s\"\n", test, sig, msg->signature);
+        ++failures;
+    }
+    return status;
+}
+
+static void CheckMember(const char* test, uint32_t msgId, const char* sig)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    if ((msgId == PRX_MY_SIGNAL) || (msgId == PRX_MY_SIGNAL_EX)) {
+        status = AJ_MarshalSignal(&bus, &msg, msgId, NULL, 0, 0, 0);
+    } else {
+        status = AJ_MarshalMethodCall(&bus, &msg, msgId, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    }
+    if (status == AJ_OK) {
+        if (strcmp(msg.signature, sig)) {
+            AJ_Printf("%s: marshaled signature \"%s\" expected \"%s\"\n", test, msg.signature, sig);
+            ++failures;
+        }
+        switch (msgId) {
+        case PRX_MY_PING:
+            status = AJ_MarshalArgs(&msg, "s", "ping");
+            break;
+
+        case PRX_TIME_PING:
+            status = AJ_MarshalArgs(&msg, "uq", 1, 2);
+            break;
+
+        case PRX_MY_SIGNAL:
+            {
+                AJ_Arg arg;
+                status = AJ_MarshalContainer(&msg, &arg, AJ_ARG_ARRAY);
+                if (status == AJ_OK) {
+                    status = AJ_MarshalCloseContainer(&msg, &arg);
+                }
+            }
+            break;
+
+        case PRX_MY_SIGNAL_EX:
+            status = AJ_MarshalArgs(&msg, "si", "ex", 3);
+            break;
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail(test, "failed to send");
+        return;
+    }
+    status = Receive(test, &msg, APP_ID(msgId), sig);
+    if (status != AJ_OK) {
+        AJ_Printf("%s: AJ_UnmarshalMsg returned %s\n", test, AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    AJ_CloseMsg(&msg);
+}
+
+/*
+ * A method call and its reply
+ */
+static void CheckReply(void)
+{
+    AJ_Status status;
+    AJ_Message call;
+    AJ_Message reply;
+    AJ_Message msg;
+    char* str;
+
+    status = AJ_MarshalMethodCall(&bus, &call, PRX_MY_PING, ServiceName, 0, 0, 1000);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&call, "s", "ping");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&call);
+    }
+    if (status == AJ_OK) {
+        status = Receive("reply", &call, APP_ID(PRX_MY_PING), "s");
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalArgs(&call, "s", &str);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalReplyMsg(&call, &reply);
+        if (strcmp(reply.signature, "s")) {
+            Fail("reply", "bad reply signature");
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&reply, "s", str);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&reply);
+    }
+    AJ_CloseMsg(&call);
+    if (status == AJ_OK) {
+        status = Receive("reply", &msg, AJ_REPLY_ID(PRX_MY_PING), "s");
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("reply: %s\n", AJ_StatusText(status));
+        ++failures;
+    }
+}
+
+/*
+ * Get or set a property and check the outcome of the receiver's property lookup
+ */
+static void CheckProperty(const char* test, uint8_t op, uint32_t propId, const char* sig, size_t sigLen, AJ_Status expect)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t rxPropId;
+    char rxSig[16];
+
+    status = AJ_MarshalMethodCall(&bus, &msg, (op == AJ_PROP_GET) ? PRX_GET_PROP : PRX_SET_PROP, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalPropertyArgs(&msg, propId);
+    }
+    if ((status == AJ_OK) && (op == AJ_PROP_SET)) {
+        if (sig[0] == 's') {
+            status = AJ_MarshalArgs(&msg, "s", "value");
+        } else if (sig[0] == 'u') {
+            status = AJ_MarshalArgs(&msg, "u", 7);
+        } else {
+            status = AJ_MarshalArgs(&msg, "i", 7);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, APP_ID((op == AJ_PROP_GET) ? PRX_GET_PROP : PRX_SET_PROP), (op == AJ_PROP_GET) ? "ss" : "ssv");
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("%s: failed %s\n", test, AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    status = AJ_UnmarshalPropertyArgs(&msg, &rxPropId, rxSig, sigLen);
+    if (status != expect) {
+        AJ_Printf("%s: AJ_UnmarshalPropertyArgs returned %s expected %s\n", test, AJ_StatusText(status), AJ_StatusText(expect));
+        ++failures;
+    } else if (status == AJ_OK) {
+        if ((rxPropId != APP_ID(propId)) || strcmp(rxSig, sig)) {
+            AJ_Printf("%s: got property %08x \"%s\"\n", test, rxPropId, rxSig);
+            ++failures;
+        }
+    }
+    AJ_CloseMsg(&msg);
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(TestObjects, TestObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    CheckMember("my_ping", PRX_MY_PING, "s");
+    CheckMember("time_ping", PRX_TIME_PING, "uq");
+    CheckMember("no_args", PRX_NO_ARGS, "");
+    CheckMember("my_signal", PRX_MY_SIGNAL, "a{ys}");
+    CheckMember("my_signal_ex", PRX_MY_SIGNAL_EX, "si");
+    CheckReply();
+
+    CheckProperty("get ro_val", AJ_PROP_GET, PRX_RO_VAL, "i", 16, AJ_OK);
+    CheckProperty("get rw_val", AJ_PROP_GET, PRX_RW_VAL, "s", 16, AJ_OK);
+    CheckProperty("get wo_val", AJ_PROP_GET, PRX_WO_VAL, "u", 16, AJ_ERR_DISALLOWED);
+    CheckProperty("set ro_val", AJ_PROP_SET, PRX_RO_VAL, "i", 16, AJ_ERR_DISALLOWED);
+    CheckProperty("set rw_val", AJ_PROP_SET, PRX_RW_VAL, "s", 16, AJ_OK);
+    CheckProperty("set wo_val", AJ_PROP_SET, PRX_WO_VAL, "u", 16, AJ_OK);
+    CheckProperty("small signature buffer", AJ_PROP_GET, PRX_RO_VAL, "i", 1, AJ_ERR_RESOURCES);
+
+    /*
+     * The receiver's descriptors are rebuilt when the objects are registered again. The signal was
+     * marshaled with the old signature so doesn't match.
+     */
+    status = AJ_MarshalSignal(&bus, &msg, PRX_MY_SIGNAL_EX, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "si", "ex", 3);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    status = AJ_MarshalSignal(&bus, &msg, PRX_MY_SIGNAL, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        AJ_Arg arg;
+        AJ_MarshalContainer(&msg, &arg, AJ_ARG_ARRAY);
+        AJ_MarshalCloseContainer(&msg, &arg);
+        status = AJ_DeliverMsg(&msg);
+    }
+    AJ_RegisterObjects(ChangedObjects, ChangedObjects);
+    status = Receive("changed my_signal_ex", &msg, APP_ID(PRX_MY_SIGNAL_EX), "si");
+    if (status == AJ_OK) {
+        AJ_CloseMsg(&msg);
+    } else {
+        Fail("changed my_signal_ex", AJ_StatusText(status));
+    }
+    status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    if (status != AJ_ERR_SIGNATURE) {
+        AJ_Printf("changed my_signal: expected AJ_ERR_SIGNATURE got %s\n", AJ_StatusText(status));
+        ++failures;
+    }
+    CheckMember("changed my_signal", PRX_MY_SIGNAL_EX, "si");
+
+    if (failures) {
+        AJ_Printf("descriptors FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("descriptors PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
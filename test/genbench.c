@@ -0,0 +1,487 @@
+/**
+ * @file  Generated interface tables, message id lookup and marshalers test and benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "genbench_ifaces.h"
+
+#define BENCH_MESSAGES  1000000
+
+/*
+ * Hand written proxy description of the same objects with a different GyroUpdate signature and
+ * without security on the Secret interface, used to send messages the generated tables must reject.
+ */
+static const char* const badSensors[] = {
+    "org.alljoyn.gen_test.Sensors",
+    "?GetTemperature sensor<u celsius>d",
+    "?GetHumidity sensor<u percent>y",
+    "?GetPressure sensor<u pascal>u",
+    "?Calibrate sensor<u offsets<ai",
+    "?Reset",
+    "?SetName sensor<u name<s",
+    "?GetName sensor<u name>s",
+    "?ListSensors sensors>a(us)",
+    "!TemperatureChanged sensor>u celsius>d",
+    "!Alarm sensor>u level>n reason>s",
+    "!Samples sensor>u values>aq",
+    "!GyroUpdate x>i y>i z>i",
+    NULL
+};
+
+static const char* const badSecret[] = {
+    "org.alljoyn.gen_test.Secret",
+    "?Unlock code<s ok>b",
+    NULL
+};
+
+static const AJ_InterfaceDescription badInterfaces[] = {
+    AJ_PropertiesIface,
+    badSensors,
+    badSensors,
+    badSecret,
+    NULL
+};
+
+static const AJ_Object BadObjects[] = {
+    { "/org/alljoyn/gen_test", badInterfaces },
+    { NULL }
+};
+
+#define BAD_GYRO_UPDATE  AJ_PRX_MESSAGE_ID(0, 1, 11)
+#define BAD_UNLOCK       AJ_PRX_MESSAGE_ID(0, 3, 0)
+
+static const char ServiceName[] = "org.alljoyn.gen_test";
+
+/*
+ * Wire image of the messages sent, the receive function can replay the last message
+ */
+typedef struct _Wire {
+    uint8_t data[1024];
+    uint32_t len;
+    uint32_t pos;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Replay(void)
+{
+    wire.pos = 0;
+    AJ_IO_BUF_RESET(&bus.sock.rx);
+}
+
+static void NewMessage(void)
+{
+    wire.len = 0;
+    Replay();
+}
+
+static void UseLookup(uint8_t generated)
+{
+    AJ_RegisterMsgIdLookup(GenBench_Objects, generated ? GenBench_LookupMsgId : NULL);
+}
+
+static void Fail(const char* test, AJ_Status status)
+{
+    AJ_Printf("%s: failed %s\n", test, AJ_StatusText(status));
+    ++failures;
+}
+
+/*
+ * Receive the message on the wire and check how it was identified
+ */
+static AJ_Status Receive(const char* test, AJ_Message* msg, uint32_t msgId, AJ_Status expect)
+{
+    AJ_Status status = AJ_UnmarshalMsg(&bus, msg, 0);
+
+    if (status != expect) {
+        AJ_Printf("%s: AJ_UnmarshalMsg returned %s expected %s\n", test, AJ_StatusText(status), AJ_StatusText(expect));
+        ++failures;
+        if (status == AJ_OK) {
+            AJ_CloseMsg(msg);
+        }
+        return AJ_ERR_FAILURE;
+    }
+    if ((status == AJ_OK) && (msg->msgId != msgId)) {
+        AJ_Printf("%s: expected msgId %08x got %08x\n", test, msgId, msg->msgId);
+        ++failures;
+        AJ_CloseMsg(msg);
+        return AJ_ERR_FAILURE;
+    }
+    return status;
+}
+
+static AJ_Status SendGyroUpdate(uint32_t msgId, uint8_t typed)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    NewMessage();
+    status = AJ_MarshalSignal(&bus, &msg, msgId, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        if (typed) {
+            status = GenBench_MarshalGyroUpdate(&msg, -1, 2, -3, "gyro");
+        } else {
+            status = AJ_MarshalArgs(&msg, "iiis", -1, 2, -3, "gyro");
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Messages are identified the same way by the generated lookup and string matching
+ */
+static void CheckIdentify(uint8_t generated)
+{
+    static const int32_t offsets[] = { -5, 0, 5, 1000 };
+    static const uint16_t values[] = { 1, 2, 3 };
+    const char* test = generated ? "generated" : "runtime";
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t sensor;
+    int32_t x, y, z;
+    int16_t level;
+    const char* str;
+    const int32_t* offs;
+    const uint16_t* vals;
+    size_t len;
+
+    UseLookup(generated);
+
+    status = SendGyroUpdate(GEN_BENCH_PRX_CHILD_GYRO_UPDATE, TRUE);
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_CHILD_GYRO_UPDATE, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = GenBench_UnmarshalGyroUpdate(&msg, &x, &y, &z, &str);
+        if ((status != AJ_OK) || (x != -1) || (y != 2) || (z != -3) || strcmp(str, "gyro")) {
+            Fail("GyroUpdate", status);
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    NewMessage();
+    status = AJ_MarshalSignal(&bus, &msg, GEN_BENCH_PRX_GEN_TEST_ALARM, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = GenBench_MarshalAlarm(&msg, 7, -2, "overheat");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_GEN_TEST_ALARM, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = GenBench_UnmarshalAlarm(&msg, &sensor, &level, &str);
+        if ((status != AJ_OK) || (sensor != 7) || (level != -2) || strcmp(str, "overheat")) {
+            Fail("Alarm", status);
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    NewMessage();
+    status = AJ_MarshalSignal(&bus, &msg, GEN_BENCH_PRX_CHILD_SAMPLES, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = GenBench_MarshalSamples(&msg, 3, values, ArraySize(values));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_CHILD_SAMPLES, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = GenBench_UnmarshalSamples(&msg, &sensor, &vals, &len);
+        if ((status != AJ_OK) || (sensor != 3) || (len != ArraySize(values)) || memcmp(vals, values, sizeof(values))) {
+            Fail("Samples", status);
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    NewMessage();
+    status = AJ_MarshalMethodCall(&bus, &msg, GEN_BENCH_PRX_GEN_TEST_CALIBRATE, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = GenBench_MarshalCalibrate(&msg, 9, offsets, ArraySize(offsets));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_GEN_TEST_CALIBRATE, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = GenBench_UnmarshalCalibrate(&msg, &sensor, &offs, &len);
+        if ((status != AJ_OK) || (sensor != 9) || (len != ArraySize(offsets)) || memcmp(offs, offsets, sizeof(offsets))) {
+            Fail("Calibrate", status);
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    NewMessage();
+    status = AJ_MarshalMethodCall(&bus, &msg, GEN_BENCH_PRX_CHILD_RESET, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_CHILD_RESET, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        AJ_CloseMsg(&msg);
+    }
+
+    NewMessage();
+    status = AJ_MarshalSignal(&bus, &msg, GEN_BENCH_PRX_CONTROL_RESET, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_CONTROL_RESET, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        AJ_CloseMsg(&msg);
+    }
+
+    /*
+     * Property set
+     */
+    NewMessage();
+    status = AJ_MarshalMethodCall(&bus, &msg, GEN_BENCH_PRX_SET_PROP, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalPropertyArgs(&msg, GEN_BENCH_PRX_MODE);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "s", "eco");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(test, &msg, GEN_BENCH_APP_SET_PROP, AJ_OK);
+    }
+    if (status == AJ_OK) {
+        uint32_t propId;
+        char sig[8];
+        status = AJ_UnmarshalPropertyArgs(&msg, &propId, sig, sizeof(sig));
+        if ((status != AJ_OK) || (propId != GEN_BENCH_APP_MODE) || strcmp(sig, "s")) {
+            Fail("Set Mode", status);
+        }
+        AJ_CloseMsg(&msg);
+    }
+
+    /*
+     * A signal with the wrong signature and a method call that should have been encrypted
+     */
+    AJ_RegisterObjects(GenBench_Objects, BadObjects);
+    NewMessage();
+    status = AJ_MarshalSignal(&bus, &msg, BAD_GYRO_UPDATE, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "iii", 1, 2, 3);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    AJ_RegisterObjects(GenBench_Objects, GenBench_Objects);
+    if (status == AJ_OK) {
+        Receive("bad signature", &msg, 0, AJ_ERR_SIGNATURE);
+    } else {
+        Fail("bad signature", status);
+    }
+    AJ_RegisterObjects(GenBench_Objects, BadObjects);
+    NewMessage();
+    status = AJ_MarshalMethodCall(&bus, &msg, BAD_UNLOCK, ServiceName, 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "s", "1234");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    AJ_RegisterObjects(GenBench_Objects, GenBench_Objects);
+    if (status == AJ_OK) {
+        Receive("not encrypted", &msg, 0, AJ_ERR_SECURITY);
+    } else {
+        Fail("not encrypted", status);
+    }
+}
+
+static void Report(const char* name, uint32_t elapsed)
+{
+    AJ_Printf("%-32s %u messages in %u ms, %u ns/message\n", name, BENCH_MESSAGES, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_MESSAGES));
+}
+
+static void UnmarshalBench(const char* name, uint8_t generated)
+{
+    AJ_Time timer;
+    uint32_t i;
+    int32_t x, y, z;
+    const char* source;
+
+    UseLookup(generated);
+    if (SendGyroUpdate(GEN_BENCH_PRX_CHILD_GYRO_UPDATE, TRUE) != AJ_OK) {
+        Fail(name, AJ_ERR_WRITE);
+        return;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        AJ_Status status;
+        AJ_Message msg;
+
+        Replay();
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != GEN_BENCH_APP_CHILD_GYRO_UPDATE)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            if (generated) {
+                status = GenBench_UnmarshalGyroUpdate(&msg, &x, &y, &z, &source);
+            } else {
+                status = AJ_UnmarshalArgs(&msg, "iiis", &x, &y, &z, &source);
+            }
+            AJ_CloseMsg(&msg);
+        }
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+static void IdentifyBench(const char* name, uint8_t generated)
+{
+    AJ_Time timer;
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t i;
+
+    UseLookup(generated);
+    status = SendGyroUpdate(GEN_BENCH_PRX_CHILD_GYRO_UPDATE, TRUE);
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        status = AJ_IdentifyMessage(&msg);
+        if ((status != AJ_OK) || (msg.msgId != GEN_BENCH_APP_CHILD_GYRO_UPDATE)) {
+            Fail(name, status);
+            break;
+        }
+    }
+    AJ_CloseMsg(&msg);
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+static void MarshalBench(const char* name, uint8_t typed)
+{
+    AJ_Time timer;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        AJ_Status status = SendGyroUpdate(GEN_BENCH_PRX_CHILD_GYRO_UPDATE, typed);
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(GenBench_Objects, GenBench_Objects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    CheckIdentify(FALSE);
+    CheckIdentify(TRUE);
+
+    IdentifyBench("identify runtime", FALSE);
+    IdentifyBench("identify generated", TRUE);
+    UnmarshalBench("unmarshal runtime", FALSE);
+    UnmarshalBench("unmarshal generated", TRUE);
+    MarshalBench("marshal AJ_MarshalArgs", FALSE);
+    MarshalBench("marshal generated", TRUE);
+
+    if (failures) {
+        AJ_Printf("genbench FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("genbench PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,442 @@
+/**
+ * @file  Header field marshaling and unmarshaling test and benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+
+#define BENCH_MESSAGES  1000000
+
+static const char* const testInterface[] = {
+    "org.alljoyn.alljoyn_test",
+    "?my_ping inStr<s outStr>s",
+    "!Gyro_Update >i >i",
+    "!my_signal >a{ys}",
+    NULL
+};
+
+static const AJ_InterfaceDescription testInterfaces[] = {
+    testInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/alljoyn_test", testInterfaces },
+    { NULL }
+};
+
+#define APP_MY_PING      AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_GYRO_UPDATE  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_MY_SIGNAL    AJ_APP_MESSAGE_ID(0, 0, 2)
+
+static const char ServiceName[] = "org.alljoyn.svclite";
+static const char Sender[] = ":1a.2";
+static const uint32_t SessionId = 0x1234;
+static const uint32_t TTL = 500;
+
+/*
+ * Wire image of a single message that the receive function replays
+ */
+typedef struct _Wire {
+    uint8_t data[512];
+    uint32_t len;
+    uint32_t pos;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Replay(void)
+{
+    wire.pos = 0;
+    AJ_IO_BUF_RESET(&bus.sock.rx);
+}
+
+#define SWAP32(p) { uint8_t* b = (uint8_t*)(p); uint8_t t = b[0]; b[0] = b[3]; b[3] = t; t = b[1]; b[1] = b[2]; b[2] = t; }
+#define SWAP16(p) { uint8_t* b = (uint8_t*)(p); uint8_t t = b[0]; b[0] = b[1]; b[1] = t; }
+
+/*
+ * Convert the wire image of a little endian message with only basic header fields and a body of
+ * 32 bit values and strings to big endian.
+ */
+static void MakeBigEndian(const char* bodySig)
+{
+    uint8_t* hdr = wire.data;
+    uint8_t* pos = hdr + sizeof(AJ_MsgHeader);
+    uint8_t* end;
+    uint32_t headerLen = *((uint32_t*)(hdr + 12));
+
+    end = pos + headerLen;
+    while (pos < end) {
+        uint8_t* val;
+        pos = hdr + (((pos - hdr) + 7) & ~7);
+        val = pos + 4;
+        switch (pos[2]) {
+        case 's':
+        case 'o':
+            pos = val + 4 + *((uint32_t*)val) + 1;
+            SWAP32(val);
+            break;
+
+        case 'g':
+            pos = val + 1 + val[0] + 1;
+            break;
+
+        case 'u':
+            SWAP32(val);
+            pos = val + 4;
+            break;
+
+        case 'q':
+            SWAP16(val);
+            pos = val + 2;
+            break;
+        }
+    }
+    pos = hdr + (((pos - hdr) + 7) & ~7);
+    while (*bodySig) {
+        pos = hdr + (((pos - hdr) + 3) & ~3);
+        if (*bodySig++ == 's') {
+            uint32_t len = *((uint32_t*)pos);
+            SWAP32(pos);
+            pos += 4 + len + 1;
+        } else {
+            SWAP32(pos);
+            pos += 4;
+        }
+    }
+    hdr[0] = AJ_BIG_ENDIAN;
+    SWAP32(hdr + 4);
+    SWAP32(hdr + 8);
+    SWAP32(hdr + 12);
+}
+
+static AJ_Status Marshal(uint8_t msgType)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    wire.len = 0;
+    if (msgType == AJ_MSG_METHOD_CALL) {
+        status = AJ_MarshalMethodCall(&bus, &msg, APP_MY_PING, ServiceName, SessionId, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "s", "Hello from the thin client");
+        }
+    } else {
+        status = AJ_MarshalSignal(&bus, &msg, APP_GYRO_UPDATE, NULL, SessionId, 0, TTL);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ii", 320, -240);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static int StrEq(const char* a, const char* b)
+{
+    return a && b && (strcmp(a, b) == 0);
+}
+
+static void Check(const char* test, uint8_t msgType)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    Replay();
+    status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    if (status != AJ_OK) {
+        AJ_Printf("%s: AJ_UnmarshalMsg returned %s\n", test, AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    if (!StrEq(msg.objPath, "/org/alljoyn/alljoyn_test") || !StrEq(msg.iface, "org.alljoyn.alljoyn_test") ||
+        !StrEq(msg.sender, Sender) || (msg.sessionId != SessionId)) {
+        AJ_Printf("%s: bad header fields\n", test);
+        ++failures;
+    }
+    if (msgType == AJ_MSG_METHOD_CALL) {
+        char* str;
+        if ((msg.msgId != APP_MY_PING) || !StrEq(msg.member, "my_ping") || !StrEq(msg.destination, ServiceName) ||
+            !StrEq(msg.signature, "s") || msg.ttl) {
+            AJ_Printf("%s: bad method call header fields\n", test);
+            ++failures;
+        }
+        status = AJ_UnmarshalArgs(&msg, "s", &str);
+        if ((status != AJ_OK) || !StrEq(str, "Hello from the thin client")) {
+            AJ_Printf("%s: bad method call body\n", test);
+            ++failures;
+        }
+    } else {
+        int32_t x;
+        int32_t y;
+        if ((msg.msgId != APP_GYRO_UPDATE) || !StrEq(msg.member, "Gyro_Update") || msg.destination ||
+            !StrEq(msg.signature, "ii") || (msg.ttl != TTL)) {
+            AJ_Printf("%s: bad signal header fields\n", test);
+            ++failures;
+        }
+        status = AJ_UnmarshalArgs(&msg, "ii", &x, &y);
+        if ((status != AJ_OK) || (x != 320) || (y != -240)) {
+            AJ_Printf("%s: bad signal body\n", test);
+            ++failures;
+        }
+    }
+    AJ_CloseMsg(&msg);
+}
+
+/*
+ * Corrupt a header field and check the message is rejected
+ */
+static void CheckCorrupt(const char* test, uint32_t offset, uint32_t val)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t save = *((uint32_t*)(wire.data + offset));
+
+    *((uint32_t*)(wire.data + offset)) = val;
+    Replay();
+    status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    if (status == AJ_OK) {
+        AJ_Printf("%s: corrupt header was accepted\n", test);
+        AJ_CloseMsg(&msg);
+        ++failures;
+    }
+    *((uint32_t*)(wire.data + offset)) = save;
+}
+
+static void UnmarshalBench(const char* name)
+{
+    AJ_Time timer;
+    AJ_Message msg;
+    uint32_t elapsed;
+    uint32_t hdrLen = 0;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        Replay();
+        if (AJ_UnmarshalMsg(&bus, &msg, 0) != AJ_OK) {
+            AJ_Printf("%s: unmarshal failed\n", name);
+            ++failures;
+            return;
+        }
+        hdrLen = msg.hdr->headerLen;
+        AJ_CloseMsg(&msg);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_Printf("%-24s header %3u bytes: %u messages in %u ms, %u ns/message\n", name, hdrLen, BENCH_MESSAGES, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_MESSAGES));
+}
+
+/*
+ * The signal sent by the siglite sample
+ */
+static AJ_Status MarshalMySignal(const char* destination, uint32_t session, uint32_t ttl)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Arg arg;
+
+    wire.len = 0;
+    status = AJ_MarshalSignal(&bus, &msg, APP_MY_SIGNAL, destination, session, 0, ttl);
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(&msg, &arg, AJ_ARG_ARRAY);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(&msg, &arg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Marshal my_signal for a mix of destinations, sessions and time-to-live values so headers are
+ * both cached and reused, and check each one has the right header fields.
+ */
+static void CheckHeaderCache(void)
+{
+    static const char* const destinations[] = { ServiceName, ":1b.3", NULL };
+    static const uint32_t ttls[] = { 0, 0, 750 };
+    uint8_t first[sizeof(wire.data)];
+    uint32_t firstLen;
+    uint32_t lastSerial = 0;
+    uint32_t i;
+
+    for (i = 0; i < 30; ++i) {
+        const char* destination = destinations[i % ArraySize(destinations)];
+        uint32_t session = (i / 3) % 2;
+        uint32_t ttl = ttls[(i / 6) % ArraySize(ttls)];
+        AJ_Message msg;
+        AJ_Status status;
+
+        MarshalMySignal(destination, session, ttl);
+        Replay();
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if (status != AJ_OK) {
+            AJ_Printf("header cache %u: AJ_UnmarshalMsg returned %s\n", i, AJ_StatusText(status));
+            ++failures;
+            continue;
+        }
+        if ((msg.msgId != APP_MY_SIGNAL) || !StrEq(msg.member, "my_signal") || !StrEq(msg.signature, "a{ys}") ||
+            !StrEq(msg.sender, Sender) || (msg.sessionId != session) || (msg.ttl != ttl) ||
+            (destination ? !StrEq(msg.destination, destination) : (msg.destination != NULL)) ||
+            (msg.hdr->serialNum == lastSerial)) {
+            AJ_Printf("header cache %u: bad header fields\n", i);
+            ++failures;
+        }
+        lastSerial = msg.hdr->serialNum;
+        AJ_CloseMsg(&msg);
+    }
+    /*
+     * A header from the cache is identical to a freshly marshaled one apart from the serial number
+     */
+    AJ_ClearHeaderCache();
+    MarshalMySignal(ServiceName, SessionId, 0);
+    memcpy(first, wire.data, wire.len);
+    firstLen = wire.len;
+    MarshalMySignal(ServiceName, SessionId, 0);
+    memcpy(first + 8, wire.data + 8, 4);
+    if ((firstLen != wire.len) || memcmp(first, wire.data, wire.len)) {
+        AJ_Printf("Cached header differs from marshaled header\n");
+        ++failures;
+    }
+}
+
+static void MarshalBench(const char* name, uint8_t cached)
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        if (!cached) {
+            AJ_ClearHeaderCache();
+        }
+        if (MarshalMySignal(ServiceName, SessionId, 0) != AJ_OK) {
+            AJ_Printf("%s: marshal failed\n", name);
+            ++failures;
+            return;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_Printf("%-24s message %3u bytes: %u messages in %u ms, %u ns/message\n", name, wire.len, BENCH_MESSAGES, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_MESSAGES));
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, Sender);
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    /*
+     * A method call to a well-known name on a session
+     */
+    Marshal(AJ_MSG_METHOD_CALL);
+    Check("method call", AJ_MSG_METHOD_CALL);
+    /*
+     * Object path length past the end of the header and a missing string NUL
+     */
+    CheckCorrupt("object path length", sizeof(AJ_MsgHeader) + 4, 0x10000);
+    CheckCorrupt("object path NUL", sizeof(AJ_MsgHeader) + 4, 24);
+    Check("method call", AJ_MSG_METHOD_CALL);
+    UnmarshalBench("method call");
+    MakeBigEndian("s");
+    Check("method call big endian", AJ_MSG_METHOD_CALL);
+    UnmarshalBench("method call big endian");
+
+    /*
+     * A session signal with a time-to-live
+     */
+    Marshal(AJ_MSG_SIGNAL);
+    Check("signal", AJ_MSG_SIGNAL);
+    UnmarshalBench("signal");
+    MakeBigEndian("ii");
+    Check("signal big endian", AJ_MSG_SIGNAL);
+    UnmarshalBench("signal big endian");
+
+    /*
+     * Marshaling the siglite signal with and without the header cache
+     */
+    CheckHeaderCache();
+    MarshalBench("siglite my_signal", FALSE);
+    MarshalBench("siglite my_signal cached", TRUE);
+
+    if (failures) {
+        AJ_Printf("hdrbench FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("hdrbench PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file  Header compression round trip and bytes-on-wire test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_compress.h"
+#include "testpipe.h"
+
+/*
+ * The signals sent by the siglite and mouse samples
+ */
+static const char* const sigliteInterface[] = {
+    "org.alljoyn.alljoyn_test",
+    "?my_ping inStr<s outStr>s",
+    "?delayed_ping inStr<s delay<u outStr>s",
+    "?time_ping <u <q >u >q",
+    "!my_signal >a{ys}",
+    NULL
+};
+
+static const AJ_InterfaceDescription sigliteInterfaces[] = {
+    sigliteInterface,
+    NULL
+};
+
+static const AJ_Object ProxyObjects[] = {
+    { "/org/alljoyn/alljoyn_test", sigliteInterfaces },
+    { NULL }
+};
+
+static const char* const mouseInterface[] = {
+    "org.alljoyn.ajlite_test",
+    "!ADC_Update >i",
+    "!Gyro_Update >i >i",
+    "!Button_Down >i",
+    NULL
+};
+
+static const AJ_InterfaceDescription mouseInterfaces[] = {
+    mouseInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/ajlite_test", mouseInterfaces },
+    { NULL }
+};
+
+#define PRX_MY_PING                  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_MY_SIGNAL                AJ_PRX_MESSAGE_ID(0, 0, 3)
+#define APP_GYROSCOPE_UPDATE_SIGNAL  AJ_APP_MESSAGE_ID(0, 0, 1)
+
+static const char ServiceName[] = "org.alljoyn.svclite";
+static const uint32_t SessionId = 0x1234;
+
+#define NUM_SIGNALS  20
+
+static TestPipe pipeAtoB;
+static TestPipe pipeBtoA;
+
+static uint8_t txDataA[1024];
+static uint8_t rxDataA[1024];
+static uint8_t txDataB[1024];
+static uint8_t rxDataB[1024];
+
+static AJ_BusAttachment busA;
+static AJ_BusAttachment busB;
+
+static uint32_t received;
+static uint32_t noMatch;
+static uint32_t failures;
+
+static AJ_Status SendSignal(uint32_t msgId, uint8_t flags, uint32_t session, uint32_t* hdrBytes)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Arg arg;
+
+    if (msgId == PRX_MY_SIGNAL) {
+        status = AJ_MarshalSignal(&busA, &msg, msgId, ServiceName, session, flags, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalContainer(&msg, &arg, AJ_ARG_ARRAY);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(&msg, &arg);
+        }
+    } else {
+        status = AJ_MarshalSignal(&busA, &msg, msgId, NULL, 0, flags, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ii", 320, 240);
+        }
+    }
+    if (status == AJ_OK) {
+        *hdrBytes = sizeof(AJ_MsgHeader) + ((msg.hdr->headerLen + 7) & ~7);
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Check a signal received by B has the header fields and body A sent
+ */
+static void CheckSignal(AJ_Message* msg, uint32_t msgId, uint32_t session)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Arg arg;
+    int32_t x;
+    int32_t y;
+
+    if (msg->msgId != msgId) {
+        AJ_Printf("Expected msgId %08x got %08x\n", msgId, msg->msgId);
+        ++failures;
+        return;
+    }
+    if (msgId == PRX_MY_SIGNAL) {
+        if (!msg->destination || strcmp(msg->destination, ServiceName) || (msg->sessionId != session)) {
+            AJ_Printf("Bad destination or session id\n");
+            ++failures;
+            return;
+        }
+        status = AJ_UnmarshalContainer(msg, &arg, AJ_ARG_ARRAY);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalCloseContainer(msg, &arg);
+        }
+    } else {
+        if (msg->destination || msg->sessionId) {
+            AJ_Printf("Unexpected destination or session id\n");
+            ++failures;
+            return;
+        }
+        status = AJ_UnmarshalArgs(msg, "ii", &x, &y);
+        if ((status == AJ_OK) && ((x != 320) || (y != 240))) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("Bad signal body %s\n", AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    ++received;
+}
+
+/*
+ * Deliver everything queued in either direction
+ */
+static void Pump(uint32_t msgId, uint32_t session)
+{
+    while ((pipeAtoB.tail != pipeAtoB.head) || (pipeBtoA.tail != pipeBtoA.head)) {
+        AJ_Message msg;
+        AJ_Status status;
+
+        while ((status = AJ_UnmarshalMsg(&busB, &msg, 0)) != AJ_ERR_TIMEOUT) {
+            if (status == AJ_ERR_NO_MATCH) {
+                ++noMatch;
+                continue;
+            }
+            if (status != AJ_OK) {
+                AJ_Printf("B: AJ_UnmarshalMsg returned %s\n", AJ_StatusText(status));
+                ++failures;
+                return;
+            }
+            if (msg.hdr->msgType == AJ_MSG_SIGNAL) {
+                CheckSignal(&msg, msgId, session);
+            } else {
+                AJ_BusHandleBusMessage(&msg);
+            }
+            AJ_CloseMsg(&msg);
+        }
+        while ((status = AJ_UnmarshalMsg(&busA, &msg, 0)) != AJ_ERR_TIMEOUT) {
+            if (status != AJ_OK) {
+                AJ_Printf("A: AJ_UnmarshalMsg returned %s\n", AJ_StatusText(status));
+                ++failures;
+                return;
+            }
+            AJ_BusHandleBusMessage(&msg);
+            AJ_CloseMsg(&msg);
+        }
+    }
+}
+
+static void RunWorkload(const char* name, uint32_t msgId, uint32_t session)
+{
+    uint32_t i;
+    uint32_t plainHdr = 0;
+    uint32_t packedHdr = 0;
+    uint32_t plainWire;
+    uint32_t packedWire;
+    uint32_t setupWire;
+
+    /*
+     * Uncompressed
+     */
+    received = 0;
+    plainWire = pipeAtoB.wire;
+    for (i = 0; i < NUM_SIGNALS; ++i) {
+        SendSignal(msgId, 0, session, &plainHdr);
+        Pump(msgId, session);
+    }
+    plainWire = pipeAtoB.wire - plainWire;
+    if (received != NUM_SIGNALS) {
+        AJ_Printf("%s: received %u of %u uncompressed signals\n", name, received, NUM_SIGNALS);
+        ++failures;
+    }
+
+    /*
+     * The first compressed signal is dropped while the receiver fetches the expansion
+     */
+    received = 0;
+    noMatch = 0;
+    setupWire = pipeAtoB.wire + pipeBtoA.wire;
+    SendSignal(msgId, AJ_FLAG_COMPRESSED, session, &packedHdr);
+    Pump(msgId, session);
+    setupWire = pipeAtoB.wire + pipeBtoA.wire - setupWire;
+    if (noMatch != 1) {
+        AJ_Printf("%s: expected the first compressed signal to need an expansion\n", name);
+        ++failures;
+    }
+
+    packedWire = pipeAtoB.wire + pipeBtoA.wire;
+    for (i = 0; i < NUM_SIGNALS; ++i) {
+        SendSignal(msgId, AJ_FLAG_COMPRESSED, session, &packedHdr);
+        Pump(msgId, session);
+    }
+    packedWire = pipeAtoB.wire + pipeBtoA.wire - packedWire;
+    if ((received != NUM_SIGNALS) || (noMatch != 1)) {
+        AJ_Printf("%s: received %u of %u compressed signals\n", name, received, NUM_SIGNALS);
+        ++failures;
+    }
+
+    AJ_Printf("%s: header %u -> %u bytes, message %u -> %u bytes (%u%% saved), expansion exchange %u bytes\n",
+              name, plainHdr, packedHdr, plainWire / NUM_SIGNALS, packedWire / NUM_SIGNALS,
+              100 - (packedWire * 100) / plainWire, setupWire);
+}
+
+int AJ_Main(void)
+{
+    uint32_t hdrBytes;
+    uint32_t session;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, ProxyObjects);
+    AJ_ClearCompressionRules();
+
+    TestPipeInitBus(&busA, ":1a.2", txDataA, sizeof(txDataA), rxDataA, sizeof(rxDataA), &pipeAtoB, &pipeBtoA);
+    TestPipeInitBus(&busB, ":1b.3", txDataB, sizeof(txDataB), rxDataB, sizeof(rxDataB), &pipeBtoA, &pipeAtoB);
+
+    RunWorkload("siglite my_signal", PRX_MY_SIGNAL, SessionId);
+    RunWorkload("mouse Gyro_Update", APP_GYROSCOPE_UPDATE_SIGNAL, 0);
+
+    /*
+     * Compress more headers than the rule caches hold so the my_signal rule is evicted. The next
+     * my_signal gets a new token that the receiver has to fetch again.
+     */
+    for (session = 1; session <= AJ_MAX_COMPRESSION_RULES; ++session) {
+        SendSignal(PRX_MY_SIGNAL, AJ_FLAG_COMPRESSED, session, &hdrBytes);
+        Pump(PRX_MY_SIGNAL, session);
+    }
+    received = 0;
+    noMatch = 0;
+    SendSignal(PRX_MY_SIGNAL, AJ_FLAG_COMPRESSED, SessionId, &hdrBytes);
+    Pump(PRX_MY_SIGNAL, SessionId);
+    SendSignal(PRX_MY_SIGNAL, AJ_FLAG_COMPRESSED, SessionId, &hdrBytes);
+    Pump(PRX_MY_SIGNAL, SessionId);
+    if ((received != 1) || (noMatch != 1)) {
+        AJ_Printf("Evicted rule: received %u noMatch %u\n", received, noMatch);
+        ++failures;
+    }
+
+    /*
+     * Compression is only applied to signals
+     */
+    {
+        AJ_Message msg;
+        AJ_MarshalMethodCall(&busA, &msg, PRX_MY_PING, ServiceName, SessionId, AJ_FLAG_COMPRESSED | AJ_FLAG_NO_REPLY_EXPECTED, 0);
+        AJ_MarshalArgs(&msg, "s", "ping");
+        if (msg.hdr->flags & AJ_FLAG_COMPRESSED) {
+            AJ_Printf("Method call was compressed\n");
+            ++failures;
+        }
+        AJ_DeliverMsg(&msg);
+        pipeAtoB.head = 0;
+        pipeAtoB.tail = 0;
+    }
+
+    if (failures) {
+        AJ_Printf("hdrcompress FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("hdrcompress PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,548 @@
+/**
+ * @file  Store-and-forward outbox for durable signals
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_outbox.h"
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.outbox_test",
+    "!Reading seq>u value>i name>s",
+    "!Event seq>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/outbox_test", sensorInterfaces },
+    { NULL }
+};
+
+#define APP_READING  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define PRX_READING  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_EVENT    AJ_PRX_MESSAGE_ID(0, 0, 1)
+
+#define FIRST_NAME   ":1a.2"
+#define SECOND_NAME  ":1b.7"
+
+/*
+ * The benchmark keeps no more signals than fit in RAM
+ */
+#define BENCH_ROUNDS   50
+#define BENCH_SIGNALS  40
+
+/*
+ * Everything sent is appended to the wire, the receive function replays it
+ */
+typedef struct _Wire {
+    uint8_t data[0x40000];
+    uint32_t len;
+    uint32_t pos;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[8192];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static char longName[201];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos), len);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static void InitBus(void)
+{
+    AJ_OutboxClear();
+    memset(&wire, 0, sizeof(wire));
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, FIRST_NAME);
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+}
+
+/*
+ * AJ_Disconnect() would close the socket so just tell the outbox
+ */
+static void Disconnect(void)
+{
+    AJ_OutboxDisconnected(&bus);
+}
+
+/*
+ * The daemon gives the bus attachment a new unique name
+ */
+static void Reconnect(void)
+{
+    strcpy(bus.uniqueName, SECOND_NAME);
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_OutboxConnected(&bus);
+}
+
+static AJ_Status ReplayAll(void)
+{
+    AJ_Status status;
+
+    do {
+        status = AJ_OutboxReplay(&bus);
+    } while (status == AJ_ERR_BUSY);
+    return status;
+}
+
+static AJ_Status SendReading(uint32_t seq, uint32_t session, uint32_t ttl, const char* name)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_READING, NULL, session, 0, ttl);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "uis", seq, -(int32_t)seq, name);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status SendEvent(uint32_t seq)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_EVENT, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "u", seq);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal everything on the wire. The readings must run from first to last with increasing
+ * serial numbers and readings from replayed onwards must have the new unique name as the sender.
+ */
+static AJ_Status ReceiveReadings(uint32_t first, uint32_t last, uint32_t replayed)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t expect = first;
+    uint32_t serial = 0;
+
+    while ((status == AJ_OK) && (wire.pos < wire.len)) {
+        AJ_Message msg;
+        uint32_t seq;
+        int32_t value;
+        char* name;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != APP_READING)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            if (msg.hdr->serialNum <= serial) {
+                status = AJ_ERR_FAILURE;
+            }
+            serial = msg.hdr->serialNum;
+            if ((status == AJ_OK) && (!msg.sender || strcmp(msg.sender, (expect >= replayed) ? SECOND_NAME : FIRST_NAME))) {
+                status = AJ_ERR_FAILURE;
+            }
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalArgs(&msg, "uis", &seq, &value, &name);
+            }
+            if ((status == AJ_OK) && ((seq != expect) || (value != -(int32_t)seq))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            ++expect;
+            AJ_CloseMsg(&msg);
+        }
+    }
+    if ((status == AJ_OK) && (expect != (last + 1))) {
+        status = AJ_ERR_FAILURE;
+    }
+    return status;
+}
+
+/*
+ * Signals delivered while disconnected are replayed in order with the new unique name, other
+ * messages fail
+ */
+static void CheckReplay(void)
+{
+    AJ_OutboxStats before;
+    AJ_OutboxStats after;
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    InitBus();
+    AJ_OutboxGetStats(&before);
+    for (i = 0; (status == AJ_OK) && (i < 5); ++i) {
+        status = SendReading(i, 0, 0, "temperature");
+    }
+    if (status == AJ_OK) {
+        Disconnect();
+    }
+    for (i = 5; (status == AJ_OK) && (i < 25); ++i) {
+        status = SendReading(i, 0, 0, "temperature");
+    }
+    if ((status == AJ_OK) && (SendEvent(0) != AJ_ERR_WRITE)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if ((status == AJ_OK) && (SendReading(99, 1234, 0, "temperature") != AJ_ERR_WRITE)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        Reconnect();
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, 24, 5);
+    }
+    AJ_OutboxGetStats(&after);
+    if ((status == AJ_OK) && (((after.captured - before.captured) != 20) || ((after.replayed - before.replayed) != 20) || after.depth)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("CheckReplay", status);
+    }
+}
+
+/*
+ * Signals whose time to live passes while disconnected are not replayed
+ */
+static void CheckExpired(void)
+{
+    AJ_OutboxStats before;
+    AJ_OutboxStats after;
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    InitBus();
+    AJ_OutboxGetStats(&before);
+    Disconnect();
+    for (i = 0; (status == AJ_OK) && (i < 10); ++i) {
+        status = SendReading(i, 0, (i < 5) ? 50 : 0, "temperature");
+    }
+    if (status == AJ_OK) {
+        AJ_Sleep(100);
+        Reconnect();
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(5, 9, 0);
+    }
+    AJ_OutboxGetStats(&after);
+    if ((status == AJ_OK) && ((after.expired - before.expired) != 5)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("CheckExpired", status);
+    }
+}
+
+/*
+ * A replayed signal only gets what is left of its time to live
+ */
+static void CheckTimeToLive(void)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    InitBus();
+    Disconnect();
+    status = SendReading(0, 0, 1000, "temperature");
+    if (status == AJ_OK) {
+        AJ_Sleep(200);
+        Reconnect();
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    }
+    if (status == AJ_OK) {
+        if ((msg.msgId != APP_READING) || !msg.ttl || (msg.ttl > 800)) {
+            status = AJ_ERR_FAILURE;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail("CheckTimeToLive", status);
+    }
+}
+
+/*
+ * Signals delivered after reconnecting wait behind the signals still in the outbox
+ */
+static void CheckOrdering(void)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    InitBus();
+    Disconnect();
+    for (i = 0; (status == AJ_OK) && (i < 40); ++i) {
+        status = SendReading(i, 0, 0, "temperature");
+    }
+    if (status == AJ_OK) {
+        Reconnect();
+        status = AJ_OutboxReplay(&bus);
+        if (status == AJ_ERR_BUSY) {
+            status = AJ_OK;
+        }
+    }
+    for (i = 40; (status == AJ_OK) && (i < 50); ++i) {
+        status = SendReading(i, 0, 0, "temperature");
+    }
+    if (status == AJ_OK) {
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = SendReading(50, 0, 0, "temperature");
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, 50, 0);
+    }
+    if (status != AJ_OK) {
+        Fail("CheckOrdering", status);
+    }
+}
+
+#if AJ_OUTBOX_SPILL_SIZE
+/*
+ * Signals that do not fit in RAM go to the spill file and are still replayed in order
+ */
+static void CheckSpill(void)
+{
+    AJ_OutboxStats before;
+    AJ_OutboxStats after;
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    InitBus();
+    AJ_OutboxGetStats(&before);
+    Disconnect();
+    for (i = 0; (status == AJ_OK) && (i < 100); ++i) {
+        status = SendReading(i, 0, 0, longName);
+    }
+    if (status == AJ_OK) {
+        Reconnect();
+        status = AJ_OutboxReplay(&bus);
+        if (status == AJ_ERR_BUSY) {
+            status = AJ_OK;
+        }
+    }
+    for (i = 100; (status == AJ_OK) && (i < 120); ++i) {
+        status = SendReading(i, 0, 0, longName);
+    }
+    if (status == AJ_OK) {
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, 119, 0);
+    }
+    AJ_OutboxGetStats(&after);
+    if ((status == AJ_OK) && ((after.spilled == before.spilled) || (after.maxBytes <= AJ_OUTBOX_SIZE))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("CheckSpill", status);
+    }
+}
+#endif
+
+/*
+ * A full outbox rejects new signals and keeps the ones it has
+ */
+static void CheckFull(void)
+{
+    AJ_OutboxStats before;
+    AJ_OutboxStats after;
+    AJ_Status status = AJ_OK;
+    uint32_t kept = 0;
+
+    InitBus();
+    AJ_OutboxGetStats(&before);
+    Disconnect();
+    while (status == AJ_OK) {
+        status = SendReading(kept, 0, 0, longName);
+        if (status == AJ_OK) {
+            ++kept;
+        }
+    }
+    if (status == AJ_ERR_RESOURCES) {
+        Reconnect();
+        status = ReplayAll();
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(0, kept - 1, 0);
+    }
+    AJ_OutboxGetStats(&after);
+    if ((status == AJ_OK) && ((after.dropped - before.dropped) != 1)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("CheckFull", status);
+    }
+}
+
+static uint64_t Microseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/*
+ * Time keeping signals while disconnected and replaying them, a connected send is the baseline
+ */
+static void ReplayBench(void)
+{
+    AJ_OutboxStats before;
+    AJ_OutboxStats after;
+    AJ_Status status = AJ_OK;
+    uint64_t direct = 0;
+    uint64_t capture = 0;
+    uint64_t replay = 0;
+    uint64_t start;
+    uint32_t round;
+    uint32_t i;
+
+    InitBus();
+    AJ_OutboxGetStats(&before);
+    for (round = 0; (status == AJ_OK) && (round < BENCH_ROUNDS); ++round) {
+        wire.len = wire.pos = 0;
+        strcpy(bus.uniqueName, FIRST_NAME);
+        start = Microseconds();
+        for (i = 0; (status == AJ_OK) && (i < BENCH_SIGNALS); ++i) {
+            status = SendReading(i, 0, 0, "temperature");
+        }
+        direct += Microseconds() - start;
+
+        wire.len = wire.pos = 0;
+        Disconnect();
+        start = Microseconds();
+        for (i = 0; (status == AJ_OK) && (i < BENCH_SIGNALS); ++i) {
+            status = SendReading(i, 0, 0, "temperature");
+        }
+        capture += Microseconds() - start;
+
+        if (status == AJ_OK) {
+            Reconnect();
+            start = Microseconds();
+            status = ReplayAll();
+            replay += Microseconds() - start;
+        }
+        if (status == AJ_OK) {
+            status = ReceiveReadings(0, BENCH_SIGNALS - 1, 0);
+        }
+    }
+    AJ_OutboxGetStats(&after);
+    if (status != AJ_OK) {
+        Fail("ReplayBench", status);
+        return;
+    }
+    AJ_Printf("%u signals: send %u ns, keep %u ns, replay %u ns per signal, %u bytes replayed\n", BENCH_ROUNDS * BENCH_SIGNALS,
+              (uint32_t)((direct * 1000) / (BENCH_ROUNDS * BENCH_SIGNALS)),
+              (uint32_t)((capture * 1000) / (BENCH_ROUNDS * BENCH_SIGNALS)),
+              (uint32_t)((replay * 1000) / (BENCH_ROUNDS * BENCH_SIGNALS)),
+              after.replayBytes - before.replayBytes);
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, AppObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+#if AJ_OUTBOX_SIZE
+    memset(longName, 'n', sizeof(longName) - 1);
+    AJ_OutboxSetDurable(PRX_READING, TRUE);
+
+    CheckReplay();
+    CheckExpired();
+    CheckTimeToLive();
+    CheckOrdering();
+#if AJ_OUTBOX_SPILL_SIZE
+    CheckSpill();
+#endif
+    CheckFull();
+
+    ReplayBench();
+#else
+    AJ_Printf("The outbox is disabled, AJ_OUTBOX_SIZE is zero\n");
+#endif
+
+    AJ_Printf("outbox %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
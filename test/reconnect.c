@@ -0,0 +1,455 @@
+/**
+ * @file  Fast reconnect to the cached daemon address
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_connect.h"
+#include "aj_disco.h"
+#include "aj_net.h"
+
+#define BENCH_RECONNECTS  50
+
+/*
+ * Discovery is given this long when there is no daemon to find
+ */
+#define DISCOVER_TIMEOUT  300
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static int listener;
+static uint16_t daemonPort;
+static uint32_t numHellos;
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static int ReadAll(int sock, uint8_t* buf, uint32_t len)
+{
+    while (len) {
+        ssize_t ret = recv(sock, buf, len, 0);
+        if (ret <= 0) {
+            return -1;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int ReadLine(int sock, char* buf, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < (len - 1); ++i) {
+        if ((recv(sock, buf + i, 1, 0) != 1)) {
+            return -1;
+        }
+        if (buf[i] == '\n') {
+            buf[i + 1] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Reply to the Hello method call with a unique name
+ */
+static uint32_t HelloReply(uint8_t* buf, uint32_t replySerial)
+{
+    AJ_MsgHeader* hdr = (AJ_MsgHeader*)buf;
+    uint8_t* field = buf + sizeof(AJ_MsgHeader);
+    char name[16];
+    uint32_t len;
+
+    len = sprintf(name, ":mock.%u", ++numHellos);
+    memset(buf, 0, 64);
+    hdr->endianess = AJ_LITTLE_ENDIAN;
+    hdr->msgType = AJ_MSG_METHOD_RET;
+    hdr->majorVersion = AJ_MAJOR_PROTOCOL_VERSION;
+    hdr->serialNum = numHellos;
+    field[0] = AJ_HDR_REPLY_SERIAL;
+    field[1] = 1;
+    field[2] = AJ_ARG_UINT32;
+    *((uint32_t*)(field + 4)) = replySerial;
+    field += 8;
+    field[0] = AJ_HDR_SIGNATURE;
+    field[1] = 1;
+    field[2] = AJ_ARG_SIGNATURE;
+    field[4] = 1;
+    field[5] = AJ_ARG_STRING;
+    hdr->headerLen = 15;
+    field += 8;
+    *((uint32_t*)field) = len;
+    memcpy(field + 4, name, len + 1);
+    hdr->bodyLen = 4 + len + 1;
+    return (uint32_t)(field - buf) + hdr->bodyLen;
+}
+
+/*
+ * Reject every mechanism except ANONYMOUS
+ */
+static int Authenticate(int sock)
+{
+    char line[256];
+
+    while (ReadLine(sock, line, sizeof(line)) == 0) {
+        if (strncmp(line, "AUTH ANONYMOUS", 14) == 0) {
+            const char ok[] = "OK 0123456789abcdef0123456789abcdef\r\n";
+            if ((send(sock, ok, sizeof(ok) - 1, 0) != (sizeof(ok) - 1)) || (ReadLine(sock, line, sizeof(line)) != 0)) {
+                return -1;
+            }
+            return (strncmp(line, "BEGIN", 5) == 0) ? 0 : -1;
+        }
+        if ((strncmp(line, "AUTH ", 5) != 0) || (send(sock, "REJECTED ANONYMOUS\r\n", 20, 0) != 20)) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Just enough of a daemon for AJ_Connect(), it authenticates with ANONYMOUS, answers Hello and
+ * then waits for the bus attachment to disconnect
+ */
+static void* MockDaemon(void* arg)
+{
+    while (TRUE) {
+        uint8_t buf[256];
+        AJ_MsgHeader* hdr = (AJ_MsgHeader*)buf;
+        uint32_t len;
+        int sock = accept(listener, NULL, NULL);
+
+        if (sock < 0) {
+            break;
+        }
+        if ((ReadAll(sock, buf, 1) == 0) && (Authenticate(sock) == 0) && (ReadAll(sock, buf, sizeof(AJ_MsgHeader)) == 0)) {
+            len = ((hdr->headerLen + 7) & ~7) + hdr->bodyLen;
+            if ((len <= (sizeof(buf) - sizeof(AJ_MsgHeader))) && (ReadAll(sock, buf + sizeof(AJ_MsgHeader), len) == 0)) {
+                len = HelloReply(buf, hdr->serialNum);
+                send(sock, buf, len, 0);
+                while (recv(sock, buf, sizeof(buf), 0) > 0) {
+                }
+            }
+        }
+        close(sock);
+    }
+    return NULL;
+}
+
+static AJ_Status StartDaemon(pthread_t* thread)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&addr, &addrLen) != 0)) {
+        close(listener);
+        return AJ_ERR_CONNECT;
+    }
+    daemonPort = ntohs(addr.sin_port);
+    pthread_create(thread, NULL, MockDaemon, NULL);
+    return AJ_OK;
+}
+
+static void StopDaemon(pthread_t thread)
+{
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    pthread_join(thread, NULL);
+}
+
+static void CacheDaemon(const char* serviceName, uint16_t port)
+{
+    AJ_Service service;
+
+    memset(&service, 0, sizeof(service));
+    service.addrTypes = AJ_ADDR_IPV4;
+    service.ipv4port = port;
+    service.ipv4 = htonl(INADDR_LOOPBACK);
+    AJ_SetCachedService(serviceName, &service);
+}
+
+static uint64_t Microseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/*
+ * Connect to the cached daemon without discovery, the reconnect after a disconnect is timed
+ */
+static void CheckCached(void)
+{
+    AJ_ConnectStats before;
+    AJ_ConnectStats after;
+    AJ_Status status;
+
+    CacheDaemon(NULL, daemonPort);
+    AJ_GetConnectStats(&before);
+    status = AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT);
+    if ((status == AJ_OK) && (strncmp(AJ_GetUniqueName(&bus), ":mock.", 6) != 0)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        AJ_Disconnect(&bus);
+        status = AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT);
+    }
+    if (status == AJ_OK) {
+        AJ_Disconnect(&bus);
+    }
+    AJ_GetConnectStats(&after);
+    if ((status == AJ_OK) && (((after.cached - before.cached) != 2) || (after.discovered != before.discovered) ||
+                              ((after.reconnects - before.reconnects) != 1) || (after.reconnectTime > AJ_CACHED_CONNECT_TIMEOUT))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("CheckCached", status);
+    }
+}
+
+/*
+ * A cached address nobody is listening at falls back to discovery, there is no daemon to discover
+ * so the connect fails
+ */
+static void CheckFallback(void)
+{
+    AJ_ConnectStats before;
+    AJ_ConnectStats after;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    AJ_Status status = AJ_OK;
+    uint64_t start;
+    int sock;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if ((bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (getsockname(sock, (struct sockaddr*)&addr, &addrLen) != 0)) {
+        status = AJ_ERR_CONNECT;
+    }
+    close(sock);
+
+    if (status == AJ_OK) {
+        CacheDaemon(NULL, ntohs(addr.sin_port));
+        AJ_GetConnectStats(&before);
+        start = Microseconds();
+        if (AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT) == AJ_OK) {
+            status = AJ_ERR_FAILURE;
+        }
+        AJ_GetConnectStats(&after);
+        if ((after.failures - before.failures) != 1) {
+            status = AJ_ERR_FAILURE;
+        }
+        AJ_Printf("cached address refused, discovery fell back in %u ms\n", (uint32_t)((Microseconds() - start) / 1000));
+    }
+    if (status != AJ_OK) {
+        Fail("CheckFallback", status);
+    }
+}
+
+/*
+ * Accepts one connection and closes it straight away, not a daemon
+ */
+static void* Impostor(void* arg)
+{
+    int sock = accept(*(int*)arg, NULL, NULL);
+
+    if (sock >= 0) {
+        close(sock);
+    }
+    return NULL;
+}
+
+/*
+ * Something that is not a daemon at the cached address accepts the connection, the same connect
+ * goes on to discovery and the cached address is forgotten
+ */
+static void CheckImpostor(void)
+{
+    AJ_ConnectStats before;
+    AJ_ConnectStats after;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    AJ_Status status = AJ_OK;
+    pthread_t thread;
+    uint64_t elapsed;
+    int sock;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if ((bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(sock, 1) != 0) ||
+        (getsockname(sock, (struct sockaddr*)&addr, &addrLen) != 0)) {
+        close(sock);
+        Fail("CheckImpostor", AJ_ERR_CONNECT);
+        return;
+    }
+    pthread_create(&thread, NULL, Impostor, &sock);
+    CacheDaemon(NULL, ntohs(addr.sin_port));
+    AJ_GetConnectStats(&before);
+    elapsed = Microseconds();
+    if (AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT) == AJ_OK) {
+        status = AJ_ERR_FAILURE;
+    }
+    elapsed = Microseconds() - elapsed;
+    pthread_join(thread, NULL);
+    close(sock);
+    AJ_GetConnectStats(&after);
+    /*
+     * There is no daemon to discover, the time shows discovery was tried
+     */
+    if (((after.failures - before.failures) != 1) || (after.cached != before.cached) || (elapsed < (DISCOVER_TIMEOUT * 1000))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        AJ_GetConnectStats(&before);
+        AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT);
+        AJ_GetConnectStats(&after);
+        if (after.cached != before.cached) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status != AJ_OK) {
+        Fail("CheckImpostor", status);
+    }
+}
+
+/*
+ * The cached address is only used for the service name it was discovered with
+ */
+static void CheckServiceName(void)
+{
+    AJ_ConnectStats before;
+    AJ_ConnectStats after;
+    AJ_Status status = AJ_OK;
+
+    CacheDaemon(NULL, daemonPort);
+    AJ_GetConnectStats(&before);
+    if (AJ_Connect(&bus, "org.alljoyn.reconnect_test", DISCOVER_TIMEOUT) == AJ_OK) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_GetConnectStats(&after);
+    if (after.cached != before.cached) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        CacheDaemon("org.alljoyn.reconnect_test", daemonPort);
+        status = AJ_Connect(&bus, "org.alljoyn.reconnect_test", DISCOVER_TIMEOUT);
+        if (status == AJ_OK) {
+            AJ_Disconnect(&bus);
+        }
+    }
+    if (status == AJ_OK) {
+        AJ_ClearCachedService();
+        if (AJ_Connect(&bus, "org.alljoyn.reconnect_test", DISCOVER_TIMEOUT) == AJ_OK) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status != AJ_OK) {
+        Fail("CheckServiceName", status);
+    }
+}
+
+static void ReconnectBench(void)
+{
+    AJ_ConnectStats stats;
+    AJ_Status status = AJ_OK;
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    uint32_t i;
+
+    CacheDaemon(NULL, daemonPort);
+    for (i = 0; (status == AJ_OK) && (i < BENCH_RECONNECTS); ++i) {
+        uint64_t start = Microseconds();
+        uint64_t elapsed;
+
+        status = AJ_Connect(&bus, NULL, DISCOVER_TIMEOUT);
+        elapsed = Microseconds() - start;
+        total += elapsed;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+        if (status == AJ_OK) {
+            AJ_Disconnect(&bus);
+        }
+    }
+    if (status != AJ_OK) {
+        Fail("ReconnectBench", status);
+        return;
+    }
+    AJ_GetConnectStats(&stats);
+    AJ_Printf("%u reconnects to the cached daemon: %u us average, worst %u us, longest time to reconnect %u ms\n",
+              BENCH_RECONNECTS, (uint32_t)(total / BENCH_RECONNECTS), (uint32_t)worst, stats.maxReconnectTime);
+}
+
+int AJ_Main(void)
+{
+    pthread_t daemon;
+
+    AJ_Initialize();
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    if (StartDaemon(&daemon) != AJ_OK) {
+        Fail("StartDaemon", AJ_ERR_CONNECT);
+    } else {
+        CheckCached();
+        CheckFallback();
+        CheckImpostor();
+        CheckServiceName();
+        ReconnectBench();
+        StopDaemon(daemon);
+    }
+    AJ_ClearCachedService();
+
+    AJ_Printf("reconnect %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
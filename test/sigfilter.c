@@ -0,0 +1,291 @@
+/**
+ * @file  Early signal filtering test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_filter.h"
+#include "testpipe.h"
+
+static const char* const mouseInterface[] = {
+    "org.alljoyn.ajlite_test",
+    "!ADC_Update >i",
+    "!Gyro_Update >i >i",
+    "!Button_Down >i",
+    "!Blob >ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription mouseInterfaces[] = {
+    mouseInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/ajlite_test", mouseInterfaces },
+    { NULL }
+};
+
+#define APP_ADC_UPDATE_SIGNAL        AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_GYROSCOPE_UPDATE_SIGNAL  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_BUTTON_DOWN_SIGNAL       AJ_APP_MESSAGE_ID(0, 0, 2)
+#define APP_BLOB_SIGNAL              AJ_APP_MESSAGE_ID(0, 0, 3)
+
+#define BLOB_SIZE  3000
+
+/*
+ * The blob signal is marshaled in one piece, it is too large for the receive buffer
+ */
+#define TX_SIZE    4096
+
+static const char SenderA[] = ":1a.2";
+static const char SenderC[] = ":1c.4";
+static const uint32_t SessionId = 0x1234;
+
+static TestPipe pipeToB;
+static TestPipe unused;
+
+static uint8_t txDataA[TX_SIZE];
+static uint8_t txDataC[TX_SIZE];
+static uint8_t txDataB[TX_SIZE];
+static uint8_t rxDataB[1024];
+static uint8_t rxDummy[64];
+
+static AJ_BusAttachment busA;
+static AJ_BusAttachment busC;
+static AJ_BusAttachment busB;
+
+static uint8_t blob[BLOB_SIZE];
+
+static uint32_t failures;
+
+/*
+ * Send a signal and return the number of bytes it occupies on the wire
+ */
+static uint32_t SendSignal(AJ_BusAttachment* bus, uint32_t msgId, uint32_t session)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t start = pipeToB.tail;
+
+    status = AJ_MarshalSignal(bus, &msg, msgId, NULL, session, 0, 0);
+    if (status == AJ_OK) {
+        if (msgId == APP_BLOB_SIGNAL) {
+            AJ_Arg arg;
+            AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, blob, sizeof(blob));
+            status = AJ_MarshalArg(&msg, &arg);
+        } else if (msgId == APP_GYROSCOPE_UPDATE_SIGNAL) {
+            status = AJ_MarshalArgs(&msg, "ii", 320, 240);
+        } else if (msgId == AJ_SIGNAL_SESSION_LOST) {
+            status = AJ_MarshalArgs(&msg, "u", session);
+        } else {
+            status = AJ_MarshalArgs(&msg, "i", 7);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("Failed to send signal %08x %s\n", msgId, AJ_StatusText(status));
+        ++failures;
+    }
+    return pipeToB.tail - start;
+}
+
+/*
+ * Receive one message and check it is the expected signal, AJ_INVALID_MSG_ID if the signal is
+ * expected to be dropped.
+ */
+static void Expect(const char* test, uint32_t msgId)
+{
+    AJ_Message msg;
+    AJ_Status status = AJ_UnmarshalMsg(&busB, &msg, 0);
+
+    if (msgId == AJ_INVALID_MSG_ID) {
+        if (status != AJ_ERR_NO_MATCH) {
+            AJ_Printf("%s: expected signal to be dropped got %s\n", test, AJ_StatusText(status));
+            ++failures;
+        }
+        if (status == AJ_OK) {
+            AJ_CloseMsg(&msg);
+        }
+        return;
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("%s: expected signal %08x got %s\n", test, msgId, AJ_StatusText(status));
+        ++failures;
+        return;
+    }
+    if (msg.msgId != msgId) {
+        AJ_Printf("%s: expected signal %08x got %08x\n", test, msgId, msg.msgId);
+        ++failures;
+    } else if (msgId == APP_GYROSCOPE_UPDATE_SIGNAL) {
+        int32_t x;
+        int32_t y;
+        status = AJ_UnmarshalArgs(&msg, "ii", &x, &y);
+        if ((status != AJ_OK) || (x != 320) || (y != 240)) {
+            AJ_Printf("%s: bad signal body\n", test);
+            ++failures;
+        }
+    }
+    AJ_CloseMsg(&msg);
+}
+
+static void CheckStats(const char* test, uint32_t messages, uint32_t bytes)
+{
+    const AJ_SignalFilterStats* stats = AJ_GetSignalFilterStats();
+
+    if ((stats->messages != messages) || (stats->bytes != bytes)) {
+        AJ_Printf("%s: dropped %u messages %u bytes expected %u messages %u bytes\n", test, stats->messages, stats->bytes, messages, bytes);
+        ++failures;
+    }
+    if (pipeToB.tail != pipeToB.head) {
+        AJ_Printf("%s: %u bytes left unread\n", test, pipeToB.tail - pipeToB.head);
+        ++failures;
+    }
+}
+
+int AJ_Main(void)
+{
+    AJ_SignalFilter filter;
+    uint32_t bytes;
+    uint32_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+    AJ_ClearSignalFilters();
+
+    TestPipeInitBus(&busA, SenderA, txDataA, sizeof(txDataA), rxDummy, sizeof(rxDummy), &pipeToB, &unused);
+    TestPipeInitBus(&busC, SenderC, txDataC, sizeof(txDataC), rxDummy, sizeof(rxDummy), &pipeToB, &unused);
+    TestPipeInitBus(&busB, ":1b.3", txDataB, sizeof(txDataB), rxDataB, sizeof(rxDataB), &unused, &pipeToB);
+
+    for (i = 0; i < sizeof(blob); ++i) {
+        blob[i] = (uint8_t)i;
+    }
+
+    /*
+     * No filters, everything is delivered
+     */
+    SendSignal(&busA, APP_GYROSCOPE_UPDATE_SIGNAL, 0);
+    SendSignal(&busA, APP_BLOB_SIGNAL, 0);
+    Expect("no filter", APP_GYROSCOPE_UPDATE_SIGNAL);
+    Expect("no filter", APP_BLOB_SIGNAL);
+    CheckStats("no filter", 0, 0);
+
+    /*
+     * Drop a chatty signal by member, including a body that is larger than the receive buffer
+     */
+    memset(&filter, 0, sizeof(filter));
+    filter.member = "Gyro_Update";
+    filter.action = AJ_SIGNAL_FILTER_DROP;
+    AJ_RegisterSignalFilter(&filter);
+    filter.member = "Blob";
+    AJ_RegisterSignalFilter(&filter);
+    bytes = 0;
+    for (i = 0; i < 10; ++i) {
+        bytes += SendSignal(&busA, APP_GYROSCOPE_UPDATE_SIGNAL, 0);
+    }
+    bytes += SendSignal(&busA, APP_BLOB_SIGNAL, 0);
+    SendSignal(&busA, APP_BUTTON_DOWN_SIGNAL, 0);
+    for (i = 0; i < 11; ++i) {
+        Expect("member", AJ_INVALID_MSG_ID);
+    }
+    Expect("member", APP_BUTTON_DOWN_SIGNAL);
+    CheckStats("member", 11, bytes);
+
+    /*
+     * A dropped signal is not decrypted. Mark a signal as encrypted on the wire, without the filter
+     * it would fail authentication.
+     */
+    i = pipeToB.tail;
+    bytes += SendSignal(&busA, APP_GYROSCOPE_UPDATE_SIGNAL, 0);
+    pipeToB.data[i + 2] |= AJ_FLAG_ENCRYPTED;
+    Expect("encrypted", AJ_INVALID_MSG_ID);
+    CheckStats("encrypted", 12, bytes);
+
+    /*
+     * Drop by sender
+     */
+    AJ_ClearSignalFilters();
+    memset(&filter, 0, sizeof(filter));
+    filter.sender = SenderC;
+    filter.action = AJ_SIGNAL_FILTER_DROP;
+    AJ_RegisterSignalFilter(&filter);
+    SendSignal(&busA, APP_ADC_UPDATE_SIGNAL, 0);
+    bytes = SendSignal(&busC, APP_ADC_UPDATE_SIGNAL, 0);
+    Expect("sender", APP_ADC_UPDATE_SIGNAL);
+    Expect("sender", AJ_INVALID_MSG_ID);
+    CheckStats("sender", 1, bytes);
+
+    /*
+     * Only accept signals on one session and a single broadcast signal, the bus signals are always
+     * accepted.
+     */
+    AJ_ClearSignalFilters();
+    memset(&filter, 0, sizeof(filter));
+    filter.sessionId = SessionId;
+    filter.action = AJ_SIGNAL_FILTER_ACCEPT;
+    AJ_RegisterSignalFilter(&filter);
+    filter.sessionId = 0;
+    filter.iface = "org.alljoyn.ajlite_test";
+    filter.member = "Button_Down";
+    AJ_RegisterSignalFilter(&filter);
+    AJ_SetSignalFilterDefault(AJ_SIGNAL_FILTER_DROP);
+    SendSignal(&busA, APP_GYROSCOPE_UPDATE_SIGNAL, SessionId);
+    bytes = SendSignal(&busA, APP_GYROSCOPE_UPDATE_SIGNAL, SessionId + 1);
+    bytes += SendSignal(&busA, APP_ADC_UPDATE_SIGNAL, 0);
+    SendSignal(&busA, APP_BUTTON_DOWN_SIGNAL, 0);
+    SendSignal(&busA, AJ_SIGNAL_SESSION_LOST, 0);
+    Expect("session", APP_GYROSCOPE_UPDATE_SIGNAL);
+    Expect("session", AJ_INVALID_MSG_ID);
+    Expect("session", AJ_INVALID_MSG_ID);
+    Expect("session", APP_BUTTON_DOWN_SIGNAL);
+    Expect("session", AJ_SIGNAL_SESSION_LOST);
+    CheckStats("session", 2, bytes);
+
+    /*
+     * The filter table is a fixed size
+     */
+    AJ_ClearSignalFilters();
+    for (i = 0; i < AJ_MAX_SIGNAL_FILTERS; ++i) {
+        if (AJ_RegisterSignalFilter(&filter) != AJ_OK) {
+            AJ_Printf("Failed to register filter %u\n", i);
+            ++failures;
+        }
+    }
+    if (AJ_RegisterSignalFilter(&filter) != AJ_ERR_RESOURCES) {
+        AJ_Printf("Registered too many filters\n");
+        ++failures;
+    }
+    AJ_ClearSignalFilters();
+
+    if (failures) {
+        AJ_Printf("sigfilter FAILED %u failures\n", failures);
+        return 1;
+    }
+    AJ_Printf("sigfilter PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,751 @@
+/**
+ * @file  Arrays of fixed layout structs unmarshaled and marshaled as arrays of C structs
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+
+static const char* const structInterface[] = {
+    "org.alljoyn.struct_test",
+    "!Points points>a(ii)",
+    "!Mixed shorts>a(qqu) doubles>a(ud)",
+    "!Quads quads>a(uuuu)",
+    "!Loose ints>a(u) named>a(is)",
+    NULL
+};
+
+static const AJ_InterfaceDescription structInterfaces[] = {
+    structInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/struct_test", structInterfaces },
+    { NULL }
+};
+
+#define APP_POINTS  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_MIXED   AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_QUADS   AJ_APP_MESSAGE_ID(0, 0, 2)
+#define APP_LOOSE   AJ_APP_MESSAGE_ID(0, 0, 3)
+
+#define PRX_POINTS  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_MIXED   AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define PRX_QUADS   AJ_PRX_MESSAGE_ID(0, 0, 2)
+#define PRX_LOOSE   AJ_PRX_MESSAGE_ID(0, 0, 3)
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+} Point;
+
+typedef struct {
+    uint16_t a;
+    uint16_t b;
+    uint32_t c;
+} Shorts;
+
+typedef struct {
+    uint32_t id;
+    double val;
+} Reading;
+
+typedef struct {
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+} Quad;
+
+#define NUM_POINTS      100
+#define NUM_MIXED       10
+#define BENCH_MESSAGES  1000
+
+/*
+ * The largest array that fits in the biggest I/O buffer and the size of arrays that are streamed
+ */
+#define BUFFER_ELEMS    4000
+#define STREAM_ELEMS    10000
+
+#define BUFFER_SIZE     (BUFFER_ELEMS * sizeof(Quad) + 1024)
+
+/*
+ * Wire image of the last message sent, the receive function replays it
+ */
+typedef struct _Wire {
+    uint8_t data[STREAM_ELEMS * sizeof(Quad) + 1024];
+    uint32_t len;
+    uint32_t pos;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[BUFFER_SIZE];
+static uint8_t rxBuffer[BUFFER_SIZE];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static Quad quads[STREAM_ELEMS];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    rx = min(rx, len);
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static void Check(const char* name, int ok)
+{
+    if (!ok) {
+        AJ_Printf("%s check failed\n", name);
+        ++failures;
+    }
+}
+
+static void Replay(void)
+{
+    wire.pos = 0;
+    AJ_IO_BUF_RESET(&bus.sock.rx);
+}
+
+static AJ_Status Start(AJ_Message* msg, uint32_t msgId)
+{
+    wire.len = 0;
+    return AJ_MarshalSignal(&bus, msg, msgId, NULL, 0, 0, 0);
+}
+
+static AJ_Status Receive(AJ_Message* msg, uint32_t msgId)
+{
+    AJ_Status status;
+
+    Replay();
+    status = AJ_UnmarshalMsg(&bus, msg, 0);
+    if ((status == AJ_OK) && (msg->msgId != msgId)) {
+        AJ_CloseMsg(msg);
+        status = AJ_ERR_NO_MATCH;
+    }
+    return status;
+}
+
+static AJ_Status MarshalPointsByElement(AJ_Message* msg, const Point* points, size_t num)
+{
+    AJ_Arg array;
+    AJ_Status status = AJ_MarshalContainer(msg, &array, AJ_ARG_ARRAY);
+
+    while ((status == AJ_OK) && num--) {
+        AJ_Arg point;
+        status = AJ_MarshalContainer(msg, &point, AJ_ARG_STRUCT);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(msg, "ii", points->x, points->y);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(msg, &point);
+        }
+        ++points;
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &array);
+    }
+    return status;
+}
+
+static AJ_Status UnmarshalPointsByElement(AJ_Message* msg, Point* points, size_t* num)
+{
+    AJ_Arg array;
+    AJ_Status status = AJ_UnmarshalContainer(msg, &array, AJ_ARG_ARRAY);
+
+    *num = 0;
+    while (status == AJ_OK) {
+        AJ_Arg point;
+        status = AJ_UnmarshalContainer(msg, &point, AJ_ARG_STRUCT);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(msg, "ii", &points->x, &points->y);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalCloseContainer(msg, &point);
+        }
+        if (status == AJ_OK) {
+            ++points;
+            ++*num;
+        }
+    }
+    if (status == AJ_ERR_NO_MORE) {
+        status = AJ_UnmarshalCloseContainer(msg, &array);
+    }
+    return status;
+}
+
+/*
+ * Struct arrays must interoperate with arrays marshaled and unmarshaled one element at a time
+ */
+static void CheckPoints(uint8_t structOut, uint8_t structIn)
+{
+    const char* name = structOut ? (structIn ? "points struct to struct" : "points struct to element") : "points element to struct";
+    Point points[NUM_POINTS];
+    Point rxPoints[NUM_POINTS];
+    const Point* rx = rxPoints;
+    AJ_Message msg;
+    AJ_Status status;
+    size_t num = 0;
+    size_t i;
+
+    for (i = 0; i < NUM_POINTS; ++i) {
+        points[i].x = (int32_t)i * 3 - 1000;
+        points[i].y = (int32_t)i * -7;
+    }
+    status = Start(&msg, PRX_POINTS);
+    if (status == AJ_OK) {
+        if (structOut) {
+            status = AJ_MarshalStructArray(&msg, points, sizeof(Point), NUM_POINTS);
+        } else {
+            status = MarshalPointsByElement(&msg, points, NUM_POINTS);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(&msg, APP_POINTS);
+    }
+    if (status == AJ_OK) {
+        if (structIn) {
+            status = AJ_UnmarshalStructArray(&msg, (const void**)&rx, sizeof(Point), &num);
+        } else {
+            status = UnmarshalPointsByElement(&msg, rxPoints, &num);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    Check(name, (num == NUM_POINTS) && (memcmp(points, rx, sizeof(points)) == 0));
+}
+
+static AJ_Status SendMixed(const Shorts* shorts, const Reading* readings)
+{
+    AJ_Message msg;
+    AJ_Status status = Start(&msg, PRX_MIXED);
+
+    if (status == AJ_OK) {
+        status = AJ_MarshalStructArray(&msg, shorts, sizeof(Shorts), NUM_MIXED);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalStructArray(&msg, readings, sizeof(Reading), NUM_MIXED);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+#define SWAP64(p) { uint8_t* b = (uint8_t*)(p); uint8_t t; int n; for (n = 0; n < 4; ++n) { t = b[n]; b[n] = b[7 - n]; b[7 - n] = t; } }
+#define SWAP32(p) { uint8_t* b = (uint8_t*)(p); uint8_t t = b[0]; b[0] = b[3]; b[3] = t; t = b[1]; b[1] = b[2]; b[2] = t; }
+#define SWAP16(p) { uint8_t* b = (uint8_t*)(p); uint8_t t = b[0]; b[0] = b[1]; b[1] = t; }
+
+/*
+ * Convert the wire image of a little endian Mixed signal to big endian
+ */
+static void MakeMixedBigEndian(void)
+{
+    uint8_t* hdr = wire.data;
+    uint8_t* pos = hdr + sizeof(AJ_MsgHeader);
+    uint8_t* end = pos + *((uint32_t*)(hdr + 12));
+    uint32_t i;
+
+    while (pos < end) {
+        uint8_t* val;
+        pos = hdr + (((pos - hdr) + 7) & ~7);
+        val = pos + 4;
+        switch (pos[2]) {
+        case 's':
+        case 'o':
+            pos = val + 4 + *((uint32_t*)val) + 1;
+            SWAP32(val);
+            break;
+
+        case 'g':
+            pos = val + 1 + val[0] + 1;
+            break;
+
+        case 'u':
+            SWAP32(val);
+            pos = val + 4;
+            break;
+
+        case 'q':
+            SWAP16(val);
+            pos = val + 2;
+            break;
+        }
+    }
+    /*
+     * a(qqu) length, padding to 8 and elements
+     */
+    pos = hdr + (((pos - hdr) + 7) & ~7);
+    SWAP32(pos);
+    pos += 8;
+    for (i = 0; i < NUM_MIXED; ++i, pos += sizeof(Shorts)) {
+        SWAP16(pos);
+        SWAP16(pos + 2);
+        SWAP32(pos + 4);
+    }
+    /*
+     * a(ud) length, padding to 8 and elements
+     */
+    SWAP32(pos);
+    pos += 8;
+    for (i = 0; i < NUM_MIXED; ++i, pos += sizeof(Reading)) {
+        SWAP32(pos);
+        SWAP64(pos + 8);
+    }
+    hdr[0] = AJ_BIG_ENDIAN;
+    SWAP32(hdr + 4);
+    SWAP32(hdr + 8);
+    SWAP32(hdr + 12);
+}
+
+/*
+ * Structs with fields of different sizes are endian swapped field by field
+ */
+static void CheckMixed(uint8_t bigEndian)
+{
+    const char* name = bigEndian ? "mixed big endian" : "mixed";
+    Shorts shorts[NUM_MIXED];
+    Reading readings[NUM_MIXED];
+    const Shorts* rxShorts = NULL;
+    const Reading* rxReadings = NULL;
+    size_t numShorts = 0;
+    size_t numReadings = 0;
+    AJ_Message msg;
+    AJ_Status status;
+    uint32_t i;
+
+    for (i = 0; i < NUM_MIXED; ++i) {
+        shorts[i].a = (uint16_t)(0x1234 + i);
+        shorts[i].b = (uint16_t)(0xFEDC - i);
+        shorts[i].c = 0x01020304 * (i + 1);
+        readings[i].id = 0xA0B0C0D0 + i;
+        readings[i].val = 1.5 * i - 3.25;
+    }
+    status = SendMixed(shorts, readings);
+    if ((status == AJ_OK) && bigEndian) {
+        MakeMixedBigEndian();
+    }
+    if (status == AJ_OK) {
+        status = Receive(&msg, APP_MIXED);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalStructArray(&msg, (const void**)&rxShorts, sizeof(Shorts), &numShorts);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalStructArray(&msg, (const void**)&rxReadings, sizeof(Reading), &numReadings);
+        }
+        if (status == AJ_OK) {
+            Check(name, (numShorts == NUM_MIXED) && (memcmp(shorts, rxShorts, sizeof(shorts)) == 0));
+            for (i = 0; i < numReadings; ++i) {
+                Check(name, (rxReadings[i].id == readings[i].id) && (rxReadings[i].val == readings[i].val));
+            }
+            Check(name, numReadings == NUM_MIXED);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+    }
+}
+
+/*
+ * A struct array can be streamed in chunks of whole elements
+ */
+static void CheckChunks(void)
+{
+    const char* name = "chunks";
+    Point points[NUM_POINTS];
+    AJ_ArrayCursor cursor;
+    AJ_Message msg;
+    AJ_Status status;
+    size_t num = 0;
+    size_t i;
+
+    for (i = 0; i < NUM_POINTS; ++i) {
+        points[i].x = (int32_t)i;
+        points[i].y = -(int32_t)i;
+    }
+    status = Start(&msg, PRX_POINTS);
+    if (status == AJ_OK) {
+        status = AJ_MarshalStructArray(&msg, points, sizeof(Point), NUM_POINTS);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(&msg, APP_POINTS);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalArrayCursor(&msg, &cursor);
+        while (status == AJ_OK) {
+            const Point* chunk;
+            size_t actual;
+            /*
+             * Ask for a size that is not a multiple of the element size
+             */
+            status = AJ_UnmarshalArrayChunk(&msg, &cursor, (const void**)&chunk, 3 * sizeof(Point) + 5, &actual);
+            if (status == AJ_OK) {
+                Check(name, (actual % sizeof(Point)) == 0);
+                Check(name, memcmp(chunk, points + num, actual) == 0);
+                num += actual / sizeof(Point);
+            }
+        }
+        if (status == AJ_ERR_NO_MORE) {
+            status = AJ_UnmarshalCloseArrayCursor(&msg, &cursor);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    Check(name, num == NUM_POINTS);
+}
+
+/*
+ * Structs that do not have a fixed layout and mismatched element sizes are rejected
+ */
+static void CheckErrors(void)
+{
+    uint32_t ints[2] = { 1, 2 };
+    Point points[2] = { { 1, 2 }, { 3, 4 } };
+    const void* data;
+    size_t num;
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = Start(&msg, PRX_LOOSE);
+    if (status == AJ_OK) {
+        Check("loose a(u)", AJ_MarshalStructArray(&msg, ints, sizeof(uint32_t), 2) == AJ_ERR_SIGNATURE);
+        status = AJ_MarshalArgs(&msg, "");
+    }
+    if (status == AJ_OK) {
+        AJ_Arg array;
+        status = AJ_MarshalContainer(&msg, &array, AJ_ARG_ARRAY);
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(&msg, &array);
+        }
+    }
+    if (status == AJ_OK) {
+        Check("loose a(is)", AJ_MarshalStructArray(&msg, points, sizeof(Point), 2) == AJ_ERR_SIGNATURE);
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail("loose", status);
+    }
+
+    status = Start(&msg, PRX_POINTS);
+    if (status == AJ_OK) {
+        Check("marshal size mismatch", AJ_MarshalStructArray(&msg, points, sizeof(Quad), 1) == AJ_ERR_SIGNATURE);
+        status = AJ_MarshalStructArray(&msg, NULL, sizeof(Point), 0);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        status = Receive(&msg, APP_POINTS);
+    }
+    if (status == AJ_OK) {
+        Check("unmarshal size mismatch", AJ_UnmarshalStructArray(&msg, &data, sizeof(Quad), &num) == AJ_ERR_SIGNATURE);
+        status = AJ_UnmarshalStructArray(&msg, &data, sizeof(Point), &num);
+        Check("empty", (status == AJ_OK) && (num == 0));
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        Fail("empty", status);
+    }
+}
+
+static AJ_Status SendQuads(uint8_t direct)
+{
+    AJ_Message msg;
+    AJ_Status status = Start(&msg, PRX_QUADS);
+
+    if (status == AJ_OK) {
+        if (direct) {
+            status = AJ_MarshalStructArray(&msg, quads, sizeof(Quad), BUFFER_ELEMS);
+        } else {
+            AJ_Arg array;
+            size_t i;
+            status = AJ_MarshalContainer(&msg, &array, AJ_ARG_ARRAY);
+            for (i = 0; (status == AJ_OK) && (i < BUFFER_ELEMS); ++i) {
+                AJ_Arg quad;
+                status = AJ_MarshalContainer(&msg, &quad, AJ_ARG_STRUCT);
+                if (status == AJ_OK) {
+                    status = AJ_MarshalArgs(&msg, "uuuu", quads[i].a, quads[i].b, quads[i].c, quads[i].d);
+                }
+                if (status == AJ_OK) {
+                    status = AJ_MarshalCloseContainer(&msg, &quad);
+                }
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalCloseContainer(&msg, &array);
+            }
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Send an array that is too big for the transmit buffer
+ */
+static AJ_Status SendStreamedQuads(void)
+{
+    static const uint8_t pad[4];
+    uint32_t len = STREAM_ELEMS * sizeof(Quad);
+    AJ_Message msg;
+    AJ_Status status = Start(&msg, PRX_QUADS);
+
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsgPartial(&msg, sizeof(len) + sizeof(pad) + len);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, &len, sizeof(len));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, pad, sizeof(pad));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, quads, len);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status ReceiveStreamedQuads(uint8_t direct, uint32_t* sum)
+{
+    AJ_Message msg;
+    AJ_ArrayCursor cursor;
+    AJ_Status status = Receive(&msg, APP_QUADS);
+    size_t i;
+
+    if (status != AJ_OK) {
+        return status;
+    }
+    status = AJ_UnmarshalArrayCursor(&msg, &cursor);
+    while (status == AJ_OK) {
+        if (direct) {
+            const Quad* rx;
+            size_t actual;
+            status = AJ_UnmarshalArrayChunk(&msg, &cursor, (const void**)&rx, STREAM_ELEMS * sizeof(Quad), &actual);
+            for (i = 0; (status == AJ_OK) && (i < actual / sizeof(Quad)); ++i) {
+                *sum += rx[i].a + rx[i].b + rx[i].c + rx[i].d;
+            }
+        } else {
+            AJ_Arg quad;
+            Quad q;
+            status = AJ_UnmarshalContainer(&msg, &quad, AJ_ARG_STRUCT);
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalArgs(&msg, "uuuu", &q.a, &q.b, &q.c, &q.d);
+            }
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalCloseContainer(&msg, &quad);
+                *sum += q.a + q.b + q.c + q.d;
+            }
+        }
+    }
+    if (status == AJ_ERR_NO_MORE) {
+        status = AJ_UnmarshalCloseArrayCursor(&msg, &cursor);
+    }
+    AJ_CloseMsg(&msg);
+    return status;
+}
+
+static AJ_Status ReceiveQuads(uint8_t direct, uint32_t* sum)
+{
+    AJ_Message msg;
+    AJ_Status status = Receive(&msg, APP_QUADS);
+    size_t i;
+
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (direct) {
+        const Quad* rx;
+        size_t num;
+        status = AJ_UnmarshalStructArray(&msg, (const void**)&rx, sizeof(Quad), &num);
+        for (i = 0; (status == AJ_OK) && (i < num); ++i) {
+            *sum += rx[i].a + rx[i].b + rx[i].c + rx[i].d;
+        }
+    } else {
+        AJ_Arg array;
+        status = AJ_UnmarshalContainer(&msg, &array, AJ_ARG_ARRAY);
+        while (status == AJ_OK) {
+            AJ_Arg quad;
+            Quad q;
+            status = AJ_UnmarshalContainer(&msg, &quad, AJ_ARG_STRUCT);
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalArgs(&msg, "uuuu", &q.a, &q.b, &q.c, &q.d);
+            }
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalCloseContainer(&msg, &quad);
+                *sum += q.a + q.b + q.c + q.d;
+            }
+        }
+        if (status == AJ_ERR_NO_MORE) {
+            status = AJ_UnmarshalCloseContainer(&msg, &array);
+        }
+    }
+    AJ_CloseMsg(&msg);
+    return status;
+}
+
+static void Report(const char* name, uint32_t elapsed)
+{
+    AJ_Printf("%-32s %u messages in %u ms, %u ns/message\n", name, BENCH_MESSAGES, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_MESSAGES));
+}
+
+static void MarshalBench(const char* name, uint8_t direct)
+{
+    AJ_Time timer;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        AJ_Status status = SendQuads(direct);
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+static void UnmarshalBench(const char* name, uint8_t direct, uint8_t streamed)
+{
+    AJ_Time timer;
+    AJ_Status status;
+    uint32_t numElems = streamed ? STREAM_ELEMS : BUFFER_ELEMS;
+    uint32_t expect = 0;
+    uint32_t i;
+
+    for (i = 0; i < numElems; ++i) {
+        expect += quads[i].a + quads[i].b + quads[i].c + quads[i].d;
+    }
+    status = streamed ? SendStreamedQuads() : SendQuads(direct);
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        uint32_t sum = 0;
+        status = streamed ? ReceiveStreamedQuads(direct, &sum) : ReceiveQuads(direct, &sum);
+        if ((status == AJ_OK) && (sum != expect)) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+int AJ_Main(void)
+{
+    uint32_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, AppObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    CheckPoints(TRUE, TRUE);
+    CheckPoints(TRUE, FALSE);
+    CheckPoints(FALSE, TRUE);
+    CheckMixed(FALSE);
+    CheckMixed(TRUE);
+    CheckChunks();
+    CheckErrors();
+
+    for (i = 0; i < STREAM_ELEMS; ++i) {
+        quads[i].a = i;
+        quads[i].b = i * 2;
+        quads[i].c = ~i;
+        quads[i].d = i ^ 0x5A5A5A5A;
+    }
+    MarshalBench("marshal 4k per element", FALSE);
+    MarshalBench("marshal 4k struct array", TRUE);
+    UnmarshalBench("unmarshal 4k per element", FALSE, FALSE);
+    UnmarshalBench("unmarshal 4k struct array", TRUE, FALSE);
+    UnmarshalBench("stream 10k per element", FALSE, TRUE);
+    UnmarshalBench("stream 10k struct chunks", TRUE, TRUE);
+
+    AJ_Printf("structarray %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
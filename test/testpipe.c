@@ -0,0 +1,65 @@
+/**
+ * @file  In-memory link between bus attachments for tests that run both ends in one process
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "testpipe.h"
+
+AJ_Status TestPipeSend(AJ_IOBuffer* buf)
+{
+    TestPipe* pipe = (TestPipe*)buf->context;
+    uint32_t len = AJ_IO_BUF_AVAIL(buf);
+
+    if ((pipe->tail + len) > sizeof(pipe->data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(&pipe->data[pipe->tail], buf->readPtr, len);
+    pipe->tail += len;
+    pipe->wire += len;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+AJ_Status TestPipeRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    TestPipe* pipe = (TestPipe*)buf->context;
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), pipe->tail - pipe->head);
+
+    rx = min(rx, len);
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, &pipe->data[pipe->head], rx);
+    buf->writePtr += rx;
+    pipe->head += rx;
+    if (pipe->head == pipe->tail) {
+        pipe->head = 0;
+        pipe->tail = 0;
+    }
+    return AJ_OK;
+}
+
+void TestPipeInitBus(AJ_BusAttachment* bus, const char* name, uint8_t* tx, uint32_t txSize, uint8_t* rx, uint32_t rxSize, TestPipe* out, TestPipe* in)
+{
+    memset(bus, 0, sizeof(AJ_BusAttachment));
+    strcpy(bus->uniqueName, name);
+    bus->serial = 1;
+    AJ_IOBufInit(&bus->sock.tx, tx, txSize, AJ_IO_BUF_TX, out);
+    bus->sock.tx.send = TestPipeSend;
+    AJ_IOBufInit(&bus->sock.rx, rx, rxSize, AJ_IO_BUF_RX, in);
+    bus->sock.rx.recv = TestPipeRecv;
+}
@@ -0,0 +1,73 @@
+#ifndef _TESTPIPE_H
+#define _TESTPIPE_H
+/**
+ * @file testpipe.h
+ * In-memory link between bus attachments for tests that run both ends in one process
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "alljoyn.h"
+
+/**
+ * Number of bytes a pipe can hold before it is read
+ */
+#ifndef TEST_PIPE_SIZE
+#define TEST_PIPE_SIZE  0x10000
+#endif
+
+/**
+ * One direction of the link. Writes that do not fit fail rather than block and the pipe goes back
+ * to the start each time it is drained.
+ */
+typedef struct _TestPipe {
+    uint8_t data[TEST_PIPE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t wire;   /**< Total bytes written to the pipe */
+} TestPipe;
+
+/**
+ * TRUE if there is nothing to read from a pipe
+ */
+#define TEST_PIPE_EMPTY(pipe)  ((pipe)->head == (pipe)->tail)
+
+/**
+ * Transmit callback, the buffer context is the pipe to write to
+ */
+AJ_Status TestPipeSend(AJ_IOBuffer* buf);
+
+/**
+ * Receive callback, the buffer context is the pipe to read from. Returns AJ_ERR_TIMEOUT straight
+ * away if the pipe is empty.
+ */
+AJ_Status TestPipeRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout);
+
+/**
+ * Set up a bus attachment that sends to one pipe and receives from another
+ *
+ * @param bus     The bus attachment
+ * @param name    The unique name for the bus attachment
+ * @param tx      Transmit buffer
+ * @param txSize  Size of the transmit buffer
+ * @param rx      Receive buffer
+ * @param rxSize  Size of the receive buffer
+ * @param out     The pipe the bus attachment sends to
+ * @param in      The pipe the bus attachment receives from
+ */
+void TestPipeInitBus(AJ_BusAttachment* bus, const char* name, uint8_t* tx, uint32_t txSize, uint8_t* rx, uint32_t rxSize, TestPipe* out, TestPipe* in);
+
+#endif
@@ -102,6 +102,8 @@ int main()
 
     extern AJ_Timer* AJ_TimerRemoveFromList(AJ_Timer** list, uint32_t timerId);
     extern AJ_Status AJ_TimerInsertInList(AJ_Timer** list, AJ_Timer* newNode);
+    extern AJ_Timer* AJ_TimerInit(uint32_t timeout, AJ_TimerCallback timerCallback, void* context, uint32_t timerId);
+    extern void _AJ_DumpTimerList(AJ_Timer* list);
     {
         AJ_Timer* StoreList = NULL;
         AJ_Timer* TempStoreList = NULL;
@@ -0,0 +1,120 @@
+/**
+ * @file  Count the wakeups the AJ_Timer backend costs while timers are pending
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include "alljoyn.h"
+#include "aj_timer.h"
+#include "aj_util.h"
+
+#define RUN_TIME       5000
+
+/*
+ * Timers modelled on the SLAP transport: a periodic resend timer that also arms a one shot
+ * acknowledge timer, and a long idle timer that should not fire during the test
+ */
+#define RESEND_PERIOD  200
+#define ACK_PERIOD     50
+#define IDLE_PERIOD    30000
+
+static uint32_t ackTimer;
+static volatile uint32_t resendCount;
+static volatile uint32_t ackCount;
+static volatile uint32_t idleCount;
+
+static void ResendCallback(uint32_t timerId, void* context)
+{
+    ++resendCount;
+    AJ_TimerRefresh(timerId, RESEND_PERIOD);
+    AJ_TimerRefresh(ackTimer, ACK_PERIOD);
+}
+
+static void AckCallback(uint32_t timerId, void* context)
+{
+    ++ackCount;
+}
+
+static void IdleCallback(uint32_t timerId, void* context)
+{
+    ++idleCount;
+}
+
+static long ContextSwitches(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    uint32_t resendTimer;
+    uint32_t idleTimer;
+    long switches;
+    uint32_t expected;
+    uint32_t fired;
+
+#ifdef AJ_TIMERFD
+    AJ_Printf("AJ_Timer driven by timerfd\n");
+#else
+    AJ_Printf("AJ_Timer driven by a periodic POSIX timer\n");
+#endif
+
+    status = AJ_TimerRegister(RESEND_PERIOD, &ResendCallback, NULL, &resendTimer);
+    if (status == AJ_OK) {
+        status = AJ_TimerRegister(ACK_PERIOD, &AckCallback, NULL, &ackTimer);
+    }
+    if (status == AJ_OK) {
+        status = AJ_TimerRegister(IDLE_PERIOD, &IdleCallback, NULL, &idleTimer);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("AJ_TimerRegister returned %d\n", status);
+        return 1;
+    }
+
+    switches = ContextSwitches();
+    AJ_Sleep(RUN_TIME);
+    switches = ContextSwitches() - switches;
+
+    AJ_TimerCancel(resendTimer, FALSE);
+    AJ_TimerCancel(ackTimer, FALSE);
+    AJ_TimerCancel(idleTimer, FALSE);
+
+    fired = resendCount + ackCount + idleCount;
+    expected = 2 * (RUN_TIME / RESEND_PERIOD);
+    AJ_Printf("%u callbacks (resend %u ack %u idle %u), %ld context switches, %ld wakeups/sec\n",
+              fired, resendCount, ackCount, idleCount, switches, switches * 1000 / RUN_TIME);
+
+    if (idleCount || (fired < expected * 9 / 10) || (fired > expected + 2)) {
+        AJ_Printf("timerwakeups FAILED expected about %u callbacks\n", expected);
+        return 1;
+    }
+    AJ_Printf("timerwakeups PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
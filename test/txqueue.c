@@ -0,0 +1,932 @@
+/**
+ * @file  Non-blocking transmit queue with congestion policies for signals
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_net.h"
+#include "aj_txqueue.h"
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.txqueue_test",
+    "!Reading seq>u value>i name>s",
+    "!Blob data>ay",
+    "!Alarm tick>u",
+    "!Chunk seq>u data>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/txqueue_test", sensorInterfaces },
+    { NULL }
+};
+
+static AJ_Object ProxyObjects[] = {
+    { "/org/alljoyn/txqueue_test", sensorInterfaces },
+    { NULL }
+};
+
+/*
+ * Two object paths with the same CRC-16
+ */
+#define STATE_PATH_A  "/org/alljoyn/txqueue_test/4"
+#define STATE_PATH_B  "/org/alljoyn/txqueue_test/2720"
+
+#define APP_READING  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_BLOB     AJ_APP_MESSAGE_ID(0, 0, 1)
+#define PRX_READING  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_BLOB     AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define APP_ALARM    AJ_APP_MESSAGE_ID(0, 0, 2)
+#define PRX_ALARM    AJ_PRX_MESSAGE_ID(0, 0, 2)
+#define PRX_CHUNK    AJ_PRX_MESSAGE_ID(0, 0, 3)
+
+#define CHECK_SIGNALS  200
+#define BLOB_SIZE      5000
+
+#define BENCH_SIGNALS  5000
+
+/*
+ * The latency benchmark runs in simulated milliseconds on a link that carries LINK_RATE bytes a
+ * millisecond. Every BURST_INTERVAL a burst of bulk chunks is sent and every ALARM_INTERVAL an
+ * alarm that should get through quickly.
+ */
+#define LATENCY_TICKS   10000
+#define LINK_RATE       256
+#define BURST_INTERVAL  50
+#define BURST_CHUNKS    16
+#define CHUNK_SIZE      400
+#define ALARM_INTERVAL  7
+
+/*
+ * Everything sent is appended to the wire, the receive function replays it. Non-blocking sends
+ * are limited to the room left on the simulated link.
+ */
+typedef struct _Wire {
+    uint8_t data[0x20000];
+    uint32_t len;
+    uint32_t pos;
+    uint32_t room;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[8192];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static uint32_t congestedCalls;
+static uint32_t drainedCalls;
+
+static uint8_t blob[BLOB_SIZE];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if (buf->flags & AJ_IO_BUF_NONBLOCK) {
+        tx = min(tx, wire.room);
+        wire.room -= tx;
+    }
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    buf->readPtr += tx;
+    if (!AJ_IO_BUF_AVAIL(buf)) {
+        AJ_IO_BUF_RESET(buf);
+    }
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos), len);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static void OnCongestion(uint32_t depth, uint8_t congested)
+{
+    if (congested) {
+        ++congestedCalls;
+    } else {
+        ++drainedCalls;
+    }
+}
+
+static void InitBus(AJ_TxFunc send, void* context)
+{
+    AJ_ReleaseTxQueue(&bus);
+    memset(&wire, 0, sizeof(wire));
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, context);
+    bus.sock.tx.send = send;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+    congestedCalls = 0;
+    drainedCalls = 0;
+}
+
+static AJ_Status SendSessionReading(uint32_t seq, uint32_t session)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_READING, NULL, session, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "uis", seq, -(int32_t)seq, "temperature");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status SendReading(uint32_t seq)
+{
+    return SendSessionReading(seq, 0);
+}
+
+/*
+ * A signal bigger than the I/O buffer
+ */
+static AJ_Status SendBlob(void)
+{
+    AJ_Message msg;
+    AJ_Status status;
+    uint32_t len = BLOB_SIZE;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_BLOB, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsgPartial(&msg, sizeof(len) + BLOB_SIZE);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, &len, sizeof(len));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, blob, BLOB_SIZE);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status SendAlarm(uint32_t tick, uint32_t* serial)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    status = AJ_MarshalSignal(&bus, &msg, PRX_ALARM, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        *serial = msg.hdr->serialNum;
+        status = AJ_MarshalArgs(&msg, "u", tick);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status SendChunk(uint32_t seq)
+{
+    static char data[CHUNK_SIZE + 1];
+    AJ_Message msg;
+    AJ_Status status;
+
+    if (!data[0]) {
+        memset(data, 'c', CHUNK_SIZE);
+    }
+    status = AJ_MarshalSignal(&bus, &msg, PRX_CHUNK, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "us", seq, data);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal up to max readings from the wire, they must be in sequence and end with the last
+ * reading sent if required. Returns the number of readings received in num.
+ */
+static AJ_Status ReceiveReadings(uint32_t* num, uint32_t max, uint8_t gaps, uint32_t last)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t expect = 0;
+
+    *num = 0;
+    while ((status == AJ_OK) && (wire.pos < wire.len) && (*num < max)) {
+        AJ_Message msg;
+        uint32_t seq;
+        int32_t value;
+        char* name;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != APP_READING)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "uis", &seq, &value, &name);
+            if ((status == AJ_OK) && ((gaps ? (seq < expect) : (seq != expect)) || (value != -(int32_t)seq))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            expect = seq + 1;
+            ++(*num);
+            AJ_CloseMsg(&msg);
+        }
+    }
+    if ((status == AJ_OK) && last && (expect != last)) {
+        status = AJ_ERR_FAILURE;
+    }
+    return status;
+}
+
+/*
+ * Send readings on a congested link then open up the link and check what arrives
+ */
+static AJ_Status CongestedBurst(uint8_t policy, uint32_t* sent, AJ_TxQueueStats* stats)
+{
+    AJ_Status status;
+    uint32_t i;
+
+    InitBus(TxFunc, NULL);
+    AJ_TxQueueSetPolicy(PRX_READING, policy);
+    status = AJ_TxQueueStart(&bus, 0, OnCongestion);
+    for (i = 0; (status == AJ_OK) && (i < CHECK_SIGNALS); ++i) {
+        status = SendReading(i);
+    }
+    *sent = i - ((status == AJ_OK) ? 0 : 1);
+    if (status == AJ_ERR_BUSY) {
+        status = AJ_OK;
+    }
+    AJ_TxQueueGetStats(stats);
+    if (status == AJ_OK) {
+        wire.room = sizeof(wire.data);
+        status = AJ_TxQueueDrain(&bus);
+    }
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_WAIT);
+    return status;
+}
+
+/*
+ * A signal with the busy policy is rejected once the queue is congested
+ */
+static void CheckBusy(void)
+{
+    AJ_TxQueueStats stats;
+    uint32_t sent;
+    uint32_t num;
+    AJ_Status status = CongestedBurst(AJ_TXQ_BUSY, &sent, &stats);
+
+    if ((status == AJ_OK) && ((sent == CHECK_SIGNALS) || (stats.busy != 1) || (stats.maxDepth > AJ_TX_QUEUE_SIZE))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if ((status == AJ_OK) && ((congestedCalls != 1) || (drainedCalls != 1))) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, FALSE, sent);
+    }
+    if (status != AJ_OK) {
+        Fail("busy", status);
+    }
+}
+
+/*
+ * Signals that do not fit are dropped, everything before them arrives
+ */
+static void CheckDropNewest(void)
+{
+    AJ_TxQueueStats stats;
+    uint32_t sent;
+    uint32_t num;
+    AJ_Status status = CongestedBurst(AJ_TXQ_DROP_NEWEST, &sent, &stats);
+
+    if ((status == AJ_OK) && ((sent != CHECK_SIGNALS) || !stats.dropped)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, FALSE, 0);
+    }
+    if ((status == AJ_OK) && ((num + stats.dropped) != CHECK_SIGNALS)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("drop newest", status);
+    }
+}
+
+/*
+ * Old signals make way for new ones so the last signal arrives
+ */
+static void CheckDropOldest(void)
+{
+    AJ_TxQueueStats stats;
+    uint32_t sent;
+    uint32_t num;
+    AJ_Status status = CongestedBurst(AJ_TXQ_DROP_OLDEST, &sent, &stats);
+
+    if ((status == AJ_OK) && ((sent != CHECK_SIGNALS) || !stats.dropped)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, TRUE, CHECK_SIGNALS);
+    }
+    if ((status == AJ_OK) && ((num + stats.dropped) != CHECK_SIGNALS)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("drop oldest", status);
+    }
+}
+
+/*
+ * The newest queued signal is replaced so the last signal arrives
+ */
+static void CheckCoalesce(void)
+{
+    AJ_TxQueueStats stats;
+    uint32_t sent;
+    uint32_t num;
+    AJ_Status status = CongestedBurst(AJ_TXQ_COALESCE, &sent, &stats);
+
+    if ((status == AJ_OK) && ((sent != CHECK_SIGNALS) || !stats.coalesced || stats.dropped)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, TRUE, CHECK_SIGNALS);
+    }
+    if ((status == AJ_OK) && ((num + stats.coalesced) != CHECK_SIGNALS)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail("coalesce", status);
+    }
+}
+
+/*
+ * Signals without a policy wait for room so nothing is lost
+ */
+static void CheckWait(void)
+{
+    AJ_TxQueueStats stats;
+    uint32_t sent;
+    uint32_t num;
+    AJ_Status status = CongestedBurst(AJ_TXQ_WAIT, &sent, &stats);
+
+    if ((status == AJ_OK) && ((sent != CHECK_SIGNALS) || !stats.waits)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, FALSE, CHECK_SIGNALS);
+    }
+    if (status != AJ_OK) {
+        Fail("wait", status);
+    }
+}
+
+/*
+ * A signal bigger than the I/O buffer is queued in pieces and stays in order
+ */
+static void CheckPartial(void)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t i;
+    uint32_t num;
+
+    for (i = 0; i < BLOB_SIZE; ++i) {
+        blob[i] = (uint8_t)i;
+    }
+    InitBus(TxFunc, NULL);
+    status = AJ_TxQueueStart(&bus, 0, NULL);
+    if (status == AJ_OK) {
+        status = SendReading(0);
+    }
+    if (status == AJ_OK) {
+        status = SendBlob();
+    }
+    if (status == AJ_OK) {
+        status = SendReading(1);
+    }
+    if ((status == AJ_OK) && wire.len) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = AJ_TxQueueStop(&bus);
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, 1, FALSE, 1);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != APP_BLOB)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            AJ_Arg arg;
+            status = AJ_UnmarshalArg(&msg, &arg);
+            if ((status == AJ_OK) && ((arg.len != BLOB_SIZE) || memcmp(arg.val.v_byte, blob, BLOB_SIZE))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            AJ_CloseMsg(&msg);
+        }
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, 1, TRUE, 2);
+    }
+    if (status != AJ_OK) {
+        Fail("partial", status);
+    }
+}
+
+/*
+ * Alarms go ahead of queued readings unless a reading has started to be written. The reserve lets
+ * an alarm through when readings have filled the rest of the queue.
+ */
+static void CheckPriority(void)
+{
+    AJ_TxQueueStats stats;
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t serial;
+    uint32_t sent;
+    uint32_t dropped = 0;
+    uint32_t num;
+    uint32_t tick = 0;
+
+    AJ_TxQueueSetPriority(PRX_READING, AJ_TXQ_PRIORITY_BULK);
+    AJ_TxQueueSetPriority(PRX_ALARM, AJ_TXQ_PRIORITY_CONTROL);
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_DROP_NEWEST);
+    /*
+     * Readings fill the queue after the first 10 bytes have been written, then an alarm is sent
+     */
+    InitBus(TxFunc, NULL);
+    status = AJ_TxQueueStart(&bus, 0, NULL);
+    for (sent = 0; (status == AJ_OK) && (sent < CHECK_SIGNALS); ++sent) {
+        status = SendReading(sent);
+        if ((status == AJ_OK) && (sent == 0)) {
+            wire.room = 10;
+            AJ_TxQueueDrain(&bus);
+        }
+    }
+    if (status == AJ_OK) {
+        AJ_TxQueueGetStats(&stats);
+        dropped = stats.dropped;
+        status = SendAlarm(1, &serial);
+    }
+    if (status == AJ_OK) {
+        AJ_TxQueueGetStats(&stats);
+        if (!dropped || (stats.dropped != dropped) || stats.waits || (stats.expedited != 1)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status == AJ_OK) {
+        wire.room = sizeof(wire.data);
+        status = AJ_TxQueueStop(&bus);
+    }
+    /*
+     * The first reading then the alarm then the rest of the readings
+     */
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, 1, FALSE, 1);
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if ((status == AJ_OK) && (msg.msgId != APP_ALARM)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "u", &tick);
+            AJ_CloseMsg(&msg);
+        }
+    }
+    if ((status == AJ_OK) && (tick != 1)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = ReceiveReadings(&num, CHECK_SIGNALS, TRUE, 0);
+    }
+    if ((status == AJ_OK) && ((num + 1 + stats.dropped) != CHECK_SIGNALS)) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_WAIT);
+    AJ_TxQueueSetPriority(PRX_READING, AJ_TXQ_PRIORITY_DEFAULT);
+    AJ_TxQueueSetPriority(PRX_ALARM, AJ_TXQ_PRIORITY_DEFAULT);
+    if (status != AJ_OK) {
+        Fail("priority", status);
+    }
+}
+
+/*
+ * State signals for each session replace unwritten signals and are held back for the interval
+ */
+static void CheckLatest(void)
+{
+    static const uint32_t expectSession[] = { 1, 2, 1 };
+    static const uint32_t expectSeq[] = { 99, 99, 149 };
+    AJ_TxQueueStats stats;
+    AJ_Status status;
+    uint32_t seq;
+    uint32_t len = 0;
+    uint32_t num = 0;
+
+    AJ_TxQueueSetStateSignal(PRX_READING, 50);
+    InitBus(TxFunc, NULL);
+    status = AJ_TxQueueStart(&bus, 0, NULL);
+    for (seq = 0; (status == AJ_OK) && (seq < 100); ++seq) {
+        status = SendSessionReading(seq, 1);
+        if (status == AJ_OK) {
+            status = SendSessionReading(seq, 2);
+        }
+    }
+    if (status == AJ_OK) {
+        wire.room = sizeof(wire.data);
+        status = AJ_TxQueueDrain(&bus);
+        len = wire.len / 2;
+    }
+    /*
+     * The interval has not passed so the latest of these is held back
+     */
+    for (; (status == AJ_OK) && (seq < 150); ++seq) {
+        status = SendSessionReading(seq, 1);
+    }
+    if (status == AJ_OK) {
+        status = AJ_TxQueueDrain(&bus);
+        if ((status != AJ_ERR_BUSY) || (wire.len != (len * 2))) {
+            status = AJ_ERR_FAILURE;
+        } else {
+            AJ_Sleep(60);
+            status = AJ_TxQueueDrain(&bus);
+        }
+    }
+    if (status == AJ_OK) {
+        AJ_TxQueueGetStats(&stats);
+        if ((stats.coalesced != 247) || (stats.coalescedBytes != (247 * len))) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    while ((status == AJ_OK) && (wire.pos < wire.len)) {
+        AJ_Message msg;
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "u", &seq);
+            if ((status == AJ_OK) && ((num >= ArraySize(expectSeq)) || (msg.sessionId != expectSession[num]) || (seq != expectSeq[num]))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            ++num;
+            AJ_CloseMsg(&msg);
+        }
+    }
+    if ((status == AJ_OK) && (num != ArraySize(expectSeq))) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_TxQueueStop(&bus);
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_WAIT);
+    if (status != AJ_OK) {
+        Fail("latest", status);
+    }
+}
+
+/*
+ * Return the serial number of the next complete message on the wire or zero
+ */
+static uint32_t NextOnWire(void)
+{
+    AJ_MsgHeader hdr;
+    uint32_t len;
+
+    if ((wire.len - wire.pos) < sizeof(hdr)) {
+        return 0;
+    }
+    memcpy(&hdr, wire.data + wire.pos, sizeof(hdr));
+    len = sizeof(hdr) + ((hdr.headerLen + 7) & ~7) + hdr.bodyLen;
+    if ((wire.len - wire.pos) < len) {
+        return 0;
+    }
+    wire.pos += len;
+    if (wire.pos == wire.len) {
+        wire.pos = 0;
+        wire.len = 0;
+    }
+    return hdr.serialNum;
+}
+
+/*
+ * State signals from objects whose paths have the same CRC must not replace each other
+ */
+static void CheckStatePaths(void)
+{
+    static const char* const paths[] = { STATE_PATH_A, STATE_PATH_B, STATE_PATH_A, STATE_PATH_B };
+    AJ_TxQueueStats stats;
+    AJ_Status status;
+    uint32_t i;
+    uint32_t num = 0;
+
+    AJ_TxQueueSetStateSignal(PRX_READING, 0);
+    InitBus(TxFunc, NULL);
+    status = AJ_TxQueueStart(&bus, 0, NULL);
+    for (i = 0; (status == AJ_OK) && (i < ArraySize(paths)); ++i) {
+        status = AJ_SetProxyObjectPath(ProxyObjects, PRX_READING, paths[i]);
+        if (status == AJ_OK) {
+            status = SendReading(i);
+        }
+    }
+    if (status == AJ_OK) {
+        wire.room = sizeof(wire.data);
+        status = AJ_TxQueueDrain(&bus);
+    }
+    if (status == AJ_OK) {
+        /*
+         * Only the first signal from each object is replaced
+         */
+        AJ_TxQueueGetStats(&stats);
+        while (NextOnWire()) {
+            ++num;
+        }
+        if ((num != 2) || (stats.coalesced != 2)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_TxQueueStop(&bus);
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_WAIT);
+    AJ_SetProxyObjectPath(ProxyObjects, PRX_READING, AppObjects[0].path);
+    if (status != AJ_OK) {
+        Fail("state paths", status);
+    }
+}
+
+/*
+ * Measures how long alarms take to get through a link that is busy with bursts of bulk data
+ */
+static void LatencyBench(const char* name, uint8_t lanes)
+{
+    AJ_TxQueueStats stats;
+    AJ_Status status;
+    uint32_t alarmSerial[BURST_INTERVAL / ALARM_INTERVAL + 2];
+    uint32_t alarmTick[BURST_INTERVAL / ALARM_INTERVAL + 2];
+    uint32_t pending = 0;
+    uint32_t alarms = 0;
+    uint32_t total = 0;
+    uint32_t worst = 0;
+    uint32_t chunks = 0;
+    uint32_t tick;
+
+    if (lanes) {
+        AJ_TxQueueSetPriority(PRX_CHUNK, AJ_TXQ_PRIORITY_BULK);
+        AJ_TxQueueSetPriority(PRX_ALARM, AJ_TXQ_PRIORITY_CONTROL);
+    }
+    InitBus(TxFunc, NULL);
+    status = AJ_TxQueueStart(&bus, 0, NULL);
+    for (tick = 0; (status == AJ_OK) && (tick < LATENCY_TICKS); ++tick) {
+        uint32_t serial;
+        uint32_t i;
+
+        wire.room = LINK_RATE;
+        if ((tick % BURST_INTERVAL) == 0) {
+            for (i = 0; (status == AJ_OK) && (i < BURST_CHUNKS); ++i) {
+                status = SendChunk(chunks++);
+            }
+        }
+        if ((status == AJ_OK) && ((tick % ALARM_INTERVAL) == 0)) {
+            if (pending == ArraySize(alarmSerial)) {
+                status = AJ_ERR_RESOURCES;
+                break;
+            }
+            status = SendAlarm(tick, &alarmSerial[pending]);
+            alarmTick[pending++] = tick;
+        }
+        if (status == AJ_OK) {
+            status = AJ_TxQueueDrain(&bus);
+            if (status == AJ_ERR_BUSY) {
+                status = AJ_OK;
+            }
+        }
+        /*
+         * An alarm has arrived when all of it is on the wire
+         */
+        while ((serial = NextOnWire()) != 0) {
+            for (i = 0; i < pending; ++i) {
+                if (alarmSerial[i] == serial) {
+                    uint32_t latency = tick - alarmTick[i];
+                    total += latency;
+                    if (latency > worst) {
+                        worst = latency;
+                    }
+                    ++alarms;
+                    alarmSerial[i] = alarmSerial[--pending];
+                    alarmTick[i] = alarmTick[pending];
+                    break;
+                }
+            }
+        }
+    }
+    AJ_TxQueueGetStats(&stats);
+    AJ_ReleaseTxQueue(&bus);
+    AJ_TxQueueSetPriority(PRX_CHUNK, AJ_TXQ_PRIORITY_DEFAULT);
+    AJ_TxQueueSetPriority(PRX_ALARM, AJ_TXQ_PRIORITY_DEFAULT);
+
+    if ((status == AJ_OK) && !alarms) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_Printf("%-32s %u alarms, average %u.%02u ms, worst %u ms, %u expedited\n", name, alarms,
+              total / alarms, ((total % alarms) * 100) / alarms, worst, stats.expedited);
+}
+
+/*
+ * The benchmark writes to a TCP loopback connection that a slow consumer reads from
+ */
+static void* SlowConsumer(void* arg)
+{
+    int sock = (int)(intptr_t)arg;
+    uint8_t buf[1024];
+
+    while (recv(sock, buf, sizeof(buf), 0) > 0) {
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static uint64_t Microseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static void CongestionBench(const char* name, uint8_t queued, uint8_t policy)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    pthread_t consumer;
+    AJ_TxQueueStats stats;
+    AJ_Status status = AJ_OK;
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    int bufSize = 8192;
+    uint32_t i;
+    int listener;
+    int sender;
+    int receiver;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    sender = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(sender, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+    if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&addr, &addrLen) != 0) ||
+        (connect(sender, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+        ((receiver = accept(listener, NULL, NULL)) < 0)) {
+        Fail(name, AJ_ERR_CONNECT);
+        close(listener);
+        close(sender);
+        return;
+    }
+    pthread_create(&consumer, NULL, SlowConsumer, (void*)(intptr_t)receiver);
+
+    InitBus(AJ_Net_Send, (void*)(intptr_t)sender);
+    if (queued) {
+        if (policy == AJ_TXQ_LATEST) {
+            AJ_TxQueueSetStateSignal(PRX_READING, 20);
+        } else {
+            AJ_TxQueueSetPolicy(PRX_READING, policy);
+        }
+        status = AJ_TxQueueStart(&bus, 0, NULL);
+    }
+    for (i = 0; (status == AJ_OK) && (i < BENCH_SIGNALS); ++i) {
+        uint64_t start = Microseconds();
+        uint64_t elapsed;
+
+        status = SendReading(i);
+        elapsed = Microseconds() - start;
+        total += elapsed;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+        /*
+         * The rest of the control loop
+         */
+        while ((Microseconds() - start) < 20) {
+        }
+    }
+    memset(&stats, 0, sizeof(stats));
+    if (queued) {
+        AJ_TxQueueGetStats(&stats);
+        if (status == AJ_OK) {
+            status = AJ_TxQueueStop(&bus);
+        }
+    }
+    AJ_TxQueueSetPolicy(PRX_READING, AJ_TXQ_WAIT);
+
+    shutdown(sender, SHUT_WR);
+    pthread_join(consumer, NULL);
+    close(sender);
+    close(receiver);
+    close(listener);
+
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_Printf("%-32s %u signals, %u ns/send, worst %u us, %u dropped, %u coalesced (%u bytes)\n", name, BENCH_SIGNALS,
+              (uint32_t)((total * 1000) / BENCH_SIGNALS), (uint32_t)worst, stats.dropped, stats.coalesced, stats.coalescedBytes);
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, ProxyObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+#if AJ_TX_QUEUE_SIZE
+    CheckBusy();
+    CheckDropNewest();
+    CheckDropOldest();
+    CheckCoalesce();
+    CheckWait();
+    CheckPartial();
+    CheckPriority();
+    CheckLatest();
+    CheckStatePaths();
+
+    CongestionBench("blocking send", FALSE, AJ_TXQ_WAIT);
+    CongestionBench("queued, drop newest", TRUE, AJ_TXQ_DROP_NEWEST);
+    CongestionBench("queued, coalesce", TRUE, AJ_TXQ_COALESCE);
+    CongestionBench("queued, state every 20 ms", TRUE, AJ_TXQ_LATEST);
+
+    LatencyBench("alarm latency, one lane", FALSE);
+    LatencyBench("alarm latency, priority lanes", TRUE);
+#else
+    AJ_Printf("The transmit queue is disabled, AJ_TX_QUEUE_SIZE is zero\n");
+#endif
+
+    AJ_Printf("txqueue %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,245 @@
+/**
+ * @file  Typed C++ marshaling compared with the varargs marshaling functions
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "aj_typed.h"
+
+extern "C" {
+#include "aj_util.h"
+#include "aj_debug.h"
+}
+
+#define BENCH_MESSAGES  1000000
+
+static const char* const sensorIface[] = {
+    "org.alljoyn.typed_test.Sensor",
+    "!Reading sensor>u seq>t x>i y>i z>i name>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorIface,
+    NULL
+};
+
+static const AJ_Object TypedObjects[] = {
+    { "/org/alljoyn/typed_test", sensorInterfaces },
+    { NULL }
+};
+
+#define APP_READING  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define PRX_READING  AJ_PRX_MESSAGE_ID(0, 0, 0)
+
+/*
+ * Wire image of the last message sent, the receive function replays it
+ */
+typedef struct _Wire {
+    uint8_t data[1024];
+    uint32_t len;
+    uint32_t pos;
+} Wire;
+
+static Wire wire;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_BusAttachment bus;
+
+static uint32_t failures;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wire.len + tx) > sizeof(wire.data)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wire.data + wire.len, buf->readPtr, tx);
+    wire.len += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), wire.len - wire.pos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data + wire.pos, rx);
+    buf->writePtr += rx;
+    wire.pos += rx;
+    return AJ_OK;
+}
+
+static void Fail(const char* name, AJ_Status status)
+{
+    AJ_Printf("%s failed %s\n", name, AJ_StatusText(status));
+    ++failures;
+}
+
+static AJ_Status SendReading(uint8_t typed, uint32_t seq)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    wire.len = 0;
+    wire.pos = 0;
+    AJ_IO_BUF_RESET(&bus.sock.rx);
+    status = AJ_MarshalSignal(&bus, &msg, PRX_READING, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        if (typed) {
+            status = aj::MarshalArgs(&msg, (uint32_t)7, (uint64_t)seq, (int32_t)-1, (int32_t)2, (int32_t)-3, "gyro");
+        } else {
+            status = AJ_MarshalArgs(&msg, "utiiis", 7, (uint64_t)seq, -1, 2, -3, "gyro");
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status ReceiveReading(uint8_t typed, uint32_t seq)
+{
+    AJ_Message msg;
+    AJ_Status status;
+    uint32_t sensor;
+    uint64_t rxSeq;
+    int32_t x, y, z;
+    const char* name;
+
+    wire.pos = 0;
+    AJ_IO_BUF_RESET(&bus.sock.rx);
+    status = AJ_UnmarshalMsg(&bus, &msg, 0);
+    if ((status == AJ_OK) && (msg.msgId != APP_READING)) {
+        status = AJ_ERR_NO_MATCH;
+    }
+    if (status == AJ_OK) {
+        if (typed) {
+            status = aj::UnmarshalArgs(&msg, sensor, rxSeq, x, y, z, name);
+        } else {
+            status = AJ_UnmarshalArgs(&msg, "utiiis", &sensor, &rxSeq, &x, &y, &z, &name);
+        }
+        if ((status == AJ_OK) && ((sensor != 7) || (rxSeq != seq) || (x != -1) || (y != 2) || (z != -3) || strcmp(name, "gyro"))) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Messages marshaled one way must unmarshal the other way
+ */
+static void CheckInterop(void)
+{
+    uint8_t typed;
+
+    for (typed = 0; typed < 2; ++typed) {
+        AJ_Status status = SendReading(typed, 42);
+        if (status == AJ_OK) {
+            status = ReceiveReading(!typed, 42);
+        }
+        if (status != AJ_OK) {
+            Fail(typed ? "typed to varargs" : "varargs to typed", status);
+        }
+    }
+}
+
+static void Report(const char* name, uint32_t elapsed)
+{
+    AJ_Printf("%-32s %u messages in %u ms, %u ns/message\n", name, BENCH_MESSAGES, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_MESSAGES));
+}
+
+static void MarshalBench(const char* name, uint8_t typed)
+{
+    AJ_Time timer;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        AJ_Status status = SendReading(typed, i);
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+static void UnmarshalBench(const char* name, uint8_t typed)
+{
+    AJ_Time timer;
+    AJ_Status status;
+    uint32_t i;
+
+    status = SendReading(typed, 1);
+    if (status != AJ_OK) {
+        Fail(name, status);
+        return;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        status = ReceiveReading(typed, 1);
+        if (status != AJ_OK) {
+            Fail(name, status);
+            return;
+        }
+    }
+    Report(name, AJ_GetElapsedTime(&timer, TRUE));
+}
+
+int AJ_Main(void)
+{
+    AJ_Initialize();
+    AJ_RegisterObjects(TypedObjects, TypedObjects);
+#ifndef NDEBUG
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+#endif
+
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":1a.2");
+    bus.serial = 1;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    CheckInterop();
+
+    MarshalBench("marshal varargs", FALSE);
+    MarshalBench("marshal typed", TRUE);
+    UnmarshalBench("unmarshal varargs", FALSE);
+    UnmarshalBench("unmarshal typed", TRUE);
+
+    AJ_Printf("typedbench %s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file  UART transport goodput test over a simulated lossy, high latency link
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+#include <stdio.h>
+#include <pthread.h>
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_bufio.h"
+#include "aj_serial.h"
+#include "aj_serio.h"
+
+#define BITRATE B921600
+
+/*
+ * Window size to request, a legacy peer will negotiate this down to MAX_LEGACY_WINDOW_SIZE
+ */
+#ifndef GOODPUT_WINDOW_SIZE
+#define GOODPUT_WINDOW_SIZE  MAX_WINDOW_SIZE
+#endif
+
+#define GOODPUT_PACKET_SIZE  256
+#define GOODPUT_BLOCK_SIZE   1024
+#define GOODPUT_TOTAL_BYTES  (256 * 1024)
+
+/*
+ * Simulated link: one way latency in milliseconds and the percentage of frames lost
+ */
+#ifndef LINK_LATENCY
+#define LINK_LATENCY         40
+#endif
+#ifndef LINK_LOSS_PERCENT
+#define LINK_LOSS_PERCENT    3
+#endif
+
+#define MAX_FRAME_LEN        (2 * (GOODPUT_PACKET_SIZE + AJ_SERIAL_HDR_LEN + AJ_CRC_LEN) + AJ_BOUNDARY_BYTES)
+#define DELAY_LINE_FRAMES    64
+
+extern void __AJ_TX(uint8_t* buf, uint32_t len);
+
+static uint8_t block[GOODPUT_BLOCK_SIZE];
+
+/*
+ * Frames in flight on the simulated link
+ */
+typedef struct _DelayedFrame {
+    uint8_t data[MAX_FRAME_LEN];
+    uint32_t len;
+    AJ_Time due;
+} DelayedFrame;
+
+static DelayedFrame delayLine[DELAY_LINE_FRAMES];
+static uint32_t delayHead;
+static uint32_t delayTail;
+static pthread_mutex_t delayLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t delayCond = PTHREAD_COND_INITIALIZER;
+
+static uint32_t framesSent;
+static uint32_t framesLost;
+
+/**
+ * Write frames to the wire when they have been on the simulated link for LINK_LATENCY ms
+ */
+static void* DelayLineThread(void* arg)
+{
+    while (TRUE) {
+        DelayedFrame* frame;
+        AJ_Time now;
+        int32_t wait;
+
+        pthread_mutex_lock(&delayLock);
+        while (delayHead == delayTail) {
+            pthread_cond_wait(&delayCond, &delayLock);
+        }
+        frame = &delayLine[delayHead % DELAY_LINE_FRAMES];
+        pthread_mutex_unlock(&delayLock);
+
+        AJ_InitTimer(&now);
+        wait = AJ_GetTimeDifference(&frame->due, &now);
+        if (wait > 0) {
+            AJ_Sleep(wait);
+        }
+        __AJ_TX(frame->data, frame->len);
+
+        pthread_mutex_lock(&delayLock);
+        ++delayHead;
+        pthread_mutex_unlock(&delayLock);
+    }
+    return NULL;
+}
+
+/**
+ * Transmit function that loses LINK_LOSS_PERCENT of the frames and delays the rest
+ */
+static void LossyTransmit(uint8_t* buf, uint32_t len)
+{
+    DelayedFrame* frame;
+
+    ++framesSent;
+    if (((rand() % 100) < LINK_LOSS_PERCENT) || (len > MAX_FRAME_LEN)) {
+        ++framesLost;
+        return;
+    }
+    pthread_mutex_lock(&delayLock);
+    if ((delayTail - delayHead) == DELAY_LINE_FRAMES) {
+        /*
+         * Link is saturated
+         */
+        ++framesLost;
+    } else {
+        frame = &delayLine[delayTail % DELAY_LINE_FRAMES];
+        memcpy(frame->data, buf, len);
+        frame->len = len;
+        AJ_InitTimer(&frame->due);
+        AJ_TimeAddOffset(&frame->due, LINK_LATENCY);
+        ++delayTail;
+        pthread_cond_signal(&delayCond);
+    }
+    pthread_mutex_unlock(&delayLock);
+}
+
+static void FillBlock(uint32_t offset)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(block); ++i) {
+        block[i] = (uint8_t)((offset + i) * 7);
+    }
+}
+
+static void PrintGoodput(const char* tag, uint32_t bytes, uint32_t elapsed)
+{
+    AJ_Printf("%s: %u bytes in %u ms, goodput %u bytes/sec window=%u seqMask=%x latency=%u loss=%u%% (%u of %u frames lost)\n",
+              tag, bytes, elapsed, elapsed ? (uint32_t)((uint64_t)bytes * 1000 / elapsed) : 0,
+              AJ_SerialLinkParams.windowSize, AJ_SerialLinkParams.seqMask, LINK_LATENCY, LINK_LOSS_PERCENT,
+              framesLost, framesSent);
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    pthread_t thread;
+    AJ_Time timer;
+    uint32_t total = 0;
+
+#ifdef READTEST
+    status = AJ_SerialInit("/dev/ttyUSB0", BITRATE, GOODPUT_WINDOW_SIZE, GOODPUT_PACKET_SIZE);
+#else
+    status = AJ_SerialInit("/dev/ttyUSB1", BITRATE, GOODPUT_WINDOW_SIZE, GOODPUT_PACKET_SIZE);
+#endif
+    AJ_Printf("serial init was %u\n", status);
+    if (status != AJ_OK) {
+        return 1;
+    }
+
+    pthread_create(&thread, NULL, DelayLineThread, NULL);
+    // Change the buffer transmission function to one that simulates the lossy link.
+    AJ_SetTxSerialTransmit(&LossyTransmit);
+
+#if defined(READTEST) && defined(GOODPUT_BORROW)
+    /*
+     * Check the payload in place in the packet buffers
+     */
+    while (total < GOODPUT_TOTAL_BYTES) {
+        const uint8_t* data;
+        uint16_t rxlen;
+
+        status = AJ_SerialRecvBorrow(&data, &rxlen, 50000);
+        if (status == AJ_ERR_TIMEOUT) {
+            continue;
+        }
+        if (total == 0) {
+            AJ_InitTimer(&timer);
+        }
+        FillBlock(total);
+        rxlen = min(rxlen, GOODPUT_BLOCK_SIZE);
+        if (memcmp(data, block, rxlen) != 0) {
+            AJ_Printf("Failed: data mismatch at offset %u\n", total);
+            return 1;
+        }
+        AJ_SerialRecvRelease(rxlen);
+        total += rxlen;
+    }
+    PrintGoodput("Borrowing receiver", total, AJ_GetElapsedTime(&timer, TRUE));
+#elif defined(READTEST)
+    while (total < GOODPUT_TOTAL_BYTES) {
+        uint8_t rxBuffer[GOODPUT_BLOCK_SIZE];
+        uint16_t rxlen;
+
+        status = AJ_SerialRecv(rxBuffer, sizeof(rxBuffer), 50000, &rxlen);
+        if (status == AJ_ERR_TIMEOUT) {
+            continue;
+        }
+        if (status != AJ_OK) {
+            AJ_Printf("AJ_SerialRecv returned %d\n", status);
+            return 1;
+        }
+        if (total == 0) {
+            AJ_InitTimer(&timer);
+        }
+        FillBlock(total);
+        if (memcmp(rxBuffer, block, rxlen) != 0) {
+            AJ_Printf("Failed: data mismatch at offset %u\n", total);
+            return 1;
+        }
+        total += rxlen;
+    }
+    PrintGoodput("Receiver", total, AJ_GetElapsedTime(&timer, TRUE));
+#else
+    AJ_Sleep(2000);
+    AJ_InitTimer(&timer);
+    while (total < GOODPUT_TOTAL_BYTES) {
+        FillBlock(total);
+        status = AJ_SerialSend(block, sizeof(block));
+        if (status != AJ_OK) {
+            AJ_Printf("AJ_SerialSend returned %d\n", status);
+            return 1;
+        }
+        total += sizeof(block);
+    }
+    PrintGoodput("Sender", total, AJ_GetElapsedTime(&timer, TRUE));
+#endif
+
+    /*
+     * Keep the link alive so the peer can finish
+     */
+    while (1) {
+        AJ_StateMachine();
+        AJ_SerialWait(NULL);
+    }
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file  CPU usage of an idle but connected UART transport
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_serial.h"
+
+#define BITRATE B115200
+
+#define IDLE_WINDOW_SIZE  4
+#define IDLE_PACKET_SIZE  1000
+
+/*
+ * How long to wait for the link to come up and then how long to sit idle
+ */
+#define LINK_UP_TIME      5000
+#define IDLE_TIME         10000
+
+static uint32_t CpuTime(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    AJ_Time timer;
+    uint8_t rxBuffer[16];
+    uint16_t rxlen;
+    uint32_t cpu;
+    uint32_t elapsed;
+
+#ifdef READTEST
+    status = AJ_SerialInit("/dev/ttyUSB0", BITRATE, IDLE_WINDOW_SIZE, IDLE_PACKET_SIZE);
+#else
+    status = AJ_SerialInit("/dev/ttyUSB1", BITRATE, IDLE_WINDOW_SIZE, IDLE_PACKET_SIZE);
+#endif
+    AJ_Printf("serial init was %u\n", status);
+    if (status != AJ_OK) {
+        return 1;
+    }
+
+    /*
+     * Nothing is sent so the receives all time out, the link stays up with acks and
+     * link packets only
+     */
+    AJ_SerialRecv(rxBuffer, sizeof(rxBuffer), LINK_UP_TIME, &rxlen);
+    if (AJ_SerialLinkParams.linkState != AJ_LINK_ACTIVE) {
+        AJ_Printf("Failed: link did not come up\n");
+        return 1;
+    }
+
+    cpu = CpuTime();
+    AJ_InitTimer(&timer);
+    while (AJ_GetElapsedTime(&timer, TRUE) < IDLE_TIME) {
+        status = AJ_SerialRecv(rxBuffer, sizeof(rxBuffer), 1000, &rxlen);
+        if (status != AJ_ERR_TIMEOUT) {
+            AJ_Printf("AJ_SerialRecv returned %d\n", status);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    cpu = CpuTime() - cpu;
+    AJ_Printf("Idle link: %u ms cpu in %u ms, %u%% of a core\n", cpu, elapsed, elapsed ? cpu * 100 / elapsed : 0);
+
+    AJ_SerialShutdown();
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @file  Latency and throughput of the Linux UART serial I/O layer over a pty pair
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_serial.h"
+#include "aj_serio.h"
+
+/*
+ * Receive buffers are sized for a slipped packet as they are by the serial transport
+ */
+#define BENCH_PACKET_SIZE  1024
+#define RX_BUFFER_LEN      (2 * (BENCH_PACKET_SIZE + AJ_SERIAL_HDR_LEN + AJ_CRC_LEN) + AJ_BOUNDARY_BYTES)
+
+#define LATENCY_ROUNDS     2000
+#define LATENCY_FRAME_LEN  64
+#define RX_TOTAL_BYTES     (16 * 1024 * 1024)
+#define TX_BUFFER_LEN      512
+#define TX_TOTAL_BUFFERS   (16 * 1024 * 1024 / TX_BUFFER_LEN)
+
+extern AJ_Status AJ_SerialTargetInit(const char* ttyName, uint16_t bitRate);
+
+static int master;
+
+static uint8_t rxBuf[RX_BUFFER_LEN];
+static volatile uint32_t rxBytes;
+static volatile uint32_t rxTarget;
+static volatile uint32_t rxReads;
+static sem_t rxDone;
+
+static uint8_t txBufs[AJ_SERIO_TX_DEPTH][TX_BUFFER_LEN];
+static volatile uint32_t txQueued;
+static volatile uint32_t txCompleted;
+static sem_t txDone;
+
+static uint64_t NowMicros(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void RxCallback(uint8_t* buf, uint16_t len)
+{
+    rxBytes += len;
+    ++rxReads;
+    if (rxBytes < rxTarget) {
+        AJ_RX(rxBuf, sizeof(rxBuf));
+        AJ_ResumeRX();
+    } else {
+        sem_post(&rxDone);
+    }
+}
+
+static void TxCallback(uint8_t* buf, uint16_t len)
+{
+    /*
+     * Everything is queued up front so there is nothing to collect
+     */
+    if (!buf) {
+        return;
+    }
+    ++txCompleted;
+    if (txQueued < TX_TOTAL_BUFFERS) {
+        ++txQueued;
+        AJ_TX(buf, len);
+        AJ_ResumeTX();
+    } else if (txCompleted == TX_TOTAL_BUFFERS) {
+        sem_post(&txDone);
+    }
+}
+
+static void Receive(uint32_t bytes)
+{
+    rxBytes = 0;
+    rxTarget = bytes;
+    AJ_PauseRX();
+    AJ_RX(rxBuf, sizeof(rxBuf));
+    AJ_ResumeRX();
+}
+
+static void WaitFor(sem_t* sem)
+{
+    while (sem_wait(sem) != 0) {
+    }
+}
+
+/**
+ * Write bytes to the master side of the pty
+ */
+static void MasterWrite(const uint8_t* buf, uint32_t len)
+{
+    while (len) {
+        ssize_t ret = write(master, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            AJ_Printf("master write failed %d\n", errno);
+            exit(1);
+        }
+        buf += ret;
+        len -= ret;
+    }
+}
+
+static void* FloodThread(void* arg)
+{
+    uint8_t chunk[4096];
+    uint32_t total = 0;
+
+    memset(chunk, 0x55, sizeof(chunk));
+    while (total < RX_TOTAL_BYTES) {
+        MasterWrite(chunk, sizeof(chunk));
+        total += sizeof(chunk);
+    }
+    return NULL;
+}
+
+static volatile uint32_t drained;
+
+static void* DrainThread(void* arg)
+{
+    uint8_t chunk[4096];
+
+    while (drained < TX_TOTAL_BUFFERS * TX_BUFFER_LEN) {
+        ssize_t ret = read(master, chunk, sizeof(chunk));
+        if (ret > 0) {
+            drained += ret;
+        } else if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+            AJ_Printf("master read failed %d\n", errno);
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+static void ReceiveLatency(void)
+{
+    uint8_t frame[LATENCY_FRAME_LEN];
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    int i;
+
+    memset(frame, 0xAA, sizeof(frame));
+    for (i = 0; i < LATENCY_ROUNDS; ++i) {
+        uint64_t start;
+        uint64_t elapsed;
+
+        Receive(sizeof(frame));
+        start = NowMicros();
+        MasterWrite(frame, sizeof(frame));
+        WaitFor(&rxDone);
+        elapsed = NowMicros() - start;
+        total += elapsed;
+        worst = max(worst, elapsed);
+    }
+    AJ_Printf("rx latency: %u byte frames, average %u us, worst %u us\n", LATENCY_FRAME_LEN,
+              (uint32_t)(total / LATENCY_ROUNDS), (uint32_t)worst);
+}
+
+static void ReceiveThroughput(void)
+{
+    pthread_t thread;
+    uint64_t start;
+    uint64_t elapsed;
+
+    rxReads = 0;
+    Receive(RX_TOTAL_BYTES);
+    start = NowMicros();
+    pthread_create(&thread, NULL, FloodThread, NULL);
+    WaitFor(&rxDone);
+    elapsed = NowMicros() - start;
+    pthread_join(thread, NULL);
+    AJ_Printf("rx throughput: %u bytes in %u ms, %u KB/sec, %u bytes per read\n", rxBytes,
+              (uint32_t)(elapsed / 1000), (uint32_t)((uint64_t)rxBytes * 1000000 / 1024 / elapsed),
+              rxBytes / rxReads);
+}
+
+static void TransmitThroughput(void)
+{
+    pthread_t thread;
+    uint64_t start;
+    uint64_t elapsed;
+    int i;
+
+    pthread_create(&thread, NULL, DrainThread, NULL);
+    start = NowMicros();
+    AJ_PauseTX();
+    for (i = 0; i < AJ_SERIO_TX_DEPTH; ++i) {
+        ++txQueued;
+        AJ_TX(txBufs[i], TX_BUFFER_LEN);
+    }
+    AJ_ResumeTX();
+    WaitFor(&txDone);
+    pthread_join(thread, NULL);
+    elapsed = NowMicros() - start;
+    AJ_Printf("tx throughput: %u bytes in %u ms, %u KB/sec, %u buffers queued\n", drained,
+              (uint32_t)(elapsed / 1000), (uint32_t)((uint64_t)drained * 1000000 / 1024 / elapsed),
+              AJ_SERIO_TX_DEPTH);
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        AJ_Printf("Failed to open pty\n");
+        return 1;
+    }
+    status = AJ_SerialTargetInit(ptsname(master), B115200);
+    if (status != AJ_OK) {
+        AJ_Printf("AJ_SerialTargetInit returned %d\n", status);
+        return 1;
+    }
+#ifdef AJ_SERIAL_IO_THREAD
+    AJ_Printf("Serial I/O threads\n");
+#else
+    AJ_Printf("Serial I/O SIGIO handler\n");
+#endif
+    sem_init(&rxDone, 0, 0);
+    sem_init(&txDone, 0, 0);
+    AJ_SetRxCB(RxCallback);
+    AJ_SetTxCB(TxCallback);
+
+    ReceiveLatency();
+    ReceiveThroughput();
+    TransmitThroughput();
+
+    AJ_SerialIOShutdown();
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file  Stress test of the serial buffer rings under a receive interrupt flood
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_serial.h"
+
+#define FLOOD_BUFFERS    (AJ_SERIAL_RING_SIZE - 1)
+#define FLOOD_BUFFER_LEN 16
+#define FLOOD_PACKETS    (4 * 1024 * 1024)
+
+static AJ_SlippedBufferRing freeRing;
+static AJ_SlippedBufferRing rxQueue;
+
+static uint32_t noFreeBuffer;
+static uint32_t queueFull;
+static uint32_t queueEmpty;
+
+/**
+ * Plays the part of the receive interrupt: takes a free buffer, fills it and queues it
+ * as fast as it can.
+ */
+static void* RxInterruptThread(void* arg)
+{
+    uint32_t seq = 0;
+
+    while (seq < FLOOD_PACKETS) {
+        AJ_SlippedBuffer* buf = AJ_SerialRingPop(&freeRing);
+        if (buf == NULL) {
+            ++noFreeBuffer;
+            sched_yield();
+            continue;
+        }
+        memcpy(buf->buffer, &seq, sizeof(seq));
+        buf->actualLen = sizeof(seq);
+        while (!AJ_SerialRingPush(&rxQueue, buf)) {
+            /*
+             * Cannot happen while there are fewer buffers than ring entries
+             */
+            ++queueFull;
+            sched_yield();
+        }
+        ++seq;
+    }
+    return NULL;
+}
+
+int AJ_Main()
+{
+    pthread_t thread;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t expect = 0;
+    int i;
+
+    AJ_SerialRingInit(&freeRing);
+    AJ_SerialRingInit(&rxQueue);
+    for (i = 0; i < FLOOD_BUFFERS; ++i) {
+        AJ_SlippedBuffer* buf = AJ_Malloc(sizeof(AJ_SlippedBuffer));
+        buf->buffer = AJ_Malloc(FLOOD_BUFFER_LEN);
+        buf->allocatedLen = FLOOD_BUFFER_LEN;
+        buf->actualLen = 0;
+        buf->next = NULL;
+        AJ_SerialRingPush(&freeRing, buf);
+    }
+#ifdef AJ_SERIAL_RING_ATOMICS
+    AJ_Printf("Rings use C11 atomics\n");
+#else
+    AJ_Printf("Rings use volatile indices\n");
+#endif
+
+    AJ_InitTimer(&timer);
+    pthread_create(&thread, NULL, RxInterruptThread, NULL);
+
+    /*
+     * Plays the part of the state machine: drain the receive queue, check nothing was
+     * lost, duplicated or reordered and hand the buffers back.
+     */
+    while (expect < FLOOD_PACKETS) {
+        uint32_t seq;
+        AJ_SlippedBuffer* buf = AJ_SerialRingPop(&rxQueue);
+        if (buf == NULL) {
+            ++queueEmpty;
+            sched_yield();
+            continue;
+        }
+        memcpy(&seq, buf->buffer, sizeof(seq));
+        if ((buf->actualLen != sizeof(seq)) || (seq != expect)) {
+            AJ_Printf("Failed: got packet %u expected %u\n", seq, expect);
+            return 1;
+        }
+        buf->actualLen = 0;
+        AJ_SerialRingPush(&freeRing, buf);
+        ++expect;
+    }
+    pthread_join(thread, NULL);
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+
+    if (!AJ_SerialRingEmpty(&rxQueue)) {
+        AJ_Printf("Failed: receive queue not empty\n");
+        return 1;
+    }
+    AJ_SerialRingClear(&freeRing);
+
+    AJ_Printf("Passed: %u packets in %u ms, %u packets/ms, free ring empty %u times, queue full %u times, queue empty %u times\n",
+              expect, elapsed, elapsed ? expect / elapsed : 0, noFreeBuffer, queueFull, queueEmpty);
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
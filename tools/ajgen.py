@@ -0,0 +1,656 @@
+#!/usr/bin/env python
+# Copyright 2013, Qualcomm Innovation Center, Inc.
+#
+#    All rights reserved.
+#    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+#    file for this project. A copy of the 3-clause BSD license is found at:
+#
+#        http://opensource.org/licenses/BSD-3-Clause.
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the license is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the license for the specific language governing permissions and
+#    limitations under the license.
+#
+
+"""Generate AllJoyn Thin Client object tables from D-Bus introspection XML.
+
+For an XML file describing one or more objects this writes a C header and source file with:
+
+  - the interface descriptions and an AJ_Object table for the objects
+  - message and property id constants for the objects used as local (APP) or proxy (PRX) objects
+  - a message id lookup function using a perfect hash of the interface and member names, to be
+    registered with AJ_RegisterMsgIdLookup()
+  - typed marshal and unmarshal functions for members whose arguments are basic types or arrays of
+    scalars
+"""
+
+from __future__ import print_function
+
+import getopt
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+SECURE_ANNOTATION = 'org.alljoyn.Bus.Secure'
+PROPS_IFACE = 'org.freedesktop.DBus.Properties'
+
+METHOD = 'method'
+SIGNAL = 'signal'
+PROPERTY = 'property'
+
+# Members of AJ_PropertiesIface in index order: name, id name, signature of the method call
+PROPS_MEMBERS = [('Get', 'GET_PROP', 'ss'), ('Set', 'SET_PROP', 'ssv'), ('GetAll', 'GET_ALL_PROPS', 's')]
+
+# C types and type ids for the basic types
+BASIC_TYPES = {
+    'y': ('uint8_t', 'AJ_ARG_BYTE', 'v_byte'),
+    'b': ('uint32_t', 'AJ_ARG_BOOLEAN', 'v_bool'),
+    'n': ('int16_t', 'AJ_ARG_INT16', 'v_int16'),
+    'q': ('uint16_t', 'AJ_ARG_UINT16', 'v_uint16'),
+    'i': ('int32_t', 'AJ_ARG_INT32', 'v_int32'),
+    'u': ('uint32_t', 'AJ_ARG_UINT32', 'v_uint32'),
+    'x': ('int64_t', 'AJ_ARG_INT64', 'v_int64'),
+    't': ('uint64_t', 'AJ_ARG_UINT64', 'v_uint64'),
+    'd': ('double', 'AJ_ARG_DOUBLE', 'v_double'),
+    's': ('const char*', 'AJ_ARG_STRING', 'v_string'),
+    'o': ('const char*', 'AJ_ARG_OBJ_PATH', 'v_objPath'),
+    'g': ('const char*', 'AJ_ARG_SIGNATURE', 'v_signature'),
+}
+
+STRING_TYPES = 'sog'
+
+LICENSE = """/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+"""
+
+
+class GenError(Exception):
+    pass
+
+
+class Arg(object):
+    def __init__(self, name, sig, direction):
+        self.name = name
+        self.sig = sig
+        self.direction = direction
+
+
+class Member(object):
+    def __init__(self, kind, name):
+        self.kind = kind
+        self.name = name
+        self.args = []
+        self.access = None
+        self.sig = None
+
+    def in_sig(self):
+        return ''.join(a.sig for a in self.args if a.direction == 'in')
+
+    def out_sig(self):
+        return ''.join(a.sig for a in self.args if a.direction == 'out')
+
+    def encoding(self):
+        if self.kind == PROPERTY:
+            return '@' + self.name + {'read': '>', 'readwrite': '=', 'write': '<'}[self.access] + self.sig
+        enc = ('?' if self.kind == METHOD else '!') + self.name
+        for a in self.args:
+            enc += ' ' + (a.name or '') + ('<' if a.direction == 'in' else '>') + a.sig
+        return enc
+
+
+class Interface(object):
+    def __init__(self, name, secure):
+        self.name = name
+        self.secure = secure
+        self.members = []
+
+    def has_properties(self):
+        return any(m.kind == PROPERTY for m in self.members)
+
+    def short_name(self):
+        return self.name.split('.')[-1]
+
+
+class Object(object):
+    def __init__(self, path):
+        self.path = path
+        self.interfaces = []
+
+    def has_properties(self):
+        return any(i.has_properties() for i in self.interfaces)
+
+    def iface_list(self):
+        """The interface names in msg id order, the properties interface comes first"""
+        names = [i.name for i in self.interfaces]
+        if self.has_properties():
+            names.insert(0, PROPS_IFACE)
+        return names
+
+    def short_name(self):
+        return self.path.rstrip('/').split('/')[-1] or 'root'
+
+
+def check_name(name, what):
+    if not name or not re.match(r'^[A-Za-z_][A-Za-z0-9_.]*$', name):
+        raise GenError('invalid %s name "%s"' % (what, name))
+
+
+def parse_sig(sig, what):
+    """Check that a signature is made of complete types"""
+    def complete(pos):
+        if pos >= len(sig):
+            raise GenError('incomplete signature "%s" for %s' % (sig, what))
+        c = sig[pos]
+        if c in BASIC_TYPES or c in 'vh':
+            return pos + 1
+        if c == 'a':
+            return complete(pos + 1)
+        close = {'(': ')', '{': '}'}.get(c)
+        if not close:
+            raise GenError('invalid signature "%s" for %s' % (sig, what))
+        pos += 1
+        while pos < len(sig) and sig[pos] != close:
+            pos = complete(pos)
+        if pos >= len(sig):
+            raise GenError('unterminated signature "%s" for %s' % (sig, what))
+        return pos + 1
+    pos = 0
+    while pos < len(sig):
+        pos = complete(pos)
+
+
+def parse_interface(elem):
+    name = elem.get('name')
+    check_name(name, 'interface')
+    secure = None
+    for a in elem.findall('annotation'):
+        if a.get('name') == SECURE_ANNOTATION:
+            secure = a.get('value')
+    iface = Interface(name, secure)
+    for child in elem:
+        kind = child.tag
+        if kind not in (METHOD, SIGNAL, PROPERTY):
+            continue
+        m = Member(kind, child.get('name'))
+        check_name(m.name, kind)
+        what = '%s.%s' % (name, m.name)
+        if kind == PROPERTY:
+            m.sig = child.get('type', '')
+            m.access = child.get('access')
+            if not m.sig:
+                raise GenError('missing type for %s' % what)
+            parse_sig(m.sig, what)
+            if m.access not in ('read', 'readwrite', 'write'):
+                raise GenError('invalid access "%s" for %s' % (m.access, what))
+        else:
+            for a in child.findall('arg'):
+                direction = a.get('direction', 'in' if kind == METHOD else 'out')
+                if kind == SIGNAL and direction != 'out':
+                    raise GenError('signal %s has an input argument' % what)
+                parse_sig(a.get('type', ''), what)
+                m.args.append(Arg(a.get('name'), a.get('type'), direction))
+        if any(x.name == m.name for x in iface.members):
+            raise GenError('duplicate member %s' % what)
+        iface.members.append(m)
+    if len(iface.members) > 255:
+        raise GenError('too many members in %s' % name)
+    return iface
+
+
+def parse_xml(path):
+    root = ET.parse(path).getroot()
+    if root.tag != 'node':
+        raise GenError('%s: root element must be <node>' % path)
+    interfaces = {}
+    objects = []
+
+    def walk(node, parent):
+        name = node.get('name')
+        if name is None:
+            obj_path = parent
+        elif name.startswith('/'):
+            obj_path = name
+        elif parent:
+            obj_path = parent.rstrip('/') + '/' + name
+        else:
+            raise GenError('relative object path "%s" without a parent' % name)
+        refs = []
+        for elem in node.findall('interface'):
+            iface = parse_interface(elem)
+            if iface.members:
+                if iface.name in interfaces and interfaces[iface.name].members:
+                    raise GenError('interface %s is defined more than once' % iface.name)
+                interfaces[iface.name] = iface
+            elif iface.name not in interfaces:
+                interfaces[iface.name] = iface
+            refs.append(iface.name)
+        if refs:
+            if not obj_path:
+                raise GenError('interfaces without an object path')
+            obj = Object(obj_path)
+            obj.interfaces = refs
+            objects.append(obj)
+        for child in node.findall('node'):
+            walk(child, obj_path)
+
+    walk(root, None)
+    for obj in objects:
+        obj.interfaces = [interfaces[n] for n in obj.interfaces]
+        if len(obj.iface_list()) > 255:
+            raise GenError('too many interfaces on %s' % obj.path)
+    if not objects:
+        raise GenError('%s: no objects' % path)
+    if len(objects) > 255:
+        raise GenError('too many objects')
+    return objects
+
+
+def camel(name):
+    return ''.join(p[:1].upper() + p[1:] for p in re.split(r'[_.]', name) if p)
+
+
+def upper(name):
+    s = re.sub(r'([a-z0-9])([A-Z])', r'\1_\2', name)
+    return re.sub(r'[^A-Za-z0-9]', '_', s).upper()
+
+
+def unique_names(entries):
+    """Pick the shortest unique name for each entry from its list of candidates"""
+    names = []
+    for cands in entries:
+        for c in cands:
+            if sum(1 for other in entries if c in other) == 1 or c == cands[-1]:
+                names.append(c)
+                break
+    return names
+
+
+def fnv(data, seed):
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+    for c in data:
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def hash_key(iface, member, kind, full):
+    """The bytes hashed by HashMember(), the interface name is only hashed if the member names,
+    message types and interface name lengths are not enough to tell the members apart"""
+    key = bytearray(member.encode('ascii'))
+    key.append(1 if kind == METHOD else 4)
+    key.append(len(iface) & 0xFF)
+    if full:
+        key += bytearray(iface.encode('ascii'))
+    return bytes(key)
+
+
+def perfect_hash(keys):
+    """Find a table size and seed for which the keys do not collide. The slot is taken from the top
+    bits of the hash because the low bits of an FNV hash only depend on the low bits of the input."""
+    bits = 1
+    while (1 << bits) < len(keys):
+        bits += 1
+    while True:
+        for seed in range(0x10000):
+            slots = set()
+            for k in keys:
+                slot = fnv(bytearray(k), seed) >> (32 - bits)
+                if slot in slots:
+                    break
+                slots.add(slot)
+            else:
+                return bits, seed
+        bits += 1
+
+
+class Generator(object):
+    def __init__(self, objects, prefix, base, xml_name):
+        self.objects = objects
+        self.prefix = prefix
+        self.base = base
+        self.xml_name = xml_name
+        self.ids = []
+        self.stubs = []
+        self.collect()
+
+    def collect(self):
+        # Message and property ids
+        entries = []
+        for p, obj in enumerate(self.objects):
+            for i, iname in enumerate(obj.iface_list()):
+                if iname == PROPS_IFACE:
+                    for m, (name, idname, sig) in enumerate(PROPS_MEMBERS):
+                        cands = [idname, upper(obj.short_name()) + '_' + idname]
+                        entries.append((cands, 'MESSAGE', p, i, m))
+                    continue
+                iface = [x for x in obj.interfaces if x.name == iname][0]
+                for m, mem in enumerate(iface.members):
+                    base = upper(mem.name)
+                    scoped = upper(iface.short_name()) + '_' + base
+                    cands = [base, scoped, upper(obj.short_name()) + '_' + base, upper(obj.short_name()) + '_' + scoped]
+                    kind = 'PROPERTY' if mem.kind == PROPERTY else 'MESSAGE'
+                    entries.append((cands, kind, p, i, m))
+        for name, (cands, kind, p, i, m) in zip(unique_names([e[0] for e in entries]), entries):
+            self.ids.append((name, kind, p, i, m))
+        # Typed marshalers, one set per interface member
+        seen = []
+        members = []
+        for obj in self.objects:
+            for iface in obj.interfaces:
+                if iface in seen:
+                    continue
+                seen.append(iface)
+                for mem in iface.members:
+                    if mem.kind != PROPERTY:
+                        members.append((iface, mem))
+        names = unique_names([[camel(mem.name), camel(iface.short_name()) + camel(mem.name)] for iface, mem in members])
+        self.stubs = list(zip(names, members))
+
+    def hash_entries(self):
+        """The method and signal entries for the lookup, each with the objects that implement it"""
+        entries = []
+        for p, obj in enumerate(self.objects):
+            for i, iname in enumerate(obj.iface_list()):
+                if iname == PROPS_IFACE:
+                    members = [(name, METHOD, sig, m) for m, (name, idname, sig) in enumerate(PROPS_MEMBERS)]
+                else:
+                    iface = [x for x in obj.interfaces if x.name == iname][0]
+                    members = [(mem.name, mem.kind, mem.in_sig() if mem.kind == METHOD else mem.out_sig(), m)
+                               for m, mem in enumerate(iface.members) if mem.kind != PROPERTY]
+                for name, kind, sig, m in members:
+                    for e in entries:
+                        if e['iface'] == iname and e['member'] == name:
+                            e['impl'].append((p, i))
+                            break
+                    else:
+                        entries.append({'iface': iname, 'member': name, 'kind': kind, 'sig': sig, 'mIndex': m, 'impl': [(p, i)]})
+        return entries
+
+    def write_header(self, out):
+        guard = '_' + re.sub(r'[^A-Za-z0-9]', '_', self.base).upper() + '_H'
+        w = out.write
+        w('#ifndef %s\n#define %s\n' % (guard, guard))
+        w('/**\n * @file %s.h\n *\n * Generated by ajgen.py from %s, do not edit.\n */\n' % (self.base, self.xml_name))
+        w(LICENSE)
+        w('\n#include "alljoyn.h"\n\n')
+        w('#ifdef __cplusplus\nextern "C" {\n#endif\n\n')
+        w('/**\n * The objects, register with AJ_RegisterObjects() as the local or proxy objects\n */\n')
+        w('extern const AJ_Object %s_Objects[];\n\n' % self.prefix)
+        w('/*\n * Message and property ids for the objects registered as local objects\n */\n')
+        for name, kind, p, i, m in self.ids:
+            w('#define %s_APP_%s AJ_APP_%s_ID(%u, %u, %u)\n' % (upper(self.prefix), name, kind, p, i, m))
+        w('\n/*\n * Message and property ids for the objects registered as proxy objects\n */\n')
+        for name, kind, p, i, m in self.ids:
+            w('#define %s_PRX_%s AJ_PRX_%s_ID(%u, %u, %u)\n' % (upper(self.prefix), name, kind, p, i, m))
+        w('\n/**\n * Identifies method calls and signals for the objects, register with AJ_RegisterMsgIdLookup()\n */\n')
+        w('AJ_Status %s_LookupMsgId(const AJ_Object* objList, AJ_Message* msg);\n' % self.prefix)
+        for decl in self.stub_decls():
+            w('\n' + decl + ';\n')
+        w('\n#ifdef __cplusplus\n}\n#endif\n\n#endif\n')
+
+    def stub_funcs(self):
+        """Name, comment, marshal flag and arguments of the typed marshalers"""
+        for name, (iface, mem) in self.stubs:
+            if mem.kind == METHOD:
+                groups = [('', 'the arguments of the %s method call' % mem.name, mem.args, 'in'),
+                          ('Reply', 'the arguments of the %s method reply' % mem.name, mem.args, 'out')]
+            else:
+                groups = [('', 'the arguments of the %s signal' % mem.name, mem.args, 'out')]
+            for suffix, what, args, direction in groups:
+                args = [a for a in args if a.direction == direction]
+                if not args or not all(supported(a.sig) for a in args):
+                    continue
+                for n, a in enumerate(args):
+                    a.cname = a.name if a.name and re.match(r'^[A-Za-z_]\w*$', a.name) else 'arg%u' % n
+                yield (name + suffix, what, args)
+
+    def stub_decls(self):
+        for fname, what, args in self.stub_funcs():
+            for marshal in (True, False):
+                params = ['AJ_Message* msg']
+                for a in args:
+                    params += c_params(a, marshal)
+                yield '/**\n * %s %s\n */\nAJ_Status %s_%s%s(%s)' % ('Marshal' if marshal else 'Unmarshal', what,
+                                                                     self.prefix, 'Marshal' if marshal else 'Unmarshal',
+                                                                     fname, ', '.join(params))
+
+    def write_source(self, out):
+        w = out.write
+        w('/**\n * @file\n *\n * Generated by ajgen.py from %s, do not edit.\n */\n' % self.xml_name)
+        w(LICENSE)
+        w('\n#include "%s.h"\n\n' % self.base)
+        # Interface descriptions
+        seen = []
+        for obj in self.objects:
+            for iface in obj.interfaces:
+                if iface in seen:
+                    continue
+                seen.append(iface)
+                flag = {'true': '$', 'off': '#'}.get(iface.secure, '')
+                w('static const char* const %sInterface[] = {\n' % camel(iface.name))
+                w('    "%s%s",\n' % (flag, iface.name))
+                for mem in iface.members:
+                    w('    "%s",\n' % mem.encoding())
+                w('    NULL\n};\n\n')
+        for p, obj in enumerate(self.objects):
+            w('static const AJ_InterfaceDescription Object%uInterfaces[] = {\n' % p)
+            if obj.has_properties():
+                w('    AJ_PropertiesIface,\n')
+            for iface in obj.interfaces:
+                w('    %sInterface,\n' % camel(iface.name))
+            w('    NULL\n};\n\n')
+        w('const AJ_Object %s_Objects[] = {\n' % self.prefix)
+        for p, obj in enumerate(self.objects):
+            w('    { "%s", Object%uInterfaces },\n' % (obj.path, p))
+        w('    { NULL }\n};\n\n')
+        self.write_lookup(out)
+        for fname, what, args in self.stub_funcs():
+            self.write_marshal(out, fname, args)
+            self.write_unmarshal(out, fname, args)
+
+    def write_lookup(self, out):
+        w = out.write
+        entries = self.hash_entries()
+        keys = [hash_key(e['iface'], e['member'], e['kind'], False) for e in entries]
+        full = len(set(keys)) != len(keys)
+        if full:
+            keys = [hash_key(e['iface'], e['member'], e['kind'], True) for e in entries]
+        bits, seed = perfect_hash(keys)
+        slots = [None] * (1 << bits)
+        for k, e in zip(keys, entries):
+            slots[fnv(bytearray(k), seed) >> (32 - bits)] = e
+        w('#define HASH_SEED        0x%04X\n#define HASH_BITS        %u\n#define HASH_SLOTS       (1 << HASH_BITS)\n' % (seed, bits))
+        w('#define HASH_FULL_IFACE  %u\n\n' % full)
+        w('/*\n * Objects and interface indices of the objects implementing each member, 0xFF terminated\n */\n')
+        w('static const uint8_t Implementations[] = {\n')
+        offset = 0
+        for e in entries:
+            e['offset'] = offset
+            w('    %s0xFF,\n' % ''.join('%u, %u, ' % pi for pi in e['impl']))
+            offset += 2 * len(e['impl']) + 1
+        w('};\n\n')
+        w('typedef struct _MemberSlot {\n')
+        w('    const char* iface;\n    const char* member;\n    const char* signature;\n')
+        w('    uint8_t msgType;\n    uint8_t mIndex;\n    uint16_t impl;\n} MemberSlot;\n\n')
+        w('/*\n * Methods and signals indexed by a perfect hash of the interface and member names\n */\n')
+        w('static const MemberSlot MemberSlots[HASH_SLOTS] = {\n')
+        for e in slots:
+            if e:
+                w('    { "%s", "%s", "%s", %s, %u, %u },\n' % (e['iface'], e['member'], e['sig'],
+                                                          'AJ_MSG_METHOD_CALL' if e['kind'] == METHOD else 'AJ_MSG_SIGNAL',
+                                                          e['mIndex'], e['offset']))
+            else:
+                w('    { NULL },\n')
+        w('};\n\n')
+        w('''static uint32_t HashMember(const char* iface, const char* member, uint8_t msgType)
+{
+    uint32_t h = 2166136261UL ^ HASH_SEED;
+
+    while (*member) {
+        h = (h ^ (uint8_t)*member++) * 16777619UL;
+    }
+    h = (h ^ msgType) * 16777619UL;
+    h = (h ^ (uint8_t)strlen(iface)) * 16777619UL;
+#if HASH_FULL_IFACE
+    while (*iface) {
+        h = (h ^ (uint8_t)*iface++) * 16777619UL;
+    }
+#endif
+    return h;
+}
+
+AJ_Status %s_LookupMsgId(const AJ_Object* objList, AJ_Message* msg)
+{
+    const MemberSlot* slot;
+    const uint8_t* impl;
+
+    if (!msg->iface || !msg->member || !msg->objPath) {
+        return AJ_ERR_NO_MATCH;
+    }
+    slot = &MemberSlots[HashMember(msg->iface, msg->member, msg->hdr->msgType) >> (32 - HASH_BITS)];
+    if (!slot->member || (slot->msgType != msg->hdr->msgType) || strcmp(slot->member, msg->member) || strcmp(slot->iface, msg->iface)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    for (impl = &Implementations[slot->impl]; *impl != 0xFF; impl += 2) {
+        const AJ_Object* obj = &objList[impl[0]];
+        if (!(obj->flags & AJ_OBJ_FLAG_DISABLED) && (strcmp(obj->path, msg->objPath) == 0)) {
+            if (strcmp(slot->signature, msg->signature ? msg->signature : "")) {
+                return AJ_ERR_SIGNATURE;
+            }
+            msg->msgId = ((uint32_t)impl[0] << 16) | ((uint32_t)impl[1] << 8) | slot->mIndex;
+            return AJ_OK;
+        }
+    }
+    return AJ_ERR_NO_MATCH;
+}
+''' % self.prefix)
+
+    def write_marshal(self, out, fname, args):
+        w = out.write
+        params = ['AJ_Message* msg']
+        for a in args:
+            params += c_params(a, True)
+        w('\nAJ_Status %s_Marshal%s(%s)\n{\n' % (self.prefix, fname, ', '.join(params)))
+        w('    AJ_Status status;\n    AJ_Arg arg;\n\n')
+        for n, a in enumerate(args):
+            indent = '    ' if n == 0 else '        '
+            if n:
+                w('    if (status == AJ_OK) {\n')
+            if a.sig[0] == 'a':
+                ctype, typeid, field = BASIC_TYPES[a.sig[1]]
+                w('%sAJ_InitArg(&arg, %s, AJ_ARRAY_FLAG, %s, %sLen * sizeof(%s));\n' % (indent, typeid, a.cname, a.cname, ctype))
+            elif a.sig in STRING_TYPES:
+                w('%sAJ_InitArg(&arg, %s, 0, %s, 0);\n' % (indent, BASIC_TYPES[a.sig][1], a.cname))
+            else:
+                w('%sAJ_InitArg(&arg, %s, 0, &%s, 0);\n' % (indent, BASIC_TYPES[a.sig][1], a.cname))
+            w('%sstatus = AJ_MarshalArg(msg, &arg);\n' % indent)
+            if n:
+                w('    }\n')
+        w('    return status;\n}\n')
+
+    def write_unmarshal(self, out, fname, args):
+        w = out.write
+        params = ['AJ_Message* msg']
+        for a in args:
+            params += c_params(a, False)
+        w('\nAJ_Status %s_Unmarshal%s(%s)\n{\n' % (self.prefix, fname, ', '.join(params)))
+        w('    AJ_Status status = AJ_OK;\n    AJ_Arg arg;\n')
+        for a in args:
+            w('\n    if (status == AJ_OK) {\n        status = AJ_UnmarshalArg(msg, &arg);\n    }\n')
+            if a.sig[0] == 'a':
+                ctype, typeid, field = BASIC_TYPES[a.sig[1]]
+                w('    if (status == AJ_OK) {\n')
+                w('        if ((arg.typeId == %s) && (arg.flags & AJ_ARRAY_FLAG)) {\n' % typeid)
+                w('            *%s = arg.val.%s;\n' % (a.cname, field))
+                w('            *%sLen = arg.len / sizeof(%s);\n' % (a.cname, ctype))
+            else:
+                ctype, typeid, field = BASIC_TYPES[a.sig]
+                deref = '' if a.sig in STRING_TYPES else '*'
+                w('    if (status == AJ_OK) {\n')
+                w('        if ((arg.typeId == %s) && !(arg.flags & AJ_ARRAY_FLAG)) {\n' % typeid)
+                w('            *%s = %sarg.val.%s;\n' % (a.cname, deref, field))
+            w('        } else {\n            status = AJ_ERR_UNMARSHAL;\n        }\n    }\n')
+        w('    return status;\n}\n')
+
+
+def supported(sig):
+    """Typed marshalers are generated for basic types and arrays of scalars"""
+    if sig in BASIC_TYPES:
+        return True
+    return len(sig) == 2 and sig[0] == 'a' and sig[1] in BASIC_TYPES and sig[1] not in STRING_TYPES
+
+
+def c_params(a, marshal):
+    if a.sig[0] == 'a':
+        ctype = BASIC_TYPES[a.sig[1]][0]
+        if marshal:
+            return ['const %s* %s' % (ctype, a.cname), 'size_t %sLen' % a.cname]
+        return ['const %s** %s' % (ctype, a.cname), 'size_t* %sLen' % a.cname]
+    ctype = BASIC_TYPES[a.sig][0]
+    return ['%s %s' % (ctype, a.cname)] if marshal else ['%s* %s' % (ctype, a.cname)]
+
+
+def usage():
+    print("""
+Usage:
+    python ajgen.py [ -p prefix ] -o output_base introspection.xml
+where:
+    prefix:       prefix for the generated names; default: output_base in camel case
+    output_base:  path of the generated files without the .c and .h extensions
+""", file=sys.stderr)
+
+
+def main(argv=None):
+    if argv is None:
+        argv = sys.argv[1:]
+    try:
+        opts, args = getopt.getopt(argv, 'p:o:h')
+    except getopt.GetoptError as err:
+        print(err, file=sys.stderr)
+        usage()
+        return 2
+    prefix = None
+    output = None
+    for o, a in opts:
+        if o == '-p':
+            prefix = a
+        elif o == '-o':
+            output = a
+        else:
+            usage()
+            return 2
+    if len(args) != 1 or not output:
+        usage()
+        return 2
+    base = os.path.basename(output)
+    if not prefix:
+        prefix = camel(base)
+    try:
+        gen = Generator(parse_xml(args[0]), prefix, base, os.path.basename(args[0]))
+    except (GenError, ET.ParseError) as err:
+        print('%s: %s' % (args[0], err), file=sys.stderr)
+        return 1
+    with open(output + '.h', 'w') as out:
+        gen.write_header(out)
+    with open(output + '.c', 'w') as out:
+        gen.write_source(out)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
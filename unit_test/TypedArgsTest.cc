@@ -0,0 +1,280 @@
+/**
+ * @file  Typed C++ Marshal/Unmarshal Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "aj_typed.h"
+
+extern "C" {
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_bufio.h"
+
+#ifndef NDEBUG
+extern AJ_MutterHook MutterHook;
+#endif
+}
+
+static uint8_t wireBuffer[16 * 1024];
+static size_t wireBytes = 0;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wireBytes + tx) > sizeof(wireBuffer)) {
+        return AJ_ERR_WRITE;
+    } else {
+        memcpy(wireBuffer + wireBytes, buf->bufStart, tx);
+        AJ_IO_BUF_RESET(buf);
+        wireBytes += tx;
+        return AJ_OK;
+    }
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t rx = AJ_IO_BUF_SPACE(buf);
+
+    rx = min(len, rx);
+    rx = min(wireBytes, rx);
+    if (!rx) {
+        return AJ_ERR_READ;
+    } else {
+        memcpy(buf->writePtr, wireBuffer, rx);
+        memmove(wireBuffer, wireBuffer + rx, wireBytes - rx);
+        wireBytes -= rx;
+        buf->writePtr += rx;
+        return AJ_OK;
+    }
+}
+
+/*
+ * Signature of the message being marshaled, set by each test
+ */
+static const char* testSignature;
+
+static AJ_Status MsgInit(AJ_Message* msg, uint32_t msgId, uint8_t msgType)
+{
+    msg->objPath = "/test/typed";
+    msg->iface = "test.typed";
+    msg->member = "mumble";
+    msg->msgId = msgId;
+    msg->signature = testSignature;
+    return AJ_OK;
+}
+
+static AJ_BusAttachment testBus;
+static AJ_Message txMsg;
+static AJ_Message rxMsg;
+
+class TypedArgsTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        memset(&testBus, 0, sizeof(testBus));
+        wireBytes = 0;
+        AJ_IOBufInit(&testBus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+        testBus.sock.tx.send = TxFunc;
+        AJ_IOBufInit(&testBus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+        testBus.sock.rx.recv = RxFunc;
+        MutterHook = MsgInit;
+        /*
+         * Every test marshals msgId 0 with a different signature
+         */
+        AJ_ClearHeaderCache();
+    }
+
+    virtual void TearDown() {
+        MutterHook = NULL;
+    }
+
+    /*
+     * Start a signal with the signature for the argument types
+     */
+    template <typename ... T>
+    AJ_Status Start() {
+        testSignature = aj::Signature<T ...>::type::value;
+        return AJ_MarshalSignal(&testBus, &txMsg, 0, "typed.service", 0, 0, 0);
+    }
+
+    AJ_Status Deliver() {
+        AJ_Status status = AJ_DeliverMsg(&txMsg);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalMsg(&testBus, &rxMsg, 0);
+        }
+        return status;
+    }
+};
+
+TEST_F(TypedArgsTest, Signatures) {
+    EXPECT_STREQ("", (aj::Signature<>::type::value));
+    EXPECT_STREQ("ybnqiuxtd", (aj::Signature<uint8_t, bool, int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t, double>::type::value));
+    EXPECT_STREQ("ssog", (aj::Signature<const char*, std::string, aj::ObjectPath, aj::SignatureString>::type::value));
+    EXPECT_STREQ("ayaias", (aj::Signature<aj::ArrayView<uint8_t>, std::vector<int32_t>, std::vector<std::string> >::type::value));
+    EXPECT_STREQ("a{us}", (aj::Signature<std::vector<std::pair<uint32_t, std::string> > >::type::value));
+    EXPECT_STREQ("(us(ii)ab)", (aj::Signature<std::tuple<uint32_t, const char*, std::tuple<int32_t, int32_t>, std::vector<bool> > >::type::value));
+    EXPECT_EQ(5U, (aj::Signature<std::vector<std::pair<uint32_t, std::string> > >::type::length));
+}
+
+TEST_F(TypedArgsTest, Scalars) {
+    ASSERT_EQ(AJ_OK, (Start<uint8_t, bool, int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t, double>()));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, (uint8_t)0xA5, true, (int16_t)-2, (uint16_t)0xFFEE, (int32_t)-3, (uint32_t)0xDEADBEEF,
+                                     (int64_t)-4, (uint64_t)0x0123456789ABCDEFULL, 3.25));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    uint8_t y;
+    bool b;
+    int16_t n;
+    uint16_t q;
+    int32_t i;
+    uint32_t u;
+    int64_t x;
+    uint64_t t;
+    double d;
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, y, b, n, q, i, u, x, t, d));
+    EXPECT_EQ(0xA5, y);
+    EXPECT_TRUE(b);
+    EXPECT_EQ(-2, n);
+    EXPECT_EQ(0xFFEE, q);
+    EXPECT_EQ(-3, i);
+    EXPECT_EQ(0xDEADBEEF, u);
+    EXPECT_EQ(-4, x);
+    EXPECT_EQ(0x0123456789ABCDEFULL, t);
+    EXPECT_EQ(3.25, d);
+    AJ_CloseMsg(&rxMsg);
+}
+
+TEST_F(TypedArgsTest, Strings) {
+    std::string str("banana");
+    aj::ObjectPath path = { "/fruit/bowl" };
+    aj::SignatureString sig = { "a{sv}" };
+
+    ASSERT_EQ(AJ_OK, (Start<const char*, std::string, aj::ObjectPath, aj::SignatureString>()));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, "apple", str, path, sig));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    const char* s;
+    std::string copy;
+    aj::ObjectPath o;
+    aj::SignatureString g;
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, s, copy, o, g));
+    EXPECT_STREQ("apple", s);
+    EXPECT_EQ(str, copy);
+    EXPECT_STREQ("/fruit/bowl", o.value);
+    EXPECT_STREQ("a{sv}", g.value);
+    AJ_CloseMsg(&rxMsg);
+}
+
+TEST_F(TypedArgsTest, Arrays) {
+    static const uint8_t bytes[] = { 1, 2, 3, 4, 5 };
+    aj::ArrayView<uint8_t> view = { bytes, ArraySize(bytes) };
+    std::vector<uint64_t> longs;
+    std::vector<std::string> fruits;
+    std::vector<bool> flags;
+
+    longs.push_back(1);
+    longs.push_back(0xFFFFFFFFFFFFULL);
+    fruits.push_back("fig");
+    fruits.push_back("grape");
+    fruits.push_back("");
+    flags.push_back(true);
+    flags.push_back(false);
+
+    ASSERT_EQ(AJ_OK, (Start<aj::ArrayView<uint8_t>, std::vector<uint64_t>, std::vector<std::string>, std::vector<bool>, std::vector<int32_t> >()));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, view, longs, fruits, flags, std::vector<int32_t>()));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    aj::ArrayView<uint8_t> rxView;
+    std::vector<uint64_t> rxLongs;
+    std::vector<std::string> rxFruits;
+    std::vector<bool> rxFlags;
+    std::vector<int32_t> rxEmpty(3);
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, rxView, rxLongs, rxFruits, rxFlags, rxEmpty));
+    ASSERT_EQ(ArraySize(bytes), rxView.count);
+    EXPECT_EQ(0, memcmp(bytes, rxView.data, sizeof(bytes)));
+    EXPECT_EQ(longs, rxLongs);
+    EXPECT_EQ(fruits, rxFruits);
+    EXPECT_EQ(flags, rxFlags);
+    EXPECT_TRUE(rxEmpty.empty());
+    AJ_CloseMsg(&rxMsg);
+}
+
+TEST_F(TypedArgsTest, DictAndStructs) {
+    typedef std::tuple<uint32_t, std::string, std::tuple<int32_t, int32_t> > Record;
+    std::vector<std::pair<uint32_t, std::string> > dict;
+    std::vector<Record> records;
+
+    dict.push_back(std::make_pair(1U, std::string("azure")));
+    dict.push_back(std::make_pair(2U, std::string("blue")));
+    records.push_back(Record(7, "seven", std::make_tuple(-7, 7)));
+    records.push_back(Record(8, "eight", std::make_tuple(-8, 8)));
+
+    ASSERT_EQ(AJ_OK, (Start<std::vector<std::pair<uint32_t, std::string> >, std::vector<Record>, Record>()));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, dict, records, records[0]));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    std::vector<std::pair<uint32_t, std::string> > rxDict;
+    std::vector<Record> rxRecords;
+    Record rxRecord;
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, rxDict, rxRecords, rxRecord));
+    EXPECT_EQ(dict, rxDict);
+    EXPECT_EQ(records, rxRecords);
+    EXPECT_EQ(records[0], rxRecord);
+    AJ_CloseMsg(&rxMsg);
+}
+
+TEST_F(TypedArgsTest, MixedWithVarargs) {
+    /*
+     * Typed and varargs marshaling can be used for different parts of the same message
+     */
+    ASSERT_EQ(AJ_OK, (Start<uint32_t, std::string, int32_t>()));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&txMsg, "u", 42));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, std::string("answer"), (int32_t)-42));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    uint32_t u;
+    const char* s;
+    int32_t i;
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, u));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalArgs(&rxMsg, "s", &s));
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, i));
+    EXPECT_EQ(42U, u);
+    EXPECT_STREQ("answer", s);
+    EXPECT_EQ(-42, i);
+    AJ_CloseMsg(&rxMsg);
+}
+
+TEST_F(TypedArgsTest, SignatureMismatch) {
+    ASSERT_EQ(AJ_OK, (Start<uint32_t, std::string>()));
+    EXPECT_EQ(AJ_ERR_SIGNATURE, aj::MarshalArgs(&txMsg, std::string("wrong"), (uint32_t)1));
+    EXPECT_EQ(AJ_ERR_SIGNATURE, aj::MarshalArgs(&txMsg, (uint32_t)1, std::string("right"), (uint32_t)1));
+    ASSERT_EQ(AJ_OK, aj::MarshalArgs(&txMsg, (uint32_t)1, std::string("right")));
+    ASSERT_EQ(AJ_OK, Deliver());
+
+    int32_t i;
+    std::string s;
+    EXPECT_EQ(AJ_ERR_SIGNATURE, aj::UnmarshalArgs(&rxMsg, i, s));
+    uint32_t u;
+    ASSERT_EQ(AJ_OK, aj::UnmarshalArgs(&rxMsg, u, s));
+    EXPECT_EQ("right", s);
+    AJ_CloseMsg(&rxMsg);
+}